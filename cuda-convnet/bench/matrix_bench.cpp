@@ -0,0 +1,121 @@
+/*
+ * matrix_bench.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ *  Benchmark of the elementwise loops of the CPU Matrix against the former
+ *  implementation, which called the function through a pointer for every
+ *  element and went through operator() when the operands had different
+ *  layouts.
+ *
+ *  make matrixbench && OMP_NUM_THREADS=4 ./bin/matrixbench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include <matrix.h>
+#include <matrix_funcs.h>
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/*
+ * The former loops.
+ */
+static void oldApplyLoopScalar(const Matrix& m, const MTYPE scalar, MTYPE(*func)(MTYPE, MTYPE), Matrix& target) {
+    MTYPE *myPtr = m.getData();
+    MTYPE *targetPtr = target.getData();
+    for (long int i = 0; i < m.getNumElements(); i++, myPtr++, targetPtr++) {
+        *targetPtr = (*func)(*myPtr, scalar);
+    }
+}
+
+static void oldApplyLoop2(const Matrix& m, const Matrix& a, MTYPE (*func)(MTYPE,MTYPE), Matrix& target) {
+    for (long int i = 0; i < m.getNumRows(); i++) {
+        for (long int j = 0; j < m.getNumCols(); j++) {
+            target(i, j) = (*func)(m(i, j), a(i, j));
+        }
+    }
+}
+
+static void fill(Matrix& m) {
+    for (long int i = 0; i < m.getNumElements(); i++) {
+        m.getData()[i] = MYRAND - 0.5;
+    }
+}
+
+static MTYPE maxDiff(Matrix& a, Matrix& b) {
+    MTYPE d = 0;
+    for (long int i = 0; i < a.getNumRows(); i++) {
+        for (long int j = 0; j < a.getNumCols(); j++) {
+            d = fmax(d, fabs(a(i, j) - b(i, j)));
+        }
+    }
+    return d;
+}
+
+enum Op { ADD_SCALAR, BIGGER_THAN, ADD_TRANS, MULT_TRANS };
+static const char* opNames[] = { "addScalar", "biggerThan", "add (a^T)", "eltWiseMult (a^T)" };
+
+static void runOld(Op op, Matrix& m, Matrix& a, Matrix& target) {
+    switch (op) {
+    case ADD_SCALAR:  oldApplyLoopScalar(m, 0.5, &_add, target); break;
+    case BIGGER_THAN: oldApplyLoop2(m, a, &_bigger, target); break;
+    case ADD_TRANS:   oldApplyLoop2(m, a, &_add, target); break;
+    case MULT_TRANS:  oldApplyLoop2(m, a, &_mult, target); break;
+    }
+}
+
+static void runNew(Op op, Matrix& m, Matrix& a, Matrix& target) {
+    switch (op) {
+    case ADD_SCALAR:  m.addScalar(0.5, target); break;
+    case BIGGER_THAN: m.biggerThan(a, target); break;
+    case ADD_TRANS:   m.add(a, target); break;
+    case MULT_TRANS:  m.eltWiseMult(a, target); break;
+    }
+}
+
+int main() {
+    const long int sizes[] = { 64, 256, 1024, 2048 };
+    const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    printf("%-18s %6s %12s %12s %8s %10s\n", "op", "n", "old (ms)", "new (ms)", "speedup", "max diff");
+    for (int o = ADD_SCALAR; o <= MULT_TRANS; o++) {
+        Op op = (Op)o;
+        bool trans = op == ADD_TRANS || op == MULT_TRANS;
+        for (int s = 0; s < numSizes; s++) {
+            long int n = sizes[s];
+            Matrix m(n, n), b(n, n), oldTarget(n, n), newTarget(n, n);
+            fill(m);
+            fill(b);
+            // a is b seen as column-major
+            Matrix& a = trans ? b.transpose() : b;
+            int reps = (int)std::max(1L, (1L << 26) / (n * n));
+
+            double t = now();
+            for (int r = 0; r < reps; r++) {
+                runOld(op, m, a, oldTarget);
+            }
+            double tOld = (now() - t) / reps;
+            t = now();
+            for (int r = 0; r < reps; r++) {
+                runNew(op, m, a, newTarget);
+            }
+            double tNew = (now() - t) / reps;
+
+            printf("%-18s %6ld %12.3f %12.3f %8.2f %10.2e\n", opNames[op], n, tOld * 1e3, tNew * 1e3,
+                   tOld / tNew, maxDiff(oldTarget, newTarget));
+            if (trans) {
+                delete &a;
+            }
+        }
+    }
+    return 0;
+}
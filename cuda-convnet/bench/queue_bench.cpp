@@ -0,0 +1,185 @@
+/*
+ * queue_bench.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ *  Contention benchmark of the lock-free Queue against the former
+ *  mutex/condition variable queue: numProducers threads enqueue numItems
+ *  elements each, numConsumers threads dequeue them all.
+ *
+ *  make queuebench && ./bin/queuebench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+#include <queue.h>
+#include <thread.h>
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/*
+ * The former queue. It grew when full, here it is allocated for all the elements.
+ */
+template <class T>
+class MutexQueue {
+private:
+    T *_elements;
+    int _numElements;
+    int _head, _tail;
+    int _maxSize;
+    pthread_mutex_t _queueMutex;
+    pthread_cond_t _queueCV;
+public:
+    MutexQueue(int size) : _numElements(0), _head(0), _tail(0), _maxSize(size) {
+        _elements = new T[size];
+        pthread_mutex_init(&_queueMutex, NULL);
+        pthread_cond_init(&_queueCV, NULL);
+    }
+
+    ~MutexQueue() {
+        pthread_mutex_destroy(&_queueMutex);
+        pthread_cond_destroy(&_queueCV);
+        delete[] _elements;
+    }
+
+    void enqueue(const T& el) {
+        pthread_mutex_lock(&_queueMutex);
+        _elements[_tail] = el;
+        _tail = (_tail + 1) % _maxSize;
+        _numElements++;
+        pthread_cond_signal(&_queueCV);
+        pthread_mutex_unlock(&_queueMutex);
+    }
+
+    T dequeue() {
+        pthread_mutex_lock(&_queueMutex);
+        while (_numElements == 0) {
+            pthread_cond_wait(&_queueCV, &_queueMutex);
+        }
+        T el = _elements[_head];
+        _head = (_head + 1) % _maxSize;
+        _numElements--;
+        pthread_mutex_unlock(&_queueMutex);
+        return el;
+    }
+};
+
+template <class Q>
+class Producer : public Thread {
+protected:
+    Q* _queue;
+    long int _first, _numItems;
+    void* run() {
+        for (long int i = 0; i < _numItems; i++) {
+            _queue->enqueue(_first + i);
+        }
+        return NULL;
+    }
+public:
+    Producer(Q& queue, long int first, long int numItems)
+        : Thread(true), _queue(&queue), _first(first), _numItems(numItems) {
+    }
+};
+
+template <class Q>
+class Consumer : public Thread {
+protected:
+    Q* _queue;
+    long int _numItems;
+    void* run() {
+        for (long int i = 0; i < _numItems; i++) {
+            sum += _queue->dequeue();
+        }
+        return NULL;
+    }
+public:
+    long int sum;
+    Consumer(Q& queue, long int numItems) : Thread(true), _queue(&queue), _numItems(numItems), sum(0) {
+    }
+};
+
+/*
+ * Returns the throughput in millions of elements per second, checks that
+ * every element was dequeued once.
+ */
+template <class Q>
+double run(int numProducers, int numConsumers, long int numItems, int capacity, bool& ok) {
+    long int total = numItems * numProducers;
+    Q queue(capacity);
+    assert(total % numConsumers == 0);
+    std::vector<Producer<Q>*> producers;
+    std::vector<Consumer<Q>*> consumers;
+    for (int c = 0; c < numConsumers; c++) {
+        consumers.push_back(new Consumer<Q>(queue, total / numConsumers));
+    }
+    for (int p = 0; p < numProducers; p++) {
+        producers.push_back(new Producer<Q>(queue, p * numItems, numItems));
+    }
+    double t = now();
+    for (int c = 0; c < numConsumers; c++) {
+        consumers[c]->start();
+    }
+    for (int p = 0; p < numProducers; p++) {
+        producers[p]->start();
+    }
+    long int sum = 0;
+    for (int p = 0; p < numProducers; p++) {
+        producers[p]->join();
+        delete producers[p];
+    }
+    for (int c = 0; c < numConsumers; c++) {
+        consumers[c]->join();
+        sum += consumers[c]->sum;
+        delete consumers[c];
+    }
+    t = now() - t;
+    ok = sum == total * (total - 1) / 2;
+    return total / t / 1e6;
+}
+
+/*
+ * Non trivially copyable elements, through a queue smaller than the number of elements.
+ */
+static bool checkStrings() {
+    Queue<std::string> queue(4);
+    bool ok = true;
+    for (int i = 0; i < 100; i++) {
+        char buf[32];
+        sprintf(buf, "element %d", i);
+        queue.enqueue(std::string(buf) + std::string(100, 'x'));
+        std::string s = queue.dequeue();
+        ok = ok && s.compare(0, strlen(buf), buf) == 0 && s.size() == strlen(buf) + 100;
+    }
+    return ok && queue.getNumElements() == 0;
+}
+
+int main(int argc, char** argv) {
+    const int configs[][2] = { {1, 1}, {1, 4}, {4, 1}, {2, 2}, {4, 4}, {8, 8} };
+    const int numConfigs = sizeof(configs) / sizeof(configs[0]);
+    const long int numItems = argc > 1 ? atol(argv[1]) : 400000;
+
+    printf("strings: %s\n", checkStrings() ? "OK" : "FAILED");
+    printf("%9s %9s %14s %16s %8s\n", "producers", "consumers", "mutex (M/s)", "lock-free (M/s)", "speedup");
+    bool allOk = true;
+    for (int i = 0; i < numConfigs; i++) {
+        bool ok1, ok2;
+        long int total = numItems * configs[i][0];
+        double mutexRate = run<MutexQueue<long int> >(configs[i][0], configs[i][1], numItems, total + 1, ok1);
+        // small enough for the producers to wait on a full queue
+        double lockFreeRate = run<Queue<long int> >(configs[i][0], configs[i][1], numItems, 4096, ok2);
+        printf("%9d %9d %14.2f %16.2f %8.2f%s\n", configs[i][0], configs[i][1], mutexRate, lockFreeRate,
+               lockFreeRate / mutexRate, ok1 && ok2 ? "" : "  FAILED");
+        allOk = allOk && ok1 && ok2;
+    }
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+# convcheck.py
+#
+#  Created on: Oct 18, 2026
+#      Author: Troy Lee (troy.lee2008@gmail.com)
+#
+# Numerical check of the CPU convolution routines (src/common/conv_cpu.cpp)
+# against the cudaconv2 GPU routines.
+#
+# On a GPU host, store the inputs and the GPU outputs of a set of layer
+# geometries:
+#   python convcheck.py --dump=convref.pkl [--gpu=0]
+# Then, on any host, recompute the outputs on the CPU and compare:
+#   python convcheck.py --check=convref.pkl [--threads=4] [--tol=1e-4]
+
+import numpy as n
+import numpy.random as nr
+import sys
+from time import time
+from util import *
+from options import *
+
+# (name, local, numImages, numImgColors, imgSizeY, imgSizeX, filterSize,
+#  paddingStart, moduleStride, numFilters, numGroups, partialSum)
+CONFIGS = [('conv-rgb',         False, 128,  3, 16, 16, 5, -2, 1, 32, 1, 0),
+           ('conv-stride',      False,  64, 16, 12, 12, 3, -1, 2, 32, 1, 7),
+           ('conv-groups',      False, 128,  8, 12, 12, 3, -1, 2, 32, 2, 0),
+           ('conv-spectrotemp', False, 128,  1, 40, 11, 5, -2, 1, 32, 1, 0),
+           ('local',            True,   64,  3,  8,  8, 3,  0, 1, 16, 1, 1),
+           ('local-groups',     True,   64,  8,  8,  8, 3, -1, 1, 32, 2, 1)]
+
+def num_modules(img_size, filter_size, padding_start, module_stride):
+    return 1 + int(n.ceil((2 * -padding_start + img_size - filter_size) / float(module_stride)))
+
+def run_config(libmodel, cfg, data, gpu, threads):
+    (name, local, num_images, num_colors, size_y, size_x, filter_size, padding, stride, num_filters, num_groups, partial_sum) = cfg
+    modules_y = num_modules(size_y, filter_size, padding, stride)
+    modules_x = num_modules(size_x, filter_size, padding, stride)
+    num_modules_all = modules_y * modules_x
+    filter_colors = num_colors / num_groups
+    filter_rows = (num_modules_all if local else 1) * filter_colors * filter_size**2
+    weight_rows = (num_modules_all / (partial_sum if partial_sum > 0 else num_modules_all)) * filter_colors * filter_size**2
+
+    if 'images' not in data:
+        data['images'] = n.require(nr.randn(num_colors * size_y * size_x, num_images), dtype=n.single, requirements='C')
+        data['filters'] = n.require(nr.randn(filter_rows, num_filters) * 0.1, dtype=n.single, requirements='C')
+        data['hidActs'] = n.require(nr.randn(num_filters * num_modules_all, num_images), dtype=n.single, requirements='C')
+
+    out = {}
+    out['filterActs'] = n.zeros((num_filters * num_modules_all, num_images), dtype=n.single)
+    libmodel.runFilterActs(data['images'], data['filters'], out['filterActs'],
+                           size_y, modules_y, modules_x, padding, stride, num_colors, num_groups, int(local), int(gpu), threads)
+    out['imgActs'] = n.zeros((num_colors * size_y * size_x, num_images), dtype=n.single)
+    libmodel.runImgActs(data['hidActs'], data['filters'], out['imgActs'],
+                        size_y, size_x, modules_y, padding, stride, num_colors, num_groups, int(local), int(gpu), threads)
+    out['weightActs'] = n.zeros((weight_rows, num_filters), dtype=n.single)
+    libmodel.runWeightActs(data['images'], data['hidActs'], out['weightActs'],
+                           size_y, modules_y, modules_x, filter_size, padding, stride, num_colors, num_groups, partial_sum,
+                           int(local), int(gpu), threads)
+    return out
+
+def get_options_parser():
+    op = OptionsParser()
+    op.add_option("dump", "dump", StringOptionParser, "Store the inputs and GPU outputs to this file", default="")
+    op.add_option("check", "check", StringOptionParser, "Check the CPU outputs against the GPU outputs in this file", default="")
+    op.add_option("gpu", "gpu", IntegerOptionParser, "GPU to use for --dump (-1 for the fastest)", default=-1)
+    op.add_option("threads", "threads", IntegerOptionParser, "Number of CPU threads", default=1)
+    op.add_option("tol", "tol", FloatOptionParser, "Tolerance on the max error relative to the max output", default=1e-4)
+    op.add_option("model-name", "model_name", StringOptionParser, "Name of the compiled module", default="ConvNet")
+    return op
+
+if __name__ == "__main__":
+    op = get_options_parser()
+    op.parse()
+    dump, check = op.get_value('dump'), op.get_value('check')
+    if (dump == "") == (check == ""):
+        print "Give one of --dump or --check"
+        sys.exit(1)
+    libmodel = __import__('_' + op.get_value('model_name'))
+
+    if dump != "":
+        libmodel.initConvDevice(op.get_value('gpu'))
+        ref = []
+        for cfg in CONFIGS:
+            data = {}
+            data['outputs'] = run_config(libmodel, cfg, data, True, 1)
+            data['config'] = cfg
+            ref += [data]
+            print "%-18s stored" % cfg[0]
+        pickle(dump, ref)
+        sys.exit(0)
+
+    failed = 0
+    for data in unpickle(check):
+        cfg = data['config']
+        t = time()
+        outputs = run_config(libmodel, cfg, data, False, op.get_value('threads'))
+        t = time() - t
+        for routine in ('filterActs', 'imgActs', 'weightActs'):
+            ref = data['outputs'][routine]
+            err = n.abs(outputs[routine] - ref).max() / max(n.abs(ref).max(), 1e-20)
+            ok = err <= op.get_value('tol')
+            failed += not ok
+            print "%-18s %-10s rel. error %.3e %s" % (cfg[0], routine, err, "OK" if ok else "FAILED")
+        print "%-18s cpu time %.3fs" % (cfg[0], t)
+    if failed > 0:
+        print "%d checks FAILED" % failed
+        sys.exit(1)
+    print "All checks passed"
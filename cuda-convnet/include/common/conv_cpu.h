@@ -0,0 +1,70 @@
+/*
+ * conv_cpu.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ *  CPU versions of the cudaconv2 routines (filterActs, imgActs, weightActs),
+ *  with the same matrix layouts and parameters as in cudaconv2.cuh:
+ *
+ *  images:      (numImgColors, imgSizeY, imgSizeX, numImages)
+ *  filters:     (numFilterColors, filterPixels, numFilters)             if conv
+ *               (numModules, numFilterColors, filterPixels, numFilters) otherwise
+ *  hidActs:     (numFilters, numModulesY, numModulesX, numImages)
+ *
+ *  For every module, the pixels under the filter are gathered into a
+ *  (numFilterColors * filterPixels, numImages) patch (im2col), with zeros
+ *  for the padding, and multiplied with the filters of each group by one
+ *  GEMM. The image batch is split over numThreads threads.
+ *
+ *  targets = scaleTargets * targets + scaleOutput * result, as on the GPU.
+ */
+
+#ifndef CONV_CPU_H_
+#define CONV_CPU_H_
+
+#include <matrix.h>
+
+/*
+ * targets:     (numFilters, numModulesY, numModulesX, numImages)
+ */
+void convFilterActsCPU(Matrix& images, Matrix& filters, Matrix& targets,
+                       int imgSizeY, int numModulesY, int numModulesX, int paddingStart, int moduleStride,
+                       int numImgColors, int numGroups,
+                       MTYPE scaleTargets = 0, MTYPE scaleOutput = 1, int numThreads = 1);
+
+void localFilterActsCPU(Matrix& images, Matrix& filters, Matrix& targets,
+                        int imgSizeY, int numModulesY, int numModulesX, int paddingStart, int moduleStride,
+                        int numImgColors, int numGroups,
+                        MTYPE scaleTargets = 0, MTYPE scaleOutput = 1, int numThreads = 1);
+
+/*
+ * targets:     (numImgColors, imgSizeY, imgSizeX, numImages)
+ */
+void convImgActsCPU(Matrix& hidActs, Matrix& filters, Matrix& targets,
+                    int imgSizeY, int imgSizeX, int numModulesY, int paddingStart, int moduleStride,
+                    int numImgColors, int numGroups,
+                    MTYPE scaleTargets = 0, MTYPE scaleOutput = 1, int numThreads = 1);
+
+void localImgActsCPU(Matrix& hidActs, Matrix& filters, Matrix& targets,
+                     int imgSizeY, int imgSizeX, int numModulesY, int paddingStart, int moduleStride,
+                     int numImgColors, int numGroups,
+                     MTYPE scaleTargets = 0, MTYPE scaleOutput = 1, int numThreads = 1);
+
+/*
+ * targets:     (numModules/partialSum, numFilterColors, filterPixels, numFilters)   if conv
+ *              (numModules, numFilterColors, filterPixels, numFilters)              otherwise
+ *
+ * partialSum = 0 sums over all the modules.
+ */
+void convWeightActsCPU(Matrix& images, Matrix& hidActs, Matrix& targets,
+                       int imgSizeY, int numModulesY, int numModulesX, int filterSize, int paddingStart,
+                       int moduleStride, int numImgColors, int numGroups, int partialSum,
+                       MTYPE scaleTargets = 0, MTYPE scaleOutput = 1, int numThreads = 1);
+
+void localWeightActsCPU(Matrix& images, Matrix& hidActs, Matrix& targets,
+                        int imgSizeY, int numModulesY, int numModulesX, int filterSize, int paddingStart,
+                        int moduleStride, int numImgColors, int numGroups,
+                        MTYPE scaleTargets = 0, MTYPE scaleOutput = 1, int numThreads = 1);
+
+#endif /* CONV_CPU_H_ */
@@ -118,11 +118,12 @@ private:
     MTYPE _aggregateRow(long int row, MTYPE(*agg_func)(MTYPE, MTYPE), MTYPE initialValue) const;
     MTYPE _aggregateCol(long int row, MTYPE(*agg_func)(MTYPE, MTYPE), MTYPE initialValue) const;
     void _updateDims(long int numRows, long int numCols);
-    void _applyLoop(MTYPE(*func)(MTYPE));
-    void _applyLoop(MTYPE (*func)(MTYPE), Matrix& target);
-    void _applyLoop2(const Matrix& a, MTYPE(*func)(MTYPE, MTYPE), Matrix& target) const;
-    void _applyLoop2(const Matrix& a, MTYPE (*func)(MTYPE,MTYPE, MTYPE), MTYPE scalar, Matrix& target) const;
-    void _applyLoopScalar(const MTYPE scalar, MTYPE(*func)(MTYPE, MTYPE), Matrix& target) const;
+    template <MTYPE (*func)(MTYPE)> void _applyLoop();
+    template <MTYPE (*func)(MTYPE)> void _applyLoop(Matrix& target);
+    template <MTYPE (*func)(MTYPE, MTYPE)> void _applyLoop2(const Matrix& a, Matrix& target) const;
+    template <MTYPE (*func)(MTYPE, MTYPE, MTYPE)> void _applyLoop2(const Matrix& a, MTYPE scalar, Matrix& target) const;
+    template <MTYPE (*func)(MTYPE, MTYPE)> void _applyLoopScalar(const MTYPE scalar, Matrix& target) const;
+    template <class Op> void _applyLoop2Op(const Matrix& a, Op op, Matrix& target) const;
     void _checkBounds(long int startRow, long int endRow, long int startCol, long int endCol) const;
     void _divideByVector(const Matrix& vec, Matrix& target);
     inline long int _getNumColsBackEnd() const {
@@ -131,4 +131,42 @@ inline MTYPE _notEqual(MTYPE x, MTYPE y) {
     return x != y;
 }
 
+/*
+ * Functors around the functions above, for the elementwise loops of Matrix.
+ * The function is a template argument, so the calls are inlined.
+ */
+template <MTYPE (*func)(MTYPE)>
+struct UnaryOp {
+    inline MTYPE operator()(MTYPE x) const {
+        return func(x);
+    }
+};
+
+template <MTYPE (*func)(MTYPE, MTYPE)>
+struct BinaryOp {
+    inline MTYPE operator()(MTYPE x, MTYPE y) const {
+        return func(x, y);
+    }
+};
+
+template <MTYPE (*func)(MTYPE, MTYPE)>
+struct ScalarOp {
+    MTYPE scalar;
+    explicit ScalarOp(MTYPE s) : scalar(s) {
+    }
+    inline MTYPE operator()(MTYPE x) const {
+        return func(x, scalar);
+    }
+};
+
+template <MTYPE (*func)(MTYPE, MTYPE, MTYPE)>
+struct BinaryScalarOp {
+    MTYPE scalar;
+    explicit BinaryScalarOp(MTYPE s) : scalar(s) {
+    }
+    inline MTYPE operator()(MTYPE x, MTYPE y) const {
+        return func(x, y, scalar);
+    }
+};
+
 #endif /* MATRIX_FUNCS_H_ */
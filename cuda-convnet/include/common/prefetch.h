@@ -0,0 +1,85 @@
+/*
+ * prefetch.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ *  Background gathering of minibatches into a ring of host buffers.
+ *
+ *  The data matrices hold the cases along their leading dimension, as in
+ *  DataProvider. A thread copies minibatches 0, 1, 2, ... into the free
+ *  buffers of the ring, so the next numBuffers minibatches are ready while
+ *  the current one is used. The buffers are allocated by the given
+ *  functions, e.g. pinned memory for faster host to device copies; by
+ *  default they are plain aligned memory. The thread starts with the
+ *  constructor.
+ */
+
+#ifndef PREFETCH_H_
+#define PREFETCH_H_
+
+#include <vector>
+#include <matrix.h>
+#include <queue.h>
+#include <thread.h>
+
+typedef void* (*HostAllocFunc)(size_t numBytes);
+typedef void (*HostFreeFunc)(void* ptr);
+
+void* alignedHostAlloc(size_t numBytes);
+void alignedHostFree(void* ptr);
+
+class MinibatchPrefetcher : public Thread {
+protected:
+    struct Buffer {
+        std::vector<MTYPE*> data;
+        std::vector<Matrix*> mats;
+    };
+
+    std::vector<Matrix*>* _data;
+    int _minibatchSize, _numCases, _numMinibatches;
+    HostFreeFunc _free;
+    std::vector<Buffer> _buffers;
+    Queue<int> _freeBuffers, _readyBuffers;
+    volatile bool _stopping;
+    bool _joined;
+
+    // consumer side
+    int _next, _current;
+    int _numAcquired, _numHits;
+    double _stallTime;
+
+    void fill(Buffer& buf, int idx);
+    void* run();
+public:
+    MinibatchPrefetcher(std::vector<Matrix*>& data, int minibatchSize, int numBuffers,
+                        HostAllocFunc allocFunc = &alignedHostAlloc, HostFreeFunc freeFunc = &alignedHostFree);
+    ~MinibatchPrefetcher();
+
+    /*
+     * Index of the minibatch the next acquire() returns, or -1 when all
+     * the minibatches were returned.
+     */
+    int getNextMinibatch() const;
+
+    /*
+     * Blocks until the next minibatch is ready. The matrices stay valid
+     * until release().
+     */
+    std::vector<Matrix*>& acquire();
+    void release();
+
+    /*
+     * Stops the thread before it gathers all the minibatches.
+     */
+    void stop();
+
+    int getNumAcquired() const;
+    // minibatches that were ready when acquired
+    int getNumHits() const;
+    // seconds spent waiting in acquire()
+    double getStallTime() const;
+    void printStats() const;
+};
+
+#endif /* PREFETCH_H_ */
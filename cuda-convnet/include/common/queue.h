@@ -26,86 +26,203 @@
 
 #ifndef QUEUE_H_
 #define QUEUE_H_
-#include <pthread.h>
-#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+#include <stddef.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#define QUEUE_DEFAULT_CAPACITY  1024
+// empty polls before a consumer yields, then sleeps
+#define QUEUE_SPIN_ITERS        64
+#define QUEUE_YIELD_ITERS       16
 
 /*
- * A thread-safe circular queue that automatically grows but never shrinks.
+ * A bounded lock-free multi-producer/multi-consumer queue (D. Vyukov's
+ * ring of sequenced cells). Producers and consumers only contend on one
+ * compare-and-swap each; there is no lock.
+ *
+ * dequeue() blocks until an element is available: it backs off by spinning,
+ * then yielding, then sleeping on a futex. enqueue() does not block, unless
+ * the queue is full, in which case it backs off until an element is
+ * dequeued. The capacity is rounded up to a power of 2.
+ *
+ * The elements are copied by assignment, so T only has to be default
+ * constructible and assignable.
  */
 template <class T>
 class Queue {
 private:
-    T *_elements;
-    int _numElements;
-    int _head, _tail;
-    int _maxSize;
-    pthread_mutex_t *_queueMutex;
-    pthread_cond_t *_queueCV;
-
-    void _init(int initialSize) {
-        _numElements = 0;
-        _head = 0;
-        _tail = 0;
-        _maxSize = initialSize;
-        _elements = new T[initialSize];
-        _queueCV = (pthread_cond_t*)(malloc(sizeof (pthread_cond_t)));
-        _queueMutex = (pthread_mutex_t*)(malloc(sizeof (pthread_mutex_t)));
-        pthread_mutex_init(_queueMutex, NULL);
-        pthread_cond_init(_queueCV, NULL);
+    struct Cell {
+        volatile size_t seq;
+        T el;
+    };
+
+    // the positions are written by different threads, keep them on separate cache lines
+    char _pad0[64];
+    volatile size_t _enqueuePos;
+    char _pad1[64 - sizeof(size_t)];
+    volatile size_t _dequeuePos;
+    char _pad2[64 - sizeof(size_t)];
+    // futex word, bumped on every enqueue, and the number of sleeping consumers
+    volatile int _signal;
+    volatile int _numWaiters;
+
+    Cell *_cells;
+    size_t _mask;
+
+    void _init(int capacity) {
+        size_t size = 2;
+        while (size < (size_t)capacity) {
+            size *= 2;
+        }
+        _mask = size - 1;
+        _cells = new Cell[size];
+        for (size_t i = 0; i < size; i++) {
+            _cells[i].seq = i;
+        }
+        _enqueuePos = 0;
+        _dequeuePos = 0;
+        _signal = 0;
+        _numWaiters = 0;
+    }
+
+    static inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+        __asm__ __volatile__("pause");
+#endif
+    }
+
+    static void backoff(int iter) {
+        if (iter < QUEUE_SPIN_ITERS) {
+            for (int i = 0; i < (1 << (iter / 16)); i++) {
+                cpuRelax();
+            }
+        } else {
+            sched_yield();
+        }
+    }
+
+    void wait(int signal) {
+#ifdef __linux__
+        syscall(SYS_futex, &_signal, FUTEX_WAIT_PRIVATE, signal, NULL, NULL, 0);
+#else
+        struct timespec ts = {0, 50000};
+        nanosleep(&ts, NULL);
+#endif
     }
 
-    void expand() {
-        T *newStorage = new T[_maxSize * 2];
-        memcpy(newStorage, _elements + _head, (_maxSize - _head) * sizeof(T));
-        memcpy(newStorage + _maxSize - _head, _elements, _tail * sizeof(T));
-        delete[] _elements;
-        _elements = newStorage;
-        _head = 0;
-        _tail = _numElements;
-        _maxSize *= 2;
+    void wake() {
+#ifdef __linux__
+        syscall(SYS_futex, &_signal, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
     }
 public:
-    Queue(int initialSize) {
-        _init(initialSize);
+    Queue(int capacity) {
+        _init(capacity);
     }
 
     Queue()  {
-        _init(1);
+        _init(QUEUE_DEFAULT_CAPACITY);
     }
 
     ~Queue() {
-        pthread_mutex_destroy(_queueMutex);
-        pthread_cond_destroy(_queueCV);
-        delete[] _elements;
-        free(_queueMutex);
-        free(_queueCV);
+        delete[] _cells;
+    }
+
+    /*
+     * Returns false if the queue is full.
+     */
+    bool tryEnqueue(const T& el) {
+        Cell *cell;
+        size_t pos = _enqueuePos;
+        while (true) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq;
+            __sync_synchronize();
+            long int dif = (long int)seq - (long int)pos;
+            if (dif == 0) {
+                if (__sync_bool_compare_and_swap(&_enqueuePos, pos, pos + 1)) {
+                    break;
+                }
+                pos = _enqueuePos;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = _enqueuePos;
+            }
+        }
+        cell->el = el;
+        __sync_synchronize();
+        cell->seq = pos + 1;
+
+        // the full barrier orders the publication before reading _numWaiters
+        __sync_fetch_and_add(&_signal, 1);
+        if (_numWaiters > 0) {
+            wake();
+        }
+        return true;
     }
 
-    void enqueue(T el) {
-        pthread_mutex_lock(_queueMutex);
-        if(_numElements == _maxSize) {
-            expand();
+    void enqueue(const T& el) {
+        for (int iter = 0; !tryEnqueue(el); iter++) {
+            backoff(iter);
         }
-        _elements[_tail] = el;
-        _tail = (_tail + 1) % _maxSize;
-        _numElements++;
+    }
 
-        pthread_cond_signal(_queueCV);
-        pthread_mutex_unlock(_queueMutex);
+    /*
+     * Returns false if the queue is empty.
+     */
+    bool tryDequeue(T& el) {
+        Cell *cell;
+        size_t pos = _dequeuePos;
+        while (true) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq;
+            __sync_synchronize();
+            long int dif = (long int)seq - (long int)(pos + 1);
+            if (dif == 0) {
+                if (__sync_bool_compare_and_swap(&_dequeuePos, pos, pos + 1)) {
+                    break;
+                }
+                pos = _dequeuePos;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = _dequeuePos;
+            }
+        }
+        el = cell->el;
+        cell->el = T();
+        __sync_synchronize();
+        cell->seq = pos + _mask + 1;
+        return true;
     }
 
     /*
      * Blocks until not empty.
      */
     T dequeue() {
-        pthread_mutex_lock(_queueMutex);
-        if(_numElements == 0) {
-            pthread_cond_wait(_queueCV, _queueMutex);
+        T el;
+        for (int iter = 0; !tryDequeue(el); iter++) {
+            if (iter < QUEUE_SPIN_ITERS + QUEUE_YIELD_ITERS) {
+                backoff(iter);
+                continue;
+            }
+            // announce the wait before checking again, so that an enqueue
+            // either is seen here or sees _numWaiters > 0
+            int signal = _signal;
+            __sync_fetch_and_add(&_numWaiters, 1);
+            if (tryDequeue(el)) {
+                __sync_fetch_and_sub(&_numWaiters, 1);
+                break;
+            }
+            wait(signal);
+            __sync_fetch_and_sub(&_numWaiters, 1);
         }
-        T el = _elements[_head];
-        _head = (_head + 1) % _maxSize;
-        _numElements--;
-        pthread_mutex_unlock(_queueMutex);
         return el;
     }
 
@@ -113,7 +230,12 @@ public:
      * Obviously this number can change by the time you actually look at it.
      */
     inline int getNumElements() const {
-        return _numElements;
+        long int n = (long int)(_enqueuePos - _dequeuePos);
+        return n < 0 ? 0 : (int)n;
+    }
+
+    inline int getCapacity() const {
+        return (int)(_mask + 1);
     }
 };
 
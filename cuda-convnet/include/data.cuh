@@ -29,6 +29,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <prefetch.h>
 #include "util.cuh"
 
 template <class T>
@@ -84,8 +85,12 @@ protected:
     NVMatrixV _data;
     int _minibatchSize;
     long int _dataSize;
+    int _numPrefetch;
+    MinibatchPrefetcher* _prefetcher;
+
+    GPUData& copyToDevice(MatrixV& hData);
 public:
-    DataProvider(int minibatchSize);
+    DataProvider(int minibatchSize, int numPrefetch=PREFETCH_MINIBATCHES);
     GPUData& operator[](int idx);
     void setData(CPUData&);
     void clearData();
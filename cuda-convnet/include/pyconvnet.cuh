@@ -40,6 +40,10 @@ PyObject* checkGradients(PyObject *self, PyObject *args);
 PyObject* syncWithHost(PyObject *self, PyObject *args);
 PyObject* startMultiviewTest(PyObject *self, PyObject *args);
 PyObject* startFeatureWriter(PyObject *self, PyObject *args);
+PyObject* initConvDevice(PyObject *self, PyObject *args);
+PyObject* runFilterActs(PyObject *self, PyObject *args);
+PyObject* runImgActs(PyObject *self, PyObject *args);
+PyObject* runWeightActs(PyObject *self, PyObject *args);
 
 #endif	/* PYCONVNET3_CUH */
 
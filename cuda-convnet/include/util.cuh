@@ -52,6 +52,12 @@ enum PASS_TYPE {PASS_TRAIN, PASS_TEST, PASS_GC};
  */ 
 #define MAX_DATA_ON_GPU             200 
 
+/*
+ * When the data is not stored on the GPU, gather up to this many minibatches
+ * ahead into pinned host memory, in a background thread.
+ */
+#define PREFETCH_MINIBATCHES        3
+
 typedef std::vector<Matrix*> MatrixV;
 typedef std::vector<NVMatrix*> NVMatrixV;
 typedef std::map<std::string,std::vector<double>*> CostMap;
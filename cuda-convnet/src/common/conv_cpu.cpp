@@ -0,0 +1,423 @@
+/*
+ * conv_cpu.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ */
+
+#include <vector>
+#include <algorithm>
+
+#include <conv_cpu.h>
+#include <thread.h>
+
+using namespace std;
+
+struct ConvArgs {
+    int numImages, numImgColors, numGroups, numFilterColors, numFilters, numFiltersPerGroup;
+    int imgSizeY, imgSizeX, imgPixels;
+    int filterSize, filterPixels;
+    int numModulesY, numModulesX, numModules;
+    int paddingStart, moduleStride;
+    int partialSum;
+    bool conv;
+
+    // images or hidActs, filters or hidActs, targets
+    const MTYPE* a;
+    const MTYPE* b;
+    MTYPE* targets;
+    MTYPE scaleTargets, scaleOutput;
+
+    inline long int patchSize() const {
+        return (long int)numFilterColors * filterPixels;
+    }
+    inline const MTYPE* moduleFilters(const MTYPE* filters, int module, int group) const {
+        return filters + (conv ? 0 : module * patchSize() * numFilters) + group * numFiltersPerGroup;
+    }
+    // first row of the group in a (numFilters, numModules, numImages) matrix
+    inline long int hidActsOffset(int module, int group) const {
+        return ((long int)group * numFiltersPerGroup * numModules + module) * numImages;
+    }
+};
+
+/*
+ * Gathers the pixels of the images [imgStart, imgStart+n) under the filter
+ * of the module into patch: (numFilterColors, filterPixels, n).
+ */
+static void _im2col(const ConvArgs& args, const MTYPE* images, int module, int group,
+                    int imgStart, int n, MTYPE* patch) {
+    int y0 = args.paddingStart + (module / args.numModulesX) * args.moduleStride;
+    int x0 = args.paddingStart + (module % args.numModulesX) * args.moduleStride;
+    for (int c = 0; c < args.numFilterColors; c++) {
+        int color = group * args.numFilterColors + c;
+        for (int fy = 0; fy < args.filterSize; fy++) {
+            for (int fx = 0; fx < args.filterSize; fx++) {
+                int y = y0 + fy, x = x0 + fx;
+                MTYPE* dst = patch + ((long int)c * args.filterPixels + fy * args.filterSize + fx) * n;
+                if (y >= 0 && y < args.imgSizeY && x >= 0 && x < args.imgSizeX) {
+                    const MTYPE* src = images + ((long int)color * args.imgPixels + y * args.imgSizeX + x) * args.numImages + imgStart;
+                    memcpy(dst, src, n * sizeof(MTYPE));
+                } else {
+                    fill(dst, dst + n, (MTYPE)0);
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Adds patch: (numFilterColors, filterPixels, n) back to the pixels under
+ * the filter of the module, the padding is dropped.
+ */
+static void _col2im(const ConvArgs& args, const MTYPE* patch, int module, int group,
+                    int imgStart, int n, MTYPE* images) {
+    int y0 = args.paddingStart + (module / args.numModulesX) * args.moduleStride;
+    int x0 = args.paddingStart + (module % args.numModulesX) * args.moduleStride;
+    for (int c = 0; c < args.numFilterColors; c++) {
+        int color = group * args.numFilterColors + c;
+        for (int fy = 0; fy < args.filterSize; fy++) {
+            int y = y0 + fy;
+            if (y < 0 || y >= args.imgSizeY) {
+                continue;
+            }
+            for (int fx = 0; fx < args.filterSize; fx++) {
+                int x = x0 + fx;
+                if (x < 0 || x >= args.imgSizeX) {
+                    continue;
+                }
+                const MTYPE* src = patch + ((long int)c * args.filterPixels + fy * args.filterSize + fx) * n;
+                MTYPE* dst = images + ((long int)color * args.imgPixels + y * args.imgSizeX + x) * args.numImages + imgStart;
+                for (int i = 0; i < n; i++) {
+                    dst[i] += src[i];
+                }
+            }
+        }
+    }
+}
+
+/*
+ * a: images, b: filters
+ */
+static void _filterActsRange(const ConvArgs& args, int imgStart, int imgEnd, MTYPE* /*out*/) {
+    int n = imgEnd - imgStart;
+    long int K = args.patchSize();
+    vector<MTYPE> patch(K * n);
+    for (int m = 0; m < args.numModules; m++) {
+        for (int g = 0; g < args.numGroups; g++) {
+            _im2col(args, args.a, m, g, imgStart, n, &patch[0]);
+            CBLAS_GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, args.numFiltersPerGroup, n, K,
+                       args.scaleOutput, args.moduleFilters(args.b, m, g), args.numFilters, &patch[0], n,
+                       args.scaleTargets, args.targets + args.hidActsOffset(m, g) + imgStart,
+                       (long int)args.numModules * args.numImages);
+        }
+    }
+}
+
+/*
+ * a: hidActs, b: filters
+ */
+static void _imgActsRange(const ConvArgs& args, int imgStart, int imgEnd, MTYPE* /*out*/) {
+    int n = imgEnd - imgStart;
+    long int K = args.patchSize();
+    for (long int r = 0; r < (long int)args.numImgColors * args.imgPixels; r++) {
+        MTYPE* row = args.targets + r * args.numImages + imgStart;
+        for (int i = 0; i < n; i++) {
+            row[i] = args.scaleTargets == 0 ? 0 : args.scaleTargets * row[i];
+        }
+    }
+    vector<MTYPE> patch(K * n);
+    for (int m = 0; m < args.numModules; m++) {
+        for (int g = 0; g < args.numGroups; g++) {
+            CBLAS_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, K, n, args.numFiltersPerGroup,
+                       args.scaleOutput, args.moduleFilters(args.b, m, g), args.numFilters,
+                       args.a + args.hidActsOffset(m, g) + imgStart, (long int)args.numModules * args.numImages,
+                       0, &patch[0], n);
+            _col2im(args, &patch[0], m, g, imgStart, n, args.targets);
+        }
+    }
+}
+
+/*
+ * a: images, b: hidActs, the sums over the images of the range are added to out
+ */
+static void _weightActsRange(const ConvArgs& args, int imgStart, int imgEnd, MTYPE* out) {
+    int n = imgEnd - imgStart;
+    long int K = args.patchSize();
+    vector<MTYPE> patch(K * n);
+    for (int m = 0; m < args.numModules; m++) {
+        int chunk = m / args.partialSum;
+        for (int g = 0; g < args.numGroups; g++) {
+            _im2col(args, args.a, m, g, imgStart, n, &patch[0]);
+            CBLAS_GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, K, args.numFiltersPerGroup, n,
+                       1, &patch[0], n,
+                       args.b + args.hidActsOffset(m, g) + imgStart, (long int)args.numModules * args.numImages,
+                       1, out + chunk * K * args.numFilters + g * args.numFiltersPerGroup, args.numFilters);
+        }
+    }
+}
+
+typedef void (*ConvRangeFunc)(const ConvArgs& args, int imgStart, int imgEnd, MTYPE* out);
+
+class ConvRangeThread : public Thread {
+private:
+    const ConvArgs* _args;
+    ConvRangeFunc _func;
+    int _imgStart, _imgEnd;
+    MTYPE* _out;
+protected:
+    void* run() {
+        _func(*_args, _imgStart, _imgEnd, _out);
+        return NULL;
+    }
+public:
+    ConvRangeThread(const ConvArgs* args, ConvRangeFunc func, int imgStart, int imgEnd, MTYPE* out)
+        : Thread(true), _args(args), _func(func), _imgStart(imgStart), _imgEnd(imgEnd), _out(out) {
+    }
+};
+
+/*
+ * Splits the images over the threads, outs[t] is given to thread t.
+ */
+static void _runOverImages(const ConvArgs& args, ConvRangeFunc func, int numThreads, vector<MTYPE*>& outs) {
+    if (numThreads <= 1) {
+        func(args, 0, args.numImages, outs[0]);
+        return;
+    }
+    vector<ConvRangeThread*> threads(numThreads);
+    for (int t = 0; t < numThreads; t++) {
+        int imgStart = (long int)args.numImages * t / numThreads;
+        int imgEnd = (long int)args.numImages * (t + 1) / numThreads;
+        threads[t] = new ConvRangeThread(&args, func, imgStart, imgEnd, outs[t]);
+        threads[t]->start();
+    }
+    for (int t = 0; t < numThreads; t++) {
+        threads[t]->join();
+        delete threads[t];
+    }
+}
+
+static void _initArgs(ConvArgs& args, int numImages, int numImgColors, int numGroups, int numFilters,
+                      int imgSizeY, int imgSizeX, int filterSize, int numModulesY, int numModulesX,
+                      int paddingStart, int moduleStride, bool conv) {
+    args.numImages = numImages;
+    args.numImgColors = numImgColors;
+    args.numGroups = numGroups;
+    args.numFilterColors = numImgColors / numGroups;
+    args.numFilters = numFilters;
+    args.numFiltersPerGroup = numFilters / numGroups;
+    args.imgSizeY = imgSizeY;
+    args.imgSizeX = imgSizeX;
+    args.imgPixels = imgSizeY * imgSizeX;
+    args.filterSize = filterSize;
+    args.filterPixels = filterSize * filterSize;
+    args.numModulesY = numModulesY;
+    args.numModulesX = numModulesX;
+    args.numModules = numModulesY * numModulesX;
+    args.paddingStart = paddingStart;
+    args.moduleStride = moduleStride;
+    args.partialSum = 1;
+    args.conv = conv;
+
+    assert(numImgColors % numGroups == 0);
+    assert(numFilters % numGroups == 0);
+    assert(paddingStart <= 0);
+    assert(moduleStride <= filterSize);
+}
+
+static int _numThreads(int numThreads, int numImages) {
+    return max(1, min(numThreads, numImages));
+}
+
+void _filterActsCPU(Matrix& images, Matrix& filters, Matrix& targets,
+                    int imgSizeY, int numModulesY, int numModulesX, int paddingStart, int moduleStride,
+                    int numImgColors, int numGroups,
+                    MTYPE scaleTargets, MTYPE scaleOutput, int numThreads, bool conv) {
+    int numFilterColors = numImgColors / numGroups;
+    int numFilters = filters.getNumCols();
+    int numModules = numModulesY * numModulesX;
+    int numImages = images.getNumCols();
+    int imgPixels = images.getNumRows() / numImgColors;
+    int imgSizeX = imgPixels / imgSizeY;
+    int filterModuleMult = conv ? 1 : numModules;
+    int filterPixels = filters.getNumRows() / (filterModuleMult * numFilterColors);
+    int filterSize = int(sqrt(filterPixels));
+
+    assert(images.getNumRows() == imgPixels * numImgColors);
+    assert(imgSizeY * imgSizeX == imgPixels);
+    assert(filterSize * filterSize == filterPixels);
+    assert(filters.getNumRows() == filterModuleMult * numFilterColors * filterPixels);
+    assert(!images.isTrans());
+    assert(!filters.isTrans());
+    assert(!targets.isTrans());
+
+    if (scaleTargets == 0) {
+        targets.resize(numFilters * numModules, numImages);
+    } else {
+        assert(targets.getNumRows() == numFilters * numModules);
+        assert(targets.getNumCols() == numImages);
+    }
+
+    ConvArgs args;
+    _initArgs(args, numImages, numImgColors, numGroups, numFilters, imgSizeY, imgSizeX, filterSize,
+              numModulesY, numModulesX, paddingStart, moduleStride, conv);
+    args.a = images.getData();
+    args.b = filters.getData();
+    args.targets = targets.getData();
+    args.scaleTargets = scaleTargets;
+    args.scaleOutput = scaleOutput;
+
+    numThreads = _numThreads(numThreads, numImages);
+    vector<MTYPE*> outs(numThreads, (MTYPE*)NULL);
+    _runOverImages(args, &_filterActsRange, numThreads, outs);
+}
+
+void _imgActsCPU(Matrix& hidActs, Matrix& filters, Matrix& targets,
+                 int imgSizeY, int imgSizeX, int numModulesY, int paddingStart, int moduleStride,
+                 int numImgColors, int numGroups,
+                 MTYPE scaleTargets, MTYPE scaleOutput, int numThreads, bool conv) {
+    int numFilterColors = numImgColors / numGroups;
+    int numImages = hidActs.getNumCols();
+    int numFilters = filters.getNumCols();
+    int numModules = hidActs.getNumRows() / numFilters;
+    int filterModuleMult = conv ? 1 : numModules;
+    int filterPixels = filters.getNumRows() / (filterModuleMult * numFilterColors);
+    int filterSize = int(sqrt(filterPixels));
+    int imgPixels = imgSizeY * imgSizeX;
+    int numModulesX = numModules / numModulesY;
+
+    assert(filterPixels == filterSize * filterSize);
+    assert(hidActs.getNumRows() == numModules * numFilters);
+    assert(filters.getNumRows() == filterModuleMult * numFilterColors * filterPixels);
+    assert(numModules == numModulesY * numModulesX);
+    assert(!hidActs.isTrans());
+    assert(!filters.isTrans());
+    assert(!targets.isTrans());
+
+    if (scaleTargets == 0) {
+        targets.resize(numImgColors * imgPixels, numImages);
+    } else {
+        assert(targets.getNumRows() == numImgColors * imgPixels);
+        assert(targets.getNumCols() == numImages);
+    }
+
+    ConvArgs args;
+    _initArgs(args, numImages, numImgColors, numGroups, numFilters, imgSizeY, imgSizeX, filterSize,
+              numModulesY, numModulesX, paddingStart, moduleStride, conv);
+    args.a = hidActs.getData();
+    args.b = filters.getData();
+    args.targets = targets.getData();
+    args.scaleTargets = scaleTargets;
+    args.scaleOutput = scaleOutput;
+
+    numThreads = _numThreads(numThreads, numImages);
+    vector<MTYPE*> outs(numThreads, (MTYPE*)NULL);
+    _runOverImages(args, &_imgActsRange, numThreads, outs);
+}
+
+void _weightActsCPU(Matrix& images, Matrix& hidActs, Matrix& targets,
+                    int imgSizeY, int numModulesY, int numModulesX, int filterSize, int paddingStart,
+                    int moduleStride, int numImgColors, int numGroups, int partialSum,
+                    MTYPE scaleTargets, MTYPE scaleOutput, int numThreads) {
+    int numFilterColors = numImgColors / numGroups;
+    int numImages = images.getNumCols();
+    int imgPixels = images.getNumRows() / numImgColors;
+    int imgSizeX = imgPixels / imgSizeY;
+    int numModules = numModulesY * numModulesX;
+    int numFilters = hidActs.getNumRows() / numModules;
+    int filterPixels = filterSize * filterSize;
+    partialSum = partialSum == 0 ? numModules : partialSum;
+
+    assert(imgSizeY * imgSizeX == imgPixels);
+    assert(images.getNumRows() == imgPixels * numImgColors);
+    assert(numModules % partialSum == 0);
+    assert(hidActs.getNumCols() == numImages);
+    assert(numModules * numFilters == hidActs.getNumRows());
+    assert(!images.isTrans());
+    assert(!hidActs.isTrans());
+    assert(!targets.isTrans());
+
+    int numRows = (numModules / partialSum) * numFilterColors * filterPixels;
+    if (scaleTargets == 0) {
+        targets.resize(numRows, numFilters);
+    } else {
+        assert(targets.getNumRows() == numRows);
+        assert(targets.getNumCols() == numFilters);
+    }
+
+    ConvArgs args;
+    _initArgs(args, numImages, numImgColors, numGroups, numFilters, imgSizeY, imgSizeX, filterSize,
+              numModulesY, numModulesX, paddingStart, moduleStride, true);
+    args.partialSum = partialSum;
+    args.a = images.getData();
+    args.b = hidActs.getData();
+    args.targets = targets.getData();
+    args.scaleTargets = scaleTargets;
+    args.scaleOutput = scaleOutput;
+
+    // every thread sums its images into its own buffer
+    numThreads = _numThreads(numThreads, numImages);
+    long int numElements = (long int)numRows * numFilters;
+    vector<MTYPE> sums(numElements * numThreads, 0);
+    vector<MTYPE*> outs(numThreads);
+    for (int t = 0; t < numThreads; t++) {
+        outs[t] = &sums[t * numElements];
+    }
+    _runOverImages(args, &_weightActsRange, numThreads, outs);
+
+    MTYPE* data = targets.getData();
+    for (long int i = 0; i < numElements; i++) {
+        MTYPE sum = 0;
+        for (int t = 0; t < numThreads; t++) {
+            sum += outs[t][i];
+        }
+        data[i] = (scaleTargets == 0 ? 0 : scaleTargets * data[i]) + scaleOutput * sum;
+    }
+}
+
+void convFilterActsCPU(Matrix& images, Matrix& filters, Matrix& targets,
+                       int imgSizeY, int numModulesY, int numModulesX, int paddingStart, int moduleStride,
+                       int numImgColors, int numGroups,
+                       MTYPE scaleTargets, MTYPE scaleOutput, int numThreads) {
+    _filterActsCPU(images, filters, targets, imgSizeY, numModulesY, numModulesX, paddingStart, moduleStride,
+                   numImgColors, numGroups, scaleTargets, scaleOutput, numThreads, true);
+}
+
+void localFilterActsCPU(Matrix& images, Matrix& filters, Matrix& targets,
+                        int imgSizeY, int numModulesY, int numModulesX, int paddingStart, int moduleStride,
+                        int numImgColors, int numGroups,
+                        MTYPE scaleTargets, MTYPE scaleOutput, int numThreads) {
+    _filterActsCPU(images, filters, targets, imgSizeY, numModulesY, numModulesX, paddingStart, moduleStride,
+                   numImgColors, numGroups, scaleTargets, scaleOutput, numThreads, false);
+}
+
+void convImgActsCPU(Matrix& hidActs, Matrix& filters, Matrix& targets,
+                    int imgSizeY, int imgSizeX, int numModulesY, int paddingStart, int moduleStride,
+                    int numImgColors, int numGroups,
+                    MTYPE scaleTargets, MTYPE scaleOutput, int numThreads) {
+    _imgActsCPU(hidActs, filters, targets, imgSizeY, imgSizeX, numModulesY, paddingStart, moduleStride,
+                numImgColors, numGroups, scaleTargets, scaleOutput, numThreads, true);
+}
+
+void localImgActsCPU(Matrix& hidActs, Matrix& filters, Matrix& targets,
+                     int imgSizeY, int imgSizeX, int numModulesY, int paddingStart, int moduleStride,
+                     int numImgColors, int numGroups,
+                     MTYPE scaleTargets, MTYPE scaleOutput, int numThreads) {
+    _imgActsCPU(hidActs, filters, targets, imgSizeY, imgSizeX, numModulesY, paddingStart, moduleStride,
+                numImgColors, numGroups, scaleTargets, scaleOutput, numThreads, false);
+}
+
+void convWeightActsCPU(Matrix& images, Matrix& hidActs, Matrix& targets,
+                       int imgSizeY, int numModulesY, int numModulesX, int filterSize, int paddingStart,
+                       int moduleStride, int numImgColors, int numGroups, int partialSum,
+                       MTYPE scaleTargets, MTYPE scaleOutput, int numThreads) {
+    _weightActsCPU(images, hidActs, targets, imgSizeY, numModulesY, numModulesX, filterSize, paddingStart,
+                   moduleStride, numImgColors, numGroups, partialSum, scaleTargets, scaleOutput, numThreads);
+}
+
+void localWeightActsCPU(Matrix& images, Matrix& hidActs, Matrix& targets,
+                        int imgSizeY, int numModulesY, int numModulesX, int filterSize, int paddingStart,
+                        int moduleStride, int numImgColors, int numGroups,
+                        MTYPE scaleTargets, MTYPE scaleOutput, int numThreads) {
+    _weightActsCPU(images, hidActs, targets, imgSizeY, numModulesY, numModulesX, filterSize, paddingStart,
+                   moduleStride, numImgColors, numGroups, 1, scaleTargets, scaleOutput, numThreads);
+}
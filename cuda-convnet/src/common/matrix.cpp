@@ -26,6 +26,7 @@
 
 #include <matrix.h>
 #include <matrix_funcs.h>
+#include <algorithm>
 
 #if defined(_WIN64) || defined(_WIN32)
 double sqrt(int _X) {return sqrt((double) _X);}
@@ -175,17 +176,17 @@ void Matrix::equalsScalar(MTYPE scalar) {
 
 void Matrix::biggerThanScalar(MTYPE scalar, Matrix& target) const {
     target.resize(*this);
-    _applyLoopScalar(scalar, &_bigger, target);
+    _applyLoopScalar<_bigger>(scalar, target);
 }
 
 void Matrix::smallerThanScalar(MTYPE scalar, Matrix& target) const {
     target.resize(*this);
-    _applyLoopScalar(scalar, &_smaller, target);
+    _applyLoopScalar<_smaller>(scalar, target);
 }
 
 void Matrix::equalsScalar(MTYPE scalar, Matrix& target) const {
     target.resize(*this);
-    _applyLoopScalar(scalar, &_equal, target);
+    _applyLoopScalar<_equal>(scalar, target);
 }
 
 void Matrix::add(const Matrix &m) {
@@ -223,9 +224,9 @@ void Matrix::add(const Matrix &m, MTYPE scale, Matrix &target) {
             target.resize(*this);
         }
         if(scale == 1) {
-            this->_applyLoop2(m, &_add, target);
+            this->_applyLoop2<_add>(m, target);
         } else {
-            this->_applyLoop2(m, &_addWithScale, scale, target);
+            this->_applyLoop2<_addWithScale>(m, scale, target);
         }
     } else {
         if (&target != this) {
@@ -241,7 +242,7 @@ void Matrix::addScalar(MTYPE scalar) {
 
 void Matrix::addScalar(MTYPE scalar, Matrix& target) const {
     target.resize(*this);
-    _applyLoopScalar(scalar, &_add, target);
+    _applyLoopScalar<_add>(scalar, target);
 }
 
 void Matrix::maxWithScalar(MTYPE scalar) {
@@ -250,7 +251,7 @@ void Matrix::maxWithScalar(MTYPE scalar) {
 
 void Matrix::maxWithScalar(MTYPE scalar, Matrix& target) const {
     target.resize(*this);
-    _applyLoopScalar(scalar, &_max, target);
+    _applyLoopScalar<_max>(scalar, target);
 }
 
 void Matrix::minWithScalar(MTYPE scalar) {
@@ -259,7 +260,7 @@ void Matrix::minWithScalar(MTYPE scalar) {
 
 void Matrix::minWithScalar(MTYPE scalar, Matrix& target) const {
     target.resize(*this);
-    _applyLoopScalar(scalar, &_min, target);
+    _applyLoopScalar<_min>(scalar, target);
 }
 
 void Matrix::biggerThan(Matrix& a) {
@@ -269,7 +270,7 @@ void Matrix::biggerThan(Matrix& a) {
 void Matrix::biggerThan(Matrix& a, Matrix& target) const {
     assert(isSameDims(a));
     target.resize(*this);
-    _applyLoop2(a, &_bigger, target);
+    _applyLoop2<_bigger>(a, target);
 }
 
 void Matrix::smallerThan(Matrix& a) {
@@ -279,7 +280,7 @@ void Matrix::smallerThan(Matrix& a) {
 void Matrix::smallerThan(Matrix& a, Matrix& target) const {
     assert(isSameDims(a));
     target.resize(*this);
-    _applyLoop2(a, &_smaller, target);
+    _applyLoop2<_smaller>(a, target);
 }
 
 void Matrix::equals(Matrix& a) {
@@ -289,7 +290,7 @@ void Matrix::equals(Matrix& a) {
 void Matrix::equals(Matrix& a, Matrix& target) const {
     assert(isSameDims(a));
     target.resize(*this);
-    _applyLoop2(a, &_equal, target);
+    _applyLoop2<_equal>(a, target);
 }
 
 void Matrix::notEquals(Matrix& a) {
@@ -299,7 +300,7 @@ void Matrix::notEquals(Matrix& a) {
 void Matrix::notEquals(Matrix& a, Matrix& target) const {
     assert(isSameDims(a));
     target.resize(*this);
-    _applyLoop2(a, &_notEqual, target);
+    _applyLoop2<_notEqual>(a, target);
 }
 
 void Matrix::minWith(Matrix &a) {
@@ -309,7 +310,7 @@ void Matrix::minWith(Matrix &a) {
 void Matrix::minWith(Matrix &a, Matrix& target) const {
     assert(isSameDims(a));
     target.resize(*this);
-    _applyLoop2(a, &_min, target);
+    _applyLoop2<_min>(a, target);
 }
 
 void Matrix::maxWith(Matrix &a) {
@@ -319,7 +320,7 @@ void Matrix::maxWith(Matrix &a) {
 void Matrix::maxWith(Matrix &a, Matrix& target) const {
     assert(isSameDims(a));
     target.resize(*this);
-    _applyLoop2(a, &_max, target);
+    _applyLoop2<_max>(a, target);
 }
 
 /* this := this + scale*tile(vec) */
@@ -661,13 +662,13 @@ void Matrix::apply(Matrix::FUNCTION f, Matrix& target) {
     } else if(f == LOG) {
         MKL_LOG(this->getNumElements(), this->_data, target._data);
     } else if (f == ZERO) {
-        _applyLoop(&_zero, target);
+        _applyLoop<_zero>(target);
     } else if (f == ONE) {
-        _applyLoop(&_one, target);
+        _applyLoop<_one>(target);
     } else if(f == ABS) {
-        _applyLoop(&_abs, target);
+        _applyLoop<_abs>(target);
     } else if(f == SIGN) {
-        _applyLoop(&_sign, target);
+        _applyLoop<_sign>(target);
     } else if (f == LOGISTIC1) {
         if(&target != this) {
             copy(target);
@@ -697,7 +698,7 @@ void Matrix::eltWiseMult(const Matrix& a, Matrix& target) const {
     if (a.isTrans() == this->isTrans()) {
         MKL_VECMUL(getNumElements(), this->_data, a._data, target._data);
     } else {
-        this->_applyLoop2(a, &_mult, target);
+        this->_applyLoop2<_mult>(a, target);
     }
 }
 
@@ -711,7 +712,7 @@ void Matrix::eltWiseDivide(const Matrix& a, Matrix &target) const {
     if (a.isTrans() == this->isTrans() && a.isTrans() == target.isTrans()) {
         MKL_VECDIV(getNumElements(), this->_data, a._data, target._data);
     } else {
-        this->_applyLoop2(a, &_divide, target);
+        this->_applyLoop2<_divide>(a, target);
     }
 }
 
@@ -755,45 +756,43 @@ void Matrix::randomizeNormal(VSLStreamStatePtr stream) {
 #else
 
 void Matrix::apply(Matrix::FUNCTION f, Matrix& target) {
-    MTYPE (*func)(MTYPE);
     if(f == EXP) {
-        func = &_exp;
+        this->_applyLoop<_exp>(target);
     } else if(f == TANH) {
-        func = &_tanh;
+        this->_applyLoop<_tanh>(target);
     } else if(f == RECIPROCAL) {
-        func = &_recip;
+        this->_applyLoop<_recip>(target);
     } else if (f == SQUARE) {
-        func = &_square;
+        this->_applyLoop<_square>(target);
     } else if(f == LOG) {
-        func = &_log;
+        this->_applyLoop<_log>(target);
     } else if(f == ZERO) {
-        func = &_zero;
+        this->_applyLoop<_zero>(target);
     } else if (f == ONE) {
-        func = &_one;
+        this->_applyLoop<_one>(target);
     } else if(f == LOGISTIC1) {
-        func = &_sigma1;
+        this->_applyLoop<_sigma1>(target);
     } else if(f == LOGISTIC2) {
-        func = &_sigma2;
+        this->_applyLoop<_sigma2>(target);
     } else if (f == ABS) {
-        func = &_abs;
+        this->_applyLoop<_abs>(target);
     } else if (f == SIGN) {
-        func = &_sign;
+        this->_applyLoop<_sign>(target);
     } else {
         throw "Matrix::apply: Unknown function type";
     }
-    this->_applyLoop(func, target);
 }
 
 void Matrix::eltWiseMult(const Matrix& a, Matrix& target) const {
     assert(isSameDims(a));
     target.resize(*this);
-    this->_applyLoop2(a, &_mult, target);
+    this->_applyLoop2<_mult>(a, target);
 }
 
 void Matrix::eltWiseDivide(const Matrix& a, Matrix& target) const {
     assert(isSameDims(a));
     target.resize(*this);
-    this->_applyLoop2(a, &_divide, target);
+    this->_applyLoop2<_divide>(a, target);
 }
 
 void Matrix::eltWiseMult(const Matrix& a) {
@@ -805,7 +804,10 @@ void Matrix::eltWiseDivide(const Matrix& a) {
 }
 
 void Matrix::randomizeUniform() {
-    this->_applyLoop(&_rand);
+    // serial, rand() keeps a global state
+    for (long int i = 0; i < getNumElements(); i++) {
+        _data[i] = MYRAND;
+    }
 }
 
 void Matrix::randomizeNormal() {
@@ -851,39 +853,96 @@ Matrix& Matrix::reshaped(long int numRows, long int numCols) {
     return *new Matrix(_data, numRows, numCols, isTrans());
 }
 
-void Matrix::_applyLoop(MTYPE (*func)(MTYPE), Matrix& target) {
-    MTYPE *ptr = this->_data, *tgtPtr = target._data;
-    for (long int i = 0; i < getNumElements(); i++, ptr++, tgtPtr++) {
-        *tgtPtr = (*func)(*ptr);
+/*
+ * Elementwise loops. The function is inlined through a functor, so the
+ * contiguous loops can be vectorized by the compiler; loops over more than
+ * ELTWISE_PARALLEL_MIN elements are split over OpenMP threads.
+ *
+ * When the operands of _applyLoop2 are not all in the same (row/column-major)
+ * layout, the loop runs over TRANS_BLOCK x TRANS_BLOCK tiles in the layout of
+ * the target, so the transposed operand is read a cache line at a time.
+ */
+#define ELTWISE_PARALLEL_MIN    (1 << 16)
+#define TRANS_BLOCK             32
+
+template <class Op>
+static void _eltwiseLoop(const MTYPE* src, MTYPE* target, long int numElements, Op op) {
+    #pragma omp parallel for if (numElements >= ELTWISE_PARALLEL_MIN)
+    for (long int i = 0; i < numElements; i++) {
+        target[i] = op(src[i]);
     }
 }
 
-void Matrix::_applyLoop(MTYPE (*func)(MTYPE)) {
-    _applyLoop(func, *this);
+template <class Op>
+static void _eltwiseLoop2(const MTYPE* a, const MTYPE* b, MTYPE* target, long int numElements, Op op) {
+    #pragma omp parallel for if (numElements >= ELTWISE_PARALLEL_MIN)
+    for (long int i = 0; i < numElements; i++) {
+        target[i] = op(a[i], b[i]);
+    }
 }
 
-void Matrix::_applyLoop2(const Matrix& a, MTYPE (*func)(MTYPE,MTYPE), Matrix& target) const {
-    for (long int i = 0; i < getNumRows(); i++) {
-        for (long int j = 0; j < getNumCols(); j++) {
-            target(i, j) = (*func)((*this)(i, j), a(i, j));
+/*
+ * target is (rows, cols) in memory, aTrans/bTrans tell if a/b are stored as (cols, rows).
+ */
+template <bool aTrans, bool bTrans, class Op>
+static void _blockedLoop2(const MTYPE* a, const MTYPE* b, MTYPE* target, long int rows, long int cols, Op op) {
+    long int numBlockRows = (rows + TRANS_BLOCK - 1) / TRANS_BLOCK;
+    #pragma omp parallel for if (rows * cols >= ELTWISE_PARALLEL_MIN)
+    for (long int br = 0; br < numBlockRows; br++) {
+        long int r0 = br * TRANS_BLOCK, r1 = std::min(r0 + TRANS_BLOCK, rows);
+        for (long int c0 = 0; c0 < cols; c0 += TRANS_BLOCK) {
+            long int c1 = std::min(c0 + TRANS_BLOCK, cols);
+            for (long int r = r0; r < r1; r++) {
+                for (long int c = c0; c < c1; c++) {
+                    target[r * cols + c] = op(aTrans ? a[c * rows + r] : a[r * cols + c],
+                                              bTrans ? b[c * rows + r] : b[r * cols + c]);
+                }
+            }
         }
     }
 }
 
-void Matrix::_applyLoop2(const Matrix& a, MTYPE (*func)(MTYPE,MTYPE, MTYPE), MTYPE scalar, Matrix& target) const {
-    for (long int i = 0; i < getNumRows(); i++) {
-        for (long int j = 0; j < getNumCols(); j++) {
-            target(i, j) = (*func)((*this)(i, j), a(i, j), scalar);
-        }
-    }
+template <MTYPE (*func)(MTYPE)>
+void Matrix::_applyLoop(Matrix& target) {
+    _eltwiseLoop(this->_data, target._data, getNumElements(), UnaryOp<func>());
 }
 
-void Matrix::_applyLoopScalar(const MTYPE scalar, MTYPE(*func)(MTYPE, MTYPE), Matrix& target) const {
-    MTYPE *myPtr = _data;
-    MTYPE *targetPtr = target._data;
-    for (long int i = 0; i < getNumElements(); i++, myPtr++, targetPtr++) {
-        *targetPtr = (*func)(*myPtr, scalar);
+template <MTYPE (*func)(MTYPE)>
+void Matrix::_applyLoop() {
+    _applyLoop<func>(*this);
+}
+
+template <class Op>
+void Matrix::_applyLoop2Op(const Matrix& a, Op op, Matrix& target) const {
+    if (isTrans() == target.isTrans() && a.isTrans() == target.isTrans()) {
+        _eltwiseLoop2(this->_data, a._data, target._data, getNumElements(), op);
+        return;
     }
+    // dimensions of the target in memory
+    long int rows = target.getFollowingDim(), cols = target.getLeadingDim();
+    bool meTrans = isTrans() != target.isTrans(), aTrans = a.isTrans() != target.isTrans();
+    if (meTrans && aTrans) {
+        _blockedLoop2<true, true>(this->_data, a._data, target._data, rows, cols, op);
+    } else if (meTrans) {
+        _blockedLoop2<true, false>(this->_data, a._data, target._data, rows, cols, op);
+    } else {
+        _blockedLoop2<false, true>(this->_data, a._data, target._data, rows, cols, op);
+    }
+}
+
+template <MTYPE (*func)(MTYPE, MTYPE)>
+void Matrix::_applyLoop2(const Matrix& a, Matrix& target) const {
+    _applyLoop2Op(a, BinaryOp<func>(), target);
+}
+
+template <MTYPE (*func)(MTYPE, MTYPE, MTYPE)>
+void Matrix::_applyLoop2(const Matrix& a, MTYPE scalar, Matrix& target) const {
+    _applyLoop2Op(a, BinaryScalarOp<func>(scalar), target);
+}
+
+template <MTYPE (*func)(MTYPE, MTYPE)>
+void Matrix::_applyLoopScalar(const MTYPE scalar, Matrix& target) const {
+    _eltwiseLoop(this->_data, target._data, getNumElements(), ScalarOp<func>(scalar));
 }
 
 bool Matrix::hasNan() const {
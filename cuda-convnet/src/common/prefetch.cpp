@@ -0,0 +1,153 @@
+/*
+ * prefetch.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <prefetch.h>
+
+using namespace std;
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+void* alignedHostAlloc(size_t numBytes) {
+    void* ptr;
+    if (posix_memalign(&ptr, 64, numBytes) != 0) {
+        return NULL;
+    }
+    return ptr;
+}
+
+void alignedHostFree(void* ptr) {
+    free(ptr);
+}
+
+MinibatchPrefetcher::MinibatchPrefetcher(vector<Matrix*>& data, int minibatchSize, int numBuffers,
+                                         HostAllocFunc allocFunc, HostFreeFunc freeFunc)
+    : Thread(true), _data(&data), _minibatchSize(minibatchSize), _free(freeFunc),
+      _buffers(max(1, numBuffers)), _freeBuffers(max(1, numBuffers) + 1), _readyBuffers(max(1, numBuffers)),
+      _stopping(false), _joined(false), _next(0), _current(-1), _numAcquired(0), _numHits(0), _stallTime(0) {
+    assert(data.size() > 0 && minibatchSize > 0);
+    _numCases = data[0]->getLeadingDim();
+    _numMinibatches = (_numCases + minibatchSize - 1) / minibatchSize;
+
+    for (size_t b = 0; b < _buffers.size(); b++) {
+        for (size_t i = 0; i < data.size(); i++) {
+            size_t numBytes = data[i]->getFollowingDim() * minibatchSize * sizeof(MTYPE);
+            MTYPE* ptr = (MTYPE*)allocFunc(numBytes);
+            if (ptr == NULL) {
+                fprintf(stderr, "MinibatchPrefetcher: unable to allocate %lu bytes\n", numBytes);
+                exit(EXIT_FAILURE);
+            }
+            _buffers[b].data.push_back(ptr);
+            _buffers[b].mats.push_back(new Matrix());
+        }
+        _freeBuffers.enqueue((int)b);
+    }
+    start();
+}
+
+MinibatchPrefetcher::~MinibatchPrefetcher() {
+    stop();
+    for (size_t b = 0; b < _buffers.size(); b++) {
+        for (size_t i = 0; i < _buffers[b].data.size(); i++) {
+            delete _buffers[b].mats[i];
+            _free(_buffers[b].data[i]);
+        }
+    }
+}
+
+/*
+ * The matrices are seen in their memory layout, (followingDim, leadingDim)
+ * row-major, so a minibatch is a block of columns.
+ */
+void MinibatchPrefetcher::fill(Buffer& buf, int idx) {
+    long int startCase = (long int)idx * _minibatchSize;
+    long int numCases = min((long int)_minibatchSize, _numCases - startCase);
+    for (size_t i = 0; i < _data->size(); i++) {
+        Matrix& src = *_data->at(i);
+        long int rows = src.getFollowingDim(), cols = src.getLeadingDim();
+        MTYPE* srcPtr = src.getData() + startCase;
+        MTYPE* dstPtr = buf.data[i];
+        for (long int r = 0; r < rows; r++) {
+            memcpy(dstPtr + r * numCases, srcPtr + r * cols, numCases * sizeof(MTYPE));
+        }
+        delete buf.mats[i];
+        buf.mats[i] = src.isTrans() ? new Matrix(dstPtr, numCases, rows, true)
+                                    : new Matrix(dstPtr, rows, numCases, false);
+    }
+}
+
+void* MinibatchPrefetcher::run() {
+    for (int idx = 0; idx < _numMinibatches && !_stopping; idx++) {
+        int b = _freeBuffers.dequeue();
+        if (b < 0) {
+            break;
+        }
+        fill(_buffers[b], idx);
+        _readyBuffers.enqueue(b);
+    }
+    return NULL;
+}
+
+int MinibatchPrefetcher::getNextMinibatch() const {
+    return _next < _numMinibatches && _current < 0 && !_stopping ? _next : -1;
+}
+
+vector<Matrix*>& MinibatchPrefetcher::acquire() {
+    assert(getNextMinibatch() >= 0);
+    if (_readyBuffers.getNumElements() > 0) {
+        _numHits++;
+    }
+    double t = now();
+    _current = _readyBuffers.dequeue();
+    _stallTime += now() - t;
+    _numAcquired++;
+    _next++;
+    return _buffers[_current].mats;
+}
+
+void MinibatchPrefetcher::release() {
+    assert(_current >= 0);
+    _freeBuffers.enqueue(_current);
+    _current = -1;
+}
+
+void MinibatchPrefetcher::stop() {
+    if (_joined) {
+        return;
+    }
+    _stopping = true;
+    // wakes up the thread if it waits for a free buffer
+    _freeBuffers.enqueue(-1);
+    join();
+    _joined = true;
+}
+
+int MinibatchPrefetcher::getNumAcquired() const {
+    return _numAcquired;
+}
+
+int MinibatchPrefetcher::getNumHits() const {
+    return _numHits;
+}
+
+double MinibatchPrefetcher::getStallTime() const {
+    return _stallTime;
+}
+
+void MinibatchPrefetcher::printStats() const {
+    printf("Prefetched %d/%d minibatches, hit rate %.1f%%, stalled %.3fs\n",
+           _numAcquired, _numMinibatches, _numAcquired > 0 ? 100.0 * _numHits / _numAcquired : 0.0,
+           _stallTime);
+}
@@ -29,8 +29,24 @@
 
 using namespace std;
 
-DataProvider::DataProvider(int minibatchSize) : 
-    _minibatchSize(minibatchSize), _hData(NULL) {
+/*
+ * Pinned buffers of the prefetcher, the host to device copies from them run
+ * at full bandwidth.
+ */
+static void* pinnedHostAlloc(size_t numBytes) {
+    void* ptr;
+    if (cudaHostAlloc(&ptr, numBytes, cudaHostAllocPortable) != cudaSuccess) {
+        return NULL;
+    }
+    return ptr;
+}
+
+static void pinnedHostFree(void* ptr) {
+    cudaFreeHost(ptr);
+}
+
+DataProvider::DataProvider(int minibatchSize, int numPrefetch) : 
+    _minibatchSize(minibatchSize), _hData(NULL), _numPrefetch(numPrefetch), _prefetcher(NULL) {
 
 }
 
@@ -39,6 +55,12 @@ GPUData& DataProvider::operator[](int idx) {
 }
 
 void DataProvider::clearData() {
+    if (_prefetcher != NULL) {
+        _prefetcher->stop();
+        _prefetcher->printStats();
+        delete _prefetcher;
+        _prefetcher = NULL;
+    }
     delete _hData;
     _hData = NULL;
     _dataSize = 0;
@@ -61,14 +83,32 @@ void DataProvider::setData(CPUData& hData) {
             }
             _data[i]->copyFromHost(hData[i], true);
         }
+    } else if (_numPrefetch > 0) {
+        // runs in the GPU thread, so the buffers can be pinned
+        _prefetcher = new MinibatchPrefetcher(hData.getData(), _minibatchSize, _numPrefetch,
+                                              &pinnedHostAlloc, &pinnedHostFree);
     }
 }
 
 GPUData& DataProvider::getMinibatch(int idx) {
     assert(idx >= 0 && idx < getNumMinibatches());
+    if (_prefetcher != NULL && _prefetcher->getNextMinibatch() == idx) {
+        GPUData& mini = copyToDevice(_prefetcher->acquire());
+        _prefetcher->release();
+        return mini;
+    }
     return getDataSlice(idx * _minibatchSize, (idx + 1) * _minibatchSize);
 }
 
+GPUData& DataProvider::copyToDevice(MatrixV& hData) {
+    NVMatrixV& miniData = *new NVMatrixV();
+    for (size_t i = 0; i < hData.size(); i++) {
+        miniData.push_back(new NVMatrix());
+        miniData.back()->copyFromHost(*hData[i], true);
+    }
+    return *new GPUData(miniData);
+}
+
 GPUData& DataProvider::getDataSlice(int startCase, int endCase) {
     assert(_hData != NULL);
     assert(_hData->getNumCases() > 0);
@@ -33,6 +33,7 @@
 #include <vector>
 
 #include <matrix.h>
+#include <conv_cpu.h>
 #include <queue.h>
 #include <worker.cuh>
 #include <util.cuh>
@@ -40,6 +41,7 @@
 
 #include <pyconvnet.cuh>
 #include <convnet.cuh>
+#include <cudaconv2.cuh>
 
 using namespace std;
 static ConvNet* model = NULL;
@@ -52,6 +54,10 @@ static PyMethodDef _ConvNetMethods[] = {  { "initModel",          initModel,
                                               { "startMultiviewTest", startMultiviewTest, METH_VARARGS },
                                               { "startFeatureWriter",  startFeatureWriter,         METH_VARARGS },
                                               { "syncWithHost",       syncWithHost,       METH_VARARGS },
+                                              { "initConvDevice",     initConvDevice,     METH_VARARGS },
+                                              { "runFilterActs",      runFilterActs,      METH_VARARGS },
+                                              { "runImgActs",         runImgActs,         METH_VARARGS },
+                                              { "runWeightActs",      runWeightActs,      METH_VARARGS },
                                               { NULL, NULL }
 };
 
@@ -239,3 +245,123 @@ PyObject* syncWithHost(PyObject *self, PyObject *args) {
     return Py_BuildValue("i", 0);
 }
 
+/*
+ * The convolution routines below run without a model, on the CPU or on the
+ * GPU, for checking the CPU versions against the GPU outputs (convcheck.py).
+ * The arrays must be C-contiguous float32, the targets array is written in
+ * place and must have the output shape.
+ */
+PyObject* initConvDevice(PyObject *self, PyObject *args) {
+    int deviceID;
+    if (!PyArg_ParseTuple(args, "i", &deviceID)) {
+        return NULL;
+    }
+    cudaSetDevice(deviceID < 0 ? cutGetMaxGflopsDeviceId() : deviceID);
+    cublasInit();
+    return Py_BuildValue("i", 0);
+}
+
+PyObject* runFilterActs(PyObject *self, PyObject *args) {
+    PyArrayObject *pyImages, *pyFilters, *pyTargets;
+    int imgSizeY, numModulesY, numModulesX, paddingStart, moduleStride, numImgColors, numGroups;
+    int local, gpu, numThreads;
+    if (!PyArg_ParseTuple(args, "O!O!O!iiiiiiiiii",
+                          &PyArray_Type, &pyImages,
+                          &PyArray_Type, &pyFilters,
+                          &PyArray_Type, &pyTargets,
+                          &imgSizeY, &numModulesY, &numModulesX, &paddingStart, &moduleStride,
+                          &numImgColors, &numGroups, &local, &gpu, &numThreads)) {
+        return NULL;
+    }
+    Matrix images(pyImages), filters(pyFilters), targets(pyTargets);
+    if (gpu) {
+        NVMatrix nvImages(images, true), nvFilters(filters, true), nvTargets;
+        if (local) {
+            localFilterActs(nvImages, nvFilters, nvTargets, imgSizeY, numModulesY, numModulesX, paddingStart, moduleStride,
+                            numImgColors, numGroups);
+        } else {
+            convFilterActs(nvImages, nvFilters, nvTargets, imgSizeY, numModulesY, numModulesX, paddingStart, moduleStride,
+                           numImgColors, numGroups);
+        }
+        nvTargets.copyToHost(targets);
+    } else {
+        if (local) {
+            localFilterActsCPU(images, filters, targets, imgSizeY, numModulesY, numModulesX, paddingStart, moduleStride,
+                               numImgColors, numGroups, 0, 1, numThreads);
+        } else {
+            convFilterActsCPU(images, filters, targets, imgSizeY, numModulesY, numModulesX, paddingStart, moduleStride,
+                              numImgColors, numGroups, 0, 1, numThreads);
+        }
+    }
+    return Py_BuildValue("i", 0);
+}
+
+PyObject* runImgActs(PyObject *self, PyObject *args) {
+    PyArrayObject *pyHidActs, *pyFilters, *pyTargets;
+    int imgSizeY, imgSizeX, numModulesY, paddingStart, moduleStride, numImgColors, numGroups;
+    int local, gpu, numThreads;
+    if (!PyArg_ParseTuple(args, "O!O!O!iiiiiiiiii",
+                          &PyArray_Type, &pyHidActs,
+                          &PyArray_Type, &pyFilters,
+                          &PyArray_Type, &pyTargets,
+                          &imgSizeY, &imgSizeX, &numModulesY, &paddingStart, &moduleStride,
+                          &numImgColors, &numGroups, &local, &gpu, &numThreads)) {
+        return NULL;
+    }
+    Matrix hidActs(pyHidActs), filters(pyFilters), targets(pyTargets);
+    if (gpu) {
+        NVMatrix nvHidActs(hidActs, true), nvFilters(filters, true), nvTargets;
+        if (local) {
+            localImgActs(nvHidActs, nvFilters, nvTargets, imgSizeY, imgSizeX, numModulesY, paddingStart, moduleStride,
+                         numImgColors, numGroups);
+        } else {
+            convImgActs(nvHidActs, nvFilters, nvTargets, imgSizeY, imgSizeX, numModulesY, paddingStart, moduleStride,
+                        numImgColors, numGroups);
+        }
+        nvTargets.copyToHost(targets);
+    } else {
+        if (local) {
+            localImgActsCPU(hidActs, filters, targets, imgSizeY, imgSizeX, numModulesY, paddingStart, moduleStride,
+                            numImgColors, numGroups, 0, 1, numThreads);
+        } else {
+            convImgActsCPU(hidActs, filters, targets, imgSizeY, imgSizeX, numModulesY, paddingStart, moduleStride,
+                           numImgColors, numGroups, 0, 1, numThreads);
+        }
+    }
+    return Py_BuildValue("i", 0);
+}
+
+PyObject* runWeightActs(PyObject *self, PyObject *args) {
+    PyArrayObject *pyImages, *pyHidActs, *pyTargets;
+    int imgSizeY, numModulesY, numModulesX, filterSize, paddingStart, moduleStride, numImgColors, numGroups, partialSum;
+    int local, gpu, numThreads;
+    if (!PyArg_ParseTuple(args, "O!O!O!iiiiiiiiiiii",
+                          &PyArray_Type, &pyImages,
+                          &PyArray_Type, &pyHidActs,
+                          &PyArray_Type, &pyTargets,
+                          &imgSizeY, &numModulesY, &numModulesX, &filterSize, &paddingStart, &moduleStride,
+                          &numImgColors, &numGroups, &partialSum, &local, &gpu, &numThreads)) {
+        return NULL;
+    }
+    Matrix images(pyImages), hidActs(pyHidActs), targets(pyTargets);
+    if (gpu) {
+        NVMatrix nvImages(images, true), nvHidActs(hidActs, true), nvTargets;
+        if (local) {
+            localWeightActs(nvImages, nvHidActs, nvTargets, imgSizeY, numModulesY, numModulesX, filterSize, paddingStart,
+                            moduleStride, numImgColors, numGroups);
+        } else {
+            convWeightActs(nvImages, nvHidActs, nvTargets, imgSizeY, numModulesY, numModulesX, filterSize, paddingStart,
+                           moduleStride, numImgColors, numGroups, partialSum);
+        }
+        nvTargets.copyToHost(targets);
+    } else {
+        if (local) {
+            localWeightActsCPU(images, hidActs, targets, imgSizeY, numModulesY, numModulesX, filterSize, paddingStart,
+                               moduleStride, numImgColors, numGroups, 0, 1, numThreads);
+        } else {
+            convWeightActsCPU(images, hidActs, targets, imgSizeY, numModulesY, numModulesX, filterSize, paddingStart,
+                              moduleStride, numImgColors, numGroups, partialSum, 0, 1, numThreads);
+        }
+    }
+    return Py_BuildValue("i", 0);
+}
@@ -86,6 +86,9 @@ void cudaF_diff_sigmoid(dim3 Gr, dim3 Bl, float *eout, const float *e, const flo
 void cudaF_regularize_l1(dim3 Gr, dim3 Bl, float *wei, float *grad, float l1, float lr, MatrixDim d);
 void cudaF_find_row_max_id(dim3 Gr, dim3 Bl, const float *mat, float *vec_val, int32_cuda *vec_id, int32_cuda voff, MatrixDim d);
 void cudaF_diff_xent(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, float *mat_net_out, float *vec_log_post, MatrixDim d);
+void cudaF_add_xent_stats(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, const int32_cuda *vec_max_id, const float *vec_log_post, float *vec_loss, float *vec_correct, int32_cuda dim);
+void cudaF_diff_mse(dim3 Gr, dim3 Bl, const float *mat_out, const float *mat_tgt, float *mat_diff, float *vec_loss, MatrixDim d, int32_cuda out_stride, int32_cuda tgt_stride);
+void cudaF_hid_mask(dim3 Gr, dim3 Bl, const float *mat_noisy, const float *mat_clean, float *mat_mask, float *mat_masked, float alpha, int32_cuda binarize, float thres, MatrixDim d, int32_cuda clean_stride, int32_cuda mask_stride, int32_cuda masked_stride);
 
 void cudaF_randomize(dim3 Gr, dim3 Bl, float *y, const float *x, const int32_cuda *copy_from, MatrixDim d_out, MatrixDim d_in);
 void cudaF_expand(dim3 Gr, dim3 Bl, float *y, const float *x, const int32_cuda *off, MatrixDim d_out, MatrixDim d_in);
@@ -144,6 +147,9 @@ void cudaD_diff_sigmoid(dim3 Gr, dim3 Bl, double *eout, const double *e, const d
 void cudaD_regularize_l1(dim3 Gr, dim3 Bl, double *wei, double *grad, double l1, double lr, MatrixDim d);
 void cudaD_find_row_max_id(dim3 Gr, dim3 Bl, const double *mat, double *vec_val, int32_cuda *vec_id, int32_cuda voff, MatrixDim d);
 void cudaD_diff_xent(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, double *mat_net_out, double *vec_log_post, MatrixDim d);
+void cudaD_add_xent_stats(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, const int32_cuda *vec_max_id, const double *vec_log_post, double *vec_loss, double *vec_correct, int32_cuda dim);
+void cudaD_diff_mse(dim3 Gr, dim3 Bl, const double *mat_out, const double *mat_tgt, double *mat_diff, double *vec_loss, MatrixDim d, int32_cuda out_stride, int32_cuda tgt_stride);
+void cudaD_hid_mask(dim3 Gr, dim3 Bl, const double *mat_noisy, const double *mat_clean, double *mat_mask, double *mat_masked, double alpha, int32_cuda binarize, double thres, MatrixDim d, int32_cuda clean_stride, int32_cuda mask_stride, int32_cuda masked_stride);
 
 void cudaD_randomize(dim3 Gr, dim3 Bl, double *y, const double *x, const int32_cuda *copy_from, MatrixDim d_out, MatrixDim d_in);
 void cudaD_expand(dim3 Gr, dim3 Bl, double *y, const double *x, const int32_cuda *off, MatrixDim d_out, MatrixDim d_in);
@@ -692,6 +692,67 @@ static void _diff_xent(const int32_cuda* vec_tgt, Real* mat_net_out, Real* vec_l
 
 
 
+template<typename Real>
+__global__
+static void _add_xent_stats(const int32_cuda* vec_tgt, const int32_cuda* vec_max_id, const Real* vec_log_post, Real* vec_loss, Real* vec_correct, int32_cuda dim) {
+  int32_cuda i = blockIdx.x * blockDim.x + threadIdx.x;
+
+  if(i < dim) {
+    vec_loss[i] -= vec_log_post[i];
+    if(vec_tgt[i] == vec_max_id[i]) vec_correct[i] += 1.0;
+  }
+}
+
+
+
+template<typename Real>
+__global__
+static void _diff_mse(const Real* mat_out, const Real* mat_tgt, Real* mat_diff, Real* vec_loss, MatrixDim d, int32_cuda out_stride, int32_cuda tgt_stride) {
+  int32_cuda j = blockIdx.y * blockDim.y + threadIdx.y; //row
+
+  if(blockIdx.x > 0) return;
+  if(blockDim.y > 1) return;
+
+  __shared__ Real row_data[256];
+
+  //one block per row, each thread takes every blockDim.x-th column
+  Real sum = 0.0;
+  for(int32_cuda i = threadIdx.x; i < d.cols; i += blockDim.x) {
+    Real diff = mat_out[i+j*out_stride] - mat_tgt[i+j*tgt_stride];
+    mat_diff[i+j*d.stride] = diff;
+    sum += diff*diff;
+  }
+  row_data[threadIdx.x] = sum;
+  __syncthreads();
+
+  //get the sum
+  sum = _sum_reduce(row_data);
+  __syncthreads();
+
+  //add to previously accumulated loss
+  if(threadIdx.x == 0)
+    vec_loss[j] += 0.5*sum;
+}
+
+
+
+template<typename Real>
+__global__
+static void _hid_mask(const Real* mat_noisy, const Real* mat_clean, Real* mat_mask, Real* mat_masked, Real alpha, int32_cuda binarize, Real thres, MatrixDim d, int32_cuda clean_stride, int32_cuda mask_stride, int32_cuda masked_stride) {
+  int32_cuda i = blockIdx.x * blockDim.x + threadIdx.x;
+  int32_cuda j = blockIdx.y * blockDim.y + threadIdx.y;
+  if ( i < d.cols  &&  j < d.rows ) {
+    Real noisy = mat_noisy[i+j*d.stride];
+    Real diff = noisy - mat_clean[i+j*clean_stride];
+    Real mask = exp(-alpha*diff*diff);
+    if(binarize) mask = (mask > thres ? 1.0 : 0.0);
+    mat_mask[i+j*mask_stride] = mask;
+    if(mat_masked != NULL) mat_masked[i+j*masked_stride] = noisy*mask;
+  }
+}
+
+
+
 template<typename Real>
 __global__
 static void _softmax_part(const Real* X, const int32_cuda* vec_ids, Real* Y, MatrixDim d) {
@@ -892,6 +953,18 @@ void cudaF_diff_xent(dim3 Gr, dim3 Bl, const int32_cuda* vec_tgt, float* mat_net
   _diff_xent<<<Gr,Bl>>>(vec_tgt,mat_net_out,vec_log_post,d);
 }
 
+void cudaF_add_xent_stats(dim3 Gr, dim3 Bl, const int32_cuda* vec_tgt, const int32_cuda* vec_max_id, const float* vec_log_post, float* vec_loss, float* vec_correct, int32_cuda dim) {
+  _add_xent_stats<<<Gr,Bl>>>(vec_tgt,vec_max_id,vec_log_post,vec_loss,vec_correct,dim);
+}
+
+void cudaF_diff_mse(dim3 Gr, dim3 Bl, const float* mat_out, const float* mat_tgt, float* mat_diff, float* vec_loss, MatrixDim d, int32_cuda out_stride, int32_cuda tgt_stride) {
+  _diff_mse<<<Gr,Bl>>>(mat_out,mat_tgt,mat_diff,vec_loss,d,out_stride,tgt_stride);
+}
+
+void cudaF_hid_mask(dim3 Gr, dim3 Bl, const float* mat_noisy, const float* mat_clean, float* mat_mask, float* mat_masked, float alpha, int32_cuda binarize, float thres, MatrixDim d, int32_cuda clean_stride, int32_cuda mask_stride, int32_cuda masked_stride) {
+  _hid_mask<<<Gr,Bl>>>(mat_noisy,mat_clean,mat_mask,mat_masked,alpha,binarize,thres,d,clean_stride,mask_stride,masked_stride);
+}
+
 
 
 
@@ -1067,6 +1140,18 @@ void cudaD_diff_xent(dim3 Gr, dim3 Bl, const int32_cuda* vec_tgt, double* mat_ne
   _diff_xent<<<Gr,Bl>>>(vec_tgt,mat_net_out,vec_log_post,d);
 }
 
+void cudaD_add_xent_stats(dim3 Gr, dim3 Bl, const int32_cuda* vec_tgt, const int32_cuda* vec_max_id, const double* vec_log_post, double* vec_loss, double* vec_correct, int32_cuda dim) {
+  _add_xent_stats<<<Gr,Bl>>>(vec_tgt,vec_max_id,vec_log_post,vec_loss,vec_correct,dim);
+}
+
+void cudaD_diff_mse(dim3 Gr, dim3 Bl, const double* mat_out, const double* mat_tgt, double* mat_diff, double* vec_loss, MatrixDim d, int32_cuda out_stride, int32_cuda tgt_stride) {
+  _diff_mse<<<Gr,Bl>>>(mat_out,mat_tgt,mat_diff,vec_loss,d,out_stride,tgt_stride);
+}
+
+void cudaD_hid_mask(dim3 Gr, dim3 Bl, const double* mat_noisy, const double* mat_clean, double* mat_mask, double* mat_masked, double alpha, int32_cuda binarize, double thres, MatrixDim d, int32_cuda clean_stride, int32_cuda mask_stride, int32_cuda masked_stride) {
+  _hid_mask<<<Gr,Bl>>>(mat_noisy,mat_clean,mat_mask,mat_masked,alpha,binarize,thres,d,clean_stride,mask_stride,masked_stride);
+}
+
 
 
 
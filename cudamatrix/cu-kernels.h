@@ -87,6 +87,9 @@ template<typename Real> inline void cuda_softmax_part(dim3 Gr, dim3 Bl, const Re
 template<typename Real> inline void cuda_regularize_l1(dim3 Gr, dim3 Bl, Real *wei, Real *grad, Real l1, Real lr, MatrixDim d) { KALDI_ERR << __func__ << " Not implemented!"; }
 template<typename Real> inline void cuda_find_row_max_id(dim3 Gr, dim3 Bl, const Real *mat, Real *vec_val, int32_cuda *vec_id, int32_cuda voff, MatrixDim d) { KALDI_ERR << __func__ << " Not implemented!"; }
 template<typename Real> inline void cuda_diff_xent(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, Real *mat_net_out, Real *vec_log_post, MatrixDim d) { KALDI_ERR << __func__ << " Not implemented!"; }
+template<typename Real> inline void cuda_add_xent_stats(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, const int32_cuda *vec_max_id, const Real *vec_log_post, Real *vec_loss, Real *vec_correct, int32_cuda dim) { KALDI_ERR << __func__ << " Not implemented!"; }
+template<typename Real> inline void cuda_diff_mse(dim3 Gr, dim3 Bl, const Real *mat_out, const Real *mat_tgt, Real *mat_diff, Real *vec_loss, MatrixDim d, int32_cuda out_stride, int32_cuda tgt_stride) { KALDI_ERR << __func__ << " Not implemented!"; }
+template<typename Real> inline void cuda_hid_mask(dim3 Gr, dim3 Bl, const Real *mat_noisy, const Real *mat_clean, Real *mat_mask, Real *mat_masked, Real alpha, int32_cuda binarize, Real thres, MatrixDim d, int32_cuda clean_stride, int32_cuda mask_stride, int32_cuda masked_stride) { KALDI_ERR << __func__ << " Not implemented!"; }
 
 template<typename Real> inline void cuda_randomize(dim3 Gr, dim3 Bl, Real *y, const Real *x, const int32_cuda *copy_from, MatrixDim d_out, MatrixDim d_in) { KALDI_ERR << __func__ << " Not implemented!"; }
 //CURRENTLY UNUSED...
@@ -147,6 +150,9 @@ template<> inline void cuda_softmax_part<float>(dim3 Gr, dim3 Bl, const float *X
 template<> inline void cuda_regularize_l1<float>(dim3 Gr, dim3 Bl, float *wei, float *grad, float l1, float lr, MatrixDim d) { cudaF_regularize_l1(Gr,Bl,wei,grad,l1,lr,d); }
 template<> inline void cuda_find_row_max_id<float>(dim3 Gr, dim3 Bl, const float *mat, float *vec_val, int32_cuda *vec_id, int32_cuda voff, MatrixDim d) { cudaF_find_row_max_id(Gr,Bl,mat,vec_val,vec_id,voff,d); }
 template<> inline void cuda_diff_xent<float>(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, float *mat_net_out, float *vec_log_post, MatrixDim d) { cudaF_diff_xent(Gr,Bl,vec_tgt,mat_net_out,vec_log_post,d); }
+template<> inline void cuda_add_xent_stats<float>(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, const int32_cuda *vec_max_id, const float *vec_log_post, float *vec_loss, float *vec_correct, int32_cuda dim) { cudaF_add_xent_stats(Gr,Bl,vec_tgt,vec_max_id,vec_log_post,vec_loss,vec_correct,dim); }
+template<> inline void cuda_diff_mse<float>(dim3 Gr, dim3 Bl, const float *mat_out, const float *mat_tgt, float *mat_diff, float *vec_loss, MatrixDim d, int32_cuda out_stride, int32_cuda tgt_stride) { cudaF_diff_mse(Gr,Bl,mat_out,mat_tgt,mat_diff,vec_loss,d,out_stride,tgt_stride); }
+template<> inline void cuda_hid_mask<float>(dim3 Gr, dim3 Bl, const float *mat_noisy, const float *mat_clean, float *mat_mask, float *mat_masked, float alpha, int32_cuda binarize, float thres, MatrixDim d, int32_cuda clean_stride, int32_cuda mask_stride, int32_cuda masked_stride) { cudaF_hid_mask(Gr,Bl,mat_noisy,mat_clean,mat_mask,mat_masked,alpha,binarize,thres,d,clean_stride,mask_stride,masked_stride); }
 
 template<> inline void cuda_randomize<float>(dim3 Gr, dim3 Bl, float *y, const float *x, const int32_cuda *copy_from, MatrixDim d_out, MatrixDim d_in) { cudaF_randomize(Gr,Bl,y,x,copy_from,d_out,d_in); }
 //CURRENTLY UNUSED...
@@ -206,6 +212,9 @@ template<> inline void cuda_softmax_part<double>(dim3 Gr, dim3 Bl, const double
 template<> inline void cuda_regularize_l1<double>(dim3 Gr, dim3 Bl, double *wei, double *grad, double l1, double lr, MatrixDim d) { cudaD_regularize_l1(Gr,Bl,wei,grad,l1,lr,d); }
 template<> inline void cuda_find_row_max_id<double>(dim3 Gr, dim3 Bl, const double *mat, double *vec_val, int32_cuda *vec_id, int32_cuda voff, MatrixDim d) { cudaD_find_row_max_id(Gr,Bl,mat,vec_val,vec_id,voff,d); }
 template<> inline void cuda_diff_xent<double>(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, double *mat_net_out, double *vec_log_post, MatrixDim d) { cudaD_diff_xent(Gr,Bl,vec_tgt,mat_net_out,vec_log_post,d); }
+template<> inline void cuda_add_xent_stats<double>(dim3 Gr, dim3 Bl, const int32_cuda *vec_tgt, const int32_cuda *vec_max_id, const double *vec_log_post, double *vec_loss, double *vec_correct, int32_cuda dim) { cudaD_add_xent_stats(Gr,Bl,vec_tgt,vec_max_id,vec_log_post,vec_loss,vec_correct,dim); }
+template<> inline void cuda_diff_mse<double>(dim3 Gr, dim3 Bl, const double *mat_out, const double *mat_tgt, double *mat_diff, double *vec_loss, MatrixDim d, int32_cuda out_stride, int32_cuda tgt_stride) { cudaD_diff_mse(Gr,Bl,mat_out,mat_tgt,mat_diff,vec_loss,d,out_stride,tgt_stride); }
+template<> inline void cuda_hid_mask<double>(dim3 Gr, dim3 Bl, const double *mat_noisy, const double *mat_clean, double *mat_mask, double *mat_masked, double alpha, int32_cuda binarize, double thres, MatrixDim d, int32_cuda clean_stride, int32_cuda mask_stride, int32_cuda masked_stride) { cudaD_hid_mask(Gr,Bl,mat_noisy,mat_clean,mat_mask,mat_masked,alpha,binarize,thres,d,clean_stride,mask_stride,masked_stride); }
 
 template<> inline void cuda_randomize<double>(dim3 Gr, dim3 Bl, double *y, const double *x, const int32_cuda *copy_from, MatrixDim d_out, MatrixDim d_in) { cudaD_randomize(Gr,Bl,y,x,copy_from,d_out,d_in); }
 //CURRENTLY UNUSED...
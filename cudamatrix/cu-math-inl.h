@@ -20,6 +20,11 @@
 #ifndef KALDI_CUDAMATRIX_CUMATH_INL_H_
 #define KALDI_CUDAMATRIX_CUMATH_INL_H_
 
+#include <pthread.h>
+
+#include <algorithm>
+#include <cstring>
+
 #include "util/timer.h"
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-matrix.h"
@@ -380,6 +385,119 @@ void DiffXent(const CuStlVector<int32> &tgt, CuMatrix<Real> *net_out_or_diff, Cu
 
 
 
+template<typename Real>
+void AddXentStats(const CuStlVector<int32> &tgt, const CuStlVector<int32> &max_id, const CuVector<Real> &log_post_tgt,
+                  CuVector<Real> *loss, CuVector<Real> *correct) {
+
+  assert(tgt.Dim() == max_id.Dim());
+  assert(tgt.Dim() == log_post_tgt.Dim());
+  assert(tgt.Dim() <= loss->Dim());
+  assert(tgt.Dim() <= correct->Dim());
+
+  #if HAVE_CUDA==1 
+  if (CuDevice::Instantiate().Enabled()) {
+    Timer tim;
+
+    dim3 dimBlock(CUBLOCK*8);
+    dim3 dimGrid(n_blocks(tgt.Dim(), CUBLOCK*8));
+    cuda_add_xent_stats(dimGrid, dimBlock, tgt.Data(), max_id.Data(), log_post_tgt.Data(), loss->Data(), correct->Data(), tgt.Dim());
+    cuSafeCall(cudaGetLastError());
+
+    CuDevice::Instantiate().AccuProfile(__func__, tim.Elapsed());
+  } else
+  #endif
+  {
+    for(int32 r=0; r<tgt.Dim(); r++) {
+      loss->Vec()(r) -= log_post_tgt.Vec()(r);
+      if (tgt.Vec()[r] == max_id.Vec()[r]) correct->Vec()(r) += 1.0;
+    }
+  }
+}
+
+
+
+template<typename Real>
+void DiffMse(const CuMatrix<Real> &net_out, const CuMatrix<Real> &target, CuMatrix<Real> *diff, CuVector<Real> *loss) {
+
+  assert(net_out.NumRows() == target.NumRows() && net_out.NumCols() == target.NumCols());
+  assert(net_out.NumRows() == diff->NumRows() && net_out.NumCols() == diff->NumCols());
+  assert(net_out.NumRows() <= loss->Dim());
+
+  #if HAVE_CUDA==1 
+  if (CuDevice::Instantiate().Enabled()) {
+    Timer tim;
+
+    if (net_out.NumRows() > 0 && net_out.NumCols() > 0) {
+      // one block per row, reduced in shared memory
+      dim3 dimBlock(std::min<int32>(net_out.NumCols(), 256), 1);
+      dim3 dimGrid(1, net_out.NumRows());
+      cuda_diff_mse(dimGrid, dimBlock, net_out.Data(), target.Data(), diff->Data(), loss->Data(),
+                    diff->Dim(), net_out.Dim().stride, target.Dim().stride);
+      cuSafeCall(cudaGetLastError());
+    }
+
+    CuDevice::Instantiate().AccuProfile(__func__, tim.Elapsed());
+  } else
+  #endif
+  {
+    const MatrixBase<Real> &out = net_out.Mat(), &tgt = target.Mat();
+    MatrixBase<Real> &d = diff->Mat();
+    for(int32 r=0; r<d.NumRows(); r++) {
+      const Real *out_row = out.RowData(r), *tgt_row = tgt.RowData(r);
+      Real *diff_row = d.RowData(r);
+      double sum = 0.0;
+      for(int32 c=0; c<d.NumCols(); c++) {
+        diff_row[c] = out_row[c] - tgt_row[c];
+        sum += diff_row[c] * diff_row[c];
+      }
+      loss->Vec()(r) += 0.5 * sum;
+    }
+  }
+}
+
+
+
+template<typename Real>
+void HidMask(const CuMatrix<Real> &noisy, const CuMatrix<Real> &clean, Real alpha, bool binarize, Real threshold,
+             CuMatrix<Real> *mask, CuMatrix<Real> *masked) {
+
+  assert(noisy.NumRows() == clean.NumRows() && noisy.NumCols() == clean.NumCols());
+  mask->Resize(noisy.NumRows(), noisy.NumCols());
+  if (masked != NULL && masked != &noisy) {
+    masked->Resize(noisy.NumRows(), noisy.NumCols());
+  }
+
+  #if HAVE_CUDA==1 
+  if (CuDevice::Instantiate().Enabled()) {
+    Timer tim;
+
+    dim3 dimBlock(CUBLOCK, CUBLOCK);
+    dim3 dimGrid(n_blocks(noisy.NumCols(), CUBLOCK), n_blocks(noisy.NumRows(), CUBLOCK));
+    cuda_hid_mask(dimGrid, dimBlock, noisy.Data(), clean.Data(), mask->Data(),
+                  (masked != NULL ? masked->Data() : NULL), alpha, (binarize ? 1 : 0), threshold,
+                  noisy.Dim(), clean.Dim().stride, mask->Dim().stride,
+                  (masked != NULL ? masked->Dim().stride : 0));
+    cuSafeCall(cudaGetLastError());
+
+    CuDevice::Instantiate().AccuProfile(__func__, tim.Elapsed());
+  } else
+  #endif
+  {
+    for(int32 r=0; r<noisy.NumRows(); r++) {
+      for(int32 c=0; c<noisy.NumCols(); c++) {
+        Real value = noisy.Mat()(r, c);
+        Real diff = value - clean.Mat()(r, c);
+        Real m = exp(-alpha * diff * diff);
+        if (binarize) m = (m > threshold ? 1.0 : 0.0);
+        mask->Mat()(r, c) = m;
+        if (masked != NULL) masked->Mat()(r, c) = value * m;
+      }
+    }
+  }
+}
+
+
+
 template<typename Real>
 void Randomize(const CuMatrix<Real> &src, const CuStlVector<int32> &copy_from_idx, CuMatrix<Real> *tgt) {
 
@@ -416,6 +534,101 @@ void Randomize(const CuMatrix<Real> &src, const CuStlVector<int32> &copy_from_id
 
 
 
+inline int32& CpuThreadsRef() {
+  static int32 num_threads = 1;
+  return num_threads;
+}
+
+inline void SetCpuThreads(int32 num_threads) {
+  CpuThreadsRef() = std::max(num_threads, 1);
+}
+
+inline int32 CpuThreads() {
+  return CpuThreadsRef();
+}
+
+
+
+/// A range of target rows of the CPU Expand/Copy
+template<typename Real>
+struct SpliceRowsJob {
+  const MatrixBase<Real> *src;
+  const std::vector<int32> *indices;  ///< frame offsets, or (tgt_col, src_col, len) runs
+  MatrixBase<Real> *tgt;
+  int32 row_begin, row_end;
+  void (*fnc)(SpliceRowsJob<Real> *job);
+};
+
+template<typename Real>
+void* RunSpliceRowsJob(void *arg) {
+  SpliceRowsJob<Real> *job = static_cast<SpliceRowsJob<Real>*>(arg);
+  job->fnc(job);
+  return NULL;
+}
+
+/// Splits the rows of job.tgt over CpuThreads() threads, with at least
+/// 128 rows per thread as the threads are started at every call
+template<typename Real>
+void SpliceRowsParallel(const SpliceRowsJob<Real> &job) {
+  int32 num_rows = job.tgt->NumRows();
+  int32 num_jobs = std::min(CpuThreads(), std::max(1, num_rows / 128));
+  std::vector<SpliceRowsJob<Real> > jobs(num_jobs, job);
+  for (int32 t = 0; t < num_jobs; t++) {
+    jobs[t].row_begin = static_cast<int64>(num_rows) * t / num_jobs;
+    jobs[t].row_end = static_cast<int64>(num_rows) * (t + 1) / num_jobs;
+  }
+  // the calling thread does the first range
+  std::vector<pthread_t> threads(num_jobs);
+  int32 num_started = 1;
+  int ret = 0;
+  for (; num_started < num_jobs; num_started++) {
+    ret = pthread_create(&threads[num_started], NULL, RunSpliceRowsJob<Real>,
+                         &jobs[num_started]);
+    if (ret != 0) break;
+  }
+  if (ret == 0) {
+    jobs[0].fnc(&jobs[0]);
+  }
+  // the started threads use jobs, wait for them before leaving
+  for (int32 t = 1; t < num_started; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  if (ret != 0) {
+    KALDI_ERR << "Error creating thread, errno was: " << ret;
+  }
+}
+
+template<typename Real>
+void ExpandRows(SpliceRowsJob<Real> *job) {
+  const MatrixBase<Real> &srcmat = *job->src;
+  const std::vector<int32> &frame_offsetvec = *job->indices;
+  int32 num_rows = srcmat.NumRows(), dim = srcmat.NumCols();
+  for(int32 r = job->row_begin; r < job->row_end; r++) {
+    Real *tgt_row = job->tgt->RowData(r);
+    for(size_t off = 0; off < frame_offsetvec.size(); off++) {
+      int32 r_off = r + frame_offsetvec[off];
+      if(r_off < 0) r_off = 0;
+      if(r_off >= num_rows) r_off = num_rows-1;
+      memcpy(tgt_row + off*dim, srcmat.RowData(r_off), sizeof(Real)*dim);
+    }
+  }
+}
+
+template<typename Real>
+void CopyRows(SpliceRowsJob<Real> *job) {
+  const MatrixBase<Real> &srcmat = *job->src;
+  const std::vector<int32> &runs = *job->indices;
+  for(int32 r = job->row_begin; r < job->row_end; r++) {
+    const Real *src_row = srcmat.RowData(r);
+    Real *tgt_row = job->tgt->RowData(r);
+    for(size_t i = 0; i < runs.size(); i += 3) {
+      memcpy(tgt_row + runs[i], src_row + runs[i+1], sizeof(Real)*runs[i+2]);
+    }
+  }
+}
+
+
+
 template<typename Real>
 void Expand(const CuMatrix<Real> &src, const CuStlVector<int32> &frame_offsets, CuMatrix<Real> *tgt) {
 
@@ -436,17 +649,58 @@ void Expand(const CuMatrix<Real> &src, const CuStlVector<int32> &frame_offsets,
   } else
   #endif
   {
-    // expand in CPU
+    // expand in CPU, one memcpy per offset, rows over the threads
+    SpliceRowsJob<Real> job;
+    job.src = &src.Mat();
+    job.indices = &frame_offsets.Vec();
+    job.tgt = &tgt->Mat();
+    job.fnc = ExpandRows<Real>;
+    SpliceRowsParallel(job);
+  }
+}
+
+
+
+template<typename Real>
+void ExpandAffine(const CuMatrix<Real> &src, const CuStlVector<int32> &frame_offsets,
+                  const CuMatrix<Real> &linearity, const CuVector<Real> &bias, CuMatrix<Real> *tgt) {
+
+  int32 num_rows = src.NumRows(), dim = src.NumCols();
+  assert(linearity.NumCols() == dim*frame_offsets.Dim());
+  assert(linearity.NumRows() == bias.Dim());
+  assert(tgt->NumRows() == num_rows && tgt->NumCols() == linearity.NumRows());
+
+  #if HAVE_CUDA==1
+  if (CuDevice::Instantiate().Enabled()) {
+    // the expanded matrix is cheap on the GPU
+    CuMatrix<Real> expanded(num_rows, linearity.NumCols());
+    Expand(src, frame_offsets, &expanded);
+    tgt->AddVecToRows(1.0, bias, 0.0);
+    tgt->AddMatMat(1.0, expanded, kNoTrans, linearity, kTrans, 1.0);
+  } else
+  #endif
+  {
+    // one GEMM per offset over the shifted rows of src, 
+    // the rows clamped at the edges are added one by one
     const MatrixBase<Real> &srcmat = src.Mat();
+    const MatrixBase<Real> &linmat = linearity.Mat();
     const std::vector<int32> &frame_offsetvec = frame_offsets.Vec();
     MatrixBase<Real> &tgtmat = tgt->Mat();
-    //
-    for(int32 r=0; r < tgtmat.NumRows(); r++) {
-      for(int32 off=0; off < frame_offsetvec.size(); off++) {
-        int32 r_off = r + frame_offsetvec[off];
-        if(r_off < 0) r_off = 0;
-        if(r_off >= srcmat.NumRows()) r_off = srcmat.NumRows()-1;
-        memcpy(tgtmat.RowData(r)+off*srcmat.NumCols(),srcmat.RowData(r_off),sizeof(Real)*srcmat.NumCols());
+    tgtmat.CopyRowsFromVec(bias.Vec());
+    for(size_t k = 0; k < frame_offsetvec.size(); k++) {
+      int32 off = frame_offsetvec[k];
+      SubMatrix<Real> lin_k(linmat, 0, linmat.NumRows(), k*dim, dim);
+      int32 lo = std::min(num_rows, std::max(0, -off)),
+          hi = std::max(0, std::min(num_rows, num_rows - off));
+      if (hi > lo) {
+        SubMatrix<Real> tgt_rows(tgtmat, lo, hi - lo, 0, tgtmat.NumCols());
+        tgt_rows.AddMatMat(1.0, SubMatrix<Real>(srcmat, lo + off, hi - lo, 0, dim), kNoTrans,
+                           lin_k, kTrans, 1.0);
+      }
+      for(int32 r = 0; r < num_rows; r++) {
+        if (r >= lo && r < hi) continue;
+        int32 r_off = std::min(num_rows - 1, std::max(0, r + off));
+        tgtmat.Row(r).AddMatVec(1.0, lin_k, kNoTrans, srcmat.Row(r_off), 1.0);
       }
     }
   }
@@ -474,15 +728,164 @@ void Copy(const CuMatrix<Real> &src, const CuStlVector<int32> &copy_from_indices
   } else
   #endif
   {
-    // expand in CPU
-    const MatrixBase<Real> &srcmat = src.Mat();
+    // copy in CPU, one memcpy per run of consecutive source columns
     const std::vector<int32> &copy_from_indicesvec = copy_from_indices.Vec();
+    std::vector<int32> runs;
+    for(int32 c = 0; c < static_cast<int32>(copy_from_indicesvec.size()); ) {
+      int32 len = 1;
+      while (c + len < static_cast<int32>(copy_from_indicesvec.size())
+             && copy_from_indicesvec[c+len] == copy_from_indicesvec[c] + len) len++;
+      runs.push_back(c);
+      runs.push_back(copy_from_indicesvec[c]);
+      runs.push_back(len);
+      c += len;
+    }
+    SpliceRowsJob<Real> job;
+    job.src = &src.Mat();
+    job.indices = &runs;
+    job.tgt = &tgt->Mat();
+    job.fnc = CopyRows<Real>;
+    SpliceRowsParallel(job);
+  }
+}
+
+
+
+template<typename Real>
+void CopyColsFromMat(const Matrix<Real> &src, const std::vector<bool> &cols, CuMatrix<Real> *tgt) {
+
+  assert(static_cast<MatrixIndexT>(cols.size()) == src.NumCols());
+
+  if (tgt->NumRows() != src.NumRows() || tgt->NumCols() != src.NumCols()) {
+    tgt->CopyFromMat(src);
+    return;
+  }
+
+  MatrixIndexT num_cols = src.NumCols();
+  for (MatrixIndexT c = 0; c < num_cols; ) {
+    if (!cols[c]) { c++; continue; }
+    MatrixIndexT end = c;
+    while (end < num_cols && cols[end]) end++;
+    if (c == 0 && end == num_cols) {
+      // everything changed, one full copy
+      tgt->CopyFromMat(src);
+      return;
+    }
+    tgt->CopyColsFromMat(src, c, end-c);
+    c = end;
+  }
+}
+
+
+
+template<typename Real>
+void SegmentAffine(const CuMatrix<Real> &src, const std::vector<int32> &offsets,
+                   const CuMatrix<Real> &linearity, const CuMatrix<Real> &bias, CuMatrix<Real> *tgt) {
+
+  int32 num_segments = offsets.size() - 1;
+  int32 dim_in = src.NumCols(), dim_out = tgt->NumCols();
+  assert(num_segments >= 0 && offsets.back() == src.NumRows());
+  assert(tgt->NumRows() == src.NumRows());
+  assert(linearity.NumRows() == num_segments*dim_out && linearity.NumCols() == dim_in);
+  assert(bias.NumRows() == num_segments && bias.NumCols() == dim_out);
+
+  #if HAVE_CUDA==1
+  if (CuDevice::Instantiate().Enabled()) {
+    Timer tim;
+
+    int32 max_len = 0;
+    for(int32 s = 0; s < num_segments; s++) {
+      max_len = std::max(max_len, offsets[s+1] - offsets[s]);
+    }
+    CuVector<Real> ones(max_len);
+    ones.Set(1.0);
+
+    for(int32 s = 0; s < num_segments; s++) {
+      int32 len = offsets[s+1] - offsets[s];
+      if (len == 0) continue;
+      Real *tgt_s = tgt->Data() + offsets[s]*tgt->Stride();
+      // precopy bias, ones(len x 1) * bias row
+      cublas_gemm('N', 'N', dim_out, len, 1, Real(1.0), bias.Data() + s*bias.Stride(), bias.Stride(),
+                  ones.Data(), 1, Real(0.0), tgt_s, tgt->Stride());
+      // src_s * linearity_s^T, with the row-major/col-major swap of CuMatrix::AddMatMat
+      cublas_gemm('T', 'N', dim_out, len, dim_in, Real(1.0), linearity.Data() + s*dim_out*linearity.Stride(),
+                  linearity.Stride(), src.Data() + offsets[s]*src.Stride(), src.Stride(),
+                  Real(1.0), tgt_s, tgt->Stride());
+    }
+    cuSafeCall(cublasGetError());
+
+    CuDevice::Instantiate().AccuProfile(__func__, tim.Elapsed());
+  } else
+  #endif
+  {
+    const MatrixBase<Real> &srcmat = src.Mat();
+    const MatrixBase<Real> &linmat = linearity.Mat();
     MatrixBase<Real> &tgtmat = tgt->Mat();
-    //
-    for(int32 r=0; r < tgtmat.NumRows(); r++) {
-      for(int32 c=0; c < copy_from_indicesvec.size(); c++) {
-        tgtmat(r,c) = srcmat(r,copy_from_indicesvec[c]);
-      }
+    for(int32 s = 0; s < num_segments; s++) {
+      int32 len = offsets[s+1] - offsets[s];
+      if (len == 0) continue;
+      SubMatrix<Real> tgt_s(tgtmat, offsets[s], len, 0, dim_out);
+      tgt_s.CopyRowsFromVec(bias.Mat().Row(s));
+      tgt_s.AddMatMat(1.0, SubMatrix<Real>(srcmat, offsets[s], len, 0, dim_in), kNoTrans,
+                      SubMatrix<Real>(linmat, s*dim_out, dim_out, 0, dim_in), kTrans, 1.0);
+    }
+  }
+}
+
+
+
+template<typename Real>
+void SegmentAffineGrad(const CuMatrix<Real> &src, const CuMatrix<Real> &err, const std::vector<int32> &offsets,
+                       const std::vector<Real> &alpha, Real beta,
+                       CuMatrix<Real> *linearity_grad, CuMatrix<Real> *bias_grad) {
+
+  int32 num_segments = offsets.size() - 1;
+  int32 dim_in = src.NumCols(), dim_out = err.NumCols();
+  assert(num_segments >= 0 && offsets.back() == src.NumRows());
+  assert(err.NumRows() == src.NumRows());
+  assert(static_cast<int32>(alpha.size()) == num_segments);
+  assert(linearity_grad->NumRows() == num_segments*dim_out && linearity_grad->NumCols() == dim_in);
+  assert(bias_grad->NumRows() == num_segments && bias_grad->NumCols() == dim_out);
+
+  #if HAVE_CUDA==1
+  if (CuDevice::Instantiate().Enabled()) {
+    Timer tim;
+
+    int32 max_len = 0;
+    for(int32 s = 0; s < num_segments; s++) {
+      max_len = std::max(max_len, offsets[s+1] - offsets[s]);
+    }
+    CuVector<Real> ones(max_len);
+    ones.Set(1.0);
+
+    for(int32 s = 0; s < num_segments; s++) {
+      int32 len = offsets[s+1] - offsets[s];
+      if (len == 0) continue;
+      const Real *src_s = src.Data() + offsets[s]*src.Stride(),
+          *err_s = err.Data() + offsets[s]*err.Stride();
+      // err_s^T * src_s
+      cublas_gemm('N', 'T', dim_in, dim_out, len, alpha[s], src_s, src.Stride(), err_s, err.Stride(),
+                  beta, linearity_grad->Data() + s*dim_out*linearity_grad->Stride(), linearity_grad->Stride());
+      // ones(1 x len) * err_s
+      cublas_gemm('N', 'N', dim_out, 1, len, alpha[s], err_s, err.Stride(), ones.Data(), len,
+                  beta, bias_grad->Data() + s*bias_grad->Stride(), bias_grad->Stride());
+    }
+    cuSafeCall(cublasGetError());
+
+    CuDevice::Instantiate().AccuProfile(__func__, tim.Elapsed());
+  } else
+  #endif
+  {
+    const MatrixBase<Real> &srcmat = src.Mat();
+    const MatrixBase<Real> &errmat = err.Mat();
+    MatrixBase<Real> &gradmat = linearity_grad->Mat();
+    for(int32 s = 0; s < num_segments; s++) {
+      int32 len = offsets[s+1] - offsets[s];
+      if (len == 0) continue;
+      SubMatrix<Real> err_s(errmat, offsets[s], len, 0, dim_out);
+      SubMatrix<Real>(gradmat, s*dim_out, dim_out, 0, dim_in).AddMatMat(
+          alpha[s], err_s, kTrans, SubMatrix<Real>(srcmat, offsets[s], len, 0, dim_in), kNoTrans, beta);
+      bias_grad->Mat().Row(s).AddRowSumMat(alpha[s], err_s, beta);
     }
   }
 }
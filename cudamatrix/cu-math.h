@@ -94,18 +94,68 @@ namespace cu {
   template<typename Real>
   void DiffXent(const CuStlVector<int32> &tgt, CuMatrix<Real> *net_out_or_diff, CuVector<Real> *log_post_tgt);
 
+  /// Accumulate the per-frame cross-entropy statistics on the device,
+  /// so they are downloaded only when reported :
+  /// loss(r) -= log_post_tgt(r), correct(r) += (tgt(r) == max_id(r))
+  template<typename Real>
+  void AddXentStats(const CuStlVector<int32> &tgt, const CuStlVector<int32> &max_id, const CuVector<Real> &log_post_tgt,
+                    CuVector<Real> *loss, CuVector<Real> *correct);
+
+  /// Differentiate the mean square error, in a single pass :
+  /// diff = net_out - target, loss(r) += 0.5 * sum_c diff(r,c)^2
+  template<typename Real>
+  void DiffMse(const CuMatrix<Real> &net_out, const CuMatrix<Real> &target, CuMatrix<Real> *diff, CuVector<Real> *loss);
+
+  /// Hidden mask of the noisy activations, in a single pass :
+  /// mask = exp(-alpha * (noisy - clean)^2), optionally binarized (mask > threshold),
+  /// masked = noisy .* mask unless NULL (masked can be &noisy)
+  template<typename Real>
+  void HidMask(const CuMatrix<Real> &noisy, const CuMatrix<Real> &clean, Real alpha, bool binarize, Real threshold,
+               CuMatrix<Real> *mask, CuMatrix<Real> *masked);
+
   /// ie. switch rows according to copy_from_idx
   template<typename Real>
   void Randomize(const CuMatrix<Real> &src, const CuStlVector<int32> &copy_from_idx, CuMatrix<Real> *tgt);
 
+  /// Number of threads of the CPU versions of Expand and Copy (default 1),
+  /// the rows are split over the threads
+  inline void SetCpuThreads(int32 num_threads);
+  inline int32 CpuThreads();
+
   /// ie. concatenate the frames with offsets from frame_offsets
   template<typename Real>
   void Expand(const CuMatrix<Real> &src, const CuStlVector<int32> &frame_offsets, CuMatrix<Real> *tgt);
 
+  /// Expand followed by an affine transform, without building the expanded matrix on CPU :
+  /// tgt = bias + sum_k shift(src, frame_offsets[k]) * linearity(:, k-th block)^T
+  template<typename Real>
+  void ExpandAffine(const CuMatrix<Real> &src, const CuStlVector<int32> &frame_offsets,
+                    const CuMatrix<Real> &linearity, const CuVector<Real> &bias, CuMatrix<Real> *tgt);
+
   /// ie. concatenate the frames with offsets from frame_offsets
   template<typename Real>
   void Copy(const CuMatrix<Real> &src, const CuStlVector<int32> &copy_from_indices, CuMatrix<Real> *tgt);
 
+  /// Upload the flagged columns of a host matrix to the same columns of tgt,
+  /// one copy per run of consecutive flagged columns
+  template<typename Real>
+  void CopyColsFromMat(const Matrix<Real> &src, const std::vector<bool> &cols, CuMatrix<Real> *tgt);
+
+  /// Block diagonal affine transform of row segments, one GEMM per segment :
+  /// rows [offsets[s], offsets[s+1]) of tgt = row s of bias + the same rows of src * 
+  /// (rows [s*D, (s+1)*D) of linearity)^T, with D = tgt->NumCols(), empty segments are skipped
+  template<typename Real>
+  void SegmentAffine(const CuMatrix<Real> &src, const std::vector<int32> &offsets,
+                     const CuMatrix<Real> &linearity, const CuMatrix<Real> &bias, CuMatrix<Real> *tgt);
+
+  /// Gradients of SegmentAffine for each segment s with rows [offsets[s], offsets[s+1]) :
+  /// block s of linearity_grad = alpha[s] * err_s^T * src_s + beta * block s,
+  /// row s of bias_grad = alpha[s] * row sum of err_s + beta * row s, empty segments are skipped
+  template<typename Real>
+  void SegmentAffineGrad(const CuMatrix<Real> &src, const CuMatrix<Real> &err, const std::vector<int32> &offsets,
+                         const std::vector<Real> &alpha, Real beta,
+                         CuMatrix<Real> *linearity_grad, CuMatrix<Real> *bias_grad);
+
 
 
 } // namespace cu
@@ -25,6 +25,8 @@
   #include <cublas.h>
 #endif
 
+#include <algorithm>
+
 #include "util/timer.h"
 #include "cu-common.h"
 #include "cu-vector.h"
@@ -141,6 +143,17 @@ void CuMatrix<Real>::Destroy() {
 
 
 
+template<typename Real>
+void CuMatrix<Real>::Swap(CuMatrix<Real> *mat) {
+  std::swap(num_rows_, mat->num_rows_);
+  std::swap(num_cols_, mat->num_cols_);
+  std::swap(stride_, mat->stride_);
+  std::swap(data_, mat->data_);
+  mat_.Swap(&mat->mat_);
+}
+
+
+
 template<typename Real>
 CuMatrix<Real>& CuMatrix<Real>::CopyFromMat(const CuMatrix<Real> &src) {
   Resize(src.NumRows(), src.NumCols());
@@ -293,6 +306,31 @@ void CuMatrix<Real>::CopyRowsFromMat(int32 r, const CuMatrix<Real> &src, int32 s
 
 
 
+template<typename Real>
+void CuMatrix<Real>::CopyColsFromMat(const Matrix<Real> &src, MatrixIndexT co, MatrixIndexT c) {
+  assert(src.NumRows() == NumRows() && src.NumCols() == NumCols());
+  assert(co >= 0 && c >= 0 && co+c <= NumCols());
+  if (c == 0) return;
+
+  #if HAVE_CUDA==1 
+  if (CuDevice::Instantiate().Enabled()) { 
+    Timer tim;
+
+    MatrixIndexT dst_pitch = stride_*sizeof(Real);
+    MatrixIndexT src_pitch = src.Stride()*sizeof(Real);
+    MatrixIndexT width = c*sizeof(Real);
+    cuSafeCall(cudaMemcpy2D(data_+co, dst_pitch, src.Data()+co, src_pitch, width, src.NumRows(), cudaMemcpyHostToDevice));
+
+    CuDevice::Instantiate().AccuProfile("CuMatrix::CopyColsFromMatH2D",tim.Elapsed());
+  } else
+  #endif
+  {
+    SubMatrix<Real>(mat_, 0, NumRows(), co, c).CopyFromMat(SubMatrix<Real>(src, 0, src.NumRows(), co, c));
+  }
+}
+
+
+
 template<typename Real>
 void CuMatrix<Real>::Read(std::istream &is, bool binary) {
   Matrix<BaseFloat> tmp;
@@ -107,6 +107,9 @@ class CuMatrix {
   /// Deallocate the memory
   void Destroy();
 
+  /// Exchange the contents with another matrix, no data is copied
+  void Swap(CuMatrix<Real> *mat);
+
   /// Copy functions (reallocates when needed)
   ThisType&        CopyFromMat(const CuMatrix<Real> &src);
   ThisType&        CopyFromMat(const Matrix<Real> &src);
@@ -130,6 +133,12 @@ class CuMatrix {
   /// @param dst_ro [in] destination matrix row offset.
   void             CopyRowsFromMat(int32 r, const CuMatrix<Real> &src, int32 src_ro, int32 dst_ro);
 
+  /// Copy column interval from a host matrix of the same size
+  /// @param src [in] source matrix.
+  /// @param co  [in] column offset, the same in both matrices.
+  /// @param c   [in] number of columns to copy.
+  void             CopyColsFromMat(const Matrix<Real> &src, MatrixIndexT co, MatrixIndexT c);
+
   /// I/O functions
   void             Read(std::istream &is, bool binary);
   void             Write(std::ostream &os, bool binary) const;
@@ -666,6 +666,272 @@ static void UnitTestCuDiffXent() {
 
 
 
+template<class Real> 
+static void UnitTestCuAddXentStats() {
+  int32 X=100, Y=111;
+  Matrix<Real> Hi(X,Y);
+  RandZeroToOneMatrix(&Hi);
+  CuMatrix<Real> Di(X,Y);
+  Di.CopyFromMat(Hi);
+  std::vector<int32> Htgt(X);
+  for(int32 i=0; i<X; i++) {
+    Htgt[i] = rand()%Y;
+  }
+  CuStlVector<int32> Dtgt(X);
+  Dtgt.CopyFromVec(Htgt);
+  CuStlVector<int32> Dmax(X);
+  cu::FindRowMaxId(Di,&Dmax);
+  std::vector<int32> Hmax;
+  Dmax.CopyToVec(&Hmax);
+  CuVector<Real> Dlogpost(X);
+  cu::DiffXent(Dtgt,&Di,&Dlogpost);
+  Vector<Real> Hlogpost;
+  Dlogpost.CopyToVec(&Hlogpost);
+
+  //accumulators longer than the bunch, accumulated twice
+  Vector<Real> Hloss(X+10), Hcorrect(X+10);
+  CuVector<Real> Dloss(X+10), Dcorrect(X+10);
+  for(int32 n=0; n<2; n++) {
+    //gpu
+    cu::AddXentStats(Dtgt,Dmax,Dlogpost,&Dloss,&Dcorrect);
+    //cpu
+    for(int32 r=0; r<X; r++) {
+      Hloss(r) -= Hlogpost(r);
+      if(Htgt[r] == Hmax[r]) Hcorrect(r) += 1.0;
+    }
+  }
+
+  Vector<Real> Hloss2, Hcorrect2;
+  Dloss.CopyToVec(&Hloss2);
+  Dcorrect.CopyToVec(&Hcorrect2);
+
+  AssertEqual(Hloss,Hloss2);
+  AssertEqual(Hcorrect,Hcorrect2);
+}
+
+
+
+template<class Real> 
+static void UnitTestCuDiffMse() {
+  int32 X=100, Y=300;
+  Matrix<Real> Hout(X,Y), Htgt(X,Y);
+  RandGaussMatrix(&Hout);
+  RandGaussMatrix(&Htgt);
+  //keep the row sums in the range of the absolute tolerance
+  Hout.Scale(0.1);
+  Htgt.Scale(0.1);
+  CuMatrix<Real> Dout(X,Y), Dtgt(X,Y), Ddiff(X,Y);
+  Dout.CopyFromMat(Hout);
+  Dtgt.CopyFromMat(Htgt);
+
+  Vector<Real> Hloss(X);
+  CuVector<Real> Dloss(X);
+  Hloss.Set(1.0);
+  Dloss.Set(1.0);
+
+  //gpu
+  cu::DiffMse(Dout,Dtgt,&Ddiff,&Dloss);
+  //cpu
+  Matrix<Real> Hdiff(Hout);
+  Hdiff.AddMat(-1.0,Htgt);
+  for(MatrixIndexT r=0; r<X; r++) {
+    Hloss(r) += 0.5*VecVec(Hdiff.Row(r),Hdiff.Row(r));
+  }
+
+  Matrix<Real> Hdiff2(X,Y);
+  Ddiff.CopyToMat(&Hdiff2);
+  Vector<Real> Hloss2(X);
+  Dloss.CopyToVec(&Hloss2);
+
+  AssertEqual(Hdiff,Hdiff2);
+  AssertEqual(Hloss,Hloss2);
+}
+
+
+template<class Real> 
+static void UnitTestCuHidMask() {
+  int32 X=100, Y=300;
+  Matrix<Real> Hnoisy(X,Y), Hclean(X,Y);
+  RandGaussMatrix(&Hnoisy);
+  RandGaussMatrix(&Hclean);
+  CuMatrix<Real> Dnoisy(X,Y), Dclean(X,Y), Dmask, Dmasked;
+  Dnoisy.CopyFromMat(Hnoisy);
+  Dclean.CopyFromMat(Hclean);
+
+  for(int32 binarize=0; binarize<2; binarize++) {
+    //gpu
+    cu::HidMask(Dnoisy,Dclean,(Real)3.0,(binarize==1),(Real)0.5,&Dmask,&Dmasked);
+    //cpu
+    Matrix<Real> Hmask(Hnoisy);
+    Hmask.AddMat(-1.0,Hclean);
+    Hmask.ApplyPow(2.0);
+    Hmask.Scale(-3.0);
+    Hmask.ApplyExp();
+    if(binarize==1) {
+      for(MatrixIndexT r=0; r<X; r++) {
+        for(MatrixIndexT c=0; c<Y; c++) {
+          Hmask(r,c) = (Hmask(r,c) > 0.5 ? 1.0 : 0.0);
+        }
+      }
+    }
+    Matrix<Real> Hmasked(Hnoisy);
+    Hmasked.MulElements(Hmask);
+
+    Matrix<Real> Hmask2(X,Y), Hmasked2(X,Y);
+    Dmask.CopyToMat(&Hmask2);
+    Dmasked.CopyToMat(&Hmasked2);
+
+    AssertEqual(Hmask,Hmask2);
+    AssertEqual(Hmasked,Hmasked2);
+  }
+}
+
+
+
+template<class Real> 
+static void UnitTestCuExpandCopy() {
+  int32 X=1000, Y=40;
+  Matrix<Real> Hsrc(X,Y);
+  RandGaussMatrix(&Hsrc);
+  CuMatrix<Real> Dsrc(X,Y);
+  Dsrc.CopyFromMat(Hsrc);
+
+  std::vector<int32> offsets;
+  for(int32 o=-5; o<=5; o++) offsets.push_back(o);
+  CuStlVector<int32> Doffsets;
+  Doffsets.CopyFromVec(offsets);
+  //runs of consecutive columns, a reversed part and a repeated column
+  std::vector<int32> indices;
+  for(int32 c=0; c<Y/2; c++) indices.push_back(c+Y/2);
+  for(int32 c=Y/2-1; c>=0; c--) indices.push_back(c);
+  indices.push_back(3);
+  CuStlVector<int32> Dindices;
+  Dindices.CopyFromVec(indices);
+
+  for(int32 threads=1; threads<=4; threads+=3) {
+    cu::SetCpuThreads(threads);
+    //gpu
+    CuMatrix<Real> Dexp(X,Y*offsets.size()), Dcopy(X,indices.size());
+    cu::Expand(Dsrc,Doffsets,&Dexp);
+    cu::Copy(Dsrc,Dindices,&Dcopy);
+    //cpu
+    Matrix<Real> Hexp(X,Y*offsets.size()), Hcopy(X,indices.size());
+    for(MatrixIndexT r=0; r<X; r++) {
+      for(size_t k=0; k<offsets.size(); k++) {
+        int32 r_off = std::min(X-1, std::max(0, r+offsets[k]));
+        for(MatrixIndexT c=0; c<Y; c++) Hexp(r,k*Y+c) = Hsrc(r_off,c);
+      }
+      for(size_t c=0; c<indices.size(); c++) Hcopy(r,c) = Hsrc(r,indices[c]);
+    }
+
+    Matrix<Real> Hexp2(X,Y*offsets.size()), Hcopy2(X,indices.size());
+    Dexp.CopyToMat(&Hexp2);
+    Dcopy.CopyToMat(&Hcopy2);
+    AssertEqual(Hexp,Hexp2);
+    AssertEqual(Hcopy,Hcopy2);
+  }
+  cu::SetCpuThreads(1);
+}
+
+
+
+template<class Real> 
+static void UnitTestCuExpandAffine() {
+  int32 X=100, Y=20, Z=30;
+  Matrix<Real> Hsrc(X,Y), Hlin(Z,5*Y);
+  Vector<Real> Hbias(Z);
+  RandGaussMatrix(&Hsrc);
+  RandGaussMatrix(&Hlin);
+  InitRand(&Hbias);
+  //keep the sums in the range of the absolute tolerance
+  Hlin.Scale(0.01);
+  CuMatrix<Real> Dsrc(X,Y), Dlin(Z,5*Y);
+  CuVector<Real> Dbias(Z);
+  Dsrc.CopyFromMat(Hsrc);
+  Dlin.CopyFromMat(Hlin);
+  Dbias.CopyFromVec(Hbias);
+
+  //the last offset is beyond the whole matrix
+  std::vector<int32> offsets;
+  offsets.push_back(-2); offsets.push_back(-1); offsets.push_back(0); 
+  offsets.push_back(3); offsets.push_back(X+5);
+  CuStlVector<int32> Doffsets;
+  Doffsets.CopyFromVec(offsets);
+
+  //fused
+  CuMatrix<Real> Dout(X,Z);
+  cu::ExpandAffine(Dsrc,Doffsets,Dlin,Dbias,&Dout);
+  //expanded
+  CuMatrix<Real> Dexp(X,5*Y), Dref(X,Z);
+  cu::Expand(Dsrc,Doffsets,&Dexp);
+  Dref.AddVecToRows(1.0,Dbias,0.0);
+  Dref.AddMatMat(1.0,Dexp,kNoTrans,Dlin,kTrans,1.0);
+
+  Matrix<Real> Hout(X,Z), Href(X,Z);
+  Dout.CopyToMat(&Hout);
+  Dref.CopyToMat(&Href);
+  AssertEqual(Hout,Href);
+}
+
+
+
+template<class Real> 
+static void UnitTestCuSegmentAffine() {
+  int32 Y=20, Z=15, S=4;
+  //the third segment is empty
+  std::vector<int32> offsets;
+  offsets.push_back(0); offsets.push_back(30); offsets.push_back(37);
+  offsets.push_back(37); offsets.push_back(100);
+  int32 X=offsets.back();
+
+  Matrix<Real> Hsrc(X,Y), Herr(X,Z), Hlin(S*Z,Y), Hbias(S,Z);
+  RandGaussMatrix(&Hsrc);
+  RandGaussMatrix(&Herr);
+  RandGaussMatrix(&Hlin);
+  RandGaussMatrix(&Hbias);
+  //keep the sums in the range of the absolute tolerance
+  Hlin.Scale(0.01);
+  Herr.Scale(0.01);
+  CuMatrix<Real> Dsrc(X,Y), Derr(X,Z), Dlin(S*Z,Y), Dbias(S,Z);
+  Dsrc.CopyFromMat(Hsrc);
+  Derr.CopyFromMat(Herr);
+  Dlin.CopyFromMat(Hlin);
+  Dbias.CopyFromMat(Hbias);
+
+  std::vector<Real> alpha;
+  for(int32 s=0; s<S; s++) alpha.push_back(1.0/(s+1));
+
+  CuMatrix<Real> Dout(X,Z), Dlin_grad(S*Z,Y), Dbias_grad(S,Z);
+  Dlin_grad.CopyFromMat(Hlin);
+  Dbias_grad.CopyFromMat(Hbias);
+  cu::SegmentAffine(Dsrc,offsets,Dlin,Dbias,&Dout);
+  cu::SegmentAffineGrad(Dsrc,Derr,offsets,alpha,Real(0.5),&Dlin_grad,&Dbias_grad);
+
+  //reference, segment by segment
+  Matrix<Real> Href(X,Z), Hlin_grad(Hlin), Hbias_grad(Hbias);
+  for(int32 s=0; s<S; s++) {
+    int32 len = offsets[s+1]-offsets[s];
+    if (len == 0) continue;
+    SubMatrix<Real> src_s(Hsrc,offsets[s],len,0,Y), err_s(Herr,offsets[s],len,0,Z);
+    SubMatrix<Real> lin_s(Hlin,s*Z,Z,0,Y);
+    SubMatrix<Real> ref_s(Href,offsets[s],len,0,Z);
+    ref_s.CopyRowsFromVec(Hbias.Row(s));
+    ref_s.AddMatMat(1.0,src_s,kNoTrans,lin_s,kTrans,1.0);
+    SubMatrix<Real>(Hlin_grad,s*Z,Z,0,Y).AddMatMat(alpha[s],err_s,kTrans,src_s,kNoTrans,0.5);
+    Hbias_grad.Row(s).AddRowSumMat(alpha[s],err_s,0.5);
+  }
+
+  Matrix<Real> Hout(X,Z), Hlin_grad2(S*Z,Y), Hbias_grad2(S,Z);
+  Dout.CopyToMat(&Hout);
+  Dlin_grad.CopyToMat(&Hlin_grad2);
+  Dbias_grad.CopyToMat(&Hbias_grad2);
+  AssertEqual(Hout,Href);
+  AssertEqual(Hlin_grad2,Hlin_grad);
+  AssertEqual(Hbias_grad2,Hbias_grad);
+}
+
+
+
 
 
 template<class Real> static void CudaMatrixUnitTest() {
@@ -692,6 +958,12 @@ template<class Real> static void CudaMatrixUnitTest() {
   UnitTestCuSoftmax<Real>();
   UnitTestCuFindRowMaxId<Real>();
   UnitTestCuDiffXent<Real>();
+  UnitTestCuAddXentStats<Real>();
+  UnitTestCuDiffMse<Real>();
+  UnitTestCuHidMask<Real>();
+  UnitTestCuExpandCopy<Real>();
+  UnitTestCuExpandAffine<Real>();
+  UnitTestCuSegmentAffine<Real>();
 }
 
 
@@ -0,0 +1,195 @@
+// nnet/nnet-activation-store.cc
+
+#include "nnet/nnet-activation-store.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+namespace kaldi {
+
+namespace {
+
+const uint64 kSpillAlignment = 64;
+
+uint64 AlignUp(uint64 offset) {
+  return (offset + kSpillAlignment - 1) / kSpillAlignment * kSpillAlignment;
+}
+
+}  // namespace
+
+ActivationStore::ActivationStore(size_t ram_limit,
+                                 const std::string &spill_dir)
+    : ram_limit_(ram_limit),
+      ram_bytes_(0),
+      spill_dir_(spill_dir),
+      fd_(-1),
+      spill_size_(0),
+      map_(NULL),
+      map_size_(0) {
+}
+
+ActivationStore::~ActivationStore() {
+  Clear();
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void ActivationStore::Add(const std::string &key,
+                          const CuMatrix<BaseFloat> &mat) {
+  if (HasKey(key)) {
+    KALDI_ERR << "Activations of " << key << " are already stored";
+  }
+  Entry entry;
+  entry.rows = mat.NumRows();
+  entry.cols = mat.NumCols();
+  entry.offset = 0;
+  entry.mat = NULL;
+
+  size_t bytes = static_cast<size_t>(entry.rows) * entry.cols
+      * sizeof(BaseFloat);
+  if (ram_bytes_ + bytes <= ram_limit_) {
+    entry.mat = new Matrix<BaseFloat>(entry.rows, entry.cols, kUndefined);
+    mat.CopyToMat(entry.mat);
+    ram_bytes_ += bytes;
+  } else {
+    host_buf_.Resize(entry.rows, entry.cols, kUndefined);
+    mat.CopyToMat(&host_buf_);
+    entry.offset = Spill(host_buf_);
+  }
+  index_[key] = entry;
+}
+
+void ActivationStore::Get(const std::string &key, CuMatrix<BaseFloat> *mat) {
+  std::map<std::string, Entry>::const_iterator it = index_.find(key);
+  if (it == index_.end()) {
+    KALDI_ERR << "No activations of " << key << " in the store";
+  }
+  const Entry &entry = it->second;
+  mat->Resize(entry.rows, entry.cols, kUndefined);
+  if (entry.mat != NULL) {
+    mat->CopyFromMat(*entry.mat);
+    return;
+  }
+
+  if (entry.rows == 0) {
+    return;
+  }
+  MapSpill();
+  const BaseFloat *src = reinterpret_cast<const BaseFloat*>(map_
+      + entry.offset);
+  // the CuMatrix here has no access to its device data, the rows go
+  // through the host buffer
+  host_buf_.Resize(entry.rows, entry.cols, kUndefined);
+  for (int32 r = 0; r < entry.rows; ++r, src += entry.cols) {
+    memcpy(host_buf_.RowData(r), src, entry.cols * sizeof(BaseFloat));
+  }
+  mat->CopyFromMat(host_buf_);
+}
+
+void ActivationStore::Clear() {
+  for (std::map<std::string, Entry>::iterator it = index_.begin();
+      it != index_.end(); ++it) {
+    delete it->second.mat;
+  }
+  index_.clear();
+  ram_bytes_ = 0;
+
+  if (map_ != NULL) {
+    munmap(map_, map_size_);
+    map_ = NULL;
+    map_size_ = 0;
+  }
+  if (fd_ >= 0 && spill_size_ > 0) {
+    if (ftruncate(fd_, 0) != 0) {
+      KALDI_WARN << "Could not truncate the activation spill file: "
+          << strerror(errno);
+    }
+  }
+  spill_size_ = 0;
+}
+
+std::string ActivationStore::Info() const {
+  int32 num_spilled = 0;
+  for (std::map<std::string, Entry>::const_iterator it = index_.begin();
+      it != index_.end(); ++it) {
+    if (it->second.mat == NULL) num_spilled++;
+  }
+  std::ostringstream os;
+  os << NumMatrices() << " matrices, " << (NumMatrices() - num_spilled)
+     << " in RAM (" << ram_bytes_ / (1024 * 1024) << "MB), " << num_spilled
+     << " spilled (" << spill_size_ / (1024 * 1024) << "MB)";
+  return os.str();
+}
+
+uint64 ActivationStore::Spill(const MatrixBase<BaseFloat> &mat) {
+  if (fd_ < 0) {
+    std::string name = spill_dir_ + "/activations.XXXXXX";
+    std::vector<char> path(name.begin(), name.end());
+    path.push_back('\0');
+    fd_ = mkstemp(&path[0]);
+    if (fd_ < 0) {
+      KALDI_ERR << "Could not create the activation spill file in "
+          << spill_dir_ << ": " << strerror(errno);
+    }
+    // only the descriptor refers to it from now on
+    unlink(&path[0]);
+    KALDI_LOG << "Activations above " << ram_limit_ / (1024 * 1024)
+        << "MB spill to " << spill_dir_;
+  }
+
+  uint64 offset = AlignUp(spill_size_);
+  size_t row_bytes = mat.NumCols() * sizeof(BaseFloat);
+  if (mat.Stride() == mat.NumCols()) {
+    // no padding, the whole matrix goes in one write
+    WriteAt(reinterpret_cast<const char*>(mat.Data()),
+            mat.NumRows() * row_bytes, offset);
+  } else {
+    for (MatrixIndexT r = 0; r < mat.NumRows(); ++r) {
+      WriteAt(reinterpret_cast<const char*>(mat.RowData(r)), row_bytes,
+              offset + r * row_bytes);
+    }
+  }
+  spill_size_ = offset + mat.NumRows() * row_bytes;
+  return offset;
+}
+
+void ActivationStore::WriteAt(const char *src, size_t bytes, uint64 pos) {
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t n = pwrite(fd_, src + done, bytes - done, pos + done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      KALDI_ERR << "Could not write the activation spill file: "
+          << strerror(errno);
+    }
+    done += n;
+  }
+}
+
+void ActivationStore::MapSpill() {
+  if (map_ != NULL && map_size_ >= spill_size_) {
+    return;
+  }
+  // the file grew since the last mapping
+  if (map_ != NULL) {
+    munmap(map_, map_size_);
+    map_ = NULL;
+    map_size_ = 0;
+  }
+  void *addr = mmap(NULL, spill_size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (addr == MAP_FAILED) {
+    KALDI_ERR << "Could not map the activation spill file: "
+        << strerror(errno);
+  }
+  map_ = static_cast<char*>(addr);
+  map_size_ = spill_size_;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,88 @@
+// nnet/nnet-activation-store.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Per-utterance store of the activations of the frozen part of a network,
+ * computed once and read back in the following iterations of an adaptation.
+ *
+ * The matrices are kept in host memory up to a byte limit, the following
+ * ones are appended to a spill file (created in a given directory and
+ * unlinked at once, so it goes away with the process) which is mapped to
+ * read them back. Each spilled matrix is stored row by row without stride,
+ * at a 64-byte aligned offset.
+ *
+ */
+
+#ifndef KALDI_NNET_ACTIVATION_STORE_H
+#define KALDI_NNET_ACTIVATION_STORE_H
+
+#include <map>
+#include <string>
+
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "cudamatrix/cu-matrix.h"
+
+namespace kaldi {
+
+class ActivationStore {
+ public:
+  /// ram_limit in bytes, spill_dir is where the spill file is created
+  /// (only when the limit is reached)
+  ActivationStore(size_t ram_limit, const std::string &spill_dir);
+  ~ActivationStore();
+
+  bool HasKey(const std::string &key) const {
+    return index_.find(key) != index_.end();
+  }
+  /// Copy the matrix into the store, the key must be new
+  void Add(const std::string &key, const CuMatrix<BaseFloat> &mat);
+  /// Copy the stored matrix out, mat is resized
+  void Get(const std::string &key, CuMatrix<BaseFloat> *mat);
+  /// Remove all the matrices, the spill file is truncated
+  void Clear();
+
+  int32 NumMatrices() const {
+    return index_.size();
+  }
+  size_t RamBytes() const {
+    return ram_bytes_;
+  }
+  size_t SpillBytes() const {
+    return spill_size_;
+  }
+  std::string Info() const;
+
+ private:
+  struct Entry {
+    Matrix<BaseFloat> *mat;  ///< NULL when spilled
+    uint64 offset;  ///< in the spill file
+    int32 rows, cols;
+  };
+
+  /// Append the matrix to the spill file, returns its offset
+  uint64 Spill(const MatrixBase<BaseFloat> &mat);
+  /// pwrite all the bytes at pos of the spill file
+  void WriteAt(const char *src, size_t bytes, uint64 pos);
+  /// Map the spill file up to its current size
+  void MapSpill();
+
+  size_t ram_limit_, ram_bytes_;
+  std::map<std::string, Entry> index_;
+
+  std::string spill_dir_;
+  int fd_;
+  uint64 spill_size_;
+  char *map_;
+  size_t map_size_;
+
+  Matrix<BaseFloat> host_buf_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ActivationStore);
+};
+
+}  // namespace kaldi
+
+#endif
@@ -8,6 +8,15 @@
  *      In this new implementation, we store the code related transform separately.
  *      code_vec_ is shared among different layers, hence cannot directly updated in each batch;
  *      code_xform_ is specific to each layer, thus can be updated similarly to the linearity.
+ *
+ *      The code is constant within a set, so code_xform_ * code_vec_ is computed once per
+ *      code change and added as a bias; the code diff and the code_xform_ gradient only
+ *      need the row sum of the output diff.
+ *
+ *      With the weight not updated, in * linearity_^T + bias_ does not change either and
+ *      can be computed once per input (InputProduct), the forward pass and the code
+ *      updates are then done from it (PropagateFromProduct, BackpropagateCode,
+ *      UpdateCodeXform) without the input.
  */
 
 #ifndef NNET_CODEBL_H_
@@ -28,7 +37,8 @@ class CodeAT : public AffineTransform {
         update_weight_(false), 
         update_code_xform_(false),
         update_code_vec_(false),
-        code_dim_(0)
+        code_dim_(0),
+        code_shift_valid_(false)
   {
   }
 
@@ -64,6 +74,7 @@ class CodeAT : public AffineTransform {
 
     code_xform_corr_.Resize(output_dim_, code_dim_);
 
+    code_shift_valid_ = false;
   }
 
   void WriteData(std::ostream &os, bool binary) const {
@@ -81,11 +92,8 @@ class CodeAT : public AffineTransform {
 
     // add the code shifting if needed
     if (code_dim_ > 0) {
-      if(in.NumRows()!=code_vec_expd_.NumRows()) {
-        code_vec_expd_.Resize(in.NumRows(), code_dim_);
-        code_vec_expd_.AddVecToRows(1.0, code_vec_, 0.0);
-      }
-      out->AddMatMat(1.0, code_vec_expd_, kNoTrans, code_xform_, kTrans, 1.0);
+      UpdateCodeShift();
+      out->AddVecToRows(1.0, code_shift_, 1.0);
     }
   }
 
@@ -94,10 +102,7 @@ class CodeAT : public AffineTransform {
                         const CuMatrix<BaseFloat> &out_diff,
                         CuMatrix<BaseFloat> *in_diff) {
     AffineTransform::BackpropagateFnc(in, out, out_diff, in_diff);
-
-    // compute the code diff
-    code_vec_diff_.Resize(out_diff.NumRows(), code_dim_);
-    code_vec_diff_.AddMatMat(1.0, out_diff, kNoTrans, code_xform_, kNoTrans, 0.0);
+    BackpropagateCode(out_diff);
   }
 
   void Update(const CuMatrix<BaseFloat> &input,
@@ -106,16 +111,57 @@ class CodeAT : public AffineTransform {
       AffineTransform::Update(input, diff);
     }
 
-    if(update_code_xform_) {
+    UpdateCodeXform(diff);
+
+    // the code vector is update in the main tool due to its inter-layer sharing
+    // the code_vec_diff_ is computed in the BackpropagateFnc.
+  }
+
+  /// prod = in * linearity_^T + bias_, fixed while the weight is not updated
+  void InputProduct(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *prod) {
+    if (update_weight_) {
+      KALDI_ERR << "The weight of <codeat> is updated, the input product changes";
+    }
+    prod->Resize(in.NumRows(), output_dim_);
+    prod->AddVecToRows(1.0, bias_, 0.0);
+    prod->AddMatMat(1.0, in, kNoTrans, linearity_, kTrans, 1.0);
+  }
+
+  /// Same output as PropagateFnc, from the InputProduct of the input
+  void PropagateFromProduct(const CuMatrix<BaseFloat> &prod,
+                            CuMatrix<BaseFloat> *out) {
+    KALDI_ASSERT(prod.NumCols() == output_dim_);
+    out->Resize(prod.NumRows(), output_dim_);
+    out->CopyFromMat(prod);
+    if (code_dim_ > 0) {
+      UpdateCodeShift();
+      out->AddVecToRows(1.0, code_shift_, 1.0);
+    }
+  }
+
+  /// Compute the code diff, the frames share the code so only the sum
+  /// of the diffs is projected, code_vec_diff_ has a single row
+  void BackpropagateCode(const CuMatrix<BaseFloat> &out_diff) {
+    if (code_dim_ > 0) {
+      SumDiff(out_diff);
+      code_vec_diff_.Resize(1, code_dim_);
+      code_vec_diff_.AddMatMat(1.0, diff_sum_, kNoTrans, code_xform_, kNoTrans, 0.0);
+    }
+  }
+
+  /// The code_xform_ update, it only needs the output diff
+  void UpdateCodeXform(const CuMatrix<BaseFloat> &diff) {
+    if(update_code_xform_ && code_dim_ > 0) {
       // we use following hyperparameters from the option class
       const BaseFloat lr = opts_.learn_rate;
       const BaseFloat mmt = opts_.momentum;
       const BaseFloat l2 = opts_.l2_penalty;
       const BaseFloat l1 = opts_.l1_penalty;
       // we will also need the number of frames in the mini-batch
-      const int32 num_frames = input.NumRows();
-      // compute gradient (incl. momentum)
-      code_xform_corr_.AddMatMat(1.0, diff, kTrans, code_vec_expd_, kNoTrans, mmt);
+      const int32 num_frames = diff.NumRows();
+      // compute gradient (incl. momentum), outer product of the diff sum and the code
+      SumDiff(diff);
+      code_xform_corr_.AddMatMat(1.0, diff_sum_, kTrans, code_row_, kNoTrans, mmt);
       
       // l2 regularization
       if (l2 != 0.0) {
@@ -127,10 +173,8 @@ class CodeAT : public AffineTransform {
       }
       // update
       code_xform_.AddMat(-lr, code_xform_corr_);
+      code_shift_valid_ = false;
     }
-
-    // the code vector is update in the main tool due to its inter-layer sharing
-    // the code_vec_diff_ is computed in the BackpropagateFnc.
   }
 
   // The diff will be averaged across layers beforing accumulated into corr_
@@ -142,6 +186,7 @@ class CodeAT : public AffineTransform {
     if(update_code_vec_) {
       code_vec_corr_.AddRowSumMat(1.0, diff, opts_.momentum);
       code_vec_.AddVec(-1 * opts_.learn_rate, code_vec_corr_);
+      code_shift_valid_ = false;
     }
   }
 
@@ -152,6 +197,7 @@ class CodeAT : public AffineTransform {
     code_vec_.CopyFromVec(code);
     code_xform_corr_.SetZero();
     code_vec_corr_.SetZero();
+    code_shift_valid_ = false;
   }
 
   void SetCode(const Vector<BaseFloat> &code) {
@@ -161,6 +207,7 @@ class CodeAT : public AffineTransform {
     code_vec_.CopyFromVec(code);
     code_xform_corr_.SetZero();
     code_vec_corr_.SetZero();
+    code_shift_valid_ = false;
   }
 
   const CuVector<BaseFloat>& GetCode() {
@@ -171,7 +218,7 @@ class CodeAT : public AffineTransform {
     if(code_vec_.Dim()>0) {
       code_vec_.SetZero();
     }
-    
+    code_shift_valid_ = false;
   }
 
   void ZeroCodeCorr() {
@@ -191,6 +238,28 @@ class CodeAT : public AffineTransform {
   }
 
  protected:
+  /// code_shift_ = code_xform_ * code_vec_, only after the code or the xform changed
+  void UpdateCodeShift() {
+    if (code_shift_valid_) {
+      return;
+    }
+    code_row_.Resize(1, code_dim_);
+    code_row_.AddVecToRows(1.0, code_vec_, 0.0);
+    code_shift_row_.Resize(1, output_dim_);
+    code_shift_row_.AddMatMat(1.0, code_row_, kNoTrans, code_xform_, kTrans, 0.0);
+    code_shift_.Resize(output_dim_);
+    code_shift_.AddRowSumMat(1.0, code_shift_row_, 0.0);
+    code_shift_valid_ = true;
+  }
+
+  /// diff_sum_ = sum of the rows of diff, as a 1 x output_dim_ matrix
+  void SumDiff(const CuMatrixBase<BaseFloat> &diff) {
+    diff_sum_vec_.Resize(diff.NumCols());
+    diff_sum_vec_.AddRowSumMat(1.0, diff, 0.0);
+    diff_sum_.Resize(1, diff.NumCols());
+    diff_sum_.AddVecToRows(1.0, diff_sum_vec_, 0.0);
+  }
+
   bool update_weight_;
   bool update_code_xform_;
   bool update_code_vec_;
@@ -200,8 +269,15 @@ class CodeAT : public AffineTransform {
   CuVector<BaseFloat> code_vec_;  // code vector
   CuVector<BaseFloat> code_vec_corr_;  // correction of the code vector
 
-  CuMatrix<BaseFloat> code_vec_expd_; // expanded code vector
-  CuMatrix<BaseFloat> code_vec_diff_;  // intermediate for code_
+  CuMatrix<BaseFloat> code_row_; // code vector as a 1 x code_dim_ matrix
+  CuMatrix<BaseFloat> code_vec_diff_;  // intermediate for code_, a single row
+
+  bool code_shift_valid_;
+  CuVector<BaseFloat> code_shift_;  // code_xform_ * code_vec_
+  CuMatrix<BaseFloat> code_shift_row_;
+
+  CuVector<BaseFloat> diff_sum_vec_;  // sum of the output diffs
+  CuMatrix<BaseFloat> diff_sum_;  // diff_sum_vec_ as a 1 x output_dim_ matrix
 
   CuMatrix<BaseFloat> code_xform_; // code transformation matrix
   CuMatrix<BaseFloat> code_xform_corr_; // correction of the code transformation matrix
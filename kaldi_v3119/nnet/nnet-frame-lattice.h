@@ -0,0 +1,101 @@
+// nnet/nnet-frame-lattice.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Flat copy of a denominator lattice for the sequential trainers: the arcs
+ * are grouped by the frame of their source state, with their pdfs and
+ * weights in contiguous arrays. The lattice is converted once per
+ * utterance; the acoustic rescoring is then a gather over the rows of the
+ * network output, and the forward-backward passes run over the same
+ * arrays and return the posteriors per (frame, pdf).
+ *
+ */
+
+#ifndef KALDI_NNET_FRAME_LATTICE_H
+#define KALDI_NNET_FRAME_LATTICE_H
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "hmm/transition-model.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+class FrameLattice {
+ public:
+  FrameLattice()
+      : num_frames_(0),
+        num_states_(0),
+        start_(0) {
+  }
+
+  /// Convert a topologically sorted lattice, with the times of its states
+  /// from LatticeStateTimes()
+  void Init(const Lattice &lat, const std::vector<int32> &state_times,
+            const TransitionModel &trans_model);
+
+  int32 NumFrames() const {
+    return num_frames_;
+  }
+  int32 NumStates() const {
+    return num_states_;
+  }
+  int32 NumArcs() const {
+    return arc_src_.size();
+  }
+
+  /// Add -log_like(t, pdf) to the acoustic costs, as LatticeAcousticRescore()
+  void AcousticRescore(const MatrixBase<BaseFloat> &log_like);
+
+  /// Scale the graph and acoustic costs, as fst::LatticeScale()
+  void Scale(BaseFloat lm_scale, BaseFloat acoustic_scale);
+
+  /// As LatticeForwardBackward(), the arc posteriors are added to
+  /// post(t, pdf). Returns the total log-likelihood of the lattice.
+  double ForwardBackward(MatrixBase<BaseFloat> *post,
+                         double *acoustic_like_sum) const;
+
+  /// MPE (phone accuracies) or sMBR (state accuracies) against the
+  /// reference alignment, the frames of silence phones count as
+  /// incorrect. The derivatives of the accuracy are added to post(t, pdf).
+  /// Returns the expected frame accuracy of the utterance.
+  double ForwardBackwardMpe(const TransitionModel &trans_model,
+                            const std::vector<int32> &ref_ali,
+                            const std::vector<int32> &silence_phones,
+                            bool smbr, MatrixBase<BaseFloat> *post) const;
+
+ private:
+  /// Log-likelihoods of the arcs and the final states with the current
+  /// costs, and the alpha and beta of all the states
+  double ComputeAlphaBeta(std::vector<double> *alpha,
+                          std::vector<double> *beta) const;
+
+  int32 num_frames_;
+  int32 num_states_;
+  int32 start_;
+
+  /// First arc of each frame, plus the end, the arcs leaving the end
+  /// states (at time num_frames_) have their own group
+  std::vector<int32> frame_offset_;
+
+  // arcs, ordered by the frame and then the id of their source state
+  std::vector<int32> arc_src_;
+  std::vector<int32> arc_dst_;
+  std::vector<int32> arc_tid_;  ///< 0 for epsilon
+  std::vector<int32> arc_pdf_;  ///< -1 for epsilon
+  std::vector<BaseFloat> graph_cost_;
+  std::vector<BaseFloat> ac_cost_;
+
+  // final states
+  std::vector<int32> final_state_;
+  std::vector<BaseFloat> final_graph_cost_;
+  std::vector<BaseFloat> final_ac_cost_;
+};
+
+}  // namespace kaldi
+
+#endif
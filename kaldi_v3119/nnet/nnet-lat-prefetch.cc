@@ -0,0 +1,252 @@
+// nnet/nnet-lat-prefetch.cc
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ */
+
+#include "nnet/nnet-lat-prefetch.h"
+
+#include <exception>
+#include <utility>
+
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "util/timer.h"
+
+namespace kaldi {
+
+LatticePrefetcher::LatticePrefetcher(const std::string &feature_rspecifier,
+                                     const std::string &lattice_rspecifier,
+                                     BaseFloat old_acoustic_scale,
+                                     int32 prefetch, int32 num_threads)
+    : lattice_reader_(lattice_rspecifier),
+      old_acoustic_scale_(old_acoustic_scale),
+      prefetching_(false),
+      head_(0),
+      next_work_(0),
+      free_slots_(prefetch > 0 ? prefetch : 0),
+      read_slots_(0),
+      stop_(false),
+      wait_time_(0.0) {
+  if (prefetch <= 0) {
+    return;
+  }
+
+  std::string script_rxfilename;
+  RspecifierOptions opts;
+  if (ClassifyRspecifier(feature_rspecifier, &script_rxfilename, &opts)
+      != kScriptRspecifier) {
+    KALDI_WARN << "Lattice prefetching needs the features as a script, "
+        << "reading the lattices on demand";
+    return;
+  }
+
+  std::vector<std::pair<std::string, std::string> > script;
+  if (!ReadScriptFile(script_rxfilename, true, &script)) {
+    KALDI_ERR << "Could not read the feature script " << script_rxfilename;
+  }
+  keys_.resize(script.size());
+  for (size_t i = 0; i < script.size(); ++i) {
+    keys_[i] = script[i].first;
+  }
+
+  ring_.resize(prefetch);
+  for (size_t i = 0; i < ring_.size(); ++i) {
+    ring_[i].ready = new Semaphore(0);
+  }
+  prefetching_ = true;
+
+  int ret = pthread_create(&read_thread_, NULL, RunRead, this);
+  if (ret != 0) {
+    for (size_t i = 0; i < ring_.size(); ++i) {
+      delete ring_[i].ready;
+    }
+    KALDI_ERR << "Error creating the lattice prefetch thread, errno was: "
+        << ret;
+  }
+  work_threads_.resize(num_threads > 0 ? num_threads : 1);
+  for (size_t i = 0; i < work_threads_.size(); ++i) {
+    ret = pthread_create(&work_threads_[i], NULL, RunWorker, this);
+    if (ret != 0) {
+      // the destructor is not run when the constructor throws,
+      // the started threads still use this object
+      StopThreads(i);
+      KALDI_ERR << "Error creating the lattice worker thread, errno was: "
+          << ret;
+    }
+  }
+}
+
+LatticePrefetcher::~LatticePrefetcher() {
+  if (prefetching_) {
+    StopThreads(work_threads_.size());
+  }
+}
+
+void LatticePrefetcher::StopThreads(size_t num_workers) {
+  // release the reader if it is waiting for a free slot,
+  // and the workers waiting for a lattice
+  stop_ = true;
+  free_slots_.Signal();
+  for (size_t i = 0; i < num_workers; ++i) {
+    read_slots_.Signal();
+  }
+  pthread_join(read_thread_, NULL);
+  for (size_t i = 0; i < num_workers; ++i) {
+    pthread_join(work_threads_[i], NULL);
+  }
+  for (size_t i = 0; i < ring_.size(); ++i) {
+    delete ring_[i].ready;
+  }
+  prefetching_ = false;
+}
+
+void LatticePrefetcher::Preprocess(Entry *entry) const {
+  entry->cyclic = false;
+  entry->max_time = 0;
+  entry->state_times.clear();
+  if (entry->status != kOk) {
+    return;
+  }
+
+  Lattice &lat = entry->lat;
+  if (lat.Start() == fst::kNoStateId) {
+    entry->status = kEmptyLattice;
+    return;
+  }
+  if (old_acoustic_scale_ != 1.0) {
+    fst::ScaleLattice(fst::AcousticLatticeScale(old_acoustic_scale_), &lat);
+  }
+  // optionaly sort it topologically
+  kaldi::uint64 props = lat.Properties(fst::kFstProperties, false);
+  if (!(props & fst::kTopSorted)) {
+    if (fst::TopSort(&lat) == false) {
+      // reported by Get() on the main thread
+      entry->cyclic = true;
+      return;
+    }
+  }
+  // get the lattice length and times of states
+  entry->max_time = kaldi::LatticeStateTimes(lat, &entry->state_times);
+}
+
+void* LatticePrefetcher::RunRead(void *arg) {
+  static_cast<LatticePrefetcher*>(arg)->Read();
+  return NULL;
+}
+
+void* LatticePrefetcher::RunWorker(void *arg) {
+  static_cast<LatticePrefetcher*>(arg)->Work();
+  return NULL;
+}
+
+void LatticePrefetcher::Read() {
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    free_slots_.Wait();
+    if (stop_) {
+      return;
+    }
+
+    Entry &entry = ring_[i % ring_.size()];
+    entry.key = keys_[i];
+    entry.error.clear();
+    // an exception must not leave the thread, Get() reports it
+    try {
+      if (lattice_reader_.HasKey(entry.key)) {
+        entry.status = kOk;
+        entry.lat = lattice_reader_.Value(entry.key);
+      } else {
+        entry.status = kNoLattice;
+        entry.lat.DeleteStates();
+      }
+    } catch (const std::exception &e) {
+      entry.status = kNoLattice;
+      entry.lat.DeleteStates();
+      entry.error = e.what();
+    }
+
+    read_slots_.Signal();
+  }
+  // past the end, the workers stop
+  for (size_t i = 0; i < work_threads_.size(); ++i) {
+    read_slots_.Signal();
+  }
+}
+
+void LatticePrefetcher::Work() {
+  while (true) {
+    read_slots_.Wait();
+    work_mutex_.Lock();
+    size_t i = next_work_++;
+    work_mutex_.Unlock();
+    if (stop_ || i >= keys_.size()) {
+      return;
+    }
+
+    Entry &entry = ring_[i % ring_.size()];
+    try {
+      Preprocess(&entry);
+    } catch (const std::exception &e) {
+      entry.error = e.what();
+    }
+    entry.ready->Signal();
+  }
+}
+
+LatticePrefetcher::Status LatticePrefetcher::Get(const std::string &key,
+                                                 Lattice *lat,
+                                                 std::vector<int32> *state_times,
+                                                 int32 *max_time) {
+  if (!prefetching_) {
+    Entry entry;
+    entry.key = key;
+    entry.status = kNoLattice;
+    if (lattice_reader_.HasKey(key)) {
+      entry.status = kOk;
+      entry.lat = lattice_reader_.Value(key);
+    }
+    Preprocess(&entry);
+    if (entry.cyclic) {
+      KALDI_ERR << "Cycles detected in lattice.";
+    }
+    *lat = entry.lat;
+    state_times->swap(entry.state_times);
+    *max_time = entry.max_time;
+    return entry.status;
+  }
+
+  if (head_ >= static_cast<int32>(keys_.size())) {
+    KALDI_ERR << "No more lattices in the feature script, got " << key;
+  }
+  Entry &entry = ring_[head_ % ring_.size()];
+
+  Timer tim;
+  entry.ready->Wait();
+  wait_time_ += tim.Elapsed();
+
+  if (entry.key != key) {
+    KALDI_ERR << "Features are not read in the script order, expected "
+        << entry.key << " got " << key;
+  }
+  if (!entry.error.empty()) {
+    KALDI_ERR << "Error reading the lattice of " << key << ": "
+        << entry.error;
+  }
+  if (entry.cyclic) {
+    KALDI_ERR << "Cycles detected in lattice.";
+  }
+  Status status = entry.status;
+  *lat = entry.lat;
+  // a fresh lattice in the ring, so the copy is not shared
+  entry.lat.DeleteStates();
+  state_times->swap(entry.state_times);
+  *max_time = entry.max_time;
+  ++head_;
+
+  free_slots_.Signal();
+  return status;
+}
+
+}  // namespace kaldi
@@ -8,6 +8,8 @@
  *      Using parallel data to guide the learning of noise parameters.
  *      Needs to specify which parameters to update.
  *      The data lists and the set2utt mapping should have the same utterance order.
+ *      Unlike codeat-train there is no --cache-activations: each utterance is
+ *      read and propagated once per run, so there is no frozen work to reuse.
  */
 
 #include "nnet/nnet-trnopts.h"
@@ -19,6 +19,9 @@
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
 #include "nnet/nnet-codeat.h"
+#include "nnet/nnet-activation-store.h"
+
+#include <algorithm>
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -26,7 +29,7 @@ int main(int argc, char *argv[]) {
   typedef kaldi::int32 int32;
   try {
     const char *usage =
-        "Perform one iteration of <codeat> learning to minimize prediction errors by stochastic gradient descent.\n"
+        "Perform one iteration (--num-iters passes per set) of <codeat> learning to minimize prediction errors by stochastic gradient descent.\n"
             "Usage:  codeat-train [options] <adapt-model-in> <back-model-in>"
             " <feature-rspecifier> <alignments-rspecifier> <set2utt-rspecifier> "
             "<code-rspecifier>\n"
@@ -76,6 +79,24 @@ int main(int argc, char *argv[]) {
     po.Register("out-adapt-filename", &out_adapt_filename, "Output adapt nnet file name");
     po.Register("code-vec-wspecifier", &code_vec_wspecifier, "Output code vector archive");
 
+    int32 num_iters = 1;
+    po.Register("num-iters", &num_iters,
+                "Number of passes over the utterances of each set (more than one "
+                "needs --cache-activations, the features are read sequentially)");
+
+    bool cache_activations = false;
+    po.Register("cache-activations", &cache_activations,
+                "Compute the input product of the first <codeat> layer (after the "
+                "feature transform and the layers below it) once per utterance "
+                "and reuse it in the following iterations");
+    int32 cache_ram_mb = 2048;
+    po.Register("cache-ram-mb", &cache_ram_mb,
+                "RAM for the cached activations of a set in MB, the rest is "
+                "spilled to a memory-mapped file");
+    std::string cache_spill_dir = "/tmp";
+    po.Register("cache-spill-dir", &cache_spill_dir,
+                "Directory of the spill file of the cached activations");
+
 #if HAVE_CUDA==1
     int32 use_gpu_id=-2;
     po.Register("use-gpu-id", &use_gpu_id, "Manually select GPU by its ID (-2 automatic selection, -1 disable GPU, 0..N select GPU)");
@@ -101,6 +122,16 @@ int main(int argc, char *argv[]) {
     if(!crossvalidate && update_code_vec && code_vec_wspecifier == "") {
       KALDI_ERR << "No output code archive is specified for learning";
     }
+    if (crossvalidate) {
+      num_iters = 1;
+    }
+    if (num_iters > 1 && !cache_activations) {
+      KALDI_ERR << "--num-iters=" << num_iters << " needs --cache-activations";
+    }
+    if (cache_activations && update_weight) {
+      KALDI_ERR << "The input product of <codeat> changes with --update-weight, "
+                << "the activations cannot be cached";
+    }
 
     std::string adapt_model_filename = po.GetArg(1),
         back_model_filename = po.GetArg(2),
@@ -153,6 +184,38 @@ int main(int argc, char *argv[]) {
     }
     KALDI_LOG<< "Totally " << num_codeat << " among " << nnet.NumComponents() << " layers of the nnet are <codeat> layers.";
 
+    /*
+     * Only the code related parameters of the <codeat> layers change, so with
+     * the layers below the first <codeat> layer not updated, its input product
+     * is the same in all the iterations. These layers are taken out of the
+     * nnet, which then starts above the first <codeat> layer (it is empty when
+     * that layer was the last one).
+     */
+    std::vector<Component*> frozen_layers;
+    CodeAT *first_codeat = NULL;
+    if (cache_activations) {
+      if (num_codeat == 0) {
+        KALDI_ERR << "No <codeat> layer, nothing to cache";
+      }
+      while (&(nnet.GetComponent(0)) != layers_codeat[0]) {
+        if (nnet.GetComponent(0).IsUpdatable()) {
+          KALDI_ERR << "Layer " << frozen_layers.size()
+                    << " below the first <codeat> layer is updated, "
+                    << "the activations cannot be cached";
+        }
+        frozen_layers.push_back(nnet.GetComponent(0).Copy());
+        nnet.RemoveComponent(0);
+      }
+      first_codeat = dynamic_cast<CodeAT*>(nnet.GetComponent(0).Copy());
+      nnet.RemoveComponent(0);
+      layers_codeat[0] = first_codeat;
+      KALDI_LOG << "Caching the input product of the <codeat> layer "
+                << frozen_layers.size() << ", " << nnet.NumComponents()
+                << " layers are propagated per bunch";
+    }
+    ActivationStore store(static_cast<size_t>(cache_ram_mb) * 1024 * 1024,
+                          cache_spill_dir);
+
     kaldi::int64 total_frames = 0;
 
     SequentialTokenVectorReader set2utt_reader(set2utt_rspecifier);
@@ -174,6 +237,7 @@ int main(int argc, char *argv[]) {
     CuMatrix<BaseFloat> code_vec_diff;
     CuMatrix<BaseFloat> feats, feats_transf, nnet_in, nnet_out, back_out,
         obj_diff, back_diff, in_diff;
+    CuMatrix<BaseFloat> frozen_out, code_out, code_diff;
     std::vector<int32> targets;
 
     Timer time;
@@ -198,110 +262,168 @@ int main(int argc, char *argv[]) {
       // all the utterances belong to this set
       std::vector<std::string> uttlst(set2utt_reader.Value());
 
-      for (int32 uid = 0; uid < uttlst.size();) {
+      for (int32 iter = 0; iter < num_iters; ++iter) {
+        if (num_iters > 1) {
+          KALDI_LOG << "Iteration " << iter + 1 << "/" << num_iters;
+        }
 
-        // fill the cache
-        while (!cache.Full() && uid < uttlst.size()) {
-          std::string utt = uttlst[uid];
-          KALDI_VLOG(2) << "Reading utt " << utt;
+        for (int32 uid = 0; uid < uttlst.size();) {
 
-          std::string feat_key = feature_reader.Key();
-          if (feat_key != utt) {
-            num_no_feats++;
-            uid++;
-            continue;
-          }
-          // check that we have alignments
-          if (!alignments_reader.HasKey(utt)) {
-            num_no_alignments++;
-            uid++;
-            continue;
-          }
-          // get feature alignment pair
-          const Matrix<BaseFloat> &mat = feature_reader.Value();
-          const std::vector<int32> &alignment = alignments_reader.Value(utt);
-          // check maximum length of utterance
-          if (mat.NumRows() > max_frames) {
-            KALDI_WARN<< "Utterance " << utt << ": Skipped because it has " << mat.NumRows() <<
-            " frames, which is more than " << max_frames << ".";
-            num_other_error++;
-            uid++;
-            continue;
-          }
-            // check length match of features/alignments
-          if ((int32)alignment.size()!= mat.NumRows()) {
-            KALDI_WARN<< "Alignment has wrong size " << alignment.size() 
-            << " vs. features' "<< mat.NumRows() << ", for utt " << utt;
-            num_other_error++;
+          // fill the cache
+          while (!cache.Full() && uid < uttlst.size()) {
+            std::string utt = uttlst[uid];
+            KALDI_VLOG(2) << "Reading utt " << utt;
+
+            if (iter > 0) {
+              // computed in the first iteration, otherwise rejected there
+              if (store.HasKey(utt)) {
+                Timer t_features;
+                store.Get(utt, &nnet_in);
+                time_next += t_features.Elapsed();
+                cache.AddData(nnet_in, alignments_reader.Value(utt));
+              }
+              uid++;
+              continue;
+            }
+
+            if (feature_reader.Done() || feature_reader.Key() != utt) {
+              num_no_feats++;
+              uid++;
+              continue;
+            }
+            // the features of utt are used or rejected, move on to the next
             uid++;
-            continue;
-          }
+            // check that we have alignments
+            if (!alignments_reader.HasKey(utt)) {
+              num_no_alignments++;
+              feature_reader.Next();
+              continue;
+            }
+            // get feature alignment pair
+            const Matrix<BaseFloat> &mat = feature_reader.Value();
+            const std::vector<int32> &alignment = alignments_reader.Value(utt);
+            // check maximum length of utterance
+            if (mat.NumRows() > max_frames) {
+              KALDI_WARN<< "Utterance " << utt << ": Skipped because it has " << mat.NumRows() <<
+              " frames, which is more than " << max_frames << ".";
+              num_other_error++;
+              feature_reader.Next();
+              continue;
+            }
+              // check length match of features/alignments
+            if ((int32)alignment.size()!= mat.NumRows()) {
+              KALDI_WARN<< "Alignment has wrong size " << alignment.size() 
+              << " vs. features' "<< mat.NumRows() << ", for utt " << utt;
+              num_other_error++;
+              feature_reader.Next();
+              continue;
+            }
+
+              // All the checks OK,
+              // push features to GPU
+            feats=mat;
+            // possibly apply transform
+            nnet_transf.Feedforward(feats, &feats_transf);
+            CuMatrix<BaseFloat> *data = &feats_transf;
+            if (cache_activations) {
+              // the frozen layers, then the product of the <codeat> layer
+              CuMatrix<BaseFloat> *out = &frozen_out;
+              for (size_t li = 0; li < frozen_layers.size(); ++li) {
+                frozen_layers[li]->Propagate(*data, out);
+                std::swap(data, out);
+              }
+              first_codeat->InputProduct(*data, out);
+              store.Add(utt, *out);
+              data = out;
+            }
+            // add to cache
+            cache.AddData(*data, alignment);
+            num_done++;
+
+            // measure the time needed to get next feature file
+            Timer t_features;
+            feature_reader.Next();
+            time_next += t_features.Elapsed();
+            // report the speed
+            if (num_done % 1000 == 0) {
+              time_now = time.Elapsed();
+              KALDI_VLOG(1) << "After " << num_done
+                  << " utterances: time elapsed = "
+                  << time_now / 60 << " min; processed "
+                  << total_frames / time_now
+                  << " frames per second.";
+            }
 
-            // All the checks OK,
-            // push features to GPU
-          feats=mat;
-          // possibly apply transform
-          nnet_transf.Feedforward(feats, &feats_transf);
-          // add to cache
-          cache.AddData(feats_transf, alignment);
-          num_done++;
-
-          // measure the time needed to get next feature file
-          Timer t_features;
-          uid++;
-          feature_reader.Next();
-          time_next += t_features.Elapsed();
-          // report the speed
-          if (num_done % 1000 == 0) {
-            time_now = time.Elapsed();
-            KALDI_VLOG(1) << "After " << num_done
-                << " utterances: time elapsed = "
-                << time_now / 60 << " min; processed "
-                << total_frames / time_now
-                << " frames per second.";
           }
+          // randomize
+          if (!crossvalidate && randomize) {
+            cache.Randomize();
+          }
+          // report
+          KALDI_VLOG(1) << "Cache #" << ++num_cache << " "
+              << (cache.Randomized() ? "[RND]" : "[NO-RND]")
+              << " segments: " << num_done
+              << " frames: " << static_cast<double>(total_frames) / 360000 << "h";
+          // train with the cache
+          while (!cache.Empty()) {
+            // get block of feature/target pairs
+            cache.GetBunch(&nnet_in, &targets);
+            // train
+            if (cache_activations) {
+              // nnet_in is the input product of the first <codeat> layer
+              first_codeat->PropagateFromProduct(nnet_in, &code_out);
+              if (nnet.NumComponents() > 0) {
+                nnet.Propagate(code_out, &nnet_out);
+                nnet_back.Propagate(nnet_out, &back_out);
+              } else {
+                nnet_back.Propagate(code_out, &back_out);
+              }
+            } else {
+              nnet.Propagate(nnet_in, &nnet_out);
+              nnet_back.Propagate(nnet_out, &back_out);
+            }
 
-        }
-        // randomize
-        if (!crossvalidate && randomize) {
-          cache.Randomize();
-        }
-        // report
-        KALDI_VLOG(1) << "Cache #" << ++num_cache << " "
-            << (cache.Randomized() ? "[RND]" : "[NO-RND]")
-            << " segments: " << num_done
-            << " frames: " << static_cast<double>(total_frames) / 360000 << "h";
-        // train with the cache
-        while (!cache.Empty()) {
-          // get block of feature/target pairs
-          cache.GetBunch(&nnet_in, &targets);
-          // train
-          nnet.Propagate(nnet_in, &nnet_out);
-          nnet_back.Propagate(nnet_out, &back_out);
-
-          xent.EvalVec(back_out, targets, &obj_diff);
-          if (!crossvalidate) {
-            nnet_back.Backpropagate(obj_diff, &back_diff);
-            nnet.Backpropagate(back_diff, &in_diff);
-
-            if(update_code_vec) {
-              // accumulate code corr through different layers
-              code_vec_diff=layers_codeat[0]->GetCodeDiff();
-              for (int32 c = 1; c < num_codeat; ++c) {
-                code_vec_diff.AddMat(1.0, layers_codeat[c]->GetCodeDiff(), 1.0);
+            xent.EvalVec(back_out, targets, &obj_diff);
+            if (!crossvalidate) {
+              nnet_back.Backpropagate(obj_diff, &back_diff);
+              if (cache_activations) {
+                // nothing below the first <codeat> layer to backpropagate to
+                const CuMatrix<BaseFloat> *diff = &back_diff;
+                if (nnet.NumComponents() > 0) {
+                  nnet.Backpropagate(back_diff, &code_diff);
+                  diff = &code_diff;
+                }
+                first_codeat->BackpropagateCode(*diff);
+                first_codeat->UpdateCodeXform(*diff);
+              } else {
+                nnet.Backpropagate(back_diff, &in_diff);
               }
-              code_vec_diff.Scale(1.0 / num_codeat);
-              // update the code
-              for (int32 c = 0; c < num_codeat; ++c) {
-                layers_codeat[c]->UpdateCode(code_vec_diff);
+
+              if(update_code_vec) {
+                // accumulate code corr through different layers
+                code_vec_diff=layers_codeat[0]->GetCodeDiff();
+                for (int32 c = 1; c < num_codeat; ++c) {
+                  code_vec_diff.AddMat(1.0, layers_codeat[c]->GetCodeDiff(), 1.0);
+                }
+                code_vec_diff.Scale(1.0 / num_codeat);
+                // update the code
+                for (int32 c = 0; c < num_codeat; ++c) {
+                  layers_codeat[c]->UpdateCode(code_vec_diff);
+                }
               }
+              
             }
-            
+            total_frames += nnet_in.NumRows();
           }
-          total_frames += nnet_in.NumRows();
-        }
 
-      }  // end for uttlst
+        }  // end for uttlst
+
+      }  // end for iter
+
+      if (cache_activations) {
+        KALDI_LOG << "Cached activations of " << setkey << ": " << store.Info();
+        store.Clear();
+      }
 
       if (!crossvalidate && update_code_vec) {
         (layers_codeat[0]->GetCode()).CopyToVec(&code);
@@ -312,7 +434,18 @@ int main(int argc, char *argv[]) {
     }  // end for set2utt
 
     if(!crossvalidate && (update_weight || update_code_xform)) {
-      nnet.Write(out_adapt_filename, binary);
+      if (cache_activations) {
+        // put the layers taken out for the caching back
+        Nnet nnet_out_adapt;
+        for (size_t li = 0; li < frozen_layers.size(); ++li) {
+          nnet_out_adapt.AppendComponent(frozen_layers[li]->Copy());
+        }
+        nnet_out_adapt.AppendComponent(first_codeat->Copy());
+        nnet_out_adapt.AppendNnet(nnet);
+        nnet_out_adapt.Write(out_adapt_filename, binary);
+      } else {
+        nnet.Write(out_adapt_filename, binary);
+      }
       KALDI_LOG << "Write model file to " << out_adapt_filename;
     }
 
@@ -328,6 +461,11 @@ int main(int argc, char *argv[]) {
 
     KALDI_LOG<< xent.Report();
 
+    for (size_t li = 0; li < frozen_layers.size(); ++li) {
+      delete frozen_layers[li];
+    }
+    delete first_codeat;
+
 #if HAVE_CUDA==1
     CuDevice::Instantiate().PrintProfile();
 #endif
@@ -33,53 +33,12 @@
 #include "nnet/nnet-activation.h"
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-pdf-prior.h"
+#include "nnet/nnet-lat-prefetch.h"
+#include "nnet/nnet-frame-lattice.h"
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
 
 
-namespace kaldi {
-namespace nnet1 {
-
-void LatticeAcousticRescore(const Matrix<BaseFloat> &log_like,
-                            const TransitionModel &trans_model,
-                            const std::vector<int32> &state_times,
-                            Lattice *lat) {
-  kaldi::uint64 props = lat->Properties(fst::kFstProperties, false);
-  if (!(props & fst::kTopSorted))
-    KALDI_ERR << "Input lattice must be topologically sorted.";
-
-  KALDI_ASSERT(!state_times.empty());
-  std::vector<std::vector<int32> > time_to_state(log_like.NumRows());
-  for (size_t i = 0; i < state_times.size(); i++) {
-    KALDI_ASSERT(state_times[i] >= 0);
-    if (state_times[i] < log_like.NumRows())  // end state may be past this..
-      time_to_state[state_times[i]].push_back(i);
-    else
-      KALDI_ASSERT(state_times[i] == log_like.NumRows()
-                   && "There appears to be lattice/feature mismatch.");
-  }
-
-  for (int32 t = 0; t < log_like.NumRows(); t++) {
-    for (size_t i = 0; i < time_to_state[t].size(); i++) {
-      int32 state = time_to_state[t][i];
-      for (fst::MutableArcIterator<Lattice> aiter(lat, state); !aiter.Done();
-           aiter.Next()) {
-        LatticeArc arc = aiter.Value();
-        int32 trans_id = arc.ilabel;
-        if (trans_id != 0) {  // Non-epsilon input label on arc
-          int32 pdf_id = trans_model.TransitionIdToPdf(trans_id);
-          arc.weight.SetValue2(-log_like(t, pdf_id) + arc.weight.Value2());
-          aiter.SetValue(arc);
-        }
-      }
-    }
-  }
-}
-
-}  // namespace nnet1
-}  // namespace kaldi
-
-
 int main(int argc, char *argv[]) {
   using namespace kaldi;
   using namespace kaldi::nnet1;
@@ -129,6 +88,13 @@ int main(int argc, char *argv[]) {
     po.Register("do-smbr", &do_smbr, "Use state-level accuracies instead of "
                 "phone accuracies.");
 
+    int32 prefetch = 0, lattice_threads = 1;
+    po.Register("prefetch-lattices", &prefetch,
+                "Number of lattices read and preprocessed ahead on background "
+                "threads (needs scp features, 0 = off)");
+    po.Register("lattice-threads", &lattice_threads,
+                "Number of threads preprocessing the prefetched lattices");
+
 #if HAVE_CUDA == 1
     kaldi::int32 use_gpu_id=-2;
     po.Register("use-gpu-id", &use_gpu_id, "Manually select GPU by its ID "
@@ -191,11 +157,14 @@ int main(int argc, char *argv[]) {
     ReadKaldiObject(transition_model_filename, &trans_model);
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessLatticeReader den_lat_reader(den_lat_rspecifier);
+    LatticePrefetcher den_lat_reader(feature_rspecifier, den_lat_rspecifier,
+                                     old_acoustic_scale, prefetch,
+                                     lattice_threads);
     RandomAccessInt32VectorReader ref_ali_reader(ref_ali_rspecifier);
 
     CuMatrix<BaseFloat> feats, feats_transf, nnet_out, nnet_diff;
     Matrix<BaseFloat> nnet_out_h, nnet_diff_h;
+    FrameLattice den_frame_lat;
 
     Timer time;
     double time_now = 0;
@@ -210,7 +179,13 @@ int main(int argc, char *argv[]) {
     // do per-utterance processing
     for (; !feature_reader.Done(); feature_reader.Next()) {
       std::string utt = feature_reader.Key();
-      if (!den_lat_reader.HasKey(utt)) {
+      // the lattice of every utterance is taken, in the order of the features
+      Lattice den_lat;
+      vector<int32> state_times;
+      int32 max_time;
+      LatticePrefetcher::Status lat_status =
+          den_lat_reader.Get(utt, &den_lat, &state_times, &max_time);
+      if (lat_status == LatticePrefetcher::kNoLattice) {
         KALDI_WARN << "Utterance " << utt << ": found no lattice.";
         num_no_den_lat++;
         continue;
@@ -237,26 +212,12 @@ int main(int argc, char *argv[]) {
 	num_other_error++;
 	continue;
       }
-      // 2) get the denominator lattice, preprocess
-      Lattice den_lat = den_lat_reader.Value(utt);
-      if (den_lat.Start() == -1) {
+      // 2) the denominator lattice, preprocessed by the prefetcher
+      if (lat_status == LatticePrefetcher::kEmptyLattice) {
         KALDI_WARN << "Empty lattice for utt " << utt;
         num_other_error++;
         continue;
       }
-      if (old_acoustic_scale != 1.0) {
-        fst::ScaleLattice(fst::AcousticLatticeScale(old_acoustic_scale),
-                          &den_lat);
-      }
-      // optionaly sort it topologically
-      kaldi::uint64 props = den_lat.Properties(fst::kFstProperties, false);
-      if (!(props & fst::kTopSorted)) {
-        if (fst::TopSort(&den_lat) == false)
-          KALDI_ERR << "Cycles detected in lattice.";
-      }
-      // get the lattice length and times of states
-      vector<int32> state_times;
-      int32 max_time = kaldi::LatticeStateTimes(den_lat, &state_times);
       // check for temporal length of denominator lattices
       if (max_time != mat.NumRows()) {
         KALDI_WARN << "Denominator lattice has wrong length "
@@ -290,42 +251,19 @@ int main(int argc, char *argv[]) {
       feats_transf.Resize(0,0);
       nnet_out.Resize(0,0);
 
-      // 4) rescore the latice
-      LatticeAcousticRescore(nnet_out_h, trans_model, state_times, &den_lat);
+      // 4) rescore the latice, over a frame-sorted copy of its arcs
+      den_frame_lat.Init(den_lat, state_times, trans_model);
+      den_frame_lat.AcousticRescore(nnet_out_h);
       if (acoustic_scale != 1.0 || lm_scale != 1.0)
-        fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &den_lat);
-
-      // 5) get the posteriors
-      vector< std::map<int32, char> > arc_accs;
-      arc_accs.resize(ref_ali.size());
-      kaldi::Posterior post;
-
-      if (do_smbr) {  // use state-level accuracies, i.e. sMBR estimation
-        for (size_t i = 0; i < ref_ali.size(); i++) {
-          int32 pdf = trans_model.TransitionIdToPdf(ref_ali[i]);
-          arc_accs[i][pdf] = 1;
-        }
-        utt_frame_acc = LatticeForwardBackwardSmbr(den_lat, trans_model,
-                                                   arc_accs, silence_phones,
-                                                   &post);
-      } else {  // use phone-level accuracies, i.e. regular MPE
-        for (size_t i = 0; i < ref_ali.size(); i++) {
-          int32 phone = trans_model.TransitionIdToPhone(ref_ali[i]);
-          arc_accs[i][phone] = 1;
-        }
-        utt_frame_acc = kaldi::LatticeForwardBackwardMpe(den_lat, trans_model,
-                                                         arc_accs, &post,
-                                                         silence_phones);
-      }
+        den_frame_lat.Scale(lm_scale, acoustic_scale);
 
-      // 6) convert the Posterior to a matrix
+      // 5) get the derivatives of the frame accuracy w.r.t. the pdfs,
+      // sMBR uses state-level accuracies, regular MPE phone-level ones
       nnet_diff_h.Resize(num_frames, num_pdfs, kSetZero);
-      for (int32 t = 0; t < post.size(); t++) {
-        for (int32 arc = 0; arc < post[t].size(); arc++) {
-          int32 pdf = trans_model.TransitionIdToPdf(post[t][arc].first);
-          nnet_diff_h(t, pdf) -= post[t][arc].second;
-        }
-      }
+      utt_frame_acc = den_frame_lat.ForwardBackwardMpe(trans_model, ref_ali,
+                                                       silence_phones, do_smbr,
+                                                       &nnet_diff_h);
+      nnet_diff_h.Scale(-1.0);
 
       KALDI_VLOG(1) << "Processed lattice for utterance " << num_done + 1
                     << " (" << utt << "): found " << den_lat.NumStates()
@@ -364,7 +302,8 @@ int main(int argc, char *argv[]) {
     time_now = time.Elapsed();
     KALDI_LOG << "TRAINING FINISHED; "
               << "Time taken = " << time_now/60 << " min; processed "
-              << (total_frames/time_now) << " frames per second.";
+              << (total_frames/time_now) << " frames per second, "
+              << den_lat_reader.WaitTime() << "s waiting for lattices.";
 
     KALDI_LOG << "Done " << num_done << " files, "
               << num_no_ref_ali << " with no reference alignments, "
@@ -0,0 +1,191 @@
+// nnet/nnet-ali-prefetch.cc
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ */
+
+#include "nnet/nnet-ali-prefetch.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "util/timer.h"
+
+namespace kaldi {
+
+void RleEncode(const std::vector<int32> &ali, RleAlignment *rle) {
+  rle->clear();
+  for (size_t i = 0; i < ali.size(); ++i) {
+    if (rle->empty() || rle->back().first != ali[i]) {
+      rle->push_back(std::make_pair(ali[i], 1));
+    } else {
+      rle->back().second++;
+    }
+  }
+}
+
+void RleDecode(const RleAlignment &rle, std::vector<int32> *ali) {
+  ali->resize(RleNumFrames(rle));
+  std::vector<int32>::iterator it = ali->begin();
+  for (size_t i = 0; i < rle.size(); ++i) {
+    std::fill(it, it + rle[i].second, rle[i].first);
+    it += rle[i].second;
+  }
+}
+
+int32 RleNumFrames(const RleAlignment &rle) {
+  int32 num_frames = 0;
+  for (size_t i = 0; i < rle.size(); ++i) {
+    num_frames += rle[i].second;
+  }
+  return num_frames;
+}
+
+AlignmentPrefetcher::AlignmentPrefetcher(
+    const std::string &feature_rspecifier,
+    const std::string &alignments_rspecifier, int32 prefetch)
+    : alignments_reader_(alignments_rspecifier),
+      prefetching_(false),
+      head_(0),
+      num_consumed_(0),
+      tail_(0),
+      free_slots_(prefetch > 0 ? prefetch : 0),
+      full_slots_(0),
+      stop_(false),
+      cur_found_(false),
+      wait_time_(0.0) {
+  if (prefetch <= 0) {
+    return;
+  }
+
+  std::string script_rxfilename;
+  RspecifierOptions opts;
+  if (ClassifyRspecifier(feature_rspecifier, &script_rxfilename, &opts)
+      != kScriptRspecifier) {
+    KALDI_WARN << "Alignment prefetching needs the features as a script, "
+        << "reading the alignments on demand";
+    return;
+  }
+
+  std::vector<std::pair<std::string, std::string> > script;
+  if (!ReadScriptFile(script_rxfilename, true, &script)) {
+    KALDI_ERR << "Could not read the feature script " << script_rxfilename;
+  }
+  keys_.resize(script.size());
+  for (size_t i = 0; i < script.size(); ++i) {
+    keys_[i] = script[i].first;
+  }
+
+  ring_.resize(prefetch);
+  prefetching_ = true;
+
+  int ret = pthread_create(&thread_, NULL, RunPrefetch, this);
+  if (ret != 0) {
+    KALDI_ERR << "Error creating the alignment prefetch thread, errno was: "
+        << ret;
+  }
+}
+
+AlignmentPrefetcher::~AlignmentPrefetcher() {
+  if (prefetching_) {
+    // release the producer if it is waiting for a free slot
+    stop_ = true;
+    free_slots_.Signal();
+    pthread_join(thread_, NULL);
+  }
+}
+
+void* AlignmentPrefetcher::RunPrefetch(void *arg) {
+  static_cast<AlignmentPrefetcher*>(arg)->Prefetch();
+  return NULL;
+}
+
+void AlignmentPrefetcher::Prefetch() {
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    free_slots_.Wait();
+    if (stop_) {
+      return;
+    }
+
+    Entry &entry = ring_[tail_];
+    entry.key = keys_[i];
+    entry.error.clear();
+    bool failed = false;
+    // an exception must not leave the thread, the main thread reports it
+    try {
+      entry.found = alignments_reader_.HasKey(entry.key);
+      if (entry.found) {
+        RleEncode(alignments_reader_.Value(entry.key), &entry.ali);
+      } else {
+        entry.ali.clear();
+      }
+    } catch (const std::exception &e) {
+      entry.found = false;
+      entry.ali.clear();
+      entry.error = e.what();
+      failed = true;
+    }
+    tail_ = (tail_ + 1) % ring_.size();
+
+    full_slots_.Signal();
+    if (failed) {
+      return;
+    }
+  }
+}
+
+bool AlignmentPrefetcher::HasKey(const std::string &key) {
+  if (!prefetching_) {
+    return alignments_reader_.HasKey(key);
+  }
+
+  if (key == cur_key_) {
+    return cur_found_;
+  }
+
+  // the tools may skip utterances (e.g. on a feature mismatch) before
+  // asking for their alignments, the entries of these are dropped
+  while (true) {
+    if (num_consumed_ >= keys_.size()) {
+      KALDI_ERR << "Features are not read in the script order, " << key
+          << " is not after " << cur_key_ << " in the script";
+    }
+    Timer tim;
+    full_slots_.Wait();
+    wait_time_ += tim.Elapsed();
+
+    Entry &entry = ring_[head_];
+    if (!entry.error.empty()) {
+      KALDI_ERR << "Error reading the alignment of " << entry.key << ": "
+          << entry.error;
+    }
+    bool match = (entry.key == key);
+    if (match) {
+      cur_key_ = key;
+      cur_found_ = entry.found;
+      RleDecode(entry.ali, &cur_ali_);
+    }
+    head_ = (head_ + 1) % ring_.size();
+    num_consumed_++;
+
+    free_slots_.Signal();
+    if (match) {
+      return cur_found_;
+    }
+  }
+}
+
+const std::vector<int32>& AlignmentPrefetcher::Value(const std::string &key) {
+  if (!prefetching_) {
+    return alignments_reader_.Value(key);
+  }
+
+  if (!HasKey(key)) {
+    KALDI_ERR << "No alignment for " << key;
+  }
+  return cur_ali_;
+}
+
+}  // namespace kaldi
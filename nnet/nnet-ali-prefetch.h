@@ -0,0 +1,103 @@
+// nnet/nnet-ali-prefetch.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Alignment reader for the trainers, which prefetches the alignments
+ * in the order of the feature script on a background thread.
+ *
+ */
+
+#ifndef KALDI_NNET_ALI_PREFETCH_H
+#define KALDI_NNET_ALI_PREFETCH_H
+
+#include <pthread.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "thread/kaldi-semaphore.h"
+
+namespace kaldi {
+
+/// Run-length encoded alignment, pairs of (pdf-id, number of frames)
+typedef std::vector<std::pair<int32, int32> > RleAlignment;
+
+/// Encode the per-frame pdf-ids as runs
+void RleEncode(const std::vector<int32> &ali, RleAlignment *rle);
+/// Expand the runs back to per-frame pdf-ids
+void RleDecode(const RleAlignment &rle, std::vector<int32> *ali);
+/// Number of frames of the encoded alignment
+int32 RleNumFrames(const RleAlignment &rle);
+
+/**
+ * Drop-in replacement of the RandomAccessInt32VectorReader in the trainers.
+ *
+ * When the features are read from a script (scp:) and prefetch > 0,
+ * the utterance list is taken from the script and a background thread
+ * fetches the alignments in that order into a ring of 'prefetch'
+ * run-length encoded entries. HasKey()/Value() must then be called in
+ * the feature order; utterances may be skipped, their entries are dropped
+ * on the next call. An error reading an alignment stops the thread and
+ * is reported by HasKey()/Value() of that utterance. For bounded memory on large corpora, the alignments
+ * should be sorted in the same order, e.g. "ark,s,cs:".
+ *
+ * Otherwise it falls back to the plain random access reader.
+ */
+class AlignmentPrefetcher {
+ public:
+  AlignmentPrefetcher(const std::string &feature_rspecifier,
+                      const std::string &alignments_rspecifier,
+                      int32 prefetch);
+  ~AlignmentPrefetcher();
+
+  bool HasKey(const std::string &key);
+  const std::vector<int32>& Value(const std::string &key);
+
+  /// Time the main thread spent waiting for the alignments
+  double WaitTime() const {
+    return wait_time_;
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    bool found;
+    RleAlignment ali;
+    std::string error;  ///< what() of a failed read, rethrown by HasKey()
+  };
+
+  static void* RunPrefetch(void *arg);
+  void Prefetch();
+
+  RandomAccessInt32VectorReader alignments_reader_;
+  bool prefetching_;
+
+  std::vector<std::string> keys_;  ///< feature order from the script
+
+  std::vector<Entry> ring_;
+  int32 head_;  ///< next entry to consume, owned by the main thread
+  size_t num_consumed_;  ///< entries consumed by the main thread
+  int32 tail_;  ///< next entry to fill, owned by the prefetch thread
+  Semaphore free_slots_;
+  Semaphore full_slots_;
+  bool stop_;
+
+  pthread_t thread_;
+
+  std::string cur_key_;
+  bool cur_found_;
+  std::vector<int32> cur_ali_;
+
+  double wait_time_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(AlignmentPrefetcher);
+};
+
+}  // namespace kaldi
+
+#endif
@@ -19,6 +19,7 @@
 #define KALDI_NNET_BIASEDLINEARITY_H
 
 #include "nnet/nnet-component.h"
+#include "nnet/nnet-model-image.h"
 #include "cudamatrix/cu-math.h"
 
 namespace kaldi {
@@ -30,7 +31,8 @@ class BiasedLinearity : public UpdatableComponent {
         linearity_(dim_out, dim_in),
         bias_(dim_out),
         linearity_corr_(dim_out, dim_in),
-        bias_corr_(dim_out)
+        bias_corr_(dim_out),
+        tied_grad_pending_(false)
   {
   }
   ~BiasedLinearity()
@@ -55,6 +57,30 @@ class BiasedLinearity : public UpdatableComponent {
     bias_.Write(os, binary);
   }
 
+  void ReadImageData(const ModelImage &image, const std::string &prefix) {
+    if (GetType() != kBiasedLinearity) {
+      // the derived layers keep more data, stored as the default blob
+      Component::ReadImageData(image, prefix);
+      return;
+    }
+    image.CopyToCuMatrix(prefix + "linearity", &linearity_);
+    image.CopyToCuVector(prefix + "bias", &bias_);
+
+    KALDI_ASSERT(linearity_.NumRows() == output_dim_);
+    KALDI_ASSERT(linearity_.NumCols() == input_dim_);
+    KALDI_ASSERT(bias_.Dim() == output_dim_);
+  }
+
+  void WriteImageData(ModelImageWriter *writer,
+                      const std::string &prefix) const {
+    if (GetType() != kBiasedLinearity) {
+      Component::WriteImageData(writer, prefix);
+      return;
+    }
+    writer->AddCuMatrix(prefix + "linearity", linearity_);
+    writer->AddCuVector(prefix + "bias", bias_);
+  }
+
   void PropagateFnc(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *out) {
     // precopy bias
     out->AddVecToRows(1.0, bias_, 0.0);
@@ -68,17 +94,34 @@ class BiasedLinearity : public UpdatableComponent {
     out_err->AddMatMat(1.0, in_err, kNoTrans, linearity_, kNoTrans, 0.0);
   }
 
+  /// Forward pass of an Expand with frame_offsets followed by this layer,
+  /// the expanded input is not built on CPU (see cu::ExpandAffine)
+  void PropagateExpanded(const CuMatrix<BaseFloat> &in,
+                         const CuStlVector<int32> &frame_offsets,
+                         CuMatrix<BaseFloat> *out) {
+    if (input_dim_ != in.NumCols() * frame_offsets.Dim()) {
+      KALDI_ERR << "Nonmatching dims, component:" << input_dim_
+                << " data:" << in.NumCols() << "x" << frame_offsets.Dim();
+    }
+    if (output_dim_ != out->NumCols() || in.NumRows() != out->NumRows()) {
+      out->Resize(in.NumRows(), output_dim_);
+    }
+    cu::ExpandAffine(in, frame_offsets, linearity_, bias_, out);
+  }
+
   void Update(const CuMatrix<BaseFloat> &input,
               const CuMatrix<BaseFloat> &err) {
 
-    // compute gradient
+    // compute gradient, on top of the one of the tied layers if any
+    BaseFloat momentum = tied_grad_pending_ ? 1.0 : momentum_;
+    tied_grad_pending_ = false;
     if (average_grad_) {
       linearity_corr_.AddMatMat(1.0 / input.NumRows(), err, kTrans, input,
                                 kNoTrans,
-                                momentum_);
+                                momentum);
       bias_corr_.AddRowSumMat(1.0 / input.NumRows(), err, momentum_);
     } else {
-      linearity_corr_.AddMatMat(1.0, err, kTrans, input, kNoTrans, momentum_);
+      linearity_corr_.AddMatMat(1.0, err, kTrans, input, kNoTrans, momentum);
       bias_corr_.AddRowSumMat(1.0, err, momentum_);
     }
     // l2 regularization
@@ -96,10 +139,22 @@ class BiasedLinearity : public UpdatableComponent {
     bias_.AddVec(-learn_rate_, bias_corr_);
   }
 
+  /// Adds the weight gradient of a TiedLinearity using the transposed
+  /// linearity, applied by the next Update of this layer
+  void AccumulateTiedGradient(BaseFloat scale,
+                              const CuMatrix<BaseFloat> &input,
+                              const CuMatrix<BaseFloat> &err) {
+    if (learn_rate_ == 0.0) return;
+    linearity_corr_.AddMatMat(scale, input, kTrans, err, kNoTrans,
+                              tied_grad_pending_ ? 1.0 : momentum_);
+    tied_grad_pending_ = true;
+  }
+
   /*
    * This function is used to tying the weights between different layers
    */
-  void SetLinearityWeight(const CuMatrix<BaseFloat> &weight, bool trans) {
+  virtual void SetLinearityWeight(const CuMatrix<BaseFloat> &weight,
+                                  bool trans) {
     if (trans) {
       Matrix<BaseFloat> mat;
       weight.CopyToMat(&mat);
@@ -110,7 +165,8 @@ class BiasedLinearity : public UpdatableComponent {
     }
   }
 
-  void SetLinearityWeight(const Matrix<BaseFloat> &weight, bool trans) {
+  virtual void SetLinearityWeight(const Matrix<BaseFloat> &weight,
+                                  bool trans) {
     if (trans) {
       Matrix<BaseFloat> mat(weight);
       mat.Transpose();
@@ -120,7 +176,7 @@ class BiasedLinearity : public UpdatableComponent {
     }
   }
 
-  const CuMatrix<BaseFloat>& GetLinearityWeight() {
+  virtual const CuMatrix<BaseFloat>& GetLinearityWeight() {
     return linearity_;
   }
 
@@ -136,7 +192,7 @@ class BiasedLinearity : public UpdatableComponent {
     return bias_;
   }
 
-  void SetToIdentity() {
+  virtual void SetToIdentity() {
     Matrix<BaseFloat> mat(linearity_.NumRows(), linearity_.NumCols());
     mat.SetUnit();
     linearity_.CopyFromMat(mat);
@@ -149,6 +205,8 @@ class BiasedLinearity : public UpdatableComponent {
 
   CuMatrix<BaseFloat> linearity_corr_;
   CuVector<BaseFloat> bias_corr_;
+
+  bool tied_grad_pending_;  ///< linearity_corr_ holds tied gradients
 };
 
 }  // namespace
@@ -49,7 +49,6 @@ void CacheXentTgtMat::AddData(const CuMatrix<BaseFloat> &features, const std::ve
   // lazy buffers allocation
   if (features_.NumRows() != cachesize_) {
     features_.Resize(cachesize_, features.NumCols());
-    aligns_.resize(cachesize_);
     targets_.Resize(cachesize_, targets.NumCols());
   }
 
@@ -64,6 +63,7 @@ void CacheXentTgtMat::AddData(const CuMatrix<BaseFloat> &features, const std::ve
   // change state
   if (state_ == EMPTY) { 
     state_ = FILLING; filling_pos_ = 0;
+    aligns_.Clear();
    
     // check for leftover from previous segment 
     int leftover = features_leftover_.NumRows();
@@ -78,7 +78,7 @@ void CacheXentTgtMat::AddData(const CuMatrix<BaseFloat> &features, const std::ve
     // prefill cache with leftover
     if (leftover > 0) {
       features_.CopyRowsFromMat(leftover, features_leftover_, 0, 0);
-      std::copy(aligns_leftover_.begin(), aligns_leftover_.begin()+leftover, aligns_.begin());
+      aligns_.Append(aligns_leftover_.begin(), aligns_leftover_.begin()+leftover);
       targets_.CopyRowsFromMat(leftover, targets_leftover_, 0, 0);
       
       features_leftover_.Destroy();
@@ -100,7 +100,7 @@ void CacheXentTgtMat::AddData(const CuMatrix<BaseFloat> &features, const std::ve
 
   // copy the data to cache
   features_.CopyRowsFromMat(fill_rows, features, 0, filling_pos_);
-  std::copy(aligns.begin(), aligns.begin()+fill_rows, aligns_.begin()+filling_pos_);
+  aligns_.Append(aligns.begin(), aligns.begin()+fill_rows);
   targets_.CopyRowsFromMat(fill_rows, targets, 0, filling_pos_);
 
   // copy leftovers
@@ -132,7 +132,6 @@ void CacheXentTgtMat::Randomize() {
 
   // lazy initialization of the output buffers
   features_random_.Resize(cachesize_, features_.NumCols());
-  aligns_random_.resize(cachesize_);
   targets_random_.Resize(cachesize_, targets_.NumCols());
 
   // generate random series of integers
@@ -145,10 +144,7 @@ void CacheXentTgtMat::Randomize() {
 
   // randomize the features
   cu::Randomize(features_, randmask_device_, &features_random_);
-  // randomize the aligns
-  for(int32 i=0; i<filling_pos_; ++i){
-    aligns_random_[i]=aligns_[randmask_[i]];
-  }
+  // the aligns stay encoded, they are gathered through randmask_ in GetBunch
   // randomize the targets
   cu::Randomize(targets_, randmask_device_, &targets_random_);
   
@@ -176,17 +172,16 @@ void CacheXentTgtMat::GetBunch(CuMatrix<BaseFloat> *features, std::vector<int32>
 
   // init the output
   features->Resize(bunchsize_, features_.NumCols());
-  aligns->resize(bunchsize_);
   targets->Resize(bunchsize_, targets_.NumCols());
 
   // copy the output
   if (randomized_) {
     features->CopyRowsFromMat(bunchsize_, features_random_, emptying_pos_, 0);
-    std::copy(aligns_random_.begin()+emptying_pos_, aligns_random_.begin()+emptying_pos_+bunchsize_, aligns->begin());
+    aligns_.Gather(randmask_, emptying_pos_, bunchsize_, aligns);
     targets->CopyRowsFromMat(bunchsize_, targets_random_, emptying_pos_, 0);
   } else {
     features->CopyRowsFromMat(bunchsize_, features_, emptying_pos_, 0);
-    std::copy(aligns_.begin()+emptying_pos_, aligns_.begin()+emptying_pos_+bunchsize_, aligns->begin());
+    aligns_.CopyRange(emptying_pos_, bunchsize_, aligns);
     targets->CopyRowsFromMat(bunchsize_, targets_, emptying_pos_, 0);
   }
 
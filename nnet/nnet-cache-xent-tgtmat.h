@@ -11,6 +11,7 @@
 
 #include "base/kaldi-math.h"
 #include "cudamatrix/cu-math.h"
+#include "nnet/nnet-label-store.h"
 
 namespace kaldi {
 
@@ -75,8 +76,7 @@ class CacheXentTgtMat {
   CuMatrix<BaseFloat> features_random_; ///< Feature cache
   CuMatrix<BaseFloat> features_leftover_; ///< Feature cache
   
-  std::vector<int32> aligns_; ///< Xent target vector cache
-  std::vector<int32> aligns_random_; ///< Xent target vector cache
+  LabelStore aligns_; ///< Xent target vector cache, run-length encoded
   std::vector<int32> aligns_leftover_; ///< Xent target vector cache
 
   CuMatrix<BaseFloat> targets_;  ///< Desired vector cache
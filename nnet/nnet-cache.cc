@@ -58,7 +58,6 @@ void Cache::AddData(const CuMatrix<BaseFloat> &features, const std::vector<int32
   // lazy buffers allocation
   if (features_.NumRows() != cachesize_) {
     features_.Resize(cachesize_, features.NumCols());
-    targets_.resize(cachesize_);
   }
 
   // warn if segment longer than half-cache 
@@ -72,6 +71,7 @@ void Cache::AddData(const CuMatrix<BaseFloat> &features, const std::vector<int32
   // change state
   if (state_ == EMPTY) { 
     state_ = FILLING; filling_pos_ = 0;
+    targets_.Clear();
    
     // check for leftover from previous segment 
     int leftover = features_leftover_.NumRows();
@@ -87,9 +87,8 @@ void Cache::AddData(const CuMatrix<BaseFloat> &features, const std::vector<int32
     if (leftover > 0) {
       features_.CopyRowsFromMat(leftover, features_leftover_, 0, 0);
       
-      std::copy(targets_leftover_.begin(),
-                targets_leftover_.begin()+leftover,
-                targets_.begin());
+      targets_.Append(targets_leftover_.begin(),
+                      targets_leftover_.begin()+leftover);
 
       features_leftover_.Destroy();
       targets_leftover_.resize(0);
@@ -110,9 +109,7 @@ void Cache::AddData(const CuMatrix<BaseFloat> &features, const std::vector<int32
   // copy the data to cache
   features_.CopyRowsFromMat(fill_rows, features, 0, filling_pos_);
 
-  std::copy(targets.begin(),
-            targets.begin()+fill_rows,
-            targets_.begin()+filling_pos_);
+  targets_.Append(targets.begin(), targets.begin()+fill_rows);
 
   // copy leftovers
   if (leftover > 0) {
@@ -142,7 +139,6 @@ void Cache::Randomize() {
 
   // lazy initialization of the output buffers
   features_random_.Resize(cachesize_, features_.NumCols());
-  targets_random_.resize(cachesize_);
 
   // generate random series of integers
   randmask_.resize(filling_pos_);
@@ -154,10 +150,7 @@ void Cache::Randomize() {
 
   // randomize the features
   cu::Randomize(features_, randmask_device_, &features_random_);
-  // randomize the targets
-  for(int32 i=0; i<filling_pos_; i++) {
-    targets_random_[i] = targets_[randmask_[i]];
-  }
+  // the targets stay encoded, they are gathered through randmask_ in GetBunch
 
   randomized_ = true;
 }
@@ -183,19 +176,14 @@ void Cache::GetBunch(CuMatrix<BaseFloat> *features, std::vector<int32> *targets)
 
   // init the output
   features->Resize(bunchsize_, features_.NumCols());
-  targets->resize(bunchsize_);
 
   // copy the output
   if (randomized_) {
     features->CopyRowsFromMat(bunchsize_, features_random_, emptying_pos_, 0);
-    std::copy(targets_random_.begin()+emptying_pos_,
-              targets_random_.begin()+emptying_pos_+bunchsize_,
-              targets->begin());
+    targets_.Gather(randmask_, emptying_pos_, bunchsize_, targets);
   } else {
     features->CopyRowsFromMat(bunchsize_, features_, emptying_pos_, 0);
-    std::copy(targets_.begin()+emptying_pos_,
-              targets_.begin()+emptying_pos_+bunchsize_,
-              targets->begin());
+    targets_.CopyRange(emptying_pos_, bunchsize_, targets);
   }
 
   // update cursor
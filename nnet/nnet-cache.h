@@ -21,6 +21,7 @@
 
 #include "base/kaldi-math.h"
 #include "cudamatrix/cu-math.h"
+#include "nnet/nnet-label-store.h"
 
 namespace kaldi {
 
@@ -85,8 +86,7 @@ class Cache {
   CuMatrix<BaseFloat> features_random_; ///< Feature cache
   CuMatrix<BaseFloat> features_leftover_; ///< Feature cache
   
-  std::vector<int32> targets_;  ///< Desired vector cache
-  std::vector<int32> targets_random_;  ///< Desired vector cache
+  LabelStore targets_;  ///< Desired vector cache, run-length encoded
   std::vector<int32> targets_leftover_;  ///< Desired vector cache
 
   std::vector<int32> randmask_;
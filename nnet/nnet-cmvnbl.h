@@ -13,6 +13,9 @@
  *
  *  Feature must be FBANK_D_A with/without _E and _E is the last element.
  *
+ *  The linearity is diagonal, so it is kept as a vector of scales and the
+ *  layer is an elementwise scale and shift, the gradient of the scales is
+ *  the column sums of err .* input.
  *
  */
 
@@ -37,15 +40,12 @@ class CMVNBL : public UpdatableComponent {
     input_dim_ = dim;  // real dimensions
     output_dim_ = dim;
 
-    linearity_.Resize(dim, dim);
     bias_.Resize(dim);
     bias_.SetZero();
     host_bias_.Resize(dim);
-    host_linearity_.Resize(dim, dim, kSetZero);
-    for (MatrixIndexT i = 0; i < dim; ++i) {
-      host_linearity_(i, i) = 1.0;
-    }
-    linearity_.CopyFromMat(host_linearity_);
+    host_scale_.Resize(dim);
+    host_scale_.Set(1.0);
+    scale_.CopyFromVec(host_scale_);
 
     // Initial normalization parameters
     clean_mu_.Resize(feat_dim_, kSetZero);
@@ -55,7 +55,8 @@ class CMVNBL : public UpdatableComponent {
     noise_mu_.Resize(feat_dim_, kSetZero);
     noise_var_.Resize(feat_dim_, kSetZero);
 
-    linearity_corr_.Resize(dim, dim);
+    scale_corr_.Resize(dim);
+    scale_corr_.SetZero();
     bias_corr_.Resize(dim);
 
     have_noise_ = false;
@@ -88,18 +89,18 @@ class CMVNBL : public UpdatableComponent {
   }
 
   void PropagateFnc(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *out) {
-    // precopy bias
-    out->AddVecToRows(1.0, bias_, 0.0);
-    // multiply by weights^t
-    out->AddMatMat(1.0, in, kNoTrans, linearity_, kTrans, 1.0);
-
+    // scale each dimension
+    out->CopyFromMat(in);
+    out->MulColsVec(scale_);
+    // add bias
+    out->AddVecToRows(1.0, bias_, 1.0);
   }
 
   void BackpropagateFnc(const CuMatrix<BaseFloat> &in_err,
                         CuMatrix<BaseFloat> *out_err) {
-    // multiply error by weights
-    out_err->AddMatMat(1.0, in_err, kNoTrans, linearity_, kNoTrans, 0.0);
-
+    // multiply error by the diagonal weights
+    out_err->CopyFromMat(in_err);
+    out_err->MulColsVec(scale_);
   }
 
   void Update(const CuMatrix<BaseFloat> &input,
@@ -109,18 +110,16 @@ class CMVNBL : public UpdatableComponent {
       return;  // nothing to update except these two
     }
 
-    // compute gradient
+    // compute gradient, only the diagonal of err^T * input is needed
+    err_input_.CopyFromMat(err);
+    err_input_.MulElements(input);
     if (average_grad_) {
-      linearity_corr_.AddMatMat(1.0 / input.NumRows(), err, kTrans, input,
-                                kNoTrans,
-                                momentum_);
+      scale_corr_.AddRowSumMat(1.0 / input.NumRows(), err_input_, momentum_);
       bias_corr_.AddRowSumMat(1.0 / input.NumRows(), err, momentum_);
     } else {
-      linearity_corr_.AddMatMat(1.0, err, kTrans, input, kNoTrans, momentum_);
+      scale_corr_.AddRowSumMat(1.0, err_input_, momentum_);
       bias_corr_.AddRowSumMat(1.0, err, momentum_);
     }
-    //linearity_corr_.AddMatMat(1.0, err, kTrans, input, kNoTrans, momentum_);
-    //bias_corr_.AddRowSumMat(1.0, err, momentum_);
     /*
      // l2 regularization
      if (l2_penalty_ != 0.0) {
@@ -135,7 +134,6 @@ class CMVNBL : public UpdatableComponent {
      */
     // update
     // In the CMVN layer, this function is only used to compute the weight changes
-    //linearity_.AddMat(-learn_rate_, linearity_corr_);
     //bias_.AddVec(-learn_rate_, bias_corr_);
     if (update_flag_ == "cmvn") {
       UpdateCMVN(input.NumRows());
@@ -251,15 +249,13 @@ class CMVNBL : public UpdatableComponent {
       /*
        * Update variance
        */
-      Matrix<BaseFloat> linearity_corr(linearity_corr_.NumRows(),
-                                       linearity_corr_.NumCols(),
-                                       kSetZero);
-      linearity_corr_.CopyToMat(&linearity_corr);
+      Vector<BaseFloat> scale_corr(scale_corr_.Dim(), kSetZero);
+      scale_corr_.CopyToVec(&scale_corr);
       Vector<double> var_corr(feat_dim_, kSetZero);
       // sum over different frames together
       for (int32 f = 0, k = 0; f < win_len_; ++f) {
         for (int32 i = 0; i < feat_dim_; ++i, ++k) {
-          var_corr(i) += static_cast<double>(-0.5 * linearity_corr(k, k)
+          var_corr(i) += static_cast<double>(-0.5 * scale_corr(k)
               + 0.5 * bias_corr(k) * noise_mu_(i));
         }
       }
@@ -323,17 +319,15 @@ class CMVNBL : public UpdatableComponent {
       /*
        * Update variance
        */
-      Matrix<BaseFloat> linearity_corr(linearity_corr_.NumRows(),
-                                       linearity_corr_.NumCols(),
-                                       kSetZero);
-      linearity_corr_.CopyToMat(&linearity_corr);
+      Vector<BaseFloat> scale_corr(scale_corr_.Dim(), kSetZero);
+      scale_corr_.CopyToVec(&scale_corr);
 
       Vector<double> var_z_corr(num_fbank_ * delta_order_, kSetZero);
       // sum over different frames together
       for (int32 f = 0, t = 0; f < win_len_; ++f) {
         for (int32 d = 0, k = 0, j = 0; d < delta_order_; ++d) {
           for (int32 i = 0; i < num_fbank_; ++i, ++j, ++k, ++t) {
-            var_z_corr(j) += static_cast<double>(-0.5 * linearity_corr(t, t)
+            var_z_corr(j) += static_cast<double>(-0.5 * scale_corr(t)
                 + 0.5 * bias_corr(t) * noise_mu_(k));
           }
           if (have_energy_) {
@@ -393,13 +387,12 @@ class CMVNBL : public UpdatableComponent {
 
     for (int32 i = 0; i < win_len_; ++i) {
       for (int32 j = 0; j < feat_dim_; ++j) {
-        host_linearity_(i * feat_dim_ + j, i * feat_dim_ + j) =
-            static_cast<BaseFloat>(inv_std(j));
+        host_scale_(i * feat_dim_ + j) = static_cast<BaseFloat>(inv_std(j));
         host_bias_(i * feat_dim_ + j) = static_cast<BaseFloat>(-noise_mu_(j)
             * inv_std(j));
       }
     }
-    linearity_.CopyFromMat(host_linearity_);
+    scale_.CopyFromVec(host_scale_);
     bias_.CopyFromVec(host_bias_);
   }
 
@@ -492,16 +485,18 @@ class CMVNBL : public UpdatableComponent {
   }
 
 private:
-  CuMatrix<BaseFloat> linearity_;
+  CuVector<BaseFloat> scale_;  // diagonal of the linearity
   CuVector<BaseFloat> bias_;
 
-  CuMatrix<BaseFloat> linearity_corr_;
+  CuVector<BaseFloat> scale_corr_;
   CuVector<BaseFloat> bias_corr_;
 
+  CuMatrix<BaseFloat> err_input_;  // err .* input buffer
+
   int32 feat_dim_;
   int32 win_len_;
 
-  Matrix<BaseFloat> host_linearity_;
+  Vector<BaseFloat> host_scale_;
   Vector<BaseFloat> host_bias_;
 
 // normalization parameters
@@ -8,6 +8,9 @@
  *      environment, etc factors. This code vector is augmented with the input to be
  *      forwarded.
  *
+ *      As the code is constant within a bunch, W_code * code is folded into
+ *      the bias and the GEMMs only run on the input columns.
+ *
  *      Assume the code is before the input.
  */
 
@@ -25,7 +28,8 @@ class CodeBL : public BiasedLinearity {
   CodeBL(MatrixIndexT dim_in, MatrixIndexT dim_out, Nnet *nnet)
       : BiasedLinearity(dim_in, dim_out, nnet),
         update_weight_(true),
-        code_dim_(0)
+        code_dim_(0),
+        code_bias_valid_(false)
 
   {
 
@@ -41,22 +45,39 @@ class CodeBL : public BiasedLinearity {
   /*
    * The reason to overwrite this read function is the matrix size won't match
    * with the input feature dim due to the additional code vector.
+   *
+   * The stored matrix is [W_code W], it is split into code_linearity_ and
+   * linearity_ when reading and joined again when writing.
    */
   void ReadData(std::istream &is, bool binary) {
     ReadBasicType(is, binary, &code_dim_);
     KALDI_ASSERT(code_dim_ >= 0);
     code_vec_.Resize(code_dim_);
+    code_vec_.SetZero();
     code_corr_.Resize(code_dim_);
+    code_corr_.SetZero();
 
-    linearity_.Read(is, binary);
+    Matrix<BaseFloat> full;
+    full.Read(is, binary);
     bias_.Read(is, binary);
 
-    KALDI_ASSERT(linearity_.NumRows() == output_dim_);
-    KALDI_ASSERT(linearity_.NumCols() == input_dim_ + code_dim_);
+    KALDI_ASSERT(full.NumRows() == output_dim_);
+    KALDI_ASSERT(full.NumCols() == input_dim_ + code_dim_);
     KALDI_ASSERT(bias_.Dim() == output_dim_);
 
-    linearity_corr_.Resize(linearity_.NumRows(), linearity_.NumCols());
+    linearity_.CopyFromMat(
+        Matrix<BaseFloat>(SubMatrix<BaseFloat>(full, 0, output_dim_, code_dim_,
+                                               input_dim_)));
+    linearity_corr_.Resize(output_dim_, input_dim_);
     bias_corr_.Resize(bias_.Dim());
+    if (code_dim_ > 0) {
+      code_linearity_.CopyFromMat(
+          Matrix<BaseFloat>(SubMatrix<BaseFloat>(full, 0, output_dim_, 0,
+                                                 code_dim_)));
+      code_linearity_corr_.Resize(output_dim_, code_dim_);
+      code_linearity_corr_.SetZero();
+    }
+    code_bias_valid_ = false;
   }
 
   void WriteData(std::ostream &os, bool binary) const {
@@ -64,80 +85,79 @@ class CodeBL : public BiasedLinearity {
     if (!binary)
       os << "\n";
 
-    linearity_.Write(os, binary);
+    Matrix<BaseFloat> full(output_dim_, input_dim_ + code_dim_), part;
+    linearity_.CopyToMat(&part);
+    SubMatrix<BaseFloat>(full, 0, output_dim_, code_dim_, input_dim_)
+        .CopyFromMat(part);
+    if (code_dim_ > 0) {
+      code_linearity_.CopyToMat(&part);
+      SubMatrix<BaseFloat>(full, 0, output_dim_, 0, code_dim_).CopyFromMat(
+          part);
+    }
+    full.Write(os, binary);
     bias_.Write(os, binary);
   }
 
   void PropagateFnc(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *out) {
-    // augment the input if needed
-    if (code_dim_ > 0) {
-      if (augmented_in_.NumRows() != in.NumRows()
-          || augmented_in_.NumCols() != in.NumCols() + code_dim_) {
-        augmented_in_.Resize(in.NumRows(), in.NumCols() + code_dim_);
-      }
-      augmented_in_.AddVecToPartialRows(1.0, 0, code_vec_, 0.0);
-      augmented_in_.PartAddMat(1.0, in, 0, code_dim_, 0.0);
-    } else {
-      augmented_in_.CopyFromMat(in);
-    }
+    // the code only shifts the bias, W_code * code + b
+    UpdateCodeBias();
 
     // precopy bias
-    out->AddVecToRows(1.0, bias_, 0.0);
+    out->AddVecToRows(1.0, code_bias_, 0.0);
     // multiply by weights^t
-    out->AddMatMat(1.0, augmented_in_, kNoTrans, linearity_, kTrans, 1.0);
+    out->AddMatMat(1.0, in, kNoTrans, linearity_, kTrans, 1.0);
   }
 
   void BackpropagateFnc(const CuMatrix<BaseFloat> &in_err,
                         CuMatrix<BaseFloat> *out_err) {
-    // multiply error by weights
-    if (augmented_err_.NumRows() != in_err.NumRows()
-        || augmented_err_.NumCols() != linearity_.NumCols()) {
-      augmented_err_.Resize(in_err.NumRows(), linearity_.NumCols());
-    }
-    augmented_err_.AddMatMat(1.0, in_err, kNoTrans, linearity_, kNoTrans, 0.0);
-
-    if (code_dim_ > 0) {
-      code_err_.CopyFromMat(augmented_err_, 0, augmented_err_.NumRows(), 0,
-                            code_dim_);
-      out_err->CopyFromMat(augmented_err_, 0, augmented_err_.NumRows(),
-                           code_dim_, augmented_err_.NumCols() - code_dim_);
-    } else {
-      out_err->CopyFromMat(augmented_err_);
-    }
+    // multiply error by weights, the code error is taken in Update()
+    out_err->AddMatMat(1.0, in_err, kNoTrans, linearity_, kNoTrans, 0.0);
   }
 
   void Update(const CuMatrix<BaseFloat> &input,
               const CuMatrix<BaseFloat> &err) {
+    BaseFloat scale = (average_grad_ ? 1.0 / input.NumRows() : 1.0);
+
+    SumErr(err);
+
     // compute gradient
-    if (average_grad_) {
-      if (update_weight_) {
-        linearity_corr_.AddMatMat(1.0 / input.NumRows(), err, kTrans,
-                                  augmented_in_, kNoTrans, momentum_);
-        bias_corr_.AddRowSumMat(1.0 / input.NumRows(), err, momentum_);
-      }
-      code_corr_.AddRowSumMat(1.0 / input.NumRows(), code_err_, momentum_);
-    } else {
-      if (update_weight_) {
-        linearity_corr_.AddMatMat(1.0, err, kTrans, augmented_in_, kNoTrans,
-                                  momentum_);
-        bias_corr_.AddRowSumMat(1.0, err, momentum_);
+    if (update_weight_) {
+      linearity_corr_.AddMatMat(scale, err, kTrans, input, kNoTrans,
+                                momentum_);
+      bias_corr_.AddVec(scale, err_sum_vec_, momentum_);
+      if (code_dim_ > 0) {
+        // outer product of the error sum and the code
+        code_linearity_corr_.AddMatMat(scale, err_sum_, kTrans, code_row_,
+                                       kNoTrans, momentum_);
       }
-      code_corr_.AddRowSumMat(1.0, code_err_, momentum_);
     }
-    // l2 regularization
-    if (l2_penalty_ != 0.0 && update_weight_) {
-      BaseFloat l2 = learn_rate_ * l2_penalty_ * input.NumRows();
-      linearity_.AddMat(-l2, linearity_);
-    }
-    // l1 regularization
-    if (l1_penalty_ != 0.0 && update_weight_) {
-      BaseFloat l1 = learn_rate_ * input.NumRows() * l1_penalty_;
-      cu::RegularizeL1(&linearity_, &linearity_corr_, l1, learn_rate_);
-    }
-    // update
+    AccumulateCodeCorr(scale);
+
     if (update_weight_) {
+      // l2 regularization
+      if (l2_penalty_ != 0.0) {
+        BaseFloat l2 = learn_rate_ * l2_penalty_ * input.NumRows();
+        linearity_.AddMat(-l2, linearity_);
+        if (code_dim_ > 0) {
+          code_linearity_.AddMat(-l2, code_linearity_);
+        }
+      }
+      // l1 regularization
+      if (l1_penalty_ != 0.0) {
+        BaseFloat l1 = learn_rate_ * input.NumRows() * l1_penalty_;
+        cu::RegularizeL1(&linearity_, &linearity_corr_, l1, learn_rate_);
+        if (code_dim_ > 0) {
+          cu::RegularizeL1(&code_linearity_, &code_linearity_corr_, l1,
+                           learn_rate_);
+        }
+      }
+      // update
       linearity_.AddMat(-learn_rate_, linearity_corr_);
       bias_.AddVec(-learn_rate_, bias_corr_);
+      if (code_dim_ > 0) {
+        code_linearity_.AddMat(-learn_rate_, code_linearity_corr_);
+      }
+      code_bias_valid_ = false;
     }
 
     // scale the code_corr_ with current layer's learn rate
@@ -145,6 +165,34 @@ class CodeBL : public BiasedLinearity {
 
   }
 
+  /*
+   * With the weights not updated (see ConfigWeightUpdate), in * W^T does
+   * not change, only the code bias does. The product can then be computed
+   * once per input and the forward pass and the code vector correction done
+   * from it (the input itself is not needed).
+   */
+  void InputProduct(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *prod) {
+    prod->Resize(in.NumRows(), output_dim_);
+    prod->AddMatMat(1.0, in, kNoTrans, linearity_, kTrans, 0.0);
+  }
+
+  void PropagateFromProduct(const CuMatrix<BaseFloat> &prod,
+                            CuMatrix<BaseFloat> *out) {
+    KALDI_ASSERT(prod.NumCols() == output_dim_);
+    UpdateCodeBias();
+    out->CopyFromMat(prod);
+    out->AddVecToRows(1.0, code_bias_, 1.0);
+  }
+
+  void UpdateCodeVec(const CuMatrix<BaseFloat> &err) {
+    if (update_weight_) {
+      KALDI_ERR << "The weights of <codebl> are updated, the input is needed";
+    }
+    SumErr(err);
+    AccumulateCodeCorr(average_grad_ ? 1.0 / err.NumRows() : 1.0);
+    code_corr_.Scale(-learn_rate_);
+  }
+
   /*
    * The update of the code vector is done outside as it may be shared
    * among different layers.
@@ -155,6 +203,7 @@ class CodeBL : public BiasedLinearity {
 
   void SetCodeVec(const CuVector<BaseFloat> &vec) {
     code_vec_.CopyFromVec(vec);
+    code_bias_valid_ = false;
   }
 
   /*
@@ -162,6 +211,7 @@ class CodeBL : public BiasedLinearity {
    */
   void ZeroCodeVec() {
     code_vec_.SetZero();
+    code_bias_valid_ = false;
   }
 
   int32 GetCodeVecDim() {
@@ -177,15 +227,64 @@ class CodeBL : public BiasedLinearity {
 
  protected:
 
+  /*
+   * Recompute code_bias_ = W_code * code + b, only after the code or the
+   * weights changed.
+   */
+  void UpdateCodeBias() {
+    if (code_bias_valid_) {
+      return;
+    }
+    code_bias_.CopyFromVec(bias_);
+    if (code_dim_ > 0) {
+      code_row_.Resize(1, code_dim_);
+      code_row_.AddVecToRows(1.0, code_vec_, 0.0);
+      code_bias_row_.Resize(1, output_dim_);
+      code_bias_row_.AddMatMat(1.0, code_row_, kNoTrans, code_linearity_,
+                               kTrans, 0.0);
+      code_bias_.AddRowSumMat(1.0, code_bias_row_, 1.0);
+    }
+    code_bias_valid_ = true;
+  }
+
+  /*
+   * The code is the same for all the frames, so all its gradients only need
+   * the sum of the errors.
+   */
+  void SumErr(const CuMatrix<BaseFloat> &err) {
+    err_sum_vec_.Resize(err.NumCols());
+    err_sum_vec_.AddRowSumMat(1.0, err, 0.0);
+    err_sum_.Resize(1, err.NumCols());
+    err_sum_.AddVecToRows(1.0, err_sum_vec_, 0.0);
+  }
+
+  void AccumulateCodeCorr(BaseFloat scale) {
+    if (code_dim_ > 0) {
+      // W_code^T * sum(err)
+      code_grad_.Resize(1, code_dim_);
+      code_grad_.AddMatMat(1.0, err_sum_, kNoTrans, code_linearity_, kNoTrans,
+                           0.0);
+      code_corr_.AddRowSumMat(scale, code_grad_, momentum_);
+    }
+  }
+
   bool update_weight_;
 
   int32 code_dim_;  // dimensionality of the code
 
-  CuMatrix<BaseFloat> augmented_in_;  // input feature + code
   CuVector<BaseFloat> code_vec_;  // code vector
+  CuMatrix<BaseFloat> code_row_;  // code vector as a 1 x code_dim_ matrix
+
+  CuMatrix<BaseFloat> code_linearity_;  // W_code, weights of the code
+  CuMatrix<BaseFloat> code_linearity_corr_;
+
+  bool code_bias_valid_;
+  CuVector<BaseFloat> code_bias_;  // W_code * code + b
+  CuMatrix<BaseFloat> code_bias_row_;
 
-  CuMatrix<BaseFloat> augmented_err_;  // the error includes code errors
-  CuMatrix<BaseFloat> code_err_;  // error matrix for code vector
+  CuVector<BaseFloat> err_sum_vec_;  // sum of the errors over the frames
+  CuMatrix<BaseFloat> err_sum_;  // err_sum_vec_ as a 1 x output_dim_ matrix
+  CuMatrix<BaseFloat> code_grad_;  // 1 x code_dim_ gradient of the code
 
   CuVector<BaseFloat> code_corr_;  // correction of the code vector
 };
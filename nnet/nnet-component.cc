@@ -33,6 +33,10 @@
 #include "nnet/nnet-linrbm.h"
 #include "nnet/nnet-hmmbl.h"
 #include "nnet/nnet-codebl.h"
+#include "nnet/nnet-tiedlinearity.h"
+#include "nnet/nnet-model-image.h"
+
+#include <sstream>
 
 namespace kaldi {
 
@@ -47,7 +51,8 @@ const struct Component::key_value Component::kMarkerMap[] = { {
     {Component::kMaskedRbm, "<maskedrbm>"}, {Component::kRoRbm, "<rorbm>"},
     {Component::kGRbm, "<grbm>"}, {Component::kLinBL, "<linbl>"},
     {Component::kLinRbm, "<linrbm>"}, {Component::kHMMBL, "<hmmbl>"},
-    {Component::kCodeBL, "<codebl>"}};
+    {Component::kCodeBL, "<codebl>"},
+    {Component::kTiedLinearity, "<tiedlinearity>"}};
 
 const char* Component::TypeToMarker(ComponentType t) {
   int32 N = sizeof(kMarkerMap) / sizeof(kMarkerMap[0]);
@@ -69,20 +74,9 @@ Component::ComponentType Component::MarkerToType(const std::string &s) {
   return kUnknown;
 }
 
-Component* Component::Read(std::istream &is, bool binary, Nnet *nnet) {
-  int32 dim_out, dim_in;
-  std::string token;
-
-  int first_char = Peek(is, binary);
-  if (first_char == EOF)
-    return NULL;
-
-  ReadToken(is, binary, &token);
-  Component::ComponentType comp_type = Component::MarkerToType(token);
-
-  ReadBasicType(is, binary, &dim_out);
-  ReadBasicType(is, binary, &dim_in);
-
+Component* Component::NewComponent(ComponentType comp_type,
+                                   MatrixIndexT dim_in, MatrixIndexT dim_out,
+                                   Nnet *nnet) {
   Component *p_comp = NULL;
   switch (comp_type) {
     case Component::kBiasedLinearity:
@@ -139,6 +133,9 @@ Component* Component::Read(std::istream &is, bool binary, Nnet *nnet) {
     case Component::kCodeBL:
       p_comp = new CodeBL(dim_in, dim_out, nnet);
       break;
+    case Component::kTiedLinearity:
+      p_comp = new TiedLinearity(dim_in, dim_out, nnet);
+      break;
     case Component::kRelu:
       p_comp = new Relu(dim_in, dim_out, nnet);
       break;
@@ -147,13 +144,78 @@ Component* Component::Read(std::istream &is, bool binary, Nnet *nnet) {
       break;
     case Component::kUnknown:
     default:
-      KALDI_ERR<< "Missing type: " << token;
+      KALDI_ERR<< "Missing type: " << comp_type;
     }
 
+  return p_comp;
+}
+
+Component* Component::Read(std::istream &is, bool binary, Nnet *nnet) {
+  int32 dim_out, dim_in;
+  std::string token;
+
+  int first_char = Peek(is, binary);
+  if (first_char == EOF)
+    return NULL;
+
+  ReadToken(is, binary, &token);
+  Component::ComponentType comp_type = Component::MarkerToType(token);
+
+  ReadBasicType(is, binary, &dim_out);
+  ReadBasicType(is, binary, &dim_in);
+
+  Component *p_comp = NewComponent(comp_type, dim_in, dim_out, nnet);
   p_comp->ReadData(is, binary);
   return p_comp;
 }
 
+/// Section prefix of the index-th component in a model image
+static std::string ImagePrefix(int32 index) {
+  std::ostringstream oss;
+  oss << "L" << index << ".";
+  return oss.str();
+}
+
+Component* Component::ReadImage(const ModelImage &image, int32 index,
+                                Nnet *nnet) {
+  std::string prefix = ImagePrefix(index);
+  std::string marker;
+  std::vector<int32> dims;
+  image.GetBlob(prefix + "marker", &marker);
+  image.GetInt32s(prefix + "dims", &dims);
+  KALDI_ASSERT(dims.size() == 2);
+
+  Component *p_comp = NewComponent(Component::MarkerToType(marker), dims[1],
+                                   dims[0], nnet);
+  p_comp->ReadImageData(image, prefix);
+  return p_comp;
+}
+
+void Component::WriteImage(ModelImageWriter *writer, int32 index) const {
+  std::string prefix = ImagePrefix(index);
+  std::vector<int32> dims(2);
+  dims[0] = OutputDim();
+  dims[1] = InputDim();
+  writer->AddBlob(prefix + "marker", Component::TypeToMarker(GetType()));
+  writer->AddInt32s(prefix + "dims", dims);
+  this->WriteImageData(writer, prefix);
+}
+
+void Component::ReadImageData(const ModelImage &image,
+                              const std::string &prefix) {
+  std::string blob;
+  image.GetBlob(prefix + "data", &blob);
+  std::istringstream is(blob);
+  ReadData(is, true);
+}
+
+void Component::WriteImageData(ModelImageWriter *writer,
+                               const std::string &prefix) const {
+  std::ostringstream os;
+  WriteData(os, true);
+  writer->AddBlob(prefix + "data", os.str());
+}
+
 void Component::Write(std::ostream &os, bool binary) const {
   WriteToken(os, binary, Component::TypeToMarker(GetType()));
   WriteBasicType(os, binary, OutputDim());
@@ -33,6 +33,8 @@ namespace kaldi {
 
 // declare the nnet class so we can declare pointer
 class Nnet;
+class ModelImage;
+class ModelImageWriter;
     
 
 /**
@@ -66,6 +68,7 @@ class Component {
     kLinBL,
     kHMMBL,
     kCodeBL,
+    kTiedLinearity,
 
     kActivationFunction = 0x0200, 
     kSoftmax, 
@@ -133,6 +136,11 @@ class Component {
   /// Write component to stream
   void WriteAsBiasedLinearity(std::ostream &os, bool binary) const;
 
+  /// Read the index-th component from a model image
+  static Component* ReadImage(const ModelImage &image, int32 index, Nnet *nnet);
+  /// Write component as the index-th component of a model image
+  void WriteImage(ModelImageWriter *writer, int32 index) const;
+
 
 
   // abstract interface for propagation/backpropagation 
@@ -150,6 +158,16 @@ class Component {
   /// Writes the component content
   virtual void WriteData(std::ostream &os, bool binary) const { }
 
+  /// Reads the component content from the image sections under the prefix,
+  /// by default from the blob written by WriteImageData
+  virtual void ReadImageData(const ModelImage &image,
+                             const std::string &prefix);
+
+  /// Writes the component content as image sections under the prefix,
+  /// by default the binary WriteData as a single blob
+  virtual void WriteImageData(ModelImageWriter *writer,
+                              const std::string &prefix) const;
+
 
   // data members
  protected:
@@ -158,6 +176,10 @@ class Component {
   
   Nnet *nnet_; ///< Pointer to the whole network
  private:
+  /// Factory of the empty components
+  static Component* NewComponent(ComponentType comp_type, MatrixIndexT dim_in,
+                                 MatrixIndexT dim_out, Nnet *nnet);
+
   KALDI_DISALLOW_COPY_AND_ASSIGN(Component);
 };
 
@@ -0,0 +1,218 @@
+// nnet/nnet-feat-io.cc
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ */
+
+#include "nnet/nnet-feat-io.h"
+
+#include <pthread.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace kaldi {
+
+int32 FormatFloat(BaseFloat value, char *buf) {
+  // the shortest of 6..9 significant digits (15..17 for double) that reads
+  // back to the same value, 9 (17) always does
+  bool is_float = (sizeof(BaseFloat) == 4);
+  int32 max_prec = is_float ? 9 : 17;
+  for (int32 prec = is_float ? 6 : 15; prec < max_prec; ++prec) {
+    int32 len = snprintf(buf, 32, "%.*g", prec, value);
+    BaseFloat back = is_float ? strtof(buf, NULL) : strtod(buf, NULL);
+    if (back == value) {
+      return len;
+    }
+  }
+  return snprintf(buf, 32, "%.*g", max_prec, value);
+}
+
+void FormatMatrixText(const MatrixBase<BaseFloat> &mat, std::string *buf) {
+  char val[32];
+  // rough guess of the size, avoids most of the reallocations
+  buf->reserve(buf->size() + mat.NumRows() * (mat.NumCols() * 16 + 1));
+  for (MatrixIndexT r = 0; r < mat.NumRows(); ++r) {
+    const BaseFloat *row = mat.RowData(r);
+    for (MatrixIndexT c = 0; c < mat.NumCols(); ++c) {
+      int32 len = FormatFloat(row[c], val);
+      val[len++] = ' ';
+      buf->append(val, len);
+    }
+    buf->push_back('\n');
+  }
+}
+
+void FormatMatrixRaw(const MatrixBase<BaseFloat> &mat, std::string *buf) {
+  size_t offset = buf->size();
+  size_t row_bytes = mat.NumCols() * sizeof(float);
+  buf->resize(offset + mat.NumRows() * row_bytes);
+  char *dst = &((*buf)[0]) + offset;
+  for (MatrixIndexT r = 0; r < mat.NumRows(); ++r, dst += row_bytes) {
+    if (sizeof(BaseFloat) == sizeof(float)) {
+      memcpy(dst, mat.RowData(r), row_bytes);
+    } else {
+      float *out = reinterpret_cast<float*>(dst);
+      const BaseFloat *row = mat.RowData(r);
+      for (MatrixIndexT c = 0; c < mat.NumCols(); ++c) {
+        out[c] = static_cast<float>(row[c]);
+      }
+    }
+  }
+}
+
+bool ParseMatrixText(const std::string &buf, int32 dim,
+                     Matrix<BaseFloat> *mat) {
+  KALDI_ASSERT(dim > 0);
+  std::vector<BaseFloat> values;
+  values.reserve(buf.size() / 8);
+
+  const char *p = buf.c_str(), *end = p + buf.size();
+  while (p < end) {
+    char *next;
+    double val = strtod(p, &next);
+    if (next == p) {
+      // only trailing white space is allowed
+      while (p < end && isspace(*p)) ++p;
+      if (p != end) return false;
+      break;
+    }
+    values.push_back(static_cast<BaseFloat>(val));
+    p = next;
+  }
+
+  if (values.size() % dim != 0) {
+    return false;
+  }
+  int32 num_frames = values.size() / dim;
+  mat->Resize(num_frames, dim, kUndefined);
+  for (int32 r = 0; r < num_frames; ++r) {
+    memcpy(mat->RowData(r), &values[r * dim], dim * sizeof(BaseFloat));
+  }
+  return true;
+}
+
+bool ParseMatrixRaw(const std::string &buf, int32 dim, Matrix<BaseFloat> *mat) {
+  KALDI_ASSERT(dim > 0);
+  size_t row_bytes = dim * sizeof(float);
+  if (buf.size() % row_bytes != 0) {
+    return false;
+  }
+  int32 num_frames = buf.size() / row_bytes;
+  mat->Resize(num_frames, dim, kUndefined);
+  const float *src = reinterpret_cast<const float*>(buf.data());
+  for (int32 r = 0; r < num_frames; ++r, src += dim) {
+    BaseFloat *row = mat->RowData(r);
+    for (int32 c = 0; c < dim; ++c) {
+      row[c] = static_cast<BaseFloat>(src[c]);
+    }
+  }
+  return true;
+}
+
+bool ReadFileToString(const std::string &filename, std::string *buf) {
+  FILE *fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL) {
+    return false;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  buf->resize(size > 0 ? size : 0);
+  bool ok = (size <= 0 || fread(&((*buf)[0]), 1, size, fp) == (size_t) size);
+  fclose(fp);
+  return ok;
+}
+
+bool WriteStringToFile(const std::string &filename, const std::string &buf) {
+  FILE *fp = fopen(filename.c_str(), "wb");
+  if (fp == NULL) {
+    return false;
+  }
+  bool ok = (fwrite(buf.data(), 1, buf.size(), fp) == buf.size());
+  ok = (fclose(fp) == 0) && ok;
+  return ok;
+}
+
+void* FeatBatchConverter::RunJob(void *arg) {
+  Job *job = static_cast<Job*>(arg);
+  const FeatBatchConverter &conv = *job->converter;
+
+  // utterances are interleaved among the threads
+  if (job->mats != NULL) {
+    for (size_t i = job->thread_id; i < job->mats->size();
+        i += conv.num_threads_) {
+      std::string &buf = (*job->bufs)[i];
+      buf.clear();
+      if (conv.raw_) {
+        FormatMatrixRaw((*job->mats)[i], &buf);
+      } else {
+        FormatMatrixText((*job->mats)[i], &buf);
+      }
+    }
+  } else {
+    std::string buf;
+    for (size_t i = job->thread_id; i < job->files->size();
+        i += conv.num_threads_) {
+      Matrix<BaseFloat> &mat = (*job->parsed)[i];
+      bool ok = ReadFileToString((*job->files)[i], &buf);
+      if (ok) {
+        ok = conv.raw_ ? ParseMatrixRaw(buf, conv.dim_, &mat)
+                       : ParseMatrixText(buf, conv.dim_, &mat);
+      }
+      (*job->ok)[i] = ok;
+    }
+  }
+  return NULL;
+}
+
+void FeatBatchConverter::RunThreads(Job *proto) {
+  std::vector<Job> jobs(num_threads_, *proto);
+  std::vector<pthread_t> threads(num_threads_);
+  for (int32 t = 0; t < num_threads_; ++t) {
+    jobs[t].thread_id = t;
+  }
+  if (num_threads_ == 1) {
+    RunJob(&jobs[0]);
+    return;
+  }
+  int32 num_started = 0;
+  int ret = 0;
+  for (; num_started < num_threads_; ++num_started) {
+    ret = pthread_create(&threads[num_started], NULL, RunJob,
+                         &jobs[num_started]);
+    if (ret != 0) {
+      break;
+    }
+  }
+  // the started threads use jobs, wait for them even on error
+  for (int32 t = 0; t < num_started; ++t) {
+    pthread_join(threads[t], NULL);
+  }
+  if (ret != 0) {
+    KALDI_ERR << "Error creating thread, errno was: " << ret;
+  }
+}
+
+void FeatBatchConverter::Format(const std::vector<Matrix<BaseFloat> > &mats,
+                                std::vector<std::string> *bufs) {
+  bufs->resize(mats.size());
+  Job proto = { this, 0, &mats, bufs, NULL, NULL, NULL };
+  RunThreads(&proto);
+}
+
+void FeatBatchConverter::Parse(const std::vector<std::string> &files,
+                               std::vector<Matrix<BaseFloat> > *mats,
+                               std::vector<char> *ok) {
+  KALDI_ASSERT(dim_ > 0);
+  mats->resize(files.size());
+  ok->assign(files.size(), 0);
+  Job proto = { this, 0, NULL, NULL, &files, mats, ok };
+  RunThreads(&proto);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,92 @@
+// nnet/nnet-feat-io.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Conversion of the feature matrices from/to the text and raw binary
+ * files exchanged with the Matlab tools (masking, robm).
+ *
+ * Text: one frame per line, values separated (and terminated) by a space,
+ *       printed with the fewest of 6..9 significant digits which read back
+ *       to the same float.
+ * Raw:  frames stored row by row as native 32-bit floats, i.e. in Matlab
+ *       fread(fid, [dim, inf], 'single')'.
+ *
+ * Batches of utterances are converted on several threads, each utterance
+ * going to/from a single memory buffer.
+ *
+ */
+
+#ifndef KALDI_NNET_FEAT_IO_H
+#define KALDI_NNET_FEAT_IO_H
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+
+namespace kaldi {
+
+/// Print the value with the shortest round-trip precision,
+/// buf must hold at least 32 chars, returns the number of chars written
+int32 FormatFloat(BaseFloat value, char *buf);
+
+/// Append the matrix as text to the buffer
+void FormatMatrixText(const MatrixBase<BaseFloat> &mat, std::string *buf);
+/// Append the matrix as raw 32-bit floats to the buffer
+void FormatMatrixRaw(const MatrixBase<BaseFloat> &mat, std::string *buf);
+
+/// Parse the text buffer into a matrix with dim columns,
+/// returns false if the number of values is not a multiple of dim
+bool ParseMatrixText(const std::string &buf, int32 dim,
+                     Matrix<BaseFloat> *mat);
+/// Parse the raw 32-bit float buffer into a matrix with dim columns
+bool ParseMatrixRaw(const std::string &buf, int32 dim, Matrix<BaseFloat> *mat);
+
+/// Read a whole file into the buffer
+bool ReadFileToString(const std::string &filename, std::string *buf);
+/// Write the buffer into the file with a single write
+bool WriteStringToFile(const std::string &filename, const std::string &buf);
+
+/**
+ * Converts batches of utterances on num_threads threads,
+ * the results are kept in the input order.
+ */
+class FeatBatchConverter {
+ public:
+  FeatBatchConverter(int32 num_threads, bool raw, int32 dim = 0)
+      : num_threads_(num_threads > 0 ? num_threads : 1),
+        raw_(raw),
+        dim_(dim) { }
+
+  /// (*bufs)[i] is the text/raw image of mats[i]
+  void Format(const std::vector<Matrix<BaseFloat> > &mats,
+              std::vector<std::string> *bufs);
+
+  /// Read and parse the files, (*ok)[i] is false if files[i] failed
+  void Parse(const std::vector<std::string> &files,
+             std::vector<Matrix<BaseFloat> > *mats, std::vector<char> *ok);
+
+ private:
+  struct Job {
+    FeatBatchConverter *converter;
+    int32 thread_id;
+    const std::vector<Matrix<BaseFloat> > *mats;
+    std::vector<std::string> *bufs;
+    const std::vector<std::string> *files;
+    std::vector<Matrix<BaseFloat> > *parsed;
+    std::vector<char> *ok;
+  };
+  static void* RunJob(void *arg);
+  void RunThreads(Job *proto);
+
+  int32 num_threads_;
+  bool raw_;
+  int32 dim_;
+};
+
+}  // namespace kaldi
+
+#endif
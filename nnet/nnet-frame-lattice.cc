@@ -0,0 +1,250 @@
+// nnet/nnet-frame-lattice.cc
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ */
+
+#include "nnet/nnet-frame-lattice.h"
+
+#include <algorithm>
+
+namespace kaldi {
+
+void FrameLattice::Init(const Lattice &lat,
+                        const std::vector<int32> &state_times,
+                        const TransitionModel &trans_model) {
+  kaldi::uint64 props = lat.Properties(fst::kFstProperties, false);
+  if (!(props & fst::kTopSorted)) {
+    KALDI_ERR << "Input lattice must be topologically sorted.";
+  }
+
+  num_states_ = lat.NumStates();
+  KALDI_ASSERT(num_states_ > 0
+               && static_cast<int32>(state_times.size()) == num_states_);
+  start_ = lat.Start();
+  num_frames_ = *std::max_element(state_times.begin(), state_times.end());
+
+  // count the arcs of each frame
+  frame_offset_.assign(num_frames_ + 2, 0);
+  for (int32 s = 0; s < num_states_; ++s) {
+    KALDI_ASSERT(state_times[s] >= 0);
+    frame_offset_[state_times[s] + 1] += lat.NumArcs(s);
+  }
+  for (int32 t = 0; t <= num_frames_; ++t) {
+    frame_offset_[t + 1] += frame_offset_[t];
+  }
+
+  int32 num_arcs = frame_offset_.back();
+  arc_src_.resize(num_arcs);
+  arc_dst_.resize(num_arcs);
+  arc_tid_.resize(num_arcs);
+  arc_pdf_.resize(num_arcs);
+  graph_cost_.resize(num_arcs);
+  ac_cost_.resize(num_arcs);
+  final_state_.clear();
+  final_graph_cost_.clear();
+  final_ac_cost_.clear();
+
+  // the states are visited in the topological order, so inside a frame the
+  // epsilon arcs come after the arcs entering their source state
+  std::vector<int32> next_arc(frame_offset_.begin(), frame_offset_.end() - 1);
+  for (int32 s = 0; s < num_states_; ++s) {
+    int32 t = state_times[s];
+    for (fst::ArcIterator<Lattice> aiter(lat, s); !aiter.Done();
+        aiter.Next()) {
+      const LatticeArc &arc = aiter.Value();
+      int32 a = next_arc[t]++;
+      arc_src_[a] = s;
+      arc_dst_[a] = arc.nextstate;
+      arc_tid_[a] = arc.ilabel;
+      if (arc.ilabel != 0) {  // Non-epsilon input label on arc
+        KALDI_ASSERT(t < num_frames_
+                     && "There appears to be lattice/feature mismatch.");
+        arc_pdf_[a] = trans_model.TransitionIdToPdf(arc.ilabel);
+      } else {
+        arc_pdf_[a] = -1;
+      }
+      graph_cost_[a] = arc.weight.Value1();
+      ac_cost_[a] = arc.weight.Value2();
+    }
+
+    LatticeWeight final = lat.Final(s);
+    if (final != LatticeWeight::Zero()) {
+      final_state_.push_back(s);
+      final_graph_cost_.push_back(final.Value1());
+      final_ac_cost_.push_back(final.Value2());
+    }
+  }
+}
+
+void FrameLattice::AcousticRescore(const MatrixBase<BaseFloat> &log_like) {
+  KALDI_ASSERT(log_like.NumRows() == num_frames_);
+
+  const int32 *pdf = &arc_pdf_[0];
+  BaseFloat *ac_cost = &ac_cost_[0];
+  for (int32 t = 0; t < num_frames_; ++t) {
+    const BaseFloat *row = log_like.RowData(t);
+    for (int32 a = frame_offset_[t]; a < frame_offset_[t + 1]; ++a) {
+      if (pdf[a] >= 0) {
+        ac_cost[a] -= row[pdf[a]];
+      }
+    }
+  }
+}
+
+void FrameLattice::Scale(BaseFloat lm_scale, BaseFloat acoustic_scale) {
+  for (size_t a = 0; a < graph_cost_.size(); ++a) {
+    graph_cost_[a] *= lm_scale;
+    ac_cost_[a] *= acoustic_scale;
+  }
+  for (size_t f = 0; f < final_state_.size(); ++f) {
+    final_graph_cost_[f] *= lm_scale;
+    final_ac_cost_[f] *= acoustic_scale;
+  }
+}
+
+double FrameLattice::ComputeAlphaBeta(std::vector<double> *alpha,
+                                      std::vector<double> *beta) const {
+  int32 num_arcs = NumArcs();
+  alpha->assign(num_states_, kLogZeroDouble);
+  beta->assign(num_states_, kLogZeroDouble);
+
+  // the arcs are in a topological order of their source states
+  (*alpha)[start_] = 0.0;
+  for (int32 a = 0; a < num_arcs; ++a) {
+    double arc_like = -(graph_cost_[a] + ac_cost_[a]);
+    (*alpha)[arc_dst_[a]] = LogAdd((*alpha)[arc_dst_[a]],
+                                   (*alpha)[arc_src_[a]] + arc_like);
+  }
+  double tot_forward_prob = kLogZeroDouble;
+  for (size_t f = 0; f < final_state_.size(); ++f) {
+    double final_like = -(final_graph_cost_[f] + final_ac_cost_[f]);
+    tot_forward_prob = LogAdd(tot_forward_prob,
+                              (*alpha)[final_state_[f]] + final_like);
+    (*beta)[final_state_[f]] = final_like;
+  }
+
+  for (int32 a = num_arcs - 1; a >= 0; --a) {
+    double arc_like = -(graph_cost_[a] + ac_cost_[a]);
+    (*beta)[arc_src_[a]] = LogAdd((*beta)[arc_src_[a]],
+                                  arc_like + (*beta)[arc_dst_[a]]);
+  }
+  double tot_backward_prob = (*beta)[start_];
+  if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-8)) {
+    KALDI_WARN << "Total forward probability over lattice = "
+        << tot_forward_prob << ", while total backward probability = "
+        << tot_backward_prob;
+  }
+  return tot_forward_prob;
+}
+
+double FrameLattice::ForwardBackward(MatrixBase<BaseFloat> *post,
+                                     double *acoustic_like_sum) const {
+  KALDI_ASSERT(post->NumRows() == num_frames_);
+
+  std::vector<double> alpha, beta;
+  double tot_prob = ComputeAlphaBeta(&alpha, &beta);
+
+  if (acoustic_like_sum != NULL) {
+    *acoustic_like_sum = 0.0;
+  }
+  for (int32 t = 0; t <= num_frames_; ++t) {
+    for (int32 a = frame_offset_[t]; a < frame_offset_[t + 1]; ++a) {
+      double arc_like = -(graph_cost_[a] + ac_cost_[a]);
+      double arc_post = exp(alpha[arc_src_[a]] + arc_like + beta[arc_dst_[a]]
+                            - tot_prob);
+      if (arc_pdf_[a] >= 0) {
+        (*post)(t, arc_pdf_[a]) += arc_post;
+      }
+      if (acoustic_like_sum != NULL) {
+        *acoustic_like_sum -= arc_post * ac_cost_[a];
+      }
+    }
+  }
+  if (acoustic_like_sum != NULL) {
+    for (size_t f = 0; f < final_state_.size(); ++f) {
+      double final_post = exp(alpha[final_state_[f]] - (final_graph_cost_[f]
+          + final_ac_cost_[f]) - tot_prob);
+      *acoustic_like_sum -= final_post * final_ac_cost_[f];
+    }
+  }
+  return tot_prob;
+}
+
+double FrameLattice::ForwardBackwardMpe(
+    const TransitionModel &trans_model, const std::vector<int32> &ref_ali,
+    const std::vector<int32> &silence_phones, bool smbr,
+    MatrixBase<BaseFloat> *post) const {
+  KALDI_ASSERT(static_cast<int32>(ref_ali.size()) == num_frames_
+               && post->NumRows() == num_frames_);
+  int32 num_arcs = NumArcs();
+
+  // accuracy of the arcs, against the pdf (sMBR) or phone (MPE) of the frame
+  std::vector<int32> silence(silence_phones);
+  std::sort(silence.begin(), silence.end());
+  std::vector<BaseFloat> arc_acc(num_arcs, 0.0);
+  for (int32 t = 0; t < num_frames_; ++t) {
+    int32 ref = smbr ? trans_model.TransitionIdToPdf(ref_ali[t]) :
+        trans_model.TransitionIdToPhone(ref_ali[t]);
+    for (int32 a = frame_offset_[t]; a < frame_offset_[t + 1]; ++a) {
+      if (arc_tid_[a] == 0) {
+        continue;
+      }
+      int32 phone = trans_model.TransitionIdToPhone(arc_tid_[a]);
+      if (std::binary_search(silence.begin(), silence.end(), phone)) {
+        continue;
+      }
+      arc_acc[a] = ((smbr ? arc_pdf_[a] : phone) == ref) ? 1.0 : 0.0;
+    }
+  }
+
+  std::vector<double> alpha, beta;
+  double tot_prob = ComputeAlphaBeta(&alpha, &beta);
+
+  // expected accuracy of the partial paths reaching each state
+  std::vector<double> alpha_acc(num_states_, 0.0);
+  for (int32 a = 0; a < num_arcs; ++a) {
+    int32 src = arc_src_[a], dst = arc_dst_[a];
+    if (alpha[dst] == kLogZeroDouble) {
+      continue;
+    }
+    double arc_scale = exp(alpha[src] - (graph_cost_[a] + ac_cost_[a])
+                           - alpha[dst]);
+    alpha_acc[dst] += arc_scale * (alpha_acc[src] + arc_acc[a]);
+  }
+  double tot_acc = 0.0;
+  for (size_t f = 0; f < final_state_.size(); ++f) {
+    int32 s = final_state_[f];
+    tot_acc += exp(alpha[s] - (final_graph_cost_[f] + final_ac_cost_[f])
+                   - tot_prob) * alpha_acc[s];
+  }
+
+  // expected accuracy of the partial paths leaving each state, the
+  // beta_acc of the destination is complete when an arc is visited
+  std::vector<double> beta_acc(num_states_, 0.0);
+  for (int32 t = num_frames_; t >= 0; --t) {
+    for (int32 a = frame_offset_[t + 1] - 1; a >= frame_offset_[t]; --a) {
+      int32 src = arc_src_[a], dst = arc_dst_[a];
+      if (beta[src] == kLogZeroDouble) {
+        continue;
+      }
+      double arc_like = -(graph_cost_[a] + ac_cost_[a]);
+      double arc_scale = exp(beta[dst] + arc_like - beta[src]);
+      beta_acc[src] += arc_scale * (beta_acc[dst] + arc_acc[a]);
+
+      if (arc_pdf_[a] >= 0) {
+        double arc_post = exp(alpha[src] + arc_like + beta[dst] - tot_prob);
+        (*post)(t, arc_pdf_[a]) += arc_post * (alpha_acc[src] + arc_acc[a]
+            + beta_acc[dst] - tot_acc);
+      }
+    }
+  }
+  if (!ApproxEqual(tot_acc, beta_acc[start_], 1e-6)) {
+    KALDI_WARN << "Total forward accuracy over lattice = " << tot_acc
+        << ", while total backward accuracy = " << beta_acc[start_];
+  }
+  return tot_acc;
+}
+
+}  // namespace kaldi
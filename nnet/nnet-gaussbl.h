@@ -4,7 +4,9 @@
 #define KALDI_NNET_GAUSSBL_H
 
 #include "nnet/nnet-component.h"
+#include "nnet/nnet-model-image.h"
 #include "gmm/am-diag-gmm.h"
+#include "vts/vts-multi-frame.h"
 #include "cudamatrix/cu-math.h"
 
 namespace kaldi {
@@ -119,6 +121,11 @@ class GaussBL : public UpdatableComponent {
     neg_am_gmm_.Write(os, binary);
   }
 
+  /// The image keeps the GMMs as arrays and the converted clean NN layer
+  void ReadImageData(const ModelImage &image, const std::string &prefix);
+  void WriteImageData(ModelImageWriter *writer,
+                      const std::string &prefix) const;
+
   // CPU based forward
   void Forward(const Matrix<BaseFloat> &in, Matrix<BaseFloat> *out) {
     // precopy bias
@@ -184,8 +191,15 @@ class GaussBL : public UpdatableComponent {
 
   }
 
+  /// Prepare the VTS compensation of the clean GMMs
   void PrepareDCTXforms();
 
+  /// Threads used by the compensation in SetNoise()
+  void SetNumThreads(int32 num_threads) {
+    pos_vts_.SetNumThreads(num_threads);
+    neg_vts_.SetNumThreads(num_threads);
+  }
+
   void SetNoise(bool compensate_var, const Vector<double> &mu_h,
                 const Vector<double> &mu_z,
                 const Vector<double> &var_z);
@@ -201,18 +215,16 @@ class GaussBL : public UpdatableComponent {
   void ComputeLogPriorAndPrecCoeff(const Matrix<BaseFloat> &weight,
                                    const Vector<BaseFloat> &bias);
 
-  void CompensateMultiFrameGmm(const Vector<double> &mu_h,
-                               const Vector<double> &mu_z,
-                               const Vector<double> &var_z, bool compensate_var,
-                               int32 num_cepstral,
-                               int32 num_fbank,
-                               const Matrix<double> &dct_mat,
-                               const Matrix<double> &inv_dct_mat,
-                               int32 num_frames,
-                               AmDiagGmm &noise_am_gmm);
-
   void ConvertToNNLayer(const AmDiagGmm &pos_am_gmm,
                         const AmDiagGmm &neg_am_gmm);
+  void ConvertToNNLayer(const AmDiagGmm &pos_am_gmm,
+                        const AmDiagGmm &neg_am_gmm,
+                        Matrix<BaseFloat> *linearity,
+                        Vector<BaseFloat> *bias) const;
+
+  /// Regenerate the NN layer in place from the compensated means and
+  /// variances kept by the VTS engines, no GMM conversions
+  void RefreshNNLayer();
 
   void UpdatePrecisionCoeff();
 
@@ -242,8 +254,8 @@ class GaussBL : public UpdatableComponent {
   int32 num_cepstral_;
   int32 num_fbank_;
   BaseFloat ceplifter_;
-  Matrix<double> dct_mat_;
-  Matrix<double> inv_dct_mat_;
+  MultiFrameCompensator pos_vts_;
+  MultiFrameCompensator neg_vts_;
 
   // noise parameters
   bool compensate_var_;
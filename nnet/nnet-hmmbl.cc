@@ -0,0 +1,121 @@
+// nnet/nnet-hmmbl.cc
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ */
+
+#include "nnet/nnet-hmmbl.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace kaldi {
+
+/*
+ * Stable log( sum_i exp(scores[i]) ), with top_k > 0 only the top_k largest
+ * scores are summed. The scores are reordered.
+ */
+static BaseFloat LogSumExp(BaseFloat *scores, int32 n, int32 top_k) {
+  if (top_k > 0 && top_k < n) {
+    std::nth_element(scores, scores + top_k - 1, scores + n,
+                     std::greater<BaseFloat>());
+    n = top_k;
+  }
+  BaseFloat max = *std::max_element(scores, scores + n);
+  if (max == -std::numeric_limits<BaseFloat>::infinity()) {
+    return max;
+  }
+  double sum = 0.0;
+  for (int32 i = 0; i < n; ++i) {
+    sum += exp(scores[i] - max);
+  }
+  return max + log(sum);
+}
+
+void HMMBL::SetupPdfBlocks() {
+  int32 num_pdf = am_gmm_clean_.NumPdfs();
+
+  pdf_gauss_offset_.resize(num_pdf + 1);
+  pdf_gauss_offset_[0] = 0;
+  for (int32 pdf = 0; pdf < num_pdf; ++pdf) {
+    pdf_gauss_offset_[pdf + 1] = pdf_gauss_offset_[pdf]
+        + am_gmm_clean_.NumGaussInPdf(pdf);
+  }
+  KALDI_ASSERT(pdf_gauss_offset_[num_pdf] == output_dim_);
+
+  // whole pdfs, at most gauss_block_size_ Gaussians unless a single pdf is larger
+  block_pdf_begin_.clear();
+  block_pdf_begin_.push_back(0);
+  for (int32 pdf = 1; pdf < num_pdf; ++pdf) {
+    if (pdf_gauss_offset_[pdf + 1] - pdf_gauss_offset_[block_pdf_begin_.back()]
+        > gauss_block_size_) {
+      block_pdf_begin_.push_back(pdf);
+    }
+  }
+  block_pdf_begin_.push_back(num_pdf);
+
+  // the bias of the pooling includes the log weights of the Gaussians
+  Vector<BaseFloat> bias(bias_cpu_);
+  for (int32 pdf = 0; pdf < num_pdf; ++pdf) {
+    const Vector<BaseFloat> &weights = am_gmm_clean_.GetPdf(pdf).weights();
+    for (int32 g = 0; g < weights.Dim(); ++g) {
+      bias(pdf_gauss_offset_[pdf] + g) += (
+          weights(g) > 0.0 ?
+              log(weights(g)) : -std::numeric_limits<BaseFloat>::infinity());
+    }
+  }
+
+  int32 num_blocks = block_pdf_begin_.size() - 1;
+  block_linearity_.clear();
+  block_bias_.clear();
+  block_linearity_.resize(num_blocks);
+  block_bias_.resize(num_blocks);
+  for (int32 b = 0; b < num_blocks; ++b) {
+    int32 begin = pdf_gauss_offset_[block_pdf_begin_[b]];
+    int32 num_gauss = pdf_gauss_offset_[block_pdf_begin_[b + 1]] - begin;
+    block_linearity_[b].CopyFromMat(linearity_, begin, num_gauss, 0,
+                                    input_dim_);
+    block_bias_[b].CopyFromVec(Vector<BaseFloat>(bias.Range(begin, num_gauss)));
+  }
+}
+
+void HMMBL::PropagatePdfs(const CuMatrix<BaseFloat> &in,
+                          CuMatrix<BaseFloat> *out) {
+  if (input_dim_ != in.NumCols()) {
+    KALDI_ERR<< "Nonmatching dims, component:" << input_dim_ << " data:" << in.NumCols();
+  }
+  if (block_linearity_.empty()) {
+    SetupPdfBlocks();
+  }
+
+  int32 num_frames = in.NumRows();
+  pdf_loglikes_cpu_.Resize(num_frames, am_gmm_clean_.NumPdfs(), kUndefined);
+
+  int32 num_blocks = block_linearity_.size();
+  for (int32 b = 0; b < num_blocks; ++b) {
+    // the Gaussian log-likelihoods of the block, the same as PropagateFnc()
+    block_scores_.Resize(num_frames, block_linearity_[b].NumRows());
+    block_scores_.AddVecToRows(1.0, block_bias_[b], 0.0);
+    block_scores_.AddMatMat(1.0, in, kNoTrans, block_linearity_[b], kTrans,
+                            1.0);
+    block_scores_.CopyToMat(&block_scores_cpu_);
+
+    int32 block_begin = pdf_gauss_offset_[block_pdf_begin_[b]];
+    for (int32 t = 0; t < num_frames; ++t) {
+      BaseFloat *scores = block_scores_cpu_.RowData(t);
+      for (int32 pdf = block_pdf_begin_[b]; pdf < block_pdf_begin_[b + 1];
+          ++pdf) {
+        int32 begin = pdf_gauss_offset_[pdf] - block_begin;
+        int32 num_gauss = pdf_gauss_offset_[pdf + 1] - pdf_gauss_offset_[pdf];
+        pdf_loglikes_cpu_(t, pdf) = LogSumExp(scores + begin, num_gauss,
+                                              top_k_);
+      }
+    }
+  }
+
+  out->CopyFromMat(pdf_loglikes_cpu_);
+}
+
+}  // namespace kaldi
@@ -10,11 +10,15 @@
 #define KALDI_NNET_HMMBL_H
 
 #include "nnet/nnet-component.h"
+#include "nnet/nnet-model-image.h"
 #include "cudamatrix/cu-math.h"
 #include "gmm/am-diag-gmm.h"
 #include "hmm/transition-model.h"
 #include "vts/vts-first-order.h"
 
+#include <sstream>
+#include <vector>
+
 namespace kaldi {
 
 class HMMBL : public UpdatableComponent {
@@ -27,7 +31,9 @@ class HMMBL : public UpdatableComponent {
         bias_corr_(dim_out),
         linearity_cpu_(dim_out, dim_in),
         bias_cpu_(dim_out),
-        apply_exp_(true)
+        apply_exp_(true),
+        gauss_block_size_(8192),
+        top_k_(0)
   {
   }
   ~HMMBL()
@@ -58,6 +64,39 @@ class HMMBL : public UpdatableComponent {
 
   }
 
+  void ReadImageData(const ModelImage &image, const std::string &prefix) {
+    std::string blob;
+    image.GetBlob(prefix + "trans_model", &blob);
+    std::istringstream is(blob);
+    trans_model_.Read(is, true);
+    ReadAmDiagGmmImage(image, prefix + "clean.", &am_gmm_clean_);
+
+    KALDI_ASSERT(input_dim_ == 2 * am_gmm_clean_.Dim());
+    KALDI_ASSERT(output_dim_ == am_gmm_clean_.NumGauss());
+
+    // the weights were converted when the image was written
+    image.CopyToMatrix(prefix + "linearity", &linearity_cpu_);
+    image.CopyToVector(prefix + "bias", &bias_cpu_);
+    linearity_.CopyFromMat(linearity_cpu_);
+    bias_.CopyFromVec(bias_cpu_);
+    block_linearity_.clear();
+  }
+
+  void WriteImageData(ModelImageWriter *writer,
+                      const std::string &prefix) const {
+    std::ostringstream os;
+    trans_model_.Write(os, true);
+    writer->AddBlob(prefix + "trans_model", os.str());
+    WriteAmDiagGmmImage(am_gmm_clean_, prefix + "clean.", writer);
+
+    // linearity_cpu_ may hold the compensated weights, convert again
+    Matrix<BaseFloat> linearity(output_dim_, input_dim_);
+    Vector<BaseFloat> bias(output_dim_);
+    ComputeWeight(am_gmm_clean_, &linearity, &bias);
+    writer->AddMatrix(prefix + "linearity", linearity);
+    writer->AddVector(prefix + "bias", bias);
+  }
+
   void PropagateFnc(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *out) {
     // precopy bias
     out->AddVecToRows(1.0, bias_, 0.0);
@@ -101,6 +140,26 @@ class HMMBL : public UpdatableComponent {
     apply_exp_ = apply_exp;
   }
 
+  int32 NumPdfs() const {
+    return am_gmm_clean_.NumPdfs();
+  }
+
+  /// Options of PropagatePdfs(): the number of Gaussian scores computed at
+  /// a time (whole pdfs, at least one pdf), and the number of best Gaussians
+  /// of each pdf to sum per frame (0 sums all of them)
+  void SetPdfPooling(int32 gauss_block_size, int32 top_k) {
+    KALDI_ASSERT(gauss_block_size > 0 && top_k >= 0);
+    gauss_block_size_ = gauss_block_size;
+    top_k_ = top_k;
+    block_linearity_.clear();
+  }
+
+  /// Per-pdf log-likelihoods log( sum_g c_g * N(x; mu_g, var_g) ) of the
+  /// [x x^2] input, one column per pdf. The Gaussians are scored by blocks
+  /// of pdfs and pooled by a max-shifted log-sum-exp, so only a
+  /// frames x gauss_block_size score matrix exists at a time.
+  void PropagatePdfs(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *out);
+
 protected:
 
   /*
@@ -110,8 +169,20 @@ protected:
    *
    */
   void ConvertWeight(const AmDiagGmm &am_gmm) {
-    gmean_.Resize(am_gmm.Dim());
-    gvar_.Resize(am_gmm.Dim());
+    ComputeWeight(am_gmm, &linearity_cpu_, &bias_cpu_);
+
+    linearity_.CopyFromMat(linearity_cpu_);
+    bias_.CopyFromVec(bias_cpu_);
+    block_linearity_.clear();
+  }
+
+  /// Split the weights into the blocks of PropagatePdfs(), the log
+  /// Gaussian weights are added to the block biases
+  void SetupPdfBlocks();
+
+  void ComputeWeight(const AmDiagGmm &am_gmm, Matrix<BaseFloat> *linearity,
+                     Vector<BaseFloat> *bias) const {
+    Vector<BaseFloat> gmean(am_gmm.Dim()), gvar(am_gmm.Dim());
 
     // initialize the weights, the -0.5 coefficient is ignored
     int32 num_pdf = am_gmm.NumPdfs();
@@ -120,32 +191,29 @@ protected:
     for (int32 pdf = 0; pdf < num_pdf; ++pdf) {
       int32 num_gauss = am_gmm.NumGaussInPdf(pdf);
       for (int32 ga = 0; ga < num_gauss; ++ga) {
-        am_gmm.GetGaussianMean(pdf, ga, &gmean_);
-        am_gmm.GetGaussianVariance(pdf, ga, &gvar_);
+        am_gmm.GetGaussianMean(pdf, ga, &gmean);
+        am_gmm.GetGaussianVariance(pdf, ga, &gvar);
 
-        gvar_.InvertElements();  // 1./ var
+        gvar.InvertElements();  // 1./ var
 
-        (SubVector<BaseFloat>(linearity_cpu_.Row(hid), dim, dim)).CopyFromVec(
-            gvar_);// coeff for x^2: 1./var
+        (SubVector<BaseFloat>(linearity->Row(hid), dim, dim)).CopyFromVec(
+            gvar);// coeff for x^2: 1./var
 
-        (SubVector<BaseFloat>(linearity_cpu_.Row(hid), 0, dim)).CopyFromVec(
-            gvar_);// coeff for x: 1./var
-        (SubVector<BaseFloat>(linearity_cpu_.Row(hid), 0, dim)).MulElements(
-            gmean_);// coeff for x: m./var
-        (SubVector<BaseFloat>(linearity_cpu_.Row(hid), 0, dim)).Scale(-2);// coeff for x: -2*m./var
+        (SubVector<BaseFloat>(linearity->Row(hid), 0, dim)).CopyFromVec(
+            gvar);// coeff for x: 1./var
+        (SubVector<BaseFloat>(linearity->Row(hid), 0, dim)).MulElements(
+            gmean);// coeff for x: m./var
+        (SubVector<BaseFloat>(linearity->Row(hid), 0, dim)).Scale(-2);// coeff for x: -2*m./var
 
-        gmean_.ApplyPow(2.0);
-        gmean_.MulElements(gvar_);// m^2 ./ var
-        bias_cpu_(hid) = gmean_.Sum() + dim * M_LOG_2PI - gvar_.SumLog();
+        gmean.ApplyPow(2.0);
+        gmean.MulElements(gvar);// m^2 ./ var
+        (*bias)(hid) = gmean.Sum() + dim * M_LOG_2PI - gvar.SumLog();
         ++hid;
       }
     }
 
-    linearity_cpu_.Scale(-0.5);
-    bias_cpu_.Scale(-0.5);
-
-    linearity_.CopyFromMat(linearity_cpu_);
-    bias_.CopyFromVec(bias_cpu_);
+    linearity->Scale(-0.5);
+    bias->Scale(-0.5);
   }
 
 protected:
@@ -160,10 +228,20 @@ protected:
 
   Matrix<BaseFloat> linearity_cpu_;
   Vector<BaseFloat> bias_cpu_;
-  Vector<BaseFloat> gmean_, gvar_;
 
   bool apply_exp_; // only with exp, will the conversion equals to the likelihood
 
+  // per-pdf pooling, see PropagatePdfs()
+  int32 gauss_block_size_;
+  int32 top_k_;
+  std::vector<int32> block_pdf_begin_;  ///< first pdf of each block, plus the end
+  std::vector<int32> pdf_gauss_offset_;  ///< first Gaussian of each pdf, plus the end
+  std::vector<CuMatrix<BaseFloat> > block_linearity_;
+  std::vector<CuVector<BaseFloat> > block_bias_;
+  CuMatrix<BaseFloat> block_scores_;
+  Matrix<BaseFloat> block_scores_cpu_;
+  Matrix<BaseFloat> pdf_loglikes_cpu_;
+
 };
 
 }  // namespace
@@ -0,0 +1,86 @@
+// nnet/nnet-label-store.cc
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ */
+
+#include "nnet/nnet-label-store.h"
+
+#include <algorithm>
+
+namespace kaldi {
+
+void LabelStore::Clear() {
+  num_frames_ = 0;
+  wide_ = false;
+  run_start_.clear();
+  label16_.clear();
+  label32_.clear();
+}
+
+void LabelStore::Widen() {
+  label32_.assign(label16_.begin(), label16_.end());
+  label16_.clear();
+  wide_ = true;
+}
+
+void LabelStore::Append(std::vector<int32>::const_iterator begin,
+                        std::vector<int32>::const_iterator end) {
+  for (std::vector<int32>::const_iterator it = begin; it != end;
+      ++it, ++num_frames_) {
+    int32 label = *it;
+    if (!run_start_.empty() && RunLabel(run_start_.size() - 1) == label) {
+      continue;  // extends the last run
+    }
+    KALDI_ASSERT(label >= 0);
+    if (!wide_ && label > 65535) {
+      Widen();
+    }
+    run_start_.push_back(num_frames_);
+    if (wide_) {
+      label32_.push_back(label);
+    } else {
+      label16_.push_back(static_cast<uint16>(label));
+    }
+  }
+}
+
+int32 LabelStore::FindRun(int32 frame) const {
+  KALDI_ASSERT(frame >= 0 && frame < num_frames_);
+  // the last run starting at or before the frame
+  return (std::upper_bound(run_start_.begin(), run_start_.end(), frame)
+      - run_start_.begin()) - 1;
+}
+
+int32 LabelStore::Label(int32 frame) const {
+  return RunLabel(FindRun(frame));
+}
+
+void LabelStore::Gather(const std::vector<int32> &index, int32 offset,
+                        int32 len, std::vector<int32> *out) const {
+  KALDI_ASSERT(offset + len <= static_cast<int32>(index.size()));
+  out->resize(len);
+  for (int32 i = 0; i < len; ++i) {
+    (*out)[i] = Label(index[offset + i]);
+  }
+}
+
+void LabelStore::CopyRange(int32 offset, int32 len,
+                           std::vector<int32> *out) const {
+  KALDI_ASSERT(offset + len <= num_frames_);
+  out->resize(len);
+  if (len == 0) return;
+
+  int32 r = FindRun(offset), num_runs = run_start_.size();
+  for (int32 i = 0; i < len; ++i) {
+    int32 frame = offset + i;
+    while (r + 1 < num_runs && run_start_[r + 1] <= frame) {
+      ++r;
+    }
+    (*out)[i] = RunLabel(r);
+  }
+}
+
+}  // namespace kaldi
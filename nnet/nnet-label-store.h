@@ -0,0 +1,75 @@
+// nnet/nnet-label-store.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Run-length encoded storage of the frame labels in the caches.
+ *
+ * The alignments consist of long runs of the same pdf-id, so the caches
+ * keep only the first frame and the label of each run, and expand the
+ * labels when a bunch is gathered. The run labels are kept as uint16
+ * as long as all the pdf-ids fit in.
+ *
+ */
+
+#ifndef KALDI_NNET_LABEL_STORE_H
+#define KALDI_NNET_LABEL_STORE_H
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+class LabelStore {
+ public:
+  LabelStore() : num_frames_(0), wide_(false) { }
+  ~LabelStore() { }
+
+  /// Remove all the frames, keep the allocated memory
+  void Clear();
+
+  /// Append the labels [begin, end) as new frames
+  void Append(std::vector<int32>::const_iterator begin,
+              std::vector<int32>::const_iterator end);
+
+  /// Number of frames stored
+  int32 NumFrames() const {
+    return num_frames_;
+  }
+  /// Number of runs stored
+  int32 NumRuns() const {
+    return run_start_.size();
+  }
+
+  /// Label of a single frame
+  int32 Label(int32 frame) const;
+
+  /// (*out)[i] = Label(index[offset + i]), for i in [0, len)
+  void Gather(const std::vector<int32> &index, int32 offset, int32 len,
+              std::vector<int32> *out) const;
+
+  /// Labels of the frames [offset, offset + len)
+  void CopyRange(int32 offset, int32 len, std::vector<int32> *out) const;
+
+ private:
+  int32 RunLabel(int32 r) const {
+    return wide_ ? label32_[r] : static_cast<int32>(label16_[r]);
+  }
+  /// Index of the run containing the frame
+  int32 FindRun(int32 frame) const;
+  /// Switch the run labels to int32
+  void Widen();
+
+  int32 num_frames_;
+  bool wide_;  ///< the labels are in label32_ instead of label16_
+
+  std::vector<int32> run_start_;  ///< first frame of each run
+  std::vector<uint16> label16_;
+  std::vector<int32> label32_;
+};
+
+}  // namespace kaldi
+
+#endif
@@ -0,0 +1,118 @@
+// nnet/nnet-lat-prefetch.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Denominator lattice reader for the sequential trainers, which reads and
+ * preprocesses the lattices of the next utterances on background threads
+ * while the network works on the current one.
+ *
+ */
+
+#ifndef KALDI_NNET_LAT_PREFETCH_H
+#define KALDI_NNET_LAT_PREFETCH_H
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "lat/kaldi-lattice.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-semaphore.h"
+
+namespace kaldi {
+
+/**
+ * The preprocessing of a lattice is the same as in the trainers: scale the
+ * acoustic scores by old_acoustic_scale, sort it topologically and get the
+ * times of the states. The rescoring and the forward-backward need the
+ * network outputs, so they stay in the trainer.
+ *
+ * When the features are read from a script (scp:) and prefetch > 0, one
+ * thread reads the lattices in the script order into a ring of 'prefetch'
+ * entries, and num_threads workers preprocess them. Get() must then be
+ * called once for every utterance of the script, in order, so the
+ * utterances are processed and the network updated in the same order as
+ * without prefetching.
+ *
+ * An error reading or preprocessing a lattice on the threads is reported
+ * by Get() of that utterance.
+ *
+ * Otherwise the lattices are read and preprocessed by Get().
+ */
+class LatticePrefetcher {
+ public:
+  enum Status {
+    kOk,
+    kNoLattice,
+    kEmptyLattice
+  };
+
+  LatticePrefetcher(const std::string &feature_rspecifier,
+                    const std::string &lattice_rspecifier,
+                    BaseFloat old_acoustic_scale, int32 prefetch,
+                    int32 num_threads);
+  ~LatticePrefetcher();
+
+  /// The preprocessed lattice of the utterance, with the times of its states,
+  /// returns the number of frames of the lattice in max_time
+  Status Get(const std::string &key, Lattice *lat,
+             std::vector<int32> *state_times, int32 *max_time);
+
+  /// Time the main thread spent waiting for the lattices
+  double WaitTime() const {
+    return wait_time_;
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    Status status;
+    bool cyclic;
+    Lattice lat;
+    std::vector<int32> state_times;
+    int32 max_time;
+    Semaphore *ready;
+    std::string error;  ///< what() of a failed read or preprocessing
+  };
+
+  /// Scale, sort and time the lattice of the entry
+  void Preprocess(Entry *entry) const;
+
+  static void* RunRead(void *arg);
+  static void* RunWorker(void *arg);
+  void Read();
+  void Work();
+  /// Stop the reader and the first num_workers workers, join them
+  /// and release the ring
+  void StopThreads(size_t num_workers);
+
+  RandomAccessLatticeReader lattice_reader_;
+  BaseFloat old_acoustic_scale_;
+  bool prefetching_;
+
+  std::vector<std::string> keys_;  ///< feature order from the script
+
+  std::vector<Entry> ring_;
+  int32 head_;  ///< next utterance to consume, owned by the main thread
+  int32 next_work_;  ///< next utterance to preprocess, guarded by work_mutex_
+  Mutex work_mutex_;
+  Semaphore free_slots_;
+  Semaphore read_slots_;
+  bool stop_;
+
+  pthread_t read_thread_;
+  std::vector<pthread_t> work_threads_;
+
+  double wait_time_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticePrefetcher);
+};
+
+}  // namespace kaldi
+
+#endif
@@ -0,0 +1,251 @@
+// nnet/nnet-lin-batch.cc
+
+#include "nnet/nnet-lin-batch.h"
+#include "cudamatrix/cu-math.h"
+
+#include <algorithm>
+
+namespace kaldi {
+
+LinBatch::LinBatch(const LinBL &lin, Nnet *backend)
+    : lin_(lin),
+      backend_(backend),
+      dim_(lin.InputDim()),
+      momentum_(0.0),
+      l2_penalty_(0.0),
+      l1_penalty_(0.0),
+      average_grad_(false),
+      gathered_(false) {
+  KALDI_ASSERT(lin.InputDim() == lin.OutputDim());
+  if (backend_->LayerCount() == 0) {
+    KALDI_ERR<< "No layers after the <linbl> layer";
+  }
+  if (backend_->InputDim() != dim_) {
+    KALDI_ERR<< "Dimensionality mismatch! LIN:" << dim_
+             << " network input:" << backend_->InputDim();
+  }
+  // only the LINs are trained
+  backend_->SetLearnRate(0.0, NULL);
+}
+
+LinBatch::~LinBatch() {
+  Clear();
+}
+
+void LinBatch::Clear() {
+  for (size_t u = 0; u < feats_.size(); u++) {
+    delete feats_[u];
+  }
+  feats_.clear();
+  alignments_.clear();
+  finished_.clear();
+  gathered_ = false;
+}
+
+void LinBatch::AddUtterance(const CuMatrix<BaseFloat> &feats,
+                            const std::vector<int32> &alignment) {
+  KALDI_ASSERT(feats.NumCols() == dim_);
+  KALDI_ASSERT(feats.NumRows() == static_cast<int32>(alignment.size()));
+  CuMatrix<BaseFloat> *mat = new CuMatrix<BaseFloat>();
+  mat->CopyFromMat(feats);
+  feats_.push_back(mat);
+  alignments_.push_back(alignment);
+  finished_.push_back(false);
+  gathered_ = false;
+}
+
+void LinBatch::Start() {
+  int32 num_utts = NumUtterances();
+  KALDI_ASSERT(num_utts > 0);
+
+  Matrix<BaseFloat> unit(dim_, dim_), lin(num_utts * dim_, dim_);
+  unit.SetUnit();
+  for (int32 u = 0; u < num_utts; u++) {
+    SubMatrix<BaseFloat>(lin, u * dim_, dim_, 0, dim_).CopyFromMat(unit);
+  }
+  linearity_.CopyFromMat(lin);
+  bias_.Resize(num_utts, dim_);
+  bias_.SetZero();
+  linearity_corr_.Resize(num_utts * dim_, dim_);
+  linearity_corr_.SetZero();
+  bias_corr_.Resize(num_utts, dim_);
+  bias_corr_.SetZero();
+
+  // the mask repeated for each LIN
+  if (lin_.GetLinBLType() != 0) {
+    mask_.Resize(num_utts * dim_, dim_);
+    for (int32 u = 0; u < num_utts; u++) {
+      mask_.CopyRowsFromMat(dim_, lin_.GetMask(), 0, u * dim_);
+    }
+  }
+}
+
+void LinBatch::SetLin(int32 u, const Matrix<BaseFloat> &weight) {
+  KALDI_ASSERT(weight.NumRows() == dim_ && weight.NumCols() == dim_);
+  blk_.CopyFromMat(weight);
+  linearity_.CopyRowsFromMat(dim_, blk_, 0, u * dim_);
+}
+
+void LinBatch::SetBias(int32 u, const Vector<BaseFloat> &bias) {
+  KALDI_ASSERT(bias.Dim() == dim_);
+  Matrix<BaseFloat> row(1, dim_);
+  row.CopyRowFromVec(bias, 0);
+  tmp_.CopyFromMat(row);
+  bias_.CopyRowsFromMat(1, tmp_, 0, u);
+}
+
+void LinBatch::GetLin(int32 u, Matrix<BaseFloat> *weight,
+                      Vector<BaseFloat> *bias) const {
+  CuMatrix<BaseFloat> blk;
+  blk.CopyFromMat(linearity_, u * dim_, dim_, 0, dim_);
+  blk.CopyToMat(weight);
+  blk.CopyFromMat(bias_, u, 1, 0, dim_);
+  Matrix<BaseFloat> row;
+  blk.CopyToMat(&row);
+  bias->Resize(dim_);
+  bias->CopyRowFromMat(row, 0);
+}
+
+void LinBatch::Finish(int32 u) {
+  if (!finished_[u]) {
+    finished_[u] = true;
+    gathered_ = false;
+  }
+}
+
+void LinBatch::Gather() {
+  int32 num_utts = NumUtterances();
+  offsets_.resize(num_utts + 1);
+  offsets_[0] = 0;
+  for (int32 u = 0; u < num_utts; u++) {
+    offsets_[u + 1] = offsets_[u] + (finished_[u] ? 0 : NumFrames(u));
+  }
+
+  in_.Resize(offsets_.back(), dim_);
+  target_.resize(offsets_.back());
+  for (int32 u = 0; u < num_utts; u++) {
+    if (finished_[u]) continue;
+    in_.CopyRowsFromMat(NumFrames(u), *feats_[u], 0, offsets_[u]);
+    std::copy(alignments_[u].begin(), alignments_[u].end(),
+              target_.begin() + offsets_[u]);
+  }
+  gathered_ = true;
+}
+
+void LinBatch::Evaluate(std::vector<BaseFloat> *accuracy) {
+  if (!gathered_) Gather();
+  if (offsets_.back() == 0) {
+    KALDI_ERR<< "All the utterances are finished";
+  }
+
+  // block diagonal LIN, then the rest of the network at once
+  lin_out_.Resize(in_.NumRows(), dim_);
+  cu::SegmentAffine(in_, offsets_, linearity_, bias_, &lin_out_);
+  backend_->Propagate(lin_out_, &nnet_out_);
+
+  xent_.Reset();
+  xent_.EvalVec(nnet_out_, target_, &nnet_err_);
+  xent_.GetSegmentAccuracies(target_, offsets_, accuracy);
+}
+
+void LinBatch::Update(const std::vector<BaseFloat> &learn_rate) {
+  int32 num_utts = NumUtterances();
+  KALDI_ASSERT(static_cast<int32>(learn_rate.size()) == num_utts);
+  KALDI_ASSERT(nnet_err_.NumRows() == in_.NumRows());
+
+  // error at the LIN output, the backend is not updated
+  backend_->Backpropagate(nnet_err_, &lin_err_);
+
+  // compute gradient
+  std::vector<BaseFloat> scale(num_utts, 1.0);
+  for (int32 u = 0; u < num_utts; u++) {
+    int32 frames = offsets_[u + 1] - offsets_[u];
+    if (average_grad_ && frames > 0) scale[u] = 1.0 / frames;
+  }
+  cu::SegmentAffineGrad(in_, lin_err_, offsets_, scale, momentum_,
+                        &linearity_corr_, &bias_corr_);
+
+  // learning rate of each row of the stacked LINs, 0 for the finished ones
+  Vector<BaseFloat> rate_rows(num_utts * dim_), rate_utts(num_utts);
+  for (int32 u = 0; u < num_utts; u++) {
+    rate_utts(u) = (finished_[u] ? 0.0 : learn_rate[u]);
+    SubVector<BaseFloat>(rate_rows, u * dim_, dim_).Set(rate_utts(u));
+  }
+  CuVector<BaseFloat> rates;
+
+  // l2 regularization
+  if (l2_penalty_ != 0.0) {
+    Vector<BaseFloat> decay_rows(num_utts * dim_);
+    for (int32 u = 0; u < num_utts; u++) {
+      int32 frames = offsets_[u + 1] - offsets_[u];
+      SubVector<BaseFloat>(decay_rows, u * dim_, dim_).Set(
+          1.0 - rate_utts(u) * l2_penalty_ * frames);
+    }
+    rates.CopyFromVec(decay_rows);
+    linearity_.MulRowsVec(rates);
+  }
+  // l1 regularization
+  if (l1_penalty_ != 0.0) {
+    for (int32 u = 0; u < num_utts; u++) {
+      if (finished_[u]) continue;
+      int32 frames = offsets_[u + 1] - offsets_[u];
+      BaseFloat l1 = learn_rate[u] * frames * l1_penalty_;
+      blk_.CopyFromMat(linearity_, u * dim_, dim_, 0, dim_);
+      blk_corr_.CopyFromMat(linearity_corr_, u * dim_, dim_, 0, dim_);
+      cu::RegularizeL1(&blk_, &blk_corr_, l1, learn_rate[u]);
+      linearity_.CopyRowsFromMat(dim_, blk_, 0, u * dim_);
+      linearity_corr_.CopyRowsFromMat(dim_, blk_corr_, 0, u * dim_);
+    }
+  }
+  // update
+  rates.CopyFromVec(rate_rows);
+  tmp_.CopyFromMat(linearity_corr_);
+  tmp_.MulRowsVec(rates);
+  linearity_.AddMat(-1.0, tmp_);
+  rates.CopyFromVec(rate_utts);
+  tmp_.CopyFromMat(bias_corr_);
+  tmp_.MulRowsVec(rates);
+  bias_.AddMat(-1.0, tmp_);
+
+  Constrain();
+}
+
+void LinBatch::Constrain() {
+  switch (lin_.GetLinBLType()) {
+    case 0: /* standard BL, no constraints */
+      break;
+    case 1: /* diagonal BL */
+    case 2: /* block diagonal BL */
+      linearity_.MulElements(mask_);
+      break;
+    case 3: { /* constrained block diagonal BL */
+      linearity_.MulElements(mask_);
+      /* average the blocks of each LIN */
+      Matrix<BaseFloat> lin, bias;
+      linearity_.CopyToMat(&lin);
+      bias_.CopyToMat(&bias);
+      for (int32 u = 0; u < NumUtterances(); u++) {
+        if (finished_[u]) continue;
+        SubMatrix<BaseFloat> lin_u(lin, u * dim_, dim_, 0, dim_);
+        SubVector<BaseFloat> bias_u(bias, u);
+        lin_.AverageBlocks(&lin_u, &bias_u);
+      }
+      linearity_.CopyFromMat(lin);
+      bias_.CopyFromMat(bias);
+      break;
+    }
+  }
+}
+
+void LinBatch::Backup() {
+  linearity_backup_.CopyFromMat(linearity_);
+  bias_backup_.CopyFromMat(bias_);
+}
+
+void LinBatch::Restore(int32 u) {
+  KALDI_ASSERT(linearity_backup_.NumRows() == linearity_.NumRows());
+  linearity_.CopyRowsFromMat(dim_, linearity_backup_, u * dim_, u * dim_);
+  bias_.CopyRowsFromMat(1, bias_backup_, u, u);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,128 @@
+// nnet/nnet-lin-batch.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Training of the per-utterance LINs of several utterances at once.
+ *
+ * The LIN of each utterance is a block of the stacked weight matrix (and a
+ * row of the stacked bias matrix). The frames of the utterances are
+ * concatenated: the LIN forward is block diagonal, one GEMM per utterance
+ * (cu::SegmentAffine), and the rest of the network, which is not trained,
+ * is propagated once for all of them. The gradients are computed per
+ * utterance (cu::SegmentAffineGrad), each utterance has its own learning
+ * rate. A finished utterance, e.g. stopped early, is taken out of the
+ * following passes.
+ *
+ */
+
+#ifndef KALDI_NNET_LIN_BATCH_H
+#define KALDI_NNET_LIN_BATCH_H
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "cudamatrix/cu-matrix.h"
+#include "nnet/nnet-nnet.h"
+#include "nnet/nnet-loss.h"
+#include "nnet/nnet-linbl.h"
+
+namespace kaldi {
+
+class LinBatch {
+ public:
+  /// The LINs have the type and the dims of lin, backend is the rest of
+  /// the network (its learning rate is set to 0)
+  LinBatch(const LinBL &lin, Nnet *backend);
+  ~LinBatch();
+
+  void SetMomentum(BaseFloat mmt) {
+    momentum_ = mmt;
+  }
+  void SetL2Penalty(BaseFloat l2) {
+    l2_penalty_ = l2;
+  }
+  void SetL1Penalty(BaseFloat l1) {
+    l1_penalty_ = l1;
+  }
+  void SetAverageGrad(bool flag) {
+    average_grad_ = flag;
+  }
+
+  /// Remove all the utterances
+  void Clear();
+  /// Add an utterance, features (after the feature transform) and alignment
+  void AddUtterance(const CuMatrix<BaseFloat> &feats,
+                    const std::vector<int32> &alignment);
+  /// Set all the LINs to identity, after the last AddUtterance
+  void Start();
+
+  int32 NumUtterances() const {
+    return feats_.size();
+  }
+  int32 NumFrames(int32 u) const {
+    return feats_[u]->NumRows();
+  }
+
+  /// Set/get the LIN of an utterance
+  void SetLin(int32 u, const Matrix<BaseFloat> &weight);
+  void SetBias(int32 u, const Vector<BaseFloat> &bias);
+  void GetLin(int32 u, Matrix<BaseFloat> *weight, Vector<BaseFloat> *bias) const;
+
+  /// Take an utterance out of the following passes
+  void Finish(int32 u);
+  bool Finished(int32 u) const {
+    return finished_[u];
+  }
+
+  /// Propagate the frames of the unfinished utterances and get the frame
+  /// accuracy of each (0 for the finished ones), keeps the error for Update
+  void Evaluate(std::vector<BaseFloat> *accuracy);
+  /// Update the unfinished LINs from the error of the last Evaluate,
+  /// with a learning rate per utterance
+  void Update(const std::vector<BaseFloat> &learn_rate);
+
+  /// Keep a copy of the current LINs
+  void Backup();
+  /// Go back to the copy of the LIN of an utterance
+  void Restore(int32 u);
+
+ private:
+  /// Concatenate the frames and the targets of the unfinished utterances
+  void Gather();
+  /// Apply the constraint of the LIN type to the unfinished LINs
+  void Constrain();
+
+  const LinBL &lin_;
+  Nnet *backend_;
+  int32 dim_;
+
+  BaseFloat momentum_, l2_penalty_, l1_penalty_;
+  bool average_grad_;
+
+  std::vector<CuMatrix<BaseFloat>*> feats_;
+  std::vector<std::vector<int32> > alignments_;
+  std::vector<bool> finished_;
+
+  /// frames of the unfinished utterances, the finished ones are empty
+  /// segments
+  bool gathered_;
+  std::vector<int32> offsets_;
+  std::vector<int32> target_;
+  CuMatrix<BaseFloat> in_;
+
+  /// the LINs, (#utterances * dim) x dim and #utterances x dim
+  CuMatrix<BaseFloat> linearity_, bias_;
+  CuMatrix<BaseFloat> linearity_corr_, bias_corr_;
+  CuMatrix<BaseFloat> linearity_backup_, bias_backup_;
+  CuMatrix<BaseFloat> mask_;
+
+  CuMatrix<BaseFloat> lin_out_, nnet_out_, nnet_err_, lin_err_;
+  CuMatrix<BaseFloat> tmp_, blk_, blk_corr_;
+  Xent xent_;
+};
+
+}  // namespace kaldi
+
+#endif
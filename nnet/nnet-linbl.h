@@ -131,32 +131,44 @@ class LinBL : public BiasedLinearity {
         /* average the blocks */
         linearity_.CopyToMat(&linearity_cpu_);
         bias_.CopyToVec(&bias_cpu_);
-        SubMatrix<BaseFloat> blk0(linearity_cpu_, 0, blk_dim_, 0, blk_dim_);
-        SubVector<BaseFloat> vec0(bias_cpu_, 0, blk_dim_);
-        int32 offset;
-        for (int32 i = 1; i < num_blks_; ++i) {
-          offset = i * blk_dim_;
-          blk0.AddMat(
-              1.0,
-              SubMatrix<BaseFloat>(linearity_cpu_, offset, blk_dim_, offset,
-                                   blk_dim_));
-          vec0.AddVec(1.0, SubVector<BaseFloat>(bias_cpu_, offset, blk_dim_));
-        }
-        blk0.Scale(1.0 / num_blks_);
-        vec0.Scale(1.0 / num_blks_);
-        /* copy back */
-        for (int32 i = 1; i < num_blks_; ++i) {
-          offset = i * blk_dim_;
-          (SubMatrix<BaseFloat>(linearity_cpu_, offset, blk_dim_, offset,
-                                blk_dim_)).CopyFromMat(blk0);
-          (SubVector<BaseFloat>(bias_cpu_, offset, blk_dim_)).CopyFromVec(vec0);
-        }
+        AverageBlocks(&linearity_cpu_, &bias_cpu_);
         linearity_.CopyFromMat(linearity_cpu_);
         bias_.CopyFromVec(bias_cpu_);
         break;
     }
   }
 
+  /// Sets all the diagonal blocks (and the bias blocks) to their average,
+  /// the constraint of type 3
+  void AverageBlocks(MatrixBase<BaseFloat> *linearity,
+                     VectorBase<BaseFloat> *bias) const {
+    SubMatrix<BaseFloat> blk0(*linearity, 0, blk_dim_, 0, blk_dim_);
+    SubVector<BaseFloat> vec0(*bias, 0, blk_dim_);
+    int32 offset;
+    for (int32 i = 1; i < num_blks_; ++i) {
+      offset = i * blk_dim_;
+      blk0.AddMat(
+          1.0,
+          SubMatrix<BaseFloat>(*linearity, offset, blk_dim_, offset,
+                               blk_dim_));
+      vec0.AddVec(1.0, SubVector<BaseFloat>(*bias, offset, blk_dim_));
+    }
+    blk0.Scale(1.0 / num_blks_);
+    vec0.Scale(1.0 / num_blks_);
+    /* copy back */
+    for (int32 i = 1; i < num_blks_; ++i) {
+      offset = i * blk_dim_;
+      (SubMatrix<BaseFloat>(*linearity, offset, blk_dim_, offset,
+                            blk_dim_)).CopyFromMat(blk0);
+      (SubVector<BaseFloat>(*bias, offset, blk_dim_)).CopyFromVec(vec0);
+    }
+  }
+
+  /// Mask of the non-zero weights of types 1, 2 and 3
+  const CuMatrix<BaseFloat>& GetMask() const {
+    return mask_;
+  }
+
   /*
    * This function is used to tying the weights between different layers
    */
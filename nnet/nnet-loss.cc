@@ -24,6 +24,11 @@
 
 namespace kaldi {
 
+// The per-frame losses are summed in single precision on the device,
+// they are folded into the double host accumulators every this many bunches
+// so the float sums do not lose the small losses of a long epoch.
+static const int32 kLossSyncBunches = 64;
+
 
 void Xent::Eval(const CuMatrix<BaseFloat> &net_out, const CuMatrix<BaseFloat> &target, CuMatrix<BaseFloat> *diff) {
   
@@ -57,14 +62,9 @@ void Xent::Eval(const CuMatrix<BaseFloat> &net_out, const CuMatrix<BaseFloat> &t
 
 
 void Xent::EvalVec(const CuMatrix<BaseFloat> &net_out, const std::vector<int32> &target, CuMatrix<BaseFloat> *diff) {
-  // evaluate the frame-level classification
-  int32 correct=0;
+  KALDI_ASSERT(net_out.NumRows() == target.size());
+  // find the frame-level classification
   cu::FindRowMaxId(net_out, &max_id_);
-  max_id_.CopyToVec(&max_id_host_);
-  KALDI_ASSERT(max_id_host_.size() == target.size());
-  for(int32 i=0; i<target.size(); i++) {
-    if (target[i] == max_id_host_[i]) correct++;
-  }
   
   // get the xentropy and global error 
   target_device_.CopyFromVec(target);
@@ -84,17 +84,36 @@ void Xent::EvalVec(const CuMatrix<BaseFloat> &net_out, const std::vector<int32>
   // log(sum_row(net_out.*target_mat)))
   // they now are stored in vector log_post_tgt_
   // 
-  log_post_tgt_.CopyToVec(&log_post_tgt_host_);
-  loss_    -= log_post_tgt_host_.Sum();
-  
-  // accumulate error quantites
+  // accumulate error quantites on the device, 
+  // they are downloaded only for the report
+  if (frame_loss_.Dim() < target.size()) {
+    SyncStats();
+    frame_loss_.Resize(target.size());
+    frame_correct_.Resize(target.size());
+  }
+  cu::AddXentStats(target_device_, max_id_, log_post_tgt_, &frame_loss_, &frame_correct_);
   frames_  += net_out.NumRows();
-  correct_ += correct;
+  if (++bunches_ >= kLossSyncBunches) {
+    SyncStats();
+  }
    
 }
 
 
+void Xent::SyncStats() {
+  bunches_ = 0;
+  if (frame_loss_.Dim() == 0) return;
+  frame_loss_.CopyToVec(&frame_stats_host_);
+  loss_ += frame_stats_host_.Sum();
+  frame_correct_.CopyToVec(&frame_stats_host_);
+  correct_ += static_cast<int32>(frame_stats_host_.Sum() + 0.5);
+  frame_loss_.SetZero();
+  frame_correct_.SetZero();
+}
+
+
 std::string Xent::Report() {
+  SyncStats();
   std::ostringstream oss;
   oss << "Xent:" << loss_ << " frames:" << frames_ 
       << " err/frm:" << loss_/frames_;
@@ -108,9 +127,15 @@ void Xent::Reset() {
   frames_=0;
   correct_=0;
   loss_=0.0;
+  bunches_=0;
+  if (frame_loss_.Dim() > 0) {
+    frame_loss_.SetZero();
+    frame_correct_.SetZero();
+  }
 }
 
 BaseFloat Xent::GetFrameAccuracy(){
+  SyncStats();
   if (frames_ <= 0){
     KALDI_ERR << "Incorrect number of frames have been seen: " << frames_;
   }
@@ -118,6 +143,24 @@ BaseFloat Xent::GetFrameAccuracy(){
   return 100.0*correct_/frames_;
 }
 
+void Xent::GetSegmentAccuracies(const std::vector<int32> &target,
+                                const std::vector<int32> &offsets,
+                                std::vector<BaseFloat> *accuracy) {
+  KALDI_ASSERT(offsets.size() > 0 && offsets.back() == max_id_.Dim());
+  KALDI_ASSERT(static_cast<int32>(target.size()) == max_id_.Dim());
+  max_id_.CopyToVec(&max_id_host_);
+
+  accuracy->resize(offsets.size() - 1);
+  for (size_t s = 0; s + 1 < offsets.size(); s++) {
+    int32 correct = 0;
+    for (int32 t = offsets[s]; t < offsets[s+1]; t++) {
+      if (max_id_host_[t] == target[t]) correct++;
+    }
+    int32 frames = offsets[s+1] - offsets[s];
+    (*accuracy)[s] = (frames > 0 ? 100.0*correct/frames : 0.0);
+  }
+}
+
 
 
 void Mse::Eval(const CuMatrix<BaseFloat> &net_out, const CuMatrix<BaseFloat> &target, CuMatrix<BaseFloat> *diff) {
@@ -126,27 +169,31 @@ void Mse::Eval(const CuMatrix<BaseFloat> &net_out, const CuMatrix<BaseFloat> &ta
   diff->Resize(net_out.NumRows(), net_out.NumCols());
 
   // compute derivative w.r.t. neural nerwork outputs
-  diff->CopyFromMat(net_out);
-  diff->AddMat(-1.0, target);
-
-  // compute the per-frame MSE stats
-  diff_pow_2_.Resize(diff->NumRows(), diff->NumCols());
-  diff_pow_2_.CopyFromMat(*diff);
-  diff_pow_2_.MulElements(diff_pow_2_); //grid-like operation
-  // at this point we have computed 'diff_pow_2'
-  // now sum each row (device)
-  sum_diff_pow_2_.Resize(diff_pow_2_.NumRows());
-  sum_diff_pow_2_.AddColSumMat(1.0,diff_pow_2_,0.0); //tree-like reduction
-  // now sum the per-frame MSE (host)
-  sum_diff_pow_2_host_.Resize(sum_diff_pow_2_.Dim());
-  sum_diff_pow_2_.CopyToVec(&sum_diff_pow_2_host_);
-  // accumulate
-  loss_ += 0.5 * sum_diff_pow_2_host_.Sum();
+  // and accumulate the per-frame MSE stats on the device (single kernel),
+  // they are downloaded only for the report
+  if (frame_loss_.Dim() < net_out.NumRows()) {
+    SyncLoss();
+    frame_loss_.Resize(net_out.NumRows());
+  }
+  cu::DiffMse(net_out, target, diff, &frame_loss_);
   frames_ += net_out.NumRows();
+  if (++bunches_ >= kLossSyncBunches) {
+    SyncLoss();
+  }
+}
+
+
+void Mse::SyncLoss() {
+  bunches_ = 0;
+  if (frame_loss_.Dim() == 0) return;
+  frame_loss_.CopyToVec(&frame_loss_host_);
+  loss_ += frame_loss_host_.Sum();
+  frame_loss_.SetZero();
 }
 
 
 std::string Mse::Report() {
+  SyncLoss();
   std::ostringstream oss;
   oss << "Mse:" << loss_ << " frames:" << frames_
       << " err/frm:" << loss_/frames_ 
@@ -163,25 +210,25 @@ void MseProgress::Eval(const CuMatrix<BaseFloat>& net_out, const CuMatrix<BaseFl
   diff->Resize(net_out.NumRows(),net_out.NumCols());
 
   //compute derivative w.r.t. neural nerwork outputs
-  diff->CopyFromMat(net_out);
-  diff->AddMat(-1.0,target);
-
-  // compute the per-frame MSE stats
-  diff_pow_2_.Resize(diff->NumRows(), diff->NumCols());
-  diff_pow_2_.CopyFromMat(*diff);
-  diff_pow_2_.MulElements(diff_pow_2_); //grid-like operation
-  // at this point we have computed 'diff_pow_2'
-  // now sum each row (device)
-  sum_diff_pow_2_.Resize(diff_pow_2_.NumRows());
-  sum_diff_pow_2_.AddColSumMat(1.0,diff_pow_2_,0.0); //tree-like reduction
-  // now sum the per-frame MSE (host)
-  sum_diff_pow_2_host_.Resize(sum_diff_pow_2_.Dim());
-  sum_diff_pow_2_.CopyToVec(&sum_diff_pow_2_host_);
-  // accumulate progress statistics
-  loss_progress_ += 0.5 * sum_diff_pow_2_host_.Sum();
+  //and accumulate the per-frame MSE stats on the device (single kernel)
+  if (frame_loss_.Dim() < net_out.NumRows()) {
+    if (frame_loss_.Dim() > 0) {
+      frame_loss_.CopyToVec(&frame_loss_host_);
+      loss_progress_ += frame_loss_host_.Sum();
+    }
+    frame_loss_.Resize(net_out.NumRows());
+  }
+  cu::DiffMse(net_out, target, diff, &frame_loss_);
   frames_progress_ += net_out.NumRows();
 
-  // monitor progress per progress_step_ frames
+  // monitor progress per progress_step_ frames,
+  // the loss is downloaded only here and every kLossSyncBunches bunches
+  if(++bunches_ >= kLossSyncBunches || frames_progress_ > progress_step_) {
+    frame_loss_.CopyToVec(&frame_loss_host_);
+    loss_progress_ += frame_loss_host_.Sum();
+    frame_loss_.SetZero();
+    bunches_ = 0;
+  }
   if(frames_progress_ > progress_step_) {
     float loss_of_step = loss_progress_/frames_progress_;
     loss_vec_.push_back(loss_of_step);
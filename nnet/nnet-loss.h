@@ -27,7 +27,7 @@ namespace kaldi {
 
 class Xent {
  public:
-  Xent() : frames_(0), correct_(0), loss_(0.0) { }
+  Xent() : frames_(0), correct_(0), loss_(0.0), bunches_(0) { }
   ~Xent() { }
 
   /// Evaluate cross entropy from hard labels
@@ -44,18 +44,33 @@ class Xent {
   void Reset();
   /// Return the current frame accuracy
   BaseFloat GetFrameAccuracy();
+  /// Frame accuracy of each segment [offsets[s], offsets[s+1]) of the frames
+  /// of the last EvalVec (0 for the empty segments)
+  void GetSegmentAccuracies(const std::vector<int32> &target,
+                            const std::vector<int32> &offsets,
+                            std::vector<BaseFloat> *accuracy);
 
  private:
+  /// Download the per-frame statistics accumulated by EvalVec,
+  /// add them to loss_ and correct_ and zero them
+  void SyncStats();
+
   int32 frames_;
   int32 correct_;
   double loss_;
+  int32 bunches_;  ///< bunches summed in frame_loss_ since the last sync
  
   CuStlVector<int32> max_id_;
   std::vector<int32> max_id_host_;
 
   CuStlVector<int32>  target_device_;
   CuVector<BaseFloat> log_post_tgt_;
-  Vector<BaseFloat>   log_post_tgt_host_;
+
+  // per-frame xentropy and correct classifications, summed over at most
+  // kLossSyncBunches bunches before they are folded into loss_/correct_
+  CuVector<BaseFloat> frame_loss_;
+  CuVector<BaseFloat> frame_correct_;
+  Vector<BaseFloat>   frame_stats_host_;
 
 };
 
@@ -63,7 +78,7 @@ class Xent {
 
 class Mse {
  public:
-  Mse() : frames_(0), loss_(0.0) { }
+  Mse() : frames_(0), loss_(0.0), bunches_(0) { }
   ~Mse() { }
 
   /// Evaluate mean square error from target values
@@ -74,12 +89,16 @@ class Mse {
   std::string Report();
 
  private:
+  /// Download the per-frame loss, add it to loss_ and zero it
+  void SyncLoss();
+
   int32 frames_;
   double loss_;
+  int32 bunches_;  ///< bunches summed in frame_loss_ since the last sync
 
-  CuMatrix<BaseFloat> diff_pow_2_;
-  CuVector<BaseFloat> sum_diff_pow_2_;
-  Vector<BaseFloat>   sum_diff_pow_2_host_;
+  // per-frame loss, summed over at most kLossSyncBunches bunches
+  CuVector<BaseFloat> frame_loss_;
+  Vector<BaseFloat>   frame_loss_host_;
 
 };
 
@@ -90,7 +109,7 @@ class MseProgress {
   MseProgress(int32 progress_step = 1e6) 
    : progress_step_(progress_step), progress_ctr_(0), 
      frames_(0), frames_progress_(0), 
-     loss_(0.0), loss_progress_(0)
+     loss_(0.0), loss_progress_(0), bunches_(0)
    { }
   ~MseProgress() { }
 
@@ -110,12 +129,14 @@ class MseProgress {
 
   double loss_;
   double loss_progress_;
+  int32 bunches_;  ///< bunches summed in frame_loss_ since the last sync
 
   std::vector<float> loss_vec_;
 
-  CuMatrix<BaseFloat> diff_pow_2_;
-  CuVector<BaseFloat> sum_diff_pow_2_;
-  Vector<BaseFloat>   sum_diff_pow_2_host_;
+  // per-frame loss, summed over at most kLossSyncBunches bunches
+  // of the progress chunk
+  CuVector<BaseFloat> frame_loss_;
+  Vector<BaseFloat>   frame_loss_host_;
 
 };
 
@@ -0,0 +1,445 @@
+// nnet/nnet-model-image.cc
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ */
+
+#include "nnet/nnet-model-image.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "util/kaldi-io.h"
+#include "cudamatrix/cu-common.h"
+#include "cudamatrix/cu-device.h"
+
+namespace kaldi {
+
+namespace {
+
+struct ImageHeader {
+  char magic[8];
+  uint32 version;
+  uint32 real_size;
+  uint32 num_sections;
+  uint32 reserved;
+  uint64 table_offset;
+};
+
+template<typename Real> struct KindOf;
+template<> struct KindOf<float> {
+  static const ModelImage::SectionKind value = ModelImage::kFloatSection;
+};
+template<> struct KindOf<double> {
+  static const ModelImage::SectionKind value = ModelImage::kDoubleSection;
+};
+
+size_t AlignUp(size_t offset) {
+  return (offset + ModelImage::kAlignment - 1) / ModelImage::kAlignment
+      * ModelImage::kAlignment;
+}
+
+}  // namespace
+
+const char ModelImage::kMagic[8] = { 'K', 'N', 'N', 'I', 'M', 'A', 'G', 'E' };
+
+ModelImage::ModelImage(const std::string &filename)
+    : filename_(filename),
+      fd_(-1),
+      data_(NULL),
+      size_(0) {
+  try {
+    Open();
+  } catch (...) {
+    // the destructor does not run when the constructor throws
+    Close();
+    throw;
+  }
+}
+
+ModelImage::~ModelImage() {
+  Close();
+}
+
+void ModelImage::Open() {
+  fd_ = open(filename_.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    KALDI_ERR << "Could not open the model image " << filename_;
+  }
+  struct stat st;
+  if (fstat(fd_, &st) != 0 || st.st_size < (off_t) sizeof(ImageHeader)) {
+    KALDI_ERR << "Model image " << filename_ << " is truncated";
+  }
+  size_ = st.st_size;
+  void *addr = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (addr == MAP_FAILED) {
+    KALDI_ERR << "Could not map the model image " << filename_;
+  }
+  data_ = static_cast<char*>(addr);
+
+  const ImageHeader *header = reinterpret_cast<const ImageHeader*>(data_);
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0) {
+    KALDI_ERR << filename_ << " is not a model image";
+  }
+  if (header->version != kVersion) {
+    KALDI_ERR << "Model image " << filename_ << " has version "
+        << header->version << ", expected " << kVersion;
+  }
+  if (header->real_size != sizeof(BaseFloat)) {
+    KALDI_ERR << "Model image " << filename_ << " was written with "
+        << header->real_size << " byte floats, this build uses "
+        << sizeof(BaseFloat);
+  }
+  if (header->table_offset + header->num_sections * sizeof(SectionEntry)
+      > size_) {
+    KALDI_ERR << "Model image " << filename_ << " is truncated";
+  }
+
+  const SectionEntry *table = reinterpret_cast<const SectionEntry*>(data_
+      + header->table_offset);
+  for (uint32 i = 0; i < header->num_sections; ++i) {
+    if (table[i].offset + table[i].size > size_) {
+      KALDI_ERR << "Section " << table[i].name << " of " << filename_
+          << " is out of the file";
+    }
+    index_[std::string(table[i].name)] = &table[i];
+  }
+}
+
+void ModelImage::Close() {
+  if (data_ != NULL) {
+    munmap(data_, size_);
+    data_ = NULL;
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  index_.clear();
+}
+
+bool ModelImage::IsImage(const std::string &filename) {
+  if (ClassifyRxfilename(filename) != kFileInput) {
+    return false;
+  }
+  FILE *fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL) {
+    return false;
+  }
+  char magic[sizeof(kMagic)];
+  bool is_image = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)
+      && memcmp(magic, kMagic, sizeof(kMagic)) == 0);
+  fclose(fp);
+  return is_image;
+}
+
+const ModelImage::SectionEntry& ModelImage::Find(const std::string &name,
+                                                 SectionKind kind) const {
+  std::map<std::string, const SectionEntry*>::const_iterator it = index_.find(
+      name);
+  if (it == index_.end()) {
+    KALDI_ERR << "No section " << name << " in the model image " << filename_;
+  }
+  if (it->second->kind != static_cast<uint32>(kind)) {
+    KALDI_ERR << "Section " << name << " of " << filename_
+        << " has kind " << it->second->kind << ", expected " << kind;
+  }
+  return *(it->second);
+}
+
+const void* ModelImage::Data(const std::string &name, SectionKind kind,
+                             int32 *rows, int32 *cols) const {
+  const SectionEntry &entry = Find(name, kind);
+  *rows = entry.rows;
+  *cols = entry.cols;
+  return data_ + entry.offset;
+}
+
+template<typename Real>
+void ModelImage::CopyToMatrix(const std::string &name,
+                              Matrix<Real> *mat) const {
+  int32 rows, cols;
+  const Real *src = static_cast<const Real*>(Data(name, KindOf<Real>::value,
+                                                  &rows, &cols));
+  mat->Resize(rows, cols, kUndefined);
+  for (int32 r = 0; r < rows; ++r, src += cols) {
+    memcpy(mat->RowData(r), src, cols * sizeof(Real));
+  }
+}
+
+template<typename Real>
+void ModelImage::CopyToVector(const std::string &name,
+                              Vector<Real> *vec) const {
+  int32 rows, cols;
+  const Real *src = static_cast<const Real*>(Data(name, KindOf<Real>::value,
+                                                  &rows, &cols));
+  KALDI_ASSERT(rows == 1);
+  vec->Resize(cols, kUndefined);
+  memcpy(vec->Data(), src, cols * sizeof(Real));
+}
+
+template
+void ModelImage::CopyToMatrix(const std::string &name,
+                              Matrix<float> *mat) const;
+template
+void ModelImage::CopyToMatrix(const std::string &name,
+                              Matrix<double> *mat) const;
+template
+void ModelImage::CopyToVector(const std::string &name,
+                              Vector<float> *vec) const;
+template
+void ModelImage::CopyToVector(const std::string &name,
+                              Vector<double> *vec) const;
+
+void ModelImage::CopyToCuMatrix(const std::string &name,
+                                CuMatrix<BaseFloat> *mat) const {
+  int32 rows, cols;
+  const BaseFloat *src = static_cast<const BaseFloat*>(Data(
+      name, KindOf<BaseFloat>::value, &rows, &cols));
+  mat->Resize(rows, cols);
+
+#if HAVE_CUDA==1
+  if (CuDevice::Instantiate().Enabled()) {
+    cuSafeCall(cudaMemcpy2D(mat->Data(), mat->Stride() * sizeof(BaseFloat),
+                            src, cols * sizeof(BaseFloat),
+                            cols * sizeof(BaseFloat), rows,
+                            cudaMemcpyHostToDevice));
+  } else
+#endif
+  {
+    MatrixBase<BaseFloat> &dst = mat->Mat();
+    for (int32 r = 0; r < rows; ++r, src += cols) {
+      memcpy(dst.RowData(r), src, cols * sizeof(BaseFloat));
+    }
+  }
+}
+
+void ModelImage::CopyToCuVector(const std::string &name,
+                                CuVector<BaseFloat> *vec) const {
+  int32 rows, cols;
+  const BaseFloat *src = static_cast<const BaseFloat*>(Data(
+      name, KindOf<BaseFloat>::value, &rows, &cols));
+  KALDI_ASSERT(rows == 1);
+  vec->Resize(cols);
+
+#if HAVE_CUDA==1
+  if (CuDevice::Instantiate().Enabled()) {
+    cuSafeCall(cudaMemcpy(vec->Data(), src, cols * sizeof(BaseFloat),
+                          cudaMemcpyHostToDevice));
+  } else
+#endif
+  {
+    memcpy(vec->Vec().Data(), src, cols * sizeof(BaseFloat));
+  }
+}
+
+void ModelImage::GetInt32s(const std::string &name,
+                           std::vector<int32> *vals) const {
+  const SectionEntry &entry = Find(name, kInt32Section);
+  const int32 *src = reinterpret_cast<const int32*>(data_ + entry.offset);
+  vals->assign(src, src + entry.cols);
+}
+
+void ModelImage::GetBlob(const std::string &name, std::string *blob) const {
+  const SectionEntry &entry = Find(name, kBlobSection);
+  blob->assign(data_ + entry.offset, entry.size);
+}
+
+ModelImageWriter::Section* ModelImageWriter::NewSection(
+    const std::string &name, ModelImage::SectionKind kind, int32 rows,
+    int32 cols, size_t bytes) {
+  if (name.size() >= sizeof(((ModelImage::SectionEntry*) 0)->name)) {
+    KALDI_ERR << "Section name too long: " << name;
+  }
+  sections_.resize(sections_.size() + 1);
+  Section *sec = &sections_.back();
+  sec->name = name;
+  sec->kind = kind;
+  sec->rows = rows;
+  sec->cols = cols;
+  sec->data.resize(bytes);
+  return sec;
+}
+
+template<typename Real>
+void ModelImageWriter::AddMatrix(const std::string &name,
+                                 const MatrixBase<Real> &mat) {
+  size_t row_bytes = mat.NumCols() * sizeof(Real);
+  Section *sec = NewSection(name, KindOf<Real>::value, mat.NumRows(),
+                            mat.NumCols(), mat.NumRows() * row_bytes);
+  for (MatrixIndexT r = 0; r < mat.NumRows(); ++r) {
+    memcpy(&sec->data[r * row_bytes], mat.RowData(r), row_bytes);
+  }
+}
+
+template<typename Real>
+void ModelImageWriter::AddVector(const std::string &name,
+                                 const VectorBase<Real> &vec) {
+  Section *sec = NewSection(name, KindOf<Real>::value, 1, vec.Dim(),
+                            vec.Dim() * sizeof(Real));
+  if (vec.Dim() > 0) {
+    memcpy(&sec->data[0], vec.Data(), vec.Dim() * sizeof(Real));
+  }
+}
+
+template
+void ModelImageWriter::AddMatrix(const std::string &name,
+                                 const MatrixBase<float> &mat);
+template
+void ModelImageWriter::AddMatrix(const std::string &name,
+                                 const MatrixBase<double> &mat);
+template
+void ModelImageWriter::AddVector(const std::string &name,
+                                 const VectorBase<float> &vec);
+template
+void ModelImageWriter::AddVector(const std::string &name,
+                                 const VectorBase<double> &vec);
+
+void ModelImageWriter::AddCuMatrix(const std::string &name,
+                                   const CuMatrix<BaseFloat> &mat) {
+  Matrix<BaseFloat> tmp;
+  mat.CopyToMat(&tmp);
+  AddMatrix(name, tmp);
+}
+
+void ModelImageWriter::AddCuVector(const std::string &name,
+                                   const CuVector<BaseFloat> &vec) {
+  Vector<BaseFloat> tmp;
+  vec.CopyToVec(&tmp);
+  AddVector(name, tmp);
+}
+
+void ModelImageWriter::AddInt32s(const std::string &name,
+                                 const std::vector<int32> &vals) {
+  Section *sec = NewSection(name, ModelImage::kInt32Section, 1, vals.size(),
+                            vals.size() * sizeof(int32));
+  if (!vals.empty()) {
+    memcpy(&sec->data[0], &vals[0], vals.size() * sizeof(int32));
+  }
+}
+
+void ModelImageWriter::AddBlob(const std::string &name,
+                               const std::string &blob) {
+  Section *sec = NewSection(name, ModelImage::kBlobSection, 1, blob.size(),
+                            blob.size());
+  sec->data = blob;
+}
+
+void ModelImageWriter::Write(const std::string &filename) const {
+  FILE *fp = fopen(filename.c_str(), "wb");
+  if (fp == NULL) {
+    KALDI_ERR << "Could not open " << filename << " for writing";
+  }
+
+  // lay out the sections after the header
+  std::vector<ModelImage::SectionEntry> table(sections_.size());
+  size_t offset = AlignUp(sizeof(ImageHeader));
+  for (size_t i = 0; i < sections_.size(); ++i) {
+    ModelImage::SectionEntry &entry = table[i];
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.name, sections_[i].name.c_str(), sizeof(entry.name) - 1);
+    entry.kind = sections_[i].kind;
+    entry.rows = sections_[i].rows;
+    entry.cols = sections_[i].cols;
+    entry.offset = offset;
+    entry.size = sections_[i].data.size();
+    offset = AlignUp(offset + entry.size);
+  }
+
+  ImageHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ModelImage::kMagic, sizeof(header.magic));
+  header.version = ModelImage::kVersion;
+  header.real_size = sizeof(BaseFloat);
+  header.num_sections = sections_.size();
+  header.table_offset = offset;
+
+  bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  size_t pos = sizeof(header);
+  static const char zeros[ModelImage::kAlignment] = { 0 };
+  for (size_t i = 0; ok && i < sections_.size(); ++i) {
+    ok = (fwrite(zeros, 1, table[i].offset - pos, fp) == table[i].offset - pos);
+    const std::string &data = sections_[i].data;
+    ok = ok && (fwrite(data.data(), 1, data.size(), fp) == data.size());
+    pos = table[i].offset + data.size();
+  }
+  ok = ok && (fwrite(zeros, 1, offset - pos, fp) == offset - pos);
+  if (!table.empty()) {
+    ok = ok && (fwrite(&table[0], sizeof(table[0]), table.size(), fp)
+        == table.size());
+  }
+  ok = (fclose(fp) == 0) && ok;
+  if (!ok) {
+    KALDI_ERR << "Error writing the model image " << filename;
+  }
+}
+
+void WriteAmDiagGmmImage(const AmDiagGmm &am_gmm, const std::string &prefix,
+                         ModelImageWriter *writer) {
+  int32 num_pdfs = am_gmm.NumPdfs(), dim = am_gmm.Dim(), total = 0;
+  std::vector<int32> num_gauss(num_pdfs);
+  for (int32 pdf = 0; pdf < num_pdfs; ++pdf) {
+    num_gauss[pdf] = am_gmm.NumGaussInPdf(pdf);
+    total += num_gauss[pdf];
+  }
+
+  Vector<BaseFloat> weights(total);
+  Matrix<BaseFloat> means_invvars(total, dim), inv_vars(total, dim);
+  int32 offset = 0;
+  for (int32 pdf = 0; pdf < num_pdfs; ++pdf) {
+    const DiagGmm &gmm = am_gmm.GetPdf(pdf);
+    int32 n = num_gauss[pdf];
+    weights.Range(offset, n).CopyFromVec(gmm.weights());
+    SubMatrix<BaseFloat>(means_invvars, offset, n, 0, dim).CopyFromMat(
+        gmm.means_invvars());
+    SubMatrix<BaseFloat>(inv_vars, offset, n, 0, dim).CopyFromMat(
+        gmm.inv_vars());
+    offset += n;
+  }
+
+  writer->AddInt32s(prefix + "num_gauss", num_gauss);
+  writer->AddVector(prefix + "weights", weights);
+  writer->AddMatrix(prefix + "means_invvars", means_invvars);
+  writer->AddMatrix(prefix + "inv_vars", inv_vars);
+}
+
+void ReadAmDiagGmmImage(const ModelImage &image, const std::string &prefix,
+                        AmDiagGmm *am_gmm) {
+  std::vector<int32> num_gauss;
+  Vector<BaseFloat> weights;
+  Matrix<BaseFloat> means_invvars, inv_vars;
+  image.GetInt32s(prefix + "num_gauss", &num_gauss);
+  image.CopyToVector(prefix + "weights", &weights);
+  image.CopyToMatrix(prefix + "means_invvars", &means_invvars);
+  image.CopyToMatrix(prefix + "inv_vars", &inv_vars);
+
+  while (am_gmm->NumPdfs() > 0) {
+    am_gmm->RemovePdf(am_gmm->NumPdfs() - 1);
+  }
+
+  // SetInvVarsAndMeans() wants the means
+  Matrix<BaseFloat> means(means_invvars);
+  means.DivElements(inv_vars);
+
+  int32 dim = inv_vars.NumCols(), offset = 0;
+  for (size_t pdf = 0; pdf < num_gauss.size(); ++pdf) {
+    int32 n = num_gauss[pdf];
+    DiagGmm gmm(n, dim);
+    gmm.SetWeights(weights.Range(offset, n));
+    gmm.SetInvVarsAndMeans(SubMatrix<BaseFloat>(inv_vars, offset, n, 0, dim),
+                           SubMatrix<BaseFloat>(means, offset, n, 0, dim));
+    gmm.ComputeGconsts();
+    am_gmm->AddPdf(gmm);
+    offset += n;
+  }
+  KALDI_ASSERT(offset == weights.Dim());
+}
+
+}  // namespace kaldi
@@ -0,0 +1,149 @@
+// nnet/nnet-model-image.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Memory-mapped model image.
+ *
+ * A versioned binary container of named sections, each section starting
+ * at a 64-byte aligned offset. Weight matrices are stored as plain row-major
+ * arrays, so loading is a memcpy (or a single host-to-device copy) from
+ * the mapped file instead of parsing the Kaldi serialization. Components
+ * without a specific layout are stored as the blob of their binary
+ * WriteData().
+ *
+ * Layout:
+ *   header  : magic "KNNIMAGE", version, sizeof(BaseFloat), #sections,
+ *             offset of the section table
+ *   data    : the aligned sections
+ *   table   : one SectionEntry per section
+ *
+ * The GMM based layers (GaussBL, HMMBL) also store the NN weights derived
+ * from the clean GMMs, so that the conversion is skipped at load time.
+ *
+ */
+
+#ifndef KALDI_NNET_MODEL_IMAGE_H
+#define KALDI_NNET_MODEL_IMAGE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+#include "gmm/am-diag-gmm.h"
+
+namespace kaldi {
+
+class ModelImage {
+ public:
+  static const char kMagic[8];
+  static const uint32 kVersion = 1;
+  static const uint32 kAlignment = 64;
+
+  typedef enum {
+    kFloatSection = 1,
+    kDoubleSection,
+    kInt32Section,
+    kBlobSection
+  } SectionKind;
+
+  struct SectionEntry {
+    char name[40];
+    uint32 kind;
+    int32 rows;
+    int32 cols;
+    uint32 reserved;
+    uint64 offset;
+    uint64 size;  ///< in bytes
+  };
+
+  /// Map the image file, the file has to be a plain file
+  explicit ModelImage(const std::string &filename);
+  ~ModelImage();
+
+  /// Check whether the file is a model image (looks at the magic only)
+  static bool IsImage(const std::string &filename);
+
+  bool HasSection(const std::string &name) const {
+    return index_.find(name) != index_.end();
+  }
+
+  /// Pointer to the data of a float/double section in the mapped file
+  const void* Data(const std::string &name, SectionKind kind, int32 *rows,
+                   int32 *cols) const;
+
+  template<typename Real>
+  void CopyToMatrix(const std::string &name, Matrix<Real> *mat) const;
+  template<typename Real>
+  void CopyToVector(const std::string &name, Vector<Real> *vec) const;
+  /// Copies directly from the mapped file to the host/device memory
+  void CopyToCuMatrix(const std::string &name,
+                      CuMatrix<BaseFloat> *mat) const;
+  void CopyToCuVector(const std::string &name,
+                      CuVector<BaseFloat> *vec) const;
+
+  void GetInt32s(const std::string &name, std::vector<int32> *vals) const;
+  void GetBlob(const std::string &name, std::string *blob) const;
+
+ private:
+  const SectionEntry& Find(const std::string &name, SectionKind kind) const;
+  /// Map the file and index its sections, throws on a bad image
+  void Open();
+  /// Unmap and close the file, also after a failed Open()
+  void Close();
+
+  std::string filename_;
+  int fd_;
+  char *data_;
+  size_t size_;
+  std::map<std::string, const SectionEntry*> index_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ModelImage);
+};
+
+/**
+ * Collects the sections in memory and writes the image at once.
+ */
+class ModelImageWriter {
+ public:
+  ModelImageWriter() { }
+
+  template<typename Real>
+  void AddMatrix(const std::string &name, const MatrixBase<Real> &mat);
+  template<typename Real>
+  void AddVector(const std::string &name, const VectorBase<Real> &vec);
+  void AddCuMatrix(const std::string &name, const CuMatrix<BaseFloat> &mat);
+  void AddCuVector(const std::string &name, const CuVector<BaseFloat> &vec);
+  void AddInt32s(const std::string &name, const std::vector<int32> &vals);
+  void AddBlob(const std::string &name, const std::string &blob);
+
+  void Write(const std::string &filename) const;
+
+ private:
+  struct Section {
+    std::string name;
+    ModelImage::SectionKind kind;
+    int32 rows, cols;
+    std::string data;
+  };
+  Section* NewSection(const std::string &name, ModelImage::SectionKind kind,
+                      int32 rows, int32 cols, size_t bytes);
+
+  std::vector<Section> sections_;
+};
+
+/// Store the GMMs as flat arrays under the prefix
+void WriteAmDiagGmmImage(const AmDiagGmm &am_gmm, const std::string &prefix,
+                         ModelImageWriter *writer);
+/// Rebuild the GMMs from the arrays, am_gmm is emptied first
+void ReadAmDiagGmmImage(const ModelImage &image, const std::string &prefix,
+                        AmDiagGmm *am_gmm);
+
+}  // namespace kaldi
+
+#endif
@@ -20,6 +20,9 @@
 #include "nnet/nnet-activation.h"
 #include "nnet/nnet-biasedlinearity.h"
 #include "nnet/nnet-various.h"
+#include "nnet/nnet-model-image.h"
+
+#include <algorithm>
 
 namespace kaldi {
 
@@ -47,6 +50,55 @@ void Nnet::Propagate(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *out) {
   out->CopyFromMat(mat);
 }
 
+void Nnet::PropagateStacked(const CuMatrix<BaseFloat> &first, const CuMatrix<BaseFloat> &second,
+                            CuMatrix<BaseFloat> *first_out, CuMatrix<BaseFloat> *second_out) {
+  KALDI_ASSERT(NULL != first_out && NULL != second_out);
+  KALDI_ASSERT(first.NumRows() == second.NumRows() && first.NumCols() == second.NumCols());
+  int32 n = first.NumRows();
+
+  if (LayerCount() == 0) {
+    first_out->Resize(n, first.NumCols());
+    first_out->CopyFromMat(first);
+    second_out->Resize(n, second.NumCols());
+    second_out->CopyFromMat(second);
+    return;
+  }
+
+  // we need at least L+1 input buffers
+  KALDI_ASSERT((int32)propagate_buf_.size() >= LayerCount()+1);
+
+  // the buffers of the previous call are 2N rows in stacked_buf_,
+  // swap them back so they are not reallocated
+  if (stacked_buf_.size() != propagate_buf_.size()) {
+    stacked_buf_.clear();
+    stacked_buf_.resize(propagate_buf_.size());
+  }
+  for (int32 i = 0; i <= LayerCount(); i++) {
+    propagate_buf_[i].Swap(&stacked_buf_[i]);
+  }
+
+  propagate_buf_[0].Resize(2*n, first.NumCols());
+  propagate_buf_[0].CopyRowsFromMat(n, first, 0, 0);
+  propagate_buf_[0].CopyRowsFromMat(n, second, 0, n);
+
+  for (int32 i = 0; i < (int32) nnet_.size(); i++) {
+    nnet_[i]->Propagate(propagate_buf_[i], &propagate_buf_[i + 1]);
+  }
+
+  CuMatrix<BaseFloat> &mat = propagate_buf_[nnet_.size()];
+  first_out->Resize(n, mat.NumCols());
+  first_out->CopyRowsFromMat(n, mat, 0, 0);
+  second_out->Resize(n, mat.NumCols());
+  second_out->CopyRowsFromMat(n, mat, n, 0);
+
+  // keep only the rows of the second bunch for the backward pass
+  for (int32 i = 0; i <= LayerCount(); i++) {
+    stacked_buf_[i].Resize(n, propagate_buf_[i].NumCols());
+    stacked_buf_[i].CopyRowsFromMat(n, propagate_buf_[i], n, 0);
+    propagate_buf_[i].Swap(&stacked_buf_[i]);
+  }
+}
+
 void Nnet::Backpropagate(const CuMatrix<BaseFloat> &in_err,
                          CuMatrix<BaseFloat> *out_err) {
   if (LayerCount() == 0) {
@@ -127,21 +179,75 @@ void Nnet::Feedforward(const CuMatrix<BaseFloat> &in,
     return;
   }
 
-  if (LayerCount() == 1) {
-    nnet_[0]->Propagate(in, out);
-    return;
-  }
-
   // we need at least 2 input buffers
-  KALDI_ASSERT(propagate_buf_.size() >= 2);
+  KALDI_ASSERT(LayerCount() == 1 || propagate_buf_.size() >= 2);
+
+  // on CPU, an Expand followed by a BiasedLinearity is done by shifted
+  // GEMMs over the unexpanded input
+#if HAVE_CUDA==1
+  bool fuse_expand = !CuDevice::Instantiate().Enabled();
+#else
+  bool fuse_expand = true;
+#endif
 
   // propagate by using exactly 2 auxiliary buffers
-  int32 L = 0;
-  nnet_[L]->Propagate(in, &propagate_buf_[L % 2]);
-  for (L++; L <= LayerCount() - 2; L++) {
-    nnet_[L]->Propagate(propagate_buf_[(L - 1) % 2], &propagate_buf_[L % 2]);
+  const CuMatrix<BaseFloat> *cur_in = &in;
+  int32 buf = 0;
+  for (int32 L = 0; L < LayerCount(); L++, buf = 1 - buf) {
+    // the type is not enough, e.g. <dropoutbl> also reports
+    // kBiasedLinearity without deriving from BiasedLinearity
+    const Expand *expand = NULL;
+    BiasedLinearity *linearity = NULL;
+    if (fuse_expand && L + 1 < LayerCount()
+        && nnet_[L]->GetType() == Component::kExpand) {
+      expand = dynamic_cast<const Expand*>(nnet_[L]);
+      linearity = dynamic_cast<BiasedLinearity*>(nnet_[L + 1]);
+    }
+    bool fused = (expand != NULL && linearity != NULL);
+    bool last = (L + (fused ? 1 : 0) == LayerCount() - 1);
+    CuMatrix<BaseFloat> *cur_out = last ? out : &propagate_buf_[buf];
+    if (fused) {
+      linearity->PropagateExpanded(*cur_in, expand->FrameOffsets(), cur_out);
+      L++;
+    } else {
+      nnet_[L]->Propagate(*cur_in, cur_out);
+    }
+    cur_in = cur_out;
   }
-  nnet_[L]->Propagate(propagate_buf_[(L - 1) % 2], out);
+}
+
+void Nnet::FeedforwardStacked(const CuMatrix<BaseFloat> &first, const CuMatrix<BaseFloat> &second,
+                              CuMatrix<BaseFloat> *first_out, CuMatrix<BaseFloat> *second_out) {
+  KALDI_ASSERT(NULL != first_out && NULL != second_out);
+  KALDI_ASSERT(first.NumRows() == second.NumRows() && first.NumCols() == second.NumCols());
+  int32 n = first.NumRows();
+
+  if (stacked_buf_.size() < 2) {
+    stacked_buf_.clear();
+    stacked_buf_.resize(2);
+  }
+  CuMatrix<BaseFloat> &in = stacked_buf_[0], &out = stacked_buf_[1];
+  in.Resize(2*n, first.NumCols());
+  in.CopyRowsFromMat(n, first, 0, 0);
+  in.CopyRowsFromMat(n, second, 0, n);
+
+  Feedforward(in, &out);
+
+  first_out->Resize(n, out.NumCols());
+  first_out->CopyRowsFromMat(n, out, 0, 0);
+  second_out->Resize(n, out.NumCols());
+  second_out->CopyRowsFromMat(n, out, n, 0);
+}
+
+void Nnet::Read(const std::string &file) {
+  if (ModelImage::IsImage(file)) {
+    ReadImage(file);
+    return;
+  }
+  bool binary;
+  Input in(file, &binary);
+  Read(in.Stream(), binary);
+  in.Close();
 }
 
 void Nnet::Read(std::istream &in, bool binary) {
@@ -162,6 +268,49 @@ void Nnet::Read(std::istream &in, bool binary) {
   learn_rate_ = 0.0;
 }
 
+Component* Nnet::RemoveFirstLayer() {
+  if (LayerCount() == 0) {
+    KALDI_ERR<< "Cannot remove a layer from empty network";
+  }
+  Component *comp = nnet_.front();
+  nnet_.erase(nnet_.begin());
+  // resize the buffers
+  propagate_buf_.resize(LayerCount() + 1);
+  backpropagate_buf_.resize(std::max(0, LayerCount() - 1));
+  return comp;
+}
+
+void Nnet::ReadImage(const std::string &file) {
+  ModelImage image(file);
+  std::vector<int32> num_layers;
+  image.GetInt32s("nnet.num_layers", &num_layers);
+  KALDI_ASSERT(num_layers.size() == 1);
+
+  for (int32 i = 0; i < num_layers[0]; i++) {
+    Component *comp = Component::ReadImage(image, i, this);
+    if (LayerCount() > 0 && nnet_.back()->OutputDim() != comp->InputDim()) {
+      KALDI_ERR<< "Dimensionality mismatch!"
+      << " Previous layer output:" << nnet_.back()->OutputDim()
+      << " Current layer input:" << comp->InputDim();
+    }
+    nnet_.push_back(comp);
+  }
+  // create empty buffers
+  propagate_buf_.resize(LayerCount() + 1);
+  backpropagate_buf_.resize(LayerCount() - 1);
+  // reset learn rate
+  learn_rate_ = 0.0;
+}
+
+void Nnet::WriteImage(const std::string &file) {
+  ModelImageWriter writer;
+  writer.AddInt32s("nnet.num_layers", std::vector<int32>(1, LayerCount()));
+  for (int32 i = 0; i < LayerCount(); i++) {
+    nnet_[i]->WriteImage(&writer, i);
+  }
+  writer.Write(file);
+}
+
 void Nnet::SetLearnRate(BaseFloat lrate, const char *lrate_factors) {
   // split lrate_factors to a vector
   std::vector<BaseFloat> lrate_factor_vec;
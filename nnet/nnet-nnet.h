@@ -42,10 +42,23 @@ class Nnet {
  public:
   /// Perform forward pass through the network
   void Propagate(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *out); 
+  /// Perform forward pass of two equally sized bunches stacked in one 
+  /// [first; second] matrix, so the weights are read once. Only the rows of 
+  /// the second bunch are kept in the buffers, Backpropagate() then works as 
+  /// after Propagate(second). (The components must work frame by frame, 
+  /// e.g. no splicing, and not keep other state from the forward pass, 
+  /// e.g. dropout masks.)
+  void PropagateStacked(const CuMatrix<BaseFloat> &first, const CuMatrix<BaseFloat> &second,
+                        CuMatrix<BaseFloat> *first_out, CuMatrix<BaseFloat> *second_out);
   /// Perform backward pass through the network
   void Backpropagate(const CuMatrix<BaseFloat> &in_err, CuMatrix<BaseFloat> *out_err);
   /// Perform forward pass through the network, don't keep buffers (use it when not training)
+  /// (on CPU, an Expand followed by a BiasedLinearity is computed without the expanded matrix)
   void Feedforward(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *out); 
+  /// Perform forward pass of two equally sized bunches stacked in one 
+  /// [first; second] matrix, don't keep buffers
+  void FeedforwardStacked(const CuMatrix<BaseFloat> &first, const CuMatrix<BaseFloat> &second,
+                          CuMatrix<BaseFloat> *first_out, CuMatrix<BaseFloat> *second_out);
 
   MatrixIndexT InputDim() const; ///< Dimensionality of the input features
   MatrixIndexT OutputDim() const; ///< Dimensionality of the desired vectors
@@ -57,6 +70,9 @@ class Nnet {
     return nnet_[index]; 
   }
   int IndexOfLayer(const Component& comp) const; ///< Get the position of layer in network
+  /// Detach the first layer, the caller takes ownership
+  /// (e.g. to train an input transform apart from the rest of the network)
+  Component* RemoveFirstLayer();
 
   /// Access to forward pass buffers
   const std::vector<CuMatrix<BaseFloat> >& PropagateBuffer() const { 
@@ -68,7 +84,8 @@ class Nnet {
     return backpropagate_buf_; 
   }
   
-  /// Read the MLP from file (can add layers to exisiting instance of Nnet)
+  /// Read the MLP from file (can add layers to exisiting instance of Nnet),
+  /// model images (see nnet-model-image.h) are detected and mapped
   void Read(const std::string &file);  
   /// Read the MLP from stream (can add layers to exisiting instance of Nnet)
   void Read(std::istream &in, bool binary);  
@@ -77,6 +94,11 @@ class Nnet {
   /// Write MLP to stream 
   void Write(std::ostream &out, bool binary);    
 
+  /// Read the MLP from a memory-mapped model image
+  void ReadImage(const std::string &file);
+  /// Write MLP as a model image
+  void WriteImage(const std::string &file);
+
   /// Write only a front part of the MLP to stream (ie. trim the MLP)
   void WriteFrontLayers(std::ostream& out, bool binary, int32 num_layers);    
   
@@ -103,6 +125,7 @@ class Nnet {
 
   std::vector<CuMatrix<BaseFloat> > propagate_buf_; ///< buffers for forward pass
   std::vector<CuMatrix<BaseFloat> > backpropagate_buf_; ///< buffers for backward pass
+  std::vector<CuMatrix<BaseFloat> > stacked_buf_; ///< swapped with propagate_buf_ by PropagateStacked
 
   BaseFloat learn_rate_; ///< global learning rate
 
@@ -150,14 +173,6 @@ inline int32 Nnet::IndexOfLayer(const Component &comp) const {
 }
  
   
-inline void Nnet::Read(const std::string &file) {
-  bool binary;
-  Input in(file, &binary);
-  Read(in.Stream(), binary);
-  in.Close();
-}
-
-
 inline void Nnet::Write(const std::string &file, bool binary) {
   Output out(file, binary, true);
   Write(out.Stream(), binary);
@@ -5,6 +5,7 @@
 
 #include "nnet/nnet-component.h"
 #include "gmm/am-diag-gmm.h"
+#include "vts/vts-multi-frame.h"
 #include "cudamatrix/cu-math.h"
 
 namespace kaldi {
@@ -180,8 +181,15 @@ class PosNegBL : public UpdatableComponent {
 
   }
 
+  /// Prepare the VTS compensation of the clean GMMs
   void PrepareDCTXforms();
 
+  /// Threads used by the compensation in SetNoise()
+  void SetNumThreads(int32 num_threads) {
+    pos_vts_.SetNumThreads(num_threads);
+    neg_vts_.SetNumThreads(num_threads);
+  }
+
   void SetNoise(bool compensate_var, const Vector<double> &mu_h,
                 const Vector<double> &mu_z,
                 const Vector<double> &var_z,
@@ -197,16 +205,6 @@ class PosNegBL : public UpdatableComponent {
 
   void UpdateVarScale();
 
-  void CompensateMultiFrameGmm(const Vector<double> &mu_h,
-                               const Vector<double> &mu_z,
-                               const Vector<double> &var_z, bool compensate_var,
-                               int32 num_cepstral,
-                               int32 num_fbank,
-                               const Matrix<double> &dct_mat,
-                               const Matrix<double> &inv_dct_mat,
-                               int32 num_frames,
-                               AmDiagGmm &noise_am_gmm);
-
   void InterpolateVariance(BaseFloat pos_weight, AmDiagGmm &pos_am_gmm,
                            AmDiagGmm &neg_am_gmm);
 
@@ -218,6 +216,10 @@ class PosNegBL : public UpdatableComponent {
       Matrix<BaseFloat> &linearity,
       Vector<BaseFloat> &bias);
 
+  /// Regenerate the NN layer in place from the compensated means and
+  /// variances kept by the VTS engines, no GMM conversions
+  void RefreshNNLayer();
+
  private:
   Matrix<BaseFloat> cpu_linearity_;
   Vector<BaseFloat> cpu_bias_;
@@ -243,8 +245,8 @@ class PosNegBL : public UpdatableComponent {
   int32 num_cepstral_;
   int32 num_fbank_;
   BaseFloat ceplifter_;
-  Matrix<double> dct_mat_;
-  Matrix<double> inv_dct_mat_;
+  MultiFrameCompensator pos_vts_;
+  MultiFrameCompensator neg_vts_;
 
   // noise parameters
   bool compensate_var_;
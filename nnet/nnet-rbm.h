@@ -19,7 +19,9 @@
 #define KALDI_NNET_RBM_H
 
 #include "nnet/nnet-component.h"
+#include "nnet/nnet-sparse-linearity.h"
 #include "cudamatrix/cu-math.h"
+#include "cudamatrix/cu-device.h"
 
 namespace kaldi {
 
@@ -287,6 +289,26 @@ class Rbm : public RbmBase {
     }
   }
 
+  /// Writes the decoder as a <tiedlinearity> sharing the weights of the
+  /// encoder written as the tied_index-th layer
+  void WriteAsTiedDecoder(std::ostream& os, int32 tied_index, bool binary) const {
+    //header
+    WriteToken(os,binary,Component::TypeToMarker(Component::kTiedLinearity));
+    WriteBasicType(os,binary,InputDim());
+    WriteBasicType(os,binary,OutputDim());
+    if(!binary) os << "\n";
+    //data
+    WriteBasicType(os,binary,tied_index);
+    vis_bias_.Write(os,binary);
+    //optionally sigmoid activation
+    if(VisType() == BERNOULLI) {
+      WriteToken(os,binary,Component::TypeToMarker(Component::kSigmoid));
+      WriteBasicType(os,binary,InputDim());
+      WriteBasicType(os,binary,InputDim());
+    }
+    if(!binary) os << "\n";
+  }
+
 protected:
   CuMatrix<BaseFloat> vis_hid_;        ///< Matrix with neuron weights
   CuVector<BaseFloat> vis_bias_;///< Vector with biases
@@ -343,17 +365,23 @@ class MaskedRbm : public Rbm {
   void ReadData(std::istream &is, bool binary) {
     Rbm::ReadData(is, binary);
 
-    mask_.Read(is, binary);
+    Matrix<BaseFloat> mask;
+    mask.Read(is, binary);
+
+    KALDI_ASSERT(mask.NumRows() == output_dim_);
+    KALDI_ASSERT(mask.NumCols() == input_dim_);
 
-    KALDI_ASSERT(mask_.NumRows() == output_dim_);
-    KALDI_ASSERT(mask_.NumCols() == input_dim_);
+    mask_.InitPattern(mask);
+    cu_mask_.Destroy();
   }
 
   void WriteData(std::ostream &os, bool binary) const {
 
     Rbm::WriteData(os, binary);
 
-    mask_.Write(os, binary);
+    Matrix<BaseFloat> mask(output_dim_, input_dim_);
+    mask_.CopyPatternToMat(&mask);
+    mask.Write(os, binary);
   }
 
   void RbmUpdate(const CuMatrix<BaseFloat> &pos_vis,
@@ -363,19 +391,38 @@ class MaskedRbm : public Rbm {
 
     Rbm::RbmUpdate(pos_vis, pos_hid, neg_vis, neg_hid);
 
-    vis_hid_.MulElements(mask_);
+    ApplyMask();
   }
 
   void SetMask(const Matrix<BaseFloat> &mask) {
     KALDI_ASSERT(mask.NumRows() == output_dim_);
     KALDI_ASSERT(mask.NumCols() == input_dim_);
 
-    mask_.CopyFromMat(mask);
-    vis_hid_.MulElements(mask_);
+    mask_.InitPattern(mask);
+    cu_mask_.Destroy();
+    ApplyMask();
   }
 
  private:
-  CuMatrix<BaseFloat> mask_;  ///< Matrix for weight mask
+  /// Zero the weights outside the mask
+  void ApplyMask() {
+#if HAVE_CUDA==1
+    if (CuDevice::Instantiate().Enabled()) {
+      // no sparse kernels, a dense copy of the mask lives on the device
+      if (cu_mask_.NumRows() != output_dim_) {
+        Matrix<BaseFloat> mask(output_dim_, input_dim_);
+        mask_.CopyPatternToMat(&mask);
+        cu_mask_.CopyFromMat(mask);
+      }
+      vis_hid_.MulElements(cu_mask_);
+      return;
+    }
+#endif
+    mask_.ApplyPattern(&(vis_hid_.Mat()));
+  }
+
+  SparseLinearity mask_;  ///< Weight mask, as the sparsity pattern only
+  CuMatrix<BaseFloat> cu_mask_;  ///< Dense mask for the GPU
 
 };
 
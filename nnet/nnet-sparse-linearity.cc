@@ -0,0 +1,218 @@
+// nnet/nnet-sparse-linearity.cc
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ */
+
+#include "nnet/nnet-sparse-linearity.h"
+
+#include <algorithm>
+
+namespace kaldi {
+
+void SparseLinearity::Init(const MatrixBase<BaseFloat> &weight,
+                           const MatrixBase<BaseFloat> &mask) {
+  KALDI_ASSERT(weight.NumRows() == mask.NumRows());
+  KALDI_ASSERT(weight.NumCols() == mask.NumCols());
+
+  InitPattern(mask);
+
+  values_.resize(col_idx_.size());
+  for (int32 r = 0; r < num_rows_; ++r) {
+    const BaseFloat *w = weight.RowData(r);
+    for (int32 k = row_ptr_[r]; k < row_ptr_[r + 1]; ++k) {
+      values_[k] = w[col_idx_[k]];
+    }
+  }
+  values_corr_.assign(col_idx_.size(), 0.0);
+}
+
+void SparseLinearity::InitPattern(const MatrixBase<BaseFloat> &mask) {
+  num_rows_ = mask.NumRows();
+  num_cols_ = mask.NumCols();
+
+  row_ptr_.resize(num_rows_ + 1);
+  col_idx_.clear();
+  for (int32 r = 0; r < num_rows_; ++r) {
+    row_ptr_[r] = col_idx_.size();
+    const BaseFloat *m = mask.RowData(r);
+    for (int32 c = 0; c < num_cols_; ++c) {
+      if (m[c] != 0.0) {
+        col_idx_.push_back(c);
+      }
+    }
+  }
+  row_ptr_[num_rows_] = col_idx_.size();
+
+  values_.clear();
+  values_corr_.clear();
+}
+
+BaseFloat SparseLinearity::Density() const {
+  if (num_rows_ == 0 || num_cols_ == 0) return 0.0;
+  return static_cast<BaseFloat>(NumNonZeros()) / num_rows_ / num_cols_;
+}
+
+BaseFloat SparseLinearity::Density(const MatrixBase<BaseFloat> &mask) {
+  if (mask.NumRows() == 0 || mask.NumCols() == 0) return 0.0;
+  int64 nnz = 0;
+  for (MatrixIndexT r = 0; r < mask.NumRows(); ++r) {
+    const BaseFloat *m = mask.RowData(r);
+    for (MatrixIndexT c = 0; c < mask.NumCols(); ++c) {
+      if (m[c] != 0.0) ++nnz;
+    }
+  }
+  return static_cast<BaseFloat>(nnz) / mask.NumRows() / mask.NumCols();
+}
+
+void SparseLinearity::CopyToMat(MatrixBase<BaseFloat> *weight) const {
+  KALDI_ASSERT(weight->NumRows() == num_rows_);
+  KALDI_ASSERT(weight->NumCols() == num_cols_);
+  KALDI_ASSERT(values_.size() == col_idx_.size());
+
+  weight->SetZero();
+  for (int32 r = 0; r < num_rows_; ++r) {
+    BaseFloat *w = weight->RowData(r);
+    for (int32 k = row_ptr_[r]; k < row_ptr_[r + 1]; ++k) {
+      w[col_idx_[k]] = values_[k];
+    }
+  }
+}
+
+void SparseLinearity::CopyPatternToMat(MatrixBase<BaseFloat> *mask) const {
+  KALDI_ASSERT(mask->NumRows() == num_rows_);
+  KALDI_ASSERT(mask->NumCols() == num_cols_);
+
+  mask->SetZero();
+  for (int32 r = 0; r < num_rows_; ++r) {
+    BaseFloat *m = mask->RowData(r);
+    for (int32 k = row_ptr_[r]; k < row_ptr_[r + 1]; ++k) {
+      m[col_idx_[k]] = 1.0;
+    }
+  }
+}
+
+void SparseLinearity::ApplyPattern(MatrixBase<BaseFloat> *mat) const {
+  KALDI_ASSERT(mat->NumRows() == num_rows_);
+  KALDI_ASSERT(mat->NumCols() == num_cols_);
+
+  for (int32 r = 0; r < num_rows_; ++r) {
+    BaseFloat *row = mat->RowData(r);
+    // the columns are sorted, zero the gaps between them
+    int32 c = 0;
+    for (int32 k = row_ptr_[r]; k < row_ptr_[r + 1]; ++k) {
+      for (; c < col_idx_[k]; ++c) {
+        row[c] = 0.0;
+      }
+      c = col_idx_[k] + 1;
+    }
+    for (; c < num_cols_; ++c) {
+      row[c] = 0.0;
+    }
+  }
+}
+
+void SparseLinearity::Propagate(const MatrixBase<BaseFloat> &in,
+                                const VectorBase<BaseFloat> &bias,
+                                MatrixBase<BaseFloat> *out) const {
+  KALDI_ASSERT(in.NumCols() == num_cols_ && bias.Dim() == num_rows_);
+  KALDI_ASSERT(out->NumRows() == in.NumRows() && out->NumCols() == num_rows_);
+
+  const int32 *col = (col_idx_.empty() ? NULL : &col_idx_[0]);
+  const BaseFloat *val = (values_.empty() ? NULL : &values_[0]);
+  for (MatrixIndexT n = 0; n < in.NumRows(); ++n) {
+    const BaseFloat *x = in.RowData(n);
+    BaseFloat *y = out->RowData(n);
+    for (int32 r = 0; r < num_rows_; ++r) {
+      BaseFloat sum = bias(r);
+      for (int32 k = row_ptr_[r]; k < row_ptr_[r + 1]; ++k) {
+        sum += val[k] * x[col[k]];
+      }
+      y[r] = sum;
+    }
+  }
+}
+
+void SparseLinearity::Backpropagate(const MatrixBase<BaseFloat> &in_err,
+                                    MatrixBase<BaseFloat> *out_err) const {
+  KALDI_ASSERT(in_err.NumCols() == num_rows_);
+  KALDI_ASSERT(out_err->NumRows() == in_err.NumRows());
+  KALDI_ASSERT(out_err->NumCols() == num_cols_);
+
+  const int32 *col = (col_idx_.empty() ? NULL : &col_idx_[0]);
+  const BaseFloat *val = (values_.empty() ? NULL : &values_[0]);
+  out_err->SetZero();
+  for (MatrixIndexT n = 0; n < in_err.NumRows(); ++n) {
+    const BaseFloat *e = in_err.RowData(n);
+    BaseFloat *d = out_err->RowData(n);
+    for (int32 r = 0; r < num_rows_; ++r) {
+      if (e[r] == 0.0) continue;
+      for (int32 k = row_ptr_[r]; k < row_ptr_[r + 1]; ++k) {
+        d[col[k]] += e[r] * val[k];
+      }
+    }
+  }
+}
+
+void SparseLinearity::AccuGradient(BaseFloat alpha,
+                                   const MatrixBase<BaseFloat> &err,
+                                   const MatrixBase<BaseFloat> &input,
+                                   BaseFloat beta) {
+  KALDI_ASSERT(err.NumCols() == num_rows_ && input.NumCols() == num_cols_);
+  KALDI_ASSERT(err.NumRows() == input.NumRows());
+  KALDI_ASSERT(values_corr_.size() == col_idx_.size());
+
+  if (col_idx_.empty()) return;
+
+  if (beta == 0.0) {
+    std::fill(values_corr_.begin(), values_corr_.end(), 0.0);
+  } else if (beta != 1.0) {
+    for (size_t k = 0; k < values_corr_.size(); ++k) {
+      values_corr_[k] *= beta;
+    }
+  }
+
+  const int32 *col = &col_idx_[0];
+  BaseFloat *corr = &values_corr_[0];
+  for (MatrixIndexT n = 0; n < err.NumRows(); ++n) {
+    const BaseFloat *e = err.RowData(n);
+    const BaseFloat *x = input.RowData(n);
+    for (int32 r = 0; r < num_rows_; ++r) {
+      if (e[r] == 0.0) continue;
+      BaseFloat a = alpha * e[r];
+      for (int32 k = row_ptr_[r]; k < row_ptr_[r + 1]; ++k) {
+        corr[k] += a * x[col[k]];
+      }
+    }
+  }
+}
+
+void SparseLinearity::Update(BaseFloat learn_rate, BaseFloat l2,
+                             BaseFloat l1) {
+  KALDI_ASSERT(values_.size() == values_corr_.size());
+
+  for (size_t k = 0; k < values_.size(); ++k) {
+    BaseFloat &w = values_[k];
+    // l2 regularization
+    if (l2 != 0.0) {
+      w -= l2 * w;
+    }
+    // l1 regularization, as cu::RegularizeL1()
+    if (l1 != 0.0 && w != 0.0) {
+      BaseFloat l1_signed = (w < 0.0 ? -l1 : l1);
+      BaseFloat after = w - learn_rate * values_corr_[k] - l1_signed;
+      if ((after > 0.0) ^ (w > 0.0)) {
+        w = 0.0;
+        values_corr_[k] = 0.0;
+      } else {
+        w -= l1_signed;
+      }
+    }
+    // update
+    w -= learn_rate * values_corr_[k];
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,92 @@
+// nnet/nnet-sparse-linearity.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Sparse (CSR) weight matrix for the masked layers.
+ *
+ * Only the weights inside the mask are stored, row by row:
+ *   row_ptr_[r] .. row_ptr_[r+1]-1 index the non-zeros of row r,
+ *   col_idx_[k] is the column of the k-th non-zero, values_[k] its weight.
+ * The mask itself is the sparsity pattern, so no dense mask is kept.
+ *
+ * The products are computed on the host matrices, the cost is
+ * O(#frames * #non-zeros) instead of O(#frames * rows * cols).
+ *
+ */
+
+#ifndef KALDI_NNET_SPARSE_LINEARITY_H
+#define KALDI_NNET_SPARSE_LINEARITY_H
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+
+namespace kaldi {
+
+class SparseLinearity {
+ public:
+  SparseLinearity()
+      : num_rows_(0),
+        num_cols_(0)
+  {
+  }
+
+  /// Build the pattern from the non-zeros of the mask,
+  /// the values are taken from the dense weight
+  void Init(const MatrixBase<BaseFloat> &weight,
+            const MatrixBase<BaseFloat> &mask);
+  /// Build the pattern only (no values), for ApplyPattern()
+  void InitPattern(const MatrixBase<BaseFloat> &mask);
+
+  int32 NumRows() const {
+    return num_rows_;
+  }
+  int32 NumCols() const {
+    return num_cols_;
+  }
+  int32 NumNonZeros() const {
+    return col_idx_.size();
+  }
+  /// Fraction of the non-zeros in the pattern
+  BaseFloat Density() const;
+  /// Fraction of the non-zeros in a dense mask
+  static BaseFloat Density(const MatrixBase<BaseFloat> &mask);
+
+  /// Dense weight, zeros outside the pattern
+  void CopyToMat(MatrixBase<BaseFloat> *weight) const;
+  /// Dense 0/1 mask of the pattern
+  void CopyPatternToMat(MatrixBase<BaseFloat> *mask) const;
+  /// Zero the entries of a dense matrix outside the pattern
+  void ApplyPattern(MatrixBase<BaseFloat> *mat) const;
+
+  /// out = in * W^T + bias
+  void Propagate(const MatrixBase<BaseFloat> &in,
+                 const VectorBase<BaseFloat> &bias,
+                 MatrixBase<BaseFloat> *out) const;
+  /// out_err = in_err * W
+  void Backpropagate(const MatrixBase<BaseFloat> &in_err,
+                     MatrixBase<BaseFloat> *out_err) const;
+
+  /// corr = alpha * (err^T * input) + beta * corr, only on the pattern
+  void AccuGradient(BaseFloat alpha, const MatrixBase<BaseFloat> &err,
+                    const MatrixBase<BaseFloat> &input, BaseFloat beta);
+  /// Same regularization and update as BiasedLinearity::Update,
+  /// l2 and l1 are already scaled by the learning rate and #frames
+  void Update(BaseFloat learn_rate, BaseFloat l2, BaseFloat l1);
+
+ private:
+  int32 num_rows_;
+  int32 num_cols_;
+
+  std::vector<int32> row_ptr_;
+  std::vector<int32> col_idx_;
+  std::vector<BaseFloat> values_;
+  std::vector<BaseFloat> values_corr_;
+};
+
+}  // namespace kaldi
+
+#endif
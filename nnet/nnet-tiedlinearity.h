@@ -0,0 +1,133 @@
+// nnet/nnet-tiedlinearity.h
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Decoder layer of a weight-tied autoencoder.
+ *
+ * The layer keeps only its bias, the weights are the transposed linearity
+ * of a BiasedLinearity lower in the same Nnet, referenced by its layer
+ * index. The forward pass multiplies by that linearity with kNoTrans
+ * (instead of kTrans), the backward pass with kTrans. The weight gradient
+ * is accumulated into the correction buffer of the referenced layer, which
+ * applies it together with its own gradient in its Update (the lower
+ * layer is updated later in Nnet::Backpropagate).
+ */
+
+#ifndef KALDI_NNET_TIEDLINEARITY_H
+#define KALDI_NNET_TIEDLINEARITY_H
+
+#include "nnet/nnet-component.h"
+#include "nnet/nnet-nnet.h"
+#include "nnet/nnet-biasedlinearity.h"
+
+namespace kaldi {
+
+class TiedLinearity : public UpdatableComponent {
+ public:
+  TiedLinearity(MatrixIndexT dim_in, MatrixIndexT dim_out, Nnet *nnet)
+      : UpdatableComponent(dim_in, dim_out, nnet),
+        tied_index_(-1),
+        bias_(dim_out),
+        bias_corr_(dim_out)
+  {
+  }
+  ~TiedLinearity()
+  {
+  }
+
+  ComponentType GetType() const {
+    return kTiedLinearity;
+  }
+
+  void ReadData(std::istream &is, bool binary) {
+    ReadBasicType(is, binary, &tied_index_);
+    bias_.Read(is, binary);
+
+    KALDI_ASSERT(tied_index_ >= 0);
+    KALDI_ASSERT(bias_.Dim() == output_dim_);
+  }
+
+  void WriteData(std::ostream &os, bool binary) const {
+    WriteBasicType(os, binary, tied_index_);
+    bias_.Write(os, binary);
+  }
+
+  void PropagateFnc(const CuMatrix<BaseFloat> &in, CuMatrix<BaseFloat> *out) {
+    // precopy bias
+    out->AddVecToRows(1.0, bias_, 0.0);
+    // multiply by the tied weights (already transposed)
+    out->AddMatMat(1.0, in, kNoTrans, Tied().GetLinearityWeight(), kNoTrans,
+                   1.0);
+  }
+
+  void BackpropagateFnc(const CuMatrix<BaseFloat> &in_err,
+                        CuMatrix<BaseFloat> *out_err) {
+    // multiply error by the tied weights^t
+    out_err->AddMatMat(1.0, in_err, kNoTrans, Tied().GetLinearityWeight(),
+                       kTrans, 0.0);
+  }
+
+  void Update(const CuMatrix<BaseFloat> &input,
+              const CuMatrix<BaseFloat> &err) {
+    BaseFloat scale = average_grad_ ? 1.0 / input.NumRows() : 1.0;
+
+    // the weight gradient goes to the tied layer
+    Tied().AccumulateTiedGradient(scale, input, err);
+
+    // own bias
+    bias_corr_.AddRowSumMat(scale, err, momentum_);
+    bias_.AddVec(-learn_rate_, bias_corr_);
+  }
+
+  int32 GetTiedIndex() const {
+    return tied_index_;
+  }
+
+  void SetTiedIndex(int32 index) {
+    tied_index_ = index;
+  }
+
+  void SetBiasWeight(const CuVector<BaseFloat> &bias) {
+    bias_.CopyFromVec(bias);
+  }
+
+  const CuVector<BaseFloat>& GetBiasWeight() {
+    return bias_;
+  }
+
+ private:
+  /// The referenced layer, checked on each use as the Nnet can be edited
+  BiasedLinearity& Tied() {
+    if (nnet_ == NULL) {
+      KALDI_ERR << "TiedLinearity used outside of an Nnet";
+    }
+    if (tied_index_ < 0 || tied_index_ >= nnet_->IndexOfLayer(*this)) {
+      KALDI_ERR << "TiedLinearity must reference a lower layer, index "
+                << tied_index_ << " vs. " << nnet_->IndexOfLayer(*this);
+    }
+    BiasedLinearity *bl =
+        dynamic_cast<BiasedLinearity*>(nnet_->Layer(tied_index_));
+    // the derived layers have their own Update, ignoring the tied gradients
+    if (bl == NULL || bl->GetType() != kBiasedLinearity) {
+      KALDI_ERR << "TiedLinearity references layer " << tied_index_
+                << " which is not a <biasedlinearity>";
+    }
+    if (bl->InputDim() != output_dim_ || bl->OutputDim() != input_dim_) {
+      KALDI_ERR << "Nonmatching dims, tied layer:" << bl->OutputDim() << "x"
+                << bl->InputDim() << " component:" << input_dim_ << "x"
+                << output_dim_;
+    }
+    return *bl;
+  }
+
+  int32 tied_index_;  ///< Layer index of the tied BiasedLinearity
+
+  CuVector<BaseFloat> bias_;
+  CuVector<BaseFloat> bias_corr_;
+};
+
+}  // namespace
+
+#endif
@@ -75,6 +75,10 @@ class Expand : public Component {
     KALDI_ERR << __func__ << "Not implemented!";
   }
 
+  const CuStlVector<int32>& FrameOffsets() const {
+    return frame_offsets_;
+  }
+
  protected:
   CuStlVector<int32> frame_offsets_;
 };
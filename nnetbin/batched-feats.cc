@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "nnet/nnet-ali-prefetch.h"
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -28,6 +29,9 @@ int main(int argc, char *argv[]) {
     int32 batch_size = 1024;
     po.Register("batch-size", &batch_size, "Number of instances in one batch");
 
+    int32 prefetch = 0;
+    po.Register("prefetch-alignments", &prefetch, "Number of alignments read ahead on a background thread (needs scp features, 0 = off)");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 2 && po.NumArgs() != 3) {
@@ -40,10 +44,10 @@ int main(int argc, char *argv[]) {
         alignments_rspecifier = po.GetOptArg(3);
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessInt32VectorReader alignments_reader;
-    if (alignments_rspecifier != "") {
-      alignments_reader.Open(alignments_rspecifier);
-    }
+    AlignmentPrefetcher alignments_reader(feature_rspecifier,
+                                          alignments_rspecifier,
+                                          alignments_rspecifier != "" ?
+                                              prefetch : 0);
 
     int32 num_done = 0, num_other_error = 0, batch_id = 1, cur_count = 0;
     char str[100];
@@ -9,6 +9,7 @@
 #include "cudamatrix/cu-device.h"
 #include "nnet/nnet-component.h"
 #include "nnet/nnet-codebl.h"
+#include "nnet/nnet-activation-store.h"
 
 #include <algorithm>
 #include <ctime>
@@ -72,6 +73,23 @@ int main(int argc, char *argv[]) {
     po.Register("cachesize", &cachesize,
                 "Size of cache for frame level shuffling");
 
+    int32 num_iters = 1;
+    po.Register("num-iters", &num_iters,
+                "Number of passes over the utterances of each set");
+
+    bool cache_activations = false;
+    po.Register("cache-activations", &cache_activations,
+                "Compute the input product of the first <codebl> layer (after the "
+                "feature transform and the frozen layers below it) once per "
+                "utterance and reuse it in the following iterations");
+    int32 cache_ram_mb = 2048;
+    po.Register("cache-ram-mb", &cache_ram_mb,
+                "RAM for the cached activations of a set in MB, the rest is "
+                "spilled to a memory-mapped file");
+    std::string cache_spill_dir = "/tmp";
+    po.Register("cache-spill-dir", &cache_spill_dir,
+                "Directory of the spill file of the cached activations");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 7 - (crossvalidate ? 1 : 0)) {
@@ -131,6 +149,43 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Totally " << num_codebl << " among " << nnet.LayerCount()
         << " layers of the nnet are <codebl> layers.";
 
+    if (crossvalidate) {
+      num_iters = 1;
+    }
+
+    /*
+     * Only the code bias of the <codebl> layers changes, so with the layers
+     * below the first <codebl> layer frozen, its input product is the same
+     * in all the iterations. These layers are taken out of the nnet, the
+     * nnet then starts above the first <codebl> layer (it is empty when the
+     * <codebl> layer was the last one, e.g. adapting the output layer from
+     * the last hidden layer activations).
+     */
+    std::vector<Component*> frozen_layers;
+    CodeBL *first_codebl = NULL;
+    if (cache_activations) {
+      if (num_codebl == 0) {
+        KALDI_ERR << "No <codebl> layer, nothing to cache";
+      }
+      first_codebl = layers_codebl[0];
+      while (nnet.Layer(0) != first_codebl) {
+        Component *comp = nnet.Layer(0);
+        if (comp->IsUpdatable()
+            && dynamic_cast<UpdatableComponent*>(comp)->GetLearnRate() > 0.0) {
+          KALDI_ERR << "Layer " << frozen_layers.size()
+                    << " below the first <codebl> layer is trained, "
+                    << "set its learn factor to 0 to cache the activations";
+        }
+        frozen_layers.push_back(nnet.RemoveFirstLayer());
+      }
+      nnet.RemoveFirstLayer();
+      KALDI_LOG << "Caching the input product of the <codebl> layer "
+                << frozen_layers.size() << ", " << nnet.LayerCount()
+                << " layers are propagated per bunch";
+    }
+    ActivationStore store(static_cast<size_t>(cache_ram_mb) * 1024 * 1024,
+                          cache_spill_dir);
+
     kaldi::int64 tot_t = 0;
 
     SequentialTokenVectorReader set2utt_reader(set2utt_rspecifier);
@@ -151,6 +206,7 @@ int main(int argc, char *argv[]) {
 
     CuVector<BaseFloat> codevec_cur(codevec_dim), codevec_corr(codevec_dim);
     CuMatrix<BaseFloat> feats, feats_transf, nnet_in, nnet_out, glob_err, backend_out, backend_err, nnet_err;
+    CuMatrix<BaseFloat> frozen_out, code_out, code_err;
     std::vector<int32> targets;
 
     Timer tim;
@@ -172,76 +228,133 @@ int main(int argc, char *argv[]) {
 
       // all the utts belong to this set
       std::vector<std::string> uttlst(set2utt_reader.Value());
-      if(shuffle){
-        std::random_shuffle(uttlst.begin(), uttlst.end());
-      }
 
-      for (int32 uid = 0; uid < uttlst.size();) {
+      for (int32 iter = 0; iter < num_iters; ++iter) {
+        if (num_iters > 1) {
+          std::cerr << "Iteration " << iter + 1 << "/" << num_iters << "\n";
+        }
+        if (shuffle) {
+          std::random_shuffle(uttlst.begin(), uttlst.end());
+        }
+
+        for (int32 uid = 0; uid < uttlst.size();) {
 
-        // fill the cache
-        while (!cache.Full() && uid < uttlst.size()) {
-          std::string key = uttlst[uid];
-          if (!alignments_reader.HasKey(key)) {
-            num_no_alignment++;
-          } else {
+          // fill the cache
+          while (!cache.Full() && uid < uttlst.size()) {
+            std::string key = uttlst[uid];
+            Timer t_features;
+            uid += 1; // next utterance
+            if (!alignments_reader.HasKey(key)) {
+              if (iter == 0) num_no_alignment++;
+              continue;
+            }
+            const std::vector<int32> &alignment = alignments_reader.Value(key);
+            if (cache_activations && store.HasKey(key)) {
+              // computed in a previous iteration
+              store.Get(key, &feats_transf);
+              time_next += t_features.Elapsed();
+              cache.AddData(feats_transf, alignment);
+              continue;
+            }
+            if (iter > 0 && cache_activations) {
+              continue;  // rejected in the first iteration
+            }
             // get feature alignment pair
             const Matrix<BaseFloat> &mat = feature_reader.Value(key);
-            const std::vector<int32> &alignment = alignments_reader.Value(key);
+            time_next += t_features.Elapsed();
             // chech for dimension
             if ((int32) alignment.size() != mat.NumRows()) {
               KALDI_WARN<< "Alignment has wrong size "<< (alignment.size()) << " vs. "<< (mat.NumRows());
-              num_other_error++;
+              if (iter == 0) num_other_error++;
               continue;
             }
-              // push features to GPU
+            // push features to GPU
             feats.CopyFromMat(mat);
             // possibly apply transform
             nnet_transf.Feedforward(feats, &feats_transf);
+            CuMatrix<BaseFloat> *data = &feats_transf;
+            if (cache_activations) {
+              // the frozen layers, then the product of the <codebl> layer
+              CuMatrix<BaseFloat> *out = &frozen_out;
+              for (size_t li = 0; li < frozen_layers.size(); ++li) {
+                frozen_layers[li]->Propagate(*data, out);
+                std::swap(data, out);
+              }
+              first_codebl->InputProduct(*data, out);
+              store.Add(key, *out);
+              data = out;
+            }
             // add to cache
-            cache.AddData(feats_transf, alignment);
-            num_done++;
+            cache.AddData(*data, alignment);
+            if (iter == 0) num_done++;
           }
-          Timer t_features;
-          uid += 1; // next utterance
-          time_next += t_features.Elapsed();
-        }
-        // randomize
-        if (!crossvalidate && randomize) {
-          cache.Randomize();
-        }
-        // report
-        std::cerr << "Cache #" << ++num_cache << " "
-            << (cache.Randomized() ? "[RND]" : "[NO-RND]")
-            << " segments: " << num_done
-            << " frames: " << tot_t << "\n";
-        // train with the cache
-        while (!cache.Empty()) {
-          // get block of feature/target pairs
-          cache.GetBunch(&nnet_in, &targets);
-          // train
-          nnet.Propagate(nnet_in, &nnet_out);
-          nnet_backend.Propagate(nnet_out, &backend_out);
-
-          xent.EvalVec(backend_out, targets, &glob_err);
-          if (!crossvalidate) {
-            nnet_backend.Backpropagate(glob_err, &backend_err);
-            nnet.Backpropagate(backend_err, &nnet_err); // to compute the code error, we need to propagete through 1st layer
-
-            // accumulate code vector correction
-            codevec_corr.SetZero();
-            for(int32 li = 0; li < num_codebl; ++li){
-              codevec_corr.AddVec(1.0, layers_codebl[li]->GetCodeVecCorr(), 1.0);
+          // randomize
+          if (!crossvalidate && randomize) {
+            cache.Randomize();
+          }
+          // report
+          std::cerr << "Cache #" << ++num_cache << " "
+              << (cache.Randomized() ? "[RND]" : "[NO-RND]")
+              << " segments: " << num_done
+              << " frames: " << tot_t << "\n";
+          // train with the cache
+          while (!cache.Empty()) {
+            // get block of feature/target pairs
+            cache.GetBunch(&nnet_in, &targets);
+            // train
+            if (cache_activations) {
+              // nnet_in is the input product of the first <codebl> layer
+              first_codebl->PropagateFromProduct(nnet_in, &code_out);
+              if (nnet.LayerCount() > 0) {
+                nnet.Propagate(code_out, &nnet_out);
+                nnet_backend.Propagate(nnet_out, &backend_out);
+              } else {
+                nnet_backend.Propagate(code_out, &backend_out);
+              }
+            } else {
+              nnet.Propagate(nnet_in, &nnet_out);
+              nnet_backend.Propagate(nnet_out, &backend_out);
             }
-            // update the current code vector with the average correction
-            codevec_cur.AddVec(1.0/num_codebl, codevec_corr, 1.0);
-            for(int32 li = 0; li < num_codebl; ++li) {
-              layers_codebl[li]->SetCodeVec(codevec_cur);
+
+            xent.EvalVec(backend_out, targets, &glob_err);
+            if (!crossvalidate) {
+              nnet_backend.Backpropagate(glob_err, &backend_err);
+              if (cache_activations) {
+                // nothing below the first <codebl> layer to backpropagate to
+                const CuMatrix<BaseFloat> *err = &backend_err;
+                if (nnet.LayerCount() > 0) {
+                  nnet.Backpropagate(backend_err, &code_err);
+                  err = &code_err;
+                }
+                if (first_codebl->GetLearnRate() > 0.0) {
+                  first_codebl->UpdateCodeVec(*err);
+                }
+              } else {
+                nnet.Backpropagate(backend_err, &nnet_err); // to compute the code error, we need to propagete through 1st layer
+              }
+
+              // accumulate code vector correction
+              codevec_corr.SetZero();
+              for(int32 li = 0; li < num_codebl; ++li){
+                codevec_corr.AddVec(1.0, layers_codebl[li]->GetCodeVecCorr(), 1.0);
+              }
+              // update the current code vector with the average correction
+              codevec_cur.AddVec(1.0/num_codebl, codevec_corr, 1.0);
+              for(int32 li = 0; li < num_codebl; ++li) {
+                layers_codebl[li]->SetCodeVec(codevec_cur);
+              }
             }
-          }
-          tot_t += nnet_in.NumRows();
-        } // end while cache
+            tot_t += nnet_in.NumRows();
+          } // end while cache
+
+        } // end for uttlst
 
-      } // end for uttlst
+      } // end for iter
+
+      if (cache_activations) {
+        KALDI_LOG << "Cached activations of " << setkey << ": " << store.Info();
+        store.Clear();
+      }
 
       // Save the new code vector
       if (!crossvalidate){
@@ -265,6 +378,11 @@ int main(int argc, char *argv[]) {
 
     KALDI_LOG<< xent.Report();
 
+    for (size_t li = 0; li < frozen_layers.size(); ++li) {
+      delete frozen_layers[li];
+    }
+    delete first_codebl;
+
 #if HAVE_CUDA==1
     CuDevice::Instantiate().PrintProfile();
 #endif
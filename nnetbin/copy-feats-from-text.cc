@@ -13,6 +13,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "matrix/kaldi-matrix.h"
+#include "nnet/nnet-feat-io.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -35,6 +36,18 @@ int main(int argc, char *argv[]) {
     std::string data_suffix = "";
     po.Register("data-suffix", &data_suffix, "The suffix for the text data");
 
+    bool raw_binary = false;
+    po.Register("raw-binary", &raw_binary,
+                "Read raw 32-bit floats instead of text");
+
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads parsing the files");
+
+    int32 batch_size = 64;
+    po.Register("batch-size", &batch_size,
+                "Number of files parsed together");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 2) {
@@ -46,59 +59,57 @@ int main(int argc, char *argv[]) {
     std::string wspecifier = po.GetArg(2);
 
     KALDI_ASSERT(dim > 0);
+    KALDI_ASSERT(batch_size > 0);
 
     int32 total_files = 0, total_frames = 0;
-    int32 max_frames = 1000, delta_frames = 500;
 
     BaseFloatMatrixWriter kaldi_writer(wspecifier);
-    Matrix<BaseFloat> data(max_frames, dim, kSetZero);
+    FeatBatchConverter converter(num_threads, raw_binary, dim);
+
+    std::vector<std::string> keys, fnames;
+    std::vector<Matrix<BaseFloat> > feats;
+    std::vector<char> ok;
 
     std::ifstream fscp(in_file_list.c_str());
 
     while (fscp.good()) {
-      std::string key;
-      fscp >> key;
-
-      if(key=="") continue;
+      // collect a batch of files
+      keys.clear();
+      fnames.clear();
+      while (fscp.good() && keys.size() < (size_t) batch_size) {
+        std::string key;
+        fscp >> key;
+
+        if(key=="") continue;
+
+        std::string fname="";
+        if (data_directory != "") {
+          fname = data_directory + "/";
+        }
 
-      std::string fname="";
-      if (data_directory != "") {
-        fname = data_directory + "/";
-      }
+        fname = fname + key;
 
-	  fname = fname + key;
+        if (data_suffix != "") {
+          fname = fname + "." + data_suffix;
+        }
 
-	  if (data_suffix != "") {
-      	fname = fname + "." + data_suffix;
-	  }
+        keys.push_back(key);
+        fnames.push_back(fname);
+      }
 
-      std::ifstream fdat(fname.c_str());
+      converter.Parse(fnames, &feats, &ok);
 
-      int32 num_frames = 0;
-      while (fdat.good()) {
-        if (num_frames >= max_frames) {
-          max_frames += delta_frames;
-          data.Resize(max_frames, dim, kCopyData);
-        }
-        for (int32 i = 0; i < dim; ++i) {
-          BaseFloat val;
-          fdat >> val;
-          data(num_frames, i) = val;
-        }
-        if (fdat.good()) {
-          ++num_frames;
+      for (size_t i = 0; i < keys.size(); ++i) {
+        if (!ok[i]) {
+          KALDI_WARN << "Could not read " << fnames[i]
+              << " as " << dim << " dimensional features, skipping";
+          continue;
         }
-      }
+        kaldi_writer.Write(keys[i], feats[i]);
 
-      {
-        Matrix<BaseFloat> feat(SubMatrix<BaseFloat>(data, 0, num_frames, 0, dim), kNoTrans);
-        kaldi_writer.Write(key, feat);
+        total_frames += feats[i].NumRows();
+        total_files += 1;
       }
-
-      total_frames += num_frames;
-      total_files += 1;
-
-      //KALDI_LOG<< "Done " << key << ", " << num_frames << " frames.";
     }
 
     KALDI_LOG<< "Totally " << total_files << " files, " << total_frames << " frames.";
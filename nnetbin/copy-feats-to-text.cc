@@ -8,11 +8,10 @@
  *
  */
 
-#include <fstream>
-
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "matrix/kaldi-matrix.h"
+#include "nnet/nnet-feat-io.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -31,6 +30,18 @@ int main(int argc, char *argv[]) {
     std::string data_suffix = "";
     po.Register("data-suffix", &data_suffix, "The suffix for the text data");
 
+    bool raw_binary = false;
+    po.Register("raw-binary", &raw_binary,
+                "Write raw 32-bit floats instead of text");
+
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads formatting the utterances");
+
+    int32 batch_size = 64;
+    po.Register("batch-size", &batch_size,
+                "Number of utterances formatted together");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 1) {
@@ -44,31 +55,46 @@ int main(int argc, char *argv[]) {
       data_directory += "/";
     }
 
-    int32 total_frames = 0;
+    KALDI_ASSERT(batch_size > 0);
 
-    SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
-    for (; !kaldi_reader.Done(); kaldi_reader.Next()) {
+    int32 total_frames = 0;
 
-      std::string key = kaldi_reader.Key();
-      const Matrix<BaseFloat> &feat = kaldi_reader.Value();
+    FeatBatchConverter converter(num_threads, raw_binary);
+    std::vector<std::string> keys;
+    std::vector<Matrix<BaseFloat> > feats;
+    std::vector<std::string> bufs;
 
-      std::string fname = data_directory+key;
-      if (data_suffix!=""){
-        fname = fname + "." +data_suffix;
+    SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
+    while (!kaldi_reader.Done()) {
+      // collect a batch of utterances
+      keys.clear();
+      feats.resize(batch_size);
+      for (; !kaldi_reader.Done() && keys.size() < (size_t) batch_size;
+          kaldi_reader.Next()) {
+        const Matrix<BaseFloat> &feat = kaldi_reader.Value();
+        Matrix<BaseFloat> &copy = feats[keys.size()];
+        copy.Resize(feat.NumRows(), feat.NumCols(), kUndefined);
+        copy.CopyFromMat(feat);
+        keys.push_back(kaldi_reader.Key());
       }
-      std::ofstream fdat(fname.c_str());
+      feats.resize(keys.size());
+
+      converter.Format(feats, &bufs);
 
-      for(int32 r=0; r<feat.NumRows(); ++r){
-        for (int32 c=0; c<feat.NumCols(); ++c){
-          fdat << feat(r,c) << " ";
+      for (size_t i = 0; i < keys.size(); ++i) {
+        std::string fname = data_directory+keys[i];
+        if (data_suffix!=""){
+          fname = fname + "." +data_suffix;
         }
-        fdat << std::endl;
+        if (!WriteStringToFile(fname, bufs[i])) {
+          KALDI_ERR << "Could not write " << fname;
+        }
+        total_frames += feats[i].NumRows();
       }
-
-      fdat.close();
-      total_frames += feat.NumRows();
     }
 
+    KALDI_LOG << "Written " << total_frames << " frames.";
+
     return 0;
   } catch (const std::exception &e) {
     std::cerr << e.what();
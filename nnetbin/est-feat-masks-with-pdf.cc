@@ -1,7 +1,7 @@
-// nnetbin/est-feat-masks.cc
+// nnetbin/est-feat-masks-with-pdf.cc
 //
-// Estimate the masks for each utterance based on the NN posteriors and
-// prior mask patterns.
+// Estimate the masks for each utterance based on the pdf label for each frame.
+// i.e. simply selecting the patterns.
 //
 
 #include "base/kaldi-common.h"
@@ -14,10 +14,12 @@ int main(int argc, char *argv[]) {
 
   try {
     const char *usage =
-        "Estimate masks for each utterance and save to the specific folder.\n"
-            "Usage:  est-feat-masks [options] <pat-wxfilename> <post-rspecifier>\n"
+        "Estimate masks for each utterance and save to the specific folder,\n"
+            "or to an archive when <mask-wspecifier> is given.\n"
+            "Usage:  est-feat-masks-with-pdf [options] <pat-wxfilename> <pdf-rspecifier> [<mask-wspecifier>]\n"
             "e.g.: \n"
-            " est-feat-masks --data-directory=mask_est --data-suffix=txt mask_patterns scp:post.scp\n";
+            " est-feat-masks-with-pdf --data-directory=mask_est --data-suffix=txt mask_patterns scp:pdf.scp\n"
+            " est-feat-masks-with-pdf mask_patterns scp:pdf.scp ark,scp:mask.ark,mask.scp\n";
 
     ParseOptions po(usage);
 
@@ -30,19 +32,24 @@ int main(int argc, char *argv[]) {
 
     po.Read(argc, argv);
 
-    if (po.NumArgs() != 2) {
+    if (po.NumArgs() != 2 && po.NumArgs() != 3) {
       po.PrintUsage();
       exit(1);
     }
 
     std::string pat_wxfilename = po.GetArg(1),
-        pdf_rspecifier = po.GetArg(2);
+        pdf_rspecifier = po.GetArg(2),
+        mask_wspecifier = po.GetOptArg(3);
 
     if (data_directory != "") {
       data_directory += "/";
     }
 
     SequentialInt32VectorReader pdf_reader(pdf_rspecifier);
+    BaseFloatMatrixWriter mask_writer;
+    if (mask_wspecifier != "") {
+      mask_writer.Open(mask_wspecifier);
+    }
 
     Timer tim;
 
@@ -54,10 +61,25 @@ int main(int argc, char *argv[]) {
       patterns.Read(ki.Stream(), binary);
     }
 
+    Matrix<BaseFloat> mask;
     for (; !pdf_reader.Done(); pdf_reader.Next()) {
       // get the keys
       std::string utt = pdf_reader.Key();
-      std::vector<int32> labs = pdf_reader.Value();
+      const std::vector<int32> &labs = pdf_reader.Value();
+
+      if (mask_wspecifier != "") {
+        mask.Resize(labs.size(), patterns.NumCols());
+        for (int32 r = 0; r < labs.size(); ++r) {
+          mask.Row(r).CopyFromVec(patterns.Row(labs[r]));
+        }
+        mask_writer.Write(utt, mask);
+
+        num_done++;
+        if (num_done % 1000 == 0) {
+          KALDI_LOG<< "Done " << num_done << " files.";
+        }
+        continue;
+      }
 
       std::string fname = data_directory + utt;
       if (data_suffix != ""){
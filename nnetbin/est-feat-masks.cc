@@ -1,23 +1,84 @@
-// nnetbin/est-feat-masks-with-pdf.cc
+// nnetbin/est-feat-masks.cc
 //
-// Estimate the masks for each utterance based on the pdf label for each frame.
-// i.e. simply selecting the patterns.
+// Estimate the masks for each utterance based on the NN posteriors and
+// prior mask patterns.
 //
 
+#include <pthread.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
 
+namespace kaldi {
+
+struct MaskJob {
+  const Matrix<BaseFloat> *patterns;
+  const std::vector<Matrix<BaseFloat> > *posts;
+  std::vector<Matrix<BaseFloat> > *masks;
+  int32 first, step, end;  // utterances first, first+step, ... < end
+  int32 top_k;
+  BaseFloat min_post;
+};
+
+// mask = post * patterns, with top_k > 0 or min_post > 0 only the top_k
+// posteriors of each frame above min_post are used
+void EstimateMask(const Matrix<BaseFloat> &post,
+                  const Matrix<BaseFloat> &patterns, int32 top_k,
+                  BaseFloat min_post, Matrix<BaseFloat> *mask) {
+  mask->Resize(post.NumRows(), patterns.NumCols());
+  if (top_k <= 0 && min_post <= 0.0) {
+    mask->AddMatMat(1.0, post, kNoTrans, patterns, kNoTrans, 0.0);
+    return;
+  }
+
+  std::vector<std::pair<BaseFloat, int32> > top;
+  for (int32 r = 0; r < post.NumRows(); ++r) {
+    top.clear();
+    for (int32 c = 0; c < post.NumCols(); ++c) {
+      if (post(r, c) > min_post) {
+        top.push_back(std::make_pair(post(r, c), c));
+      }
+    }
+    if (top_k > 0 && static_cast<int32>(top.size()) > top_k) {
+      std::nth_element(top.begin(), top.begin() + top_k, top.end(),
+                       std::greater<std::pair<BaseFloat, int32> >());
+      top.resize(top_k);
+    }
+    SubVector<BaseFloat> row(*mask, r);
+    for (size_t k = 0; k < top.size(); ++k) {
+      row.AddVec(top[k].first, patterns.Row(top[k].second));
+    }
+  }
+}
+
+void* RunMaskJob(void *arg) {
+  MaskJob *job = static_cast<MaskJob*>(arg);
+  for (int32 i = job->first; i < job->end; i += job->step) {
+    EstimateMask((*job->posts)[i], *job->patterns, job->top_k, job->min_post,
+                 &(*job->masks)[i]);
+  }
+  return NULL;
+}
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   using namespace kaldi;
   typedef kaldi::int32 int32;
 
   try {
     const char *usage =
-        "Estimate masks for each utterance and save to the specific folder.\n"
-            "Usage:  est-feat-masks-with-pdf [options] <pat-wxfilename> <pdf-rspecifier>\n"
+        "Estimate masks for each utterance and save to the specific folder,\n"
+            "or to an archive when <mask-wspecifier> is given.\n"
+            "Usage:  est-feat-masks [options] <pat-wxfilename> <post-rspecifier> [<mask-wspecifier>]\n"
             "e.g.: \n"
-            " est-feat-masks-with-pdf --data-directory=mask_est --data-suffix=txt mask_patterns scp:pdf.scp\n";
+            " est-feat-masks --data-directory=mask_est --data-suffix=txt mask_patterns scp:post.scp\n"
+            " est-feat-masks --top-k=5 --num-threads=4 mask_patterns scp:post.scp ark,scp:mask.ark,mask.scp\n";
 
     ParseOptions po(usage);
 
@@ -28,21 +89,44 @@ int main(int argc, char *argv[]) {
     std::string data_suffix = "";
     po.Register("data-suffix", &data_suffix, "The suffix for the text data");
 
+    int32 top_k = 0;
+    po.Register("top-k", &top_k,
+                "Use only the top-k posteriors of each frame (0 uses all)");
+
+    BaseFloat min_post = 0.0;
+    po.Register("min-post", &min_post,
+                "Skip the posteriors not above this value");
+
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads estimating the masks");
+
+    int32 batch_size = 256;
+    po.Register("batch-size", &batch_size,
+                "Number of utterances estimated at a time");
+
     po.Read(argc, argv);
 
-    if (po.NumArgs() != 2) {
+    if (po.NumArgs() != 2 && po.NumArgs() != 3) {
       po.PrintUsage();
       exit(1);
     }
 
     std::string pat_wxfilename = po.GetArg(1),
-        post_rspecifier = po.GetArg(2);
+        post_rspecifier = po.GetArg(2),
+        mask_wspecifier = po.GetOptArg(3);
 
     if (data_directory != "") {
       data_directory += "/";
     }
+    num_threads = std::max(num_threads, 1);
+    batch_size = std::max(batch_size, num_threads);
 
     SequentialBaseFloatMatrixReader post_reader(post_rspecifier);
+    BaseFloatMatrixWriter mask_writer;
+    if (mask_wspecifier != "") {
+      mask_writer.Open(mask_wspecifier);
+    }
 
     Timer tim;
 
@@ -54,30 +138,82 @@ int main(int argc, char *argv[]) {
       patterns.Read(ki.Stream(), binary);
     }
 
-    for (; !post_reader.Done(); post_reader.Next()) {
-      // get the keys
-      std::string utt = post_reader.Key();
-      const Matrix<BaseFloat> &post = post_reader.Value();
-
-      Matrix<BaseFloat> mask(post.NumRows(), patterns.NumCols());
-      mask.AddMatMat(1.0, post, kNoTrans, patterns, kNoTrans, 0.0);
-
-      std::ofstream fdat((data_directory + utt + "." + data_suffix).c_str());
+    std::vector<std::string> keys;
+    std::vector<Matrix<BaseFloat> > posts(batch_size), masks(batch_size);
+    while (!post_reader.Done()) {
+      // read a batch of utterances
+      keys.clear();
+      for (; !post_reader.Done() && static_cast<int32>(keys.size()) < batch_size;
+          post_reader.Next()) {
+        const Matrix<BaseFloat> &post = post_reader.Value();
+        if (post.NumCols() != patterns.NumRows()) {
+          KALDI_ERR<< "Posterior dimension mismatch for " << post_reader.Key()
+          << ": " << post.NumCols() << " vs. " << patterns.NumRows();
+        }
+        Matrix<BaseFloat> &dst = posts[keys.size()];
+        dst.Resize(post.NumRows(), post.NumCols());
+        dst.CopyFromMat(post);
+        keys.push_back(post_reader.Key());
+      }
 
-      for (int32 r = 0; r < mask.NumRows(); ++r) {
-        for (int32 c = 0; c < mask.NumCols(); ++c) {
-          fdat << mask(r, c) << " ";
+      // estimate the masks, the utterances are interleaved over the threads
+      int32 num_utts = keys.size();
+      int32 num_jobs = std::min(num_threads, num_utts);
+      std::vector<MaskJob> jobs(num_jobs);
+      for (int32 t = 0; t < num_jobs; ++t) {
+        MaskJob &job = jobs[t];
+        job.patterns = &patterns;
+        job.posts = &posts;
+        job.masks = &masks;
+        job.first = t;
+        job.step = num_jobs;
+        job.end = num_utts;
+        job.top_k = top_k;
+        job.min_post = min_post;
+      }
+      if (num_jobs == 1) {
+        RunMaskJob(&jobs[0]);
+      } else {
+        std::vector<pthread_t> threads(num_jobs);
+        int32 num_started = 0;
+        int ret = 0;
+        for (; num_started < num_jobs; ++num_started) {
+          ret = pthread_create(&threads[num_started], NULL, RunMaskJob,
+                               &jobs[num_started]);
+          if (ret != 0) break;
+        }
+        // the started threads use jobs and masks, wait for them first
+        for (int32 t = 0; t < num_started; ++t) {
+          pthread_join(threads[t], NULL);
+        }
+        if (ret != 0) {
+          KALDI_ERR<< "Error creating thread, errno was: " << ret;
         }
-        fdat << std::endl;
       }
 
-      fdat.close();
+      // write in the input order
+      for (int32 i = 0; i < num_utts; ++i) {
+        const Matrix<BaseFloat> &mask = masks[i];
+        if (mask_wspecifier != "") {
+          mask_writer.Write(keys[i], mask);
+        } else {
+          std::ofstream fdat((data_directory + keys[i] + "." + data_suffix).c_str());
+
+          for (int32 r = 0; r < mask.NumRows(); ++r) {
+            for (int32 c = 0; c < mask.NumCols(); ++c) {
+              fdat << mask(r, c) << " ";
+            }
+            fdat << std::endl;
+          }
+
+          fdat.close();
+        }
 
-      num_done++;
-      if (num_done % 1000 == 0) {
-        KALDI_LOG<< "Done " << num_done << " files.";
+        num_done++;
+        if (num_done % 1000 == 0) {
+          KALDI_LOG<< "Done " << num_done << " files.";
+        }
       }
-
     }
 
     std::cout << "\n" << std::flush;
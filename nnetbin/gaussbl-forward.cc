@@ -55,6 +55,10 @@ int main(int argc, char *argv[]) {
     bool silent = false;
     po.Register("silent", &silent, "Don't print any messages");
 
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads for the VTS compensation of the GMMs");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 3 && po.NumArgs() != 4) {
@@ -88,6 +92,7 @@ int main(int argc, char *argv[]) {
     KALDI_ASSERT(comp->GetType() == Component::kGaussBL);
 
     GaussBL *layer = static_cast<GaussBL*>(nnet.Layer(0));
+    layer->SetNumThreads(num_threads);
 
     kaldi::int64 tot_t = 0;
 
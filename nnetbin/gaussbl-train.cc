@@ -16,6 +16,7 @@
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
 #include "nnet/nnet-gaussbl.h"
+#include "nnet/nnet-ali-prefetch.h"
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -71,6 +72,9 @@ int main(int argc, char *argv[]) {
     bool average_grad = false;
     po.Register("average-grad", &average_grad, "Average the gradient in the bunch");
 
+    int32 prefetch = 0;
+    po.Register("prefetch-alignments", &prefetch, "Number of alignments read ahead on a background thread (needs scp features, 0 = off)");
+
     po.Read(argc, argv);
 
     if (!cross_validate && update_flag != "model" && update_flag != "noise") {
@@ -119,7 +123,7 @@ int main(int argc, char *argv[]) {
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomAccessDoubleVectorReader noiseparams_reader(noise_rspecifier);
-    RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
+    AlignmentPrefetcher alignments_reader(feature_rspecifier, alignments_rspecifier, prefetch);
 
     // only used when update_flag = "noise"
     DoubleVectorWriter noise_writer;
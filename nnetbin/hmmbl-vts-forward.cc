@@ -30,6 +30,15 @@ int main(int argc, char *argv[]) {
     bool apply_exp = true;
     po.Register("apply-exp", &apply_exp, "Apply Exponential to the acts, such that the acts are exactly the likelihood.");
 
+    bool pdf_loglikes = false;
+    po.Register("pdf-loglikes", &pdf_loglikes, "Output the per-pdf log-likelihoods of the weighted Gaussians instead of the per-Gaussian acts (--apply-exp is ignored).");
+
+    int32 gauss_block_size = 8192;
+    po.Register("gauss-block-size", &gauss_block_size, "Number of Gaussians scored at a time with --pdf-loglikes.");
+
+    int32 top_k = 0;
+    po.Register("top-k", &top_k, "Sum only the top-k Gaussians of each pdf per frame with --pdf-loglikes, 0 for all.");
+
     int32 num_cepstral = 13;
     po.Register("num-cepstral", &num_cepstral, "Number of cepstral features in MFCC.");
 
@@ -58,6 +67,7 @@ int main(int argc, char *argv[]) {
     HMMBL &hmmbl = dynamic_cast<HMMBL&>(*nnet.Layer(0));
 
     hmmbl.EnableExp(apply_exp);
+    hmmbl.SetPdfPooling(gauss_block_size, top_k);
 
     Matrix<double> dct_mat, inv_dct_mat;
     GenerateDCTmatrix(num_cepstral, num_fbank, ceplifter, &dct_mat, &inv_dct_mat);
@@ -111,7 +121,11 @@ int main(int argc, char *argv[]) {
       (SubMatrix<BaseFloat>(feat, 0, num, dim, dim)).ApplyPow(2.0);
 
       in.CopyFromMat(feat);
-      hmmbl.Propagate(in, &out);
+      if (pdf_loglikes) {
+        hmmbl.PropagatePdfs(in, &out);
+      } else {
+        hmmbl.Propagate(in, &out);
+      }
 
       out.CopyToMat(&out_host);
 
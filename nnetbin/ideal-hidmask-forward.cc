@@ -15,6 +15,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
+#include "cudamatrix/cu-math.h"
 
 
 int main(int argc, char *argv[]) {
@@ -39,6 +40,10 @@ int main(int argc, char *argv[]) {
     BaseFloat alpha = 1.0;
     po.Register("alpha", &alpha, "Alpha value for the hidden mask compuation");
 
+    bool stack_clean_noisy = false;
+    po.Register("stack-clean-noisy", &stack_clean_noisy, "Forward the features and the reference "
+                "features through the l1 model in one stacked pass (l1 model must work frame by frame)");
+
     std::string feature_transform;
     po.Register("feature-transform", &feature_transform, "Feature transform Neural Network");
 
@@ -152,24 +157,18 @@ int main(int argc, char *argv[]) {
       nnet_transf.Feedforward(feats, &feats_transf);
       nnet_transf.Feedforward(ref_feats, &ref_feats_transf);
 
-      nnet.Feedforward(feats_transf, &l1_out);
-      nnet.Feedforward(ref_feats_transf, &ref_l1_out);
+      if(stack_clean_noisy) {
+        nnet.FeedforwardStacked(feats_transf, ref_feats_transf, &l1_out, &ref_l1_out);
+      } else {
+        nnet.Feedforward(feats_transf, &l1_out);
+        nnet.Feedforward(ref_feats_transf, &ref_l1_out);
+      }
 
       /*
        * Do masking
        *
        */
-      if(hidmask.NumRows()!=l1_out.NumRows() || hidmask.NumCols() != l1_out.NumCols()){
-        hidmask.Resize(l1_out.NumRows(), l1_out.NumCols());
-      }
-      hidmask.CopyFromMat(l1_out);
-      hidmask.AddMat(-1.0, ref_l1_out, 1.0);
-      hidmask.Power(2.0);
-      hidmask.Scale(-1.0*alpha);
-      hidmask.ApplyExp();
-      if(binarize_mask) hidmask.Binarize(binarize_threshold);
-
-      l1_out.MulElements(hidmask);
+      cu::HidMask(l1_out, ref_l1_out, alpha, binarize_mask, binarize_threshold, &hidmask, &l1_out);
 
       // forward through the backend dnn
       if(backend_nnet != ""){
@@ -3,6 +3,9 @@
  * Single iteration of training.
  * Train a LIN per utterance and save the transforms in archive file.
  * Due to the only utterance, train and cv are the same.
+ *
+ * With --batch-size, the LINs of several utterances are trained together,
+ * their frames go through the rest of the network at once (see LinBatch).
  */
 
 #include "nnet/nnet-nnet.h"
@@ -12,6 +15,8 @@
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
 #include "nnet/nnet-linbl.h"
+#include "nnet/nnet-lin-batch.h"
+#include "nnet/nnet-ali-prefetch.h"
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -49,12 +54,22 @@ int main(int argc, char *argv[]) {
     bool average_grad = false;
     po.Register("average-grad", &average_grad, "Average the gradent or not");
 
+    int32 batch_size = 1;
+    po.Register("batch-size", &batch_size,
+                "Number of utterances whose LINs are trained together");
+
+    int32 prefetch = 0;
+    po.Register("prefetch-alignments", &prefetch, "Number of alignments read ahead on a background thread (needs scp features, 0 = off)");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5) {
       po.PrintUsage();
       exit(1);
     }
+    if (batch_size < 1) {
+      KALDI_ERR<< "Invalid batch size " << batch_size;
+    }
 
     std::string si_model_filename = po.GetArg(1),
         feature_rspecifier = po.GetArg(2),
@@ -73,27 +88,20 @@ int main(int argc, char *argv[]) {
     Nnet nnet;
     nnet.Read(si_model_filename);
 
-    // construct the learn factors, only learn the first LIN layer,
-    // i.e. "1,0,0,0,...,0"
-    std::string learn_factors = "1";
-    for (int32 i = 1; i < nnet.LayerCount(); ++i) {
-      if (nnet.Layer(i)->IsUpdatable())
-        learn_factors += ",0";
-    }
-
-    nnet.SetAverageGrad(average_grad);
-    nnet.SetMomentum(momentum);
-    nnet.SetL2Penalty(l2_penalty);
-    nnet.SetL1Penalty(l1_penalty);
-    nnet.SetLearnRate(learn_rate, learn_factors.c_str());
-
     if (nnet.Layer(0)->GetType() != Component::kLinBL) {
       KALDI_ERR<< "The first layer is not <linbl> layer!";
     }
-    LinBL *lin = static_cast<LinBL*>(nnet.Layer(0));
+    // the LINs are trained apart from the rest of the network
+    LinBL *lin = static_cast<LinBL*>(nnet.RemoveFirstLayer());
+
+    LinBatch batch(*lin, &nnet);
+    batch.SetAverageGrad(average_grad);
+    batch.SetMomentum(momentum);
+    batch.SetL2Penalty(l2_penalty);
+    batch.SetL1Penalty(l1_penalty);
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
+    AlignmentPrefetcher alignments_reader(feature_rspecifier, alignments_rspecifier, prefetch);
 
     RandomAccessBaseFloatMatrixReader weight_reader(weight_init);
     RandomAccessBaseFloatVectorReader bias_reader(bias_init);
@@ -101,9 +109,7 @@ int main(int argc, char *argv[]) {
     BaseFloatMatrixWriter weight_writer(weight_wspecifier);
     BaseFloatVectorWriter bias_writer(bias_wspecifier);
 
-    Xent xent;
-
-    CuMatrix<BaseFloat> feats, feats_transf, nnet_out, glob_err;
+    CuMatrix<BaseFloat> feats, feats_transf;
 
     Matrix<BaseFloat> lin_weight;
     Vector<BaseFloat> lin_bias;
@@ -115,75 +121,76 @@ int main(int argc, char *argv[]) {
 
     int32 num_done = 0, num_no_alignment = 0, num_other_error = 0;
     /* initialize variables */
-    BaseFloat acc;
-
-    for (; !feature_reader.Done();) {
-      std::string key = feature_reader.Key();
-
-      if (!alignments_reader.HasKey(key)) {
-        num_no_alignment++;
-        continue;
-      }
+    std::vector<BaseFloat> acc;
 
+    while (!feature_reader.Done()) {
       /*
-       * LIN Training for the current utterance
+       * Collect the next utterances
        */
-
-      /* Feature preparation */
-      const Matrix<BaseFloat> &mat = feature_reader.Value();
-      const std::vector<int32> &alignment = alignments_reader.Value(key);
-
-      // std::cout << mat;
-
-      if ((int32) alignment.size() != mat.NumRows()) {
-        KALDI_WARN<< "Alignment has wrong size "<< (alignment.size()) << " vs. "<< (mat.NumRows());
-        num_other_error++;
-        continue;
-      }
+      std::vector<std::string> keys;
+      batch.Clear();
+      for (; !feature_reader.Done() && batch.NumUtterances() < batch_size;
+           feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!alignments_reader.HasKey(key)) {
+          num_no_alignment++;
+          continue;
+        }
+        const Matrix<BaseFloat> &mat = feature_reader.Value();
+        const std::vector<int32> &alignment = alignments_reader.Value(key);
+
+        if ((int32) alignment.size() != mat.NumRows()) {
+          KALDI_WARN<< "Alignment has wrong size "<< (alignment.size()) << " vs. "<< (mat.NumRows());
+          num_other_error++;
+          continue;
+        }
 
         /* forward feats through input transform if has */
-      feats.CopyFromMat(mat);  // push features to GPU
-      nnet_transf.Feedforward(feats, &feats_transf);
-
-      /* initialize si nnet */
-      lin->SetToIdentity();
-      if (weight_init != "" && weight_reader.HasKey(key)) {
-        lin->SetLinearityWeight(weight_reader.Value(key), false);
+        feats.CopyFromMat(mat);  // push features to GPU
+        nnet_transf.Feedforward(feats, &feats_transf);
+        batch.AddUtterance(feats_transf, alignment);
+        keys.push_back(key);
       }
-      if (bias_init != "" && bias_reader.HasKey(key)) {
-        lin->SetBiasWeight(bias_reader.Value(key));
+      if (keys.empty()) break;
+
+      /*
+       * LIN Training for the utterances of the batch
+       */
+      int32 num_utts = keys.size();
+      batch.Start();
+      for (int32 u = 0; u < num_utts; u++) {
+        if (weight_init != "" && weight_reader.HasKey(keys[u])) {
+          batch.SetLin(u, weight_reader.Value(keys[u]));
+        }
+        if (bias_init != "" && bias_reader.HasKey(keys[u])) {
+          batch.SetBias(u, bias_reader.Value(keys[u]));
+        }
       }
 
       /* pre-run cross-validation */
-      nnet.Propagate(feats_transf, &nnet_out);
-      xent.Reset();
-      xent.EvalVec(nnet_out, alignment, &glob_err);
-
-      // update the model
-      nnet.Backpropagate(glob_err, NULL);
+      batch.Evaluate(&acc);
 
-      /* save the LIN */
-      (lin->GetLinearityWeight()).CopyToMat(&lin_weight);
-      (lin->GetBiasWeight()).CopyToVec(&lin_bias);
+      // update the models
+      batch.Update(std::vector<BaseFloat>(num_utts, learn_rate));
 
-      weight_writer.Write(key, lin_weight);
-      bias_writer.Write(key, lin_bias);
+      /* test the updated models */
+      batch.Evaluate(&acc);
 
-      /* test the updated model */
-      nnet.Propagate(feats_transf, &nnet_out);
-      xent.Reset();
-      xent.EvalVec(nnet_out, alignment, &glob_err);
-      acc = xent.GetFrameAccuracy();
+      /* save the LINs, in the input order */
+      for (int32 u = 0; u < num_utts; u++) {
+        batch.GetLin(u, &lin_weight, &lin_bias);
+        weight_writer.Write(keys[u], lin_weight);
+        bias_writer.Write(keys[u], lin_bias);
 
-      KALDI_LOG<< "*** Utterance: " << key << ", [" << mat.NumRows() << " frames][CV " << acc << "]";
+        KALDI_LOG<< "*** Utterance: " << keys[u] << ", [" << batch.NumFrames(u) << " frames][CV " << acc[u] << "]";
+      }
 
-      ++num_done;
-      if (num_done % 1000 == 0) {
+      num_done += num_utts;
+      if (num_done / 1000 != (num_done - num_utts) / 1000) {
         KALDI_LOG<< "[" << num_done << " done]";
       }
-
-      feature_reader.Next();
     }
+    delete lin;
 
     std::cout << "\n" << std::flush;
 
@@ -2,6 +2,9 @@
 /*
  * Train a LIN per utterance and save the transforms in archive file.
  * Due to the only utterance, train and cv are the same.
+ *
+ * With --batch-size, the LINs of several utterances are trained together,
+ * their frames go through the rest of the network at once (see LinBatch).
  */
 
 #include "nnet/nnet-nnet.h"
@@ -11,6 +14,8 @@
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
 #include "nnet/nnet-linbl.h"
+#include "nnet/nnet-lin-batch.h"
+#include "nnet/nnet-ali-prefetch.h"
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -56,12 +61,22 @@ int main(int argc, char *argv[]) {
     bool average_grad = false;
     po.Register("average-grad", &average_grad, "Average the gradient");
 
+    int32 batch_size = 1;
+    po.Register("batch-size", &batch_size,
+                "Number of utterances whose LINs are trained together");
+
+    int32 prefetch = 0;
+    po.Register("prefetch-alignments", &prefetch, "Number of alignments read ahead on a background thread (needs scp features, 0 = off)");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5) {
       po.PrintUsage();
       exit(1);
     }
+    if (batch_size < 1) {
+      KALDI_ERR<< "Invalid batch size " << batch_size;
+    }
 
     std::string si_model_filename = po.GetArg(1),
         feature_rspecifier = po.GetArg(2),
@@ -80,146 +95,130 @@ int main(int argc, char *argv[]) {
     Nnet nnet;
     nnet.Read(si_model_filename);
 
-    // construct the learn factors, only learn the first LIN layer,
-    // i.e. "1,0,0,0,...,0"
-    std::string learn_factors = "1";
-    for (int32 i = 1; i < nnet.LayerCount(); ++i) {
-      if (nnet.Layer(i)->IsUpdatable())
-        learn_factors += ",0";
-    }
-
-    nnet.SetMomentum(momentum);
-    nnet.SetL2Penalty(l2_penalty);
-    nnet.SetL1Penalty(l1_penalty);
-
     if (nnet.Layer(0)->GetType() != Component::kLinBL) {
       KALDI_ERR<< "The first layer is not <linbl> layer!";
     }
-    LinBL *lin = static_cast<LinBL*>(nnet.Layer(0));
+    // the LINs are trained apart from the rest of the network
+    LinBL *lin = static_cast<LinBL*>(nnet.RemoveFirstLayer());
+
+    LinBatch batch(*lin, &nnet);
+    batch.SetMomentum(momentum);
+    batch.SetL2Penalty(l2_penalty);
+    batch.SetL1Penalty(l1_penalty);
+    batch.SetAverageGrad(average_grad);
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
+    AlignmentPrefetcher alignments_reader(feature_rspecifier, alignments_rspecifier, prefetch);
 
     BaseFloatMatrixWriter weight_writer(weight_wspecifier);
     BaseFloatVectorWriter bias_writer(bias_wspecifier);
 
-    Xent xent;
-
-    CuMatrix<BaseFloat> feats, feats_transf, nnet_out, glob_err, prev_weight;
-    CuVector<BaseFloat> prev_bias;
+    CuMatrix<BaseFloat> feats, feats_transf;
 
     Matrix<BaseFloat> lin_weight;
     Vector<BaseFloat> lin_bias;
 
     int32 num_done = 0, num_no_alignment = 0, num_other_error = 0;
-    for (; !feature_reader.Done();) {
-      std::string key = feature_reader.Key();
-
-      if (!alignments_reader.HasKey(key)) {
-        num_no_alignment++;
-      } else {
-        Timer lin_timer;
-        /*
-         * LIN Training for the current utterance
-         */
-        KALDI_LOG << "============================================================";
-        KALDI_LOG << "*** Utterance: " << key;
-        KALDI_LOG << "Training started ...";
-
-        /* initialize variables */
-        BaseFloat acc, acc_new, acc_prev;
-        BaseFloat learn_rate = learn_rate_init_val;
-
-        /* Feature preparation */
+    while (!feature_reader.Done()) {
+      /*
+       * Collect the next utterances
+       */
+      std::vector<std::string> keys;
+      batch.Clear();
+      for (; !feature_reader.Done() && batch.NumUtterances() < batch_size;
+           feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!alignments_reader.HasKey(key)) {
+          num_no_alignment++;
+          continue;
+        }
         const Matrix<BaseFloat> &mat = feature_reader.Value();
         const std::vector<int32> &alignment = alignments_reader.Value(key);
 
-        // std::cout << mat;
-
         if ((int32) alignment.size() != mat.NumRows()) {
           KALDI_WARN<< "Alignment has wrong size "<< (alignment.size()) << " vs. "<< (mat.NumRows());
           num_other_error++;
           continue;
         }
 
-        KALDI_LOG << "[" << mat.NumRows() << " frames]";
-
-          /* forward feats through input transform if has */
+        /* forward feats through input transform if has */
         feats.CopyFromMat(mat);  // push features to GPU
         nnet_transf.Feedforward(feats, &feats_transf);
+        batch.AddUtterance(feats_transf, alignment);
+        keys.push_back(key);
+      }
+      if (keys.empty()) break;
 
-        /* initialize si nnet */
-        lin->SetToIdentity();
-        nnet.SetLearnRate(learn_rate, learn_factors.c_str());
-
-        /* pre-run cross-validation */
-        nnet.Propagate(feats_transf, &nnet_out);
-        xent.Reset();
-        xent.EvalVec(nnet_out, alignment, &glob_err);
-        acc=xent.GetFrameAccuracy();
-        KALDI_LOG << "CROSSVAL PRERUN ACCURACY " << acc ;
-
-        for(int32 iter=0; iter < max_iters; ++iter){
-          // keep a copy of the current model
-          prev_weight.CopyFromMat(lin->GetLinearityWeight());
-          prev_bias.CopyFromVec(lin->GetBiasWeight());
-
-          // update the model
-          nnet.Backpropagate(glob_err, NULL);
-
-          // cross-validation
-          nnet.Propagate(feats_transf, &nnet_out);
-          xent.Reset();
-          xent.EvalVec(nnet_out, alignment, &glob_err);
-          acc_new=xent.GetFrameAccuracy();
-
-          acc_prev = acc;
-          if(acc_new > acc){
-            // accept the weight
-            acc = acc_new;
-
-            KALDI_LOG << "ITERATION " << iter << ": LRATE " << learn_rate
-                << " CROSSVAL ACCURACY " << acc_new << " [accepted]";
-          }else{
-            // reject and revert back the weight
-            lin->SetLinearityWeight(prev_weight, false);
-            lin->SetBiasWeight(prev_bias);
+      /*
+       * LIN Training for the utterances of the batch, each with its own
+       * learning rate and stopping
+       */
+      Timer lin_timer;
+      int32 num_utts = keys.size();
+      batch.Start();
 
-            KALDI_LOG << "ITERATION " << iter << ": LRATE " << learn_rate
-                << " CROSSVAL ACCURACY " << acc_new << " [rejected]";
-          }
+      std::vector<BaseFloat> acc, acc_new, acc_init;
+      std::vector<BaseFloat> learn_rate(num_utts, learn_rate_init_val);
+      std::vector<int32> num_iters(num_utts, 0);
 
-          if (learn_rate < learn_rate_end_val){
-            KALDI_LOG << "Too small learning rate " << learn_rate << "!";
-            break;
-          }
+      /* pre-run cross-validation */
+      batch.Evaluate(&acc);
+      acc_init = acc;
 
-          if (acc < acc_prev + start_halving_inc){
-            learn_rate = learn_rate * halving_factor;
-            nnet.SetLearnRate(learn_rate, learn_factors.c_str());
-          }
-        }
+      for (int32 iter = 0; iter < max_iters; ++iter) {
+        // keep a copy of the current models
+        batch.Backup();
 
-        /* save the LIN */
-        (lin->GetLinearityWeight()).CopyToMat(&lin_weight);
-        (lin->GetBiasWeight()).CopyToVec(&lin_bias);
+        // update the models
+        batch.Update(learn_rate);
 
-        weight_writer.Write(key, lin_weight);
-        bias_writer.Write(key, lin_bias);
+        // cross-validation
+        batch.Evaluate(&acc_new);
 
-        KALDI_LOG << "Training finished in " << lin_timer.Elapsed() << "s.";
-        KALDI_LOG << "============================================================";
+        for (int32 u = 0; u < num_utts; u++) {
+          if (batch.Finished(u)) continue;
+          num_iters[u]++;
 
+          BaseFloat acc_prev = acc[u];
+          if (acc_new[u] > acc[u]) {
+            // accept the weight
+            acc[u] = acc_new[u];
+          } else {
+            // reject and revert back the weight
+            batch.Restore(u);
+          }
 
-        ++num_done;
-        if(num_done % 1000 == 0){
-          KALDI_LOG << "[" << num_done << " done]";
+          if (learn_rate[u] < learn_rate_end_val) {
+            batch.Finish(u);
+          } else if (acc[u] < acc_prev + start_halving_inc) {
+            learn_rate[u] *= halving_factor;
+          }
+        }
+        bool all_finished = true;
+        for (int32 u = 0; u < num_utts; u++) {
+          all_finished = all_finished && batch.Finished(u);
         }
+        if (all_finished) break;
+      }
+
+      /* save the LINs, in the input order */
+      for (int32 u = 0; u < num_utts; u++) {
+        batch.GetLin(u, &lin_weight, &lin_bias);
+        weight_writer.Write(keys[u], lin_weight);
+        bias_writer.Write(keys[u], lin_bias);
 
+        KALDI_LOG << "*** Utterance: " << keys[u] << " [" << batch.NumFrames(u)
+            << " frames] CROSSVAL ACCURACY " << acc_init[u] << " -> " << acc[u]
+            << " after " << num_iters[u] << " iterations, LRATE " << learn_rate[u];
       }
+      KALDI_LOG << "Trained " << num_utts << " LINs in " << lin_timer.Elapsed() << "s.";
 
-      feature_reader.Next();
+      num_done += num_utts;
+      if (num_done / 1000 != (num_done - num_utts) / 1000) {
+        KALDI_LOG << "[" << num_done << " done]";
+      }
     }
+    delete lin;
 
     std::cout << "\n" << std::flush;
 
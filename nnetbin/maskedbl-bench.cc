@@ -0,0 +1,143 @@
+/*
+ * maskedbl-bench.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ *      Time the dense and the sparse (CSR) storage of <maskedbl>
+ *      at several mask densities.
+ */
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "util/timer.h"
+#include "nnet/nnet-maskedbl.h"
+
+namespace kaldi {
+
+struct BenchResult {
+  double propagate, backpropagate, update;
+};
+
+static void RunMaskedBL(MaskedBL *mbl, const CuMatrix<BaseFloat> &in,
+                        const CuMatrix<BaseFloat> &err, int32 num_iters,
+                        CuMatrix<BaseFloat> *out, BenchResult *res) {
+  CuMatrix<BaseFloat> out_err;
+  Timer tim;
+
+  res->propagate = res->backpropagate = res->update = 0.0;
+  for (int32 i = 0; i < num_iters; ++i) {
+    tim.Reset();
+    mbl->Propagate(in, out);
+    res->propagate += tim.Elapsed();
+
+    tim.Reset();
+    mbl->Backpropagate(err, &out_err);
+    res->backpropagate += tim.Elapsed();
+
+    tim.Reset();
+    mbl->Update(in, err);
+    res->update += tim.Elapsed();
+  }
+}
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Time the dense and sparse storage of <maskedbl> with random masks\n"
+            "Usage: maskedbl-bench [options]\n"
+            "e.g.: \n"
+            " maskedbl-bench --densities=5:10:20:50 --input-dim=1024 --output-dim=1024\n";
+
+    ParseOptions po(usage);
+
+    std::string densities_str = "5:10:20:50";
+    po.Register("densities", &densities_str,
+                "Colon separated list of the mask densities in percent");
+
+    int32 input_dim = 1024, output_dim = 1024;
+    po.Register("input-dim", &input_dim, "Input dimension of the layer");
+    po.Register("output-dim", &output_dim, "Output dimension of the layer");
+
+    int32 num_frames = 256;
+    po.Register("num-frames", &num_frames, "Number of frames in a minibatch");
+
+    int32 num_iters = 20;
+    po.Register("num-iters", &num_iters, "Number of minibatches to time");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::vector<int32> densities;
+    if (!SplitStringToIntegers(densities_str, ":", false, &densities)) {
+      KALDI_ERR<< "Invalid densities " << densities_str;
+    }
+
+    Matrix<BaseFloat> mat(num_frames, input_dim);
+    mat.SetRandn();
+    CuMatrix<BaseFloat> in;
+    in.CopyFromMat(mat);
+    mat.Resize(num_frames, output_dim);
+    mat.SetRandn();
+    mat.Scale(0.01);
+    CuMatrix<BaseFloat> err;
+    err.CopyFromMat(mat);
+
+    Matrix<BaseFloat> linearity(output_dim, input_dim);
+    linearity.SetRandn();
+    linearity.Scale(0.1);
+    Vector<BaseFloat> bias(output_dim);
+
+    for (size_t d = 0; d < densities.size(); ++d) {
+      Matrix<BaseFloat> mask(output_dim, input_dim);
+      for (int32 r = 0; r < output_dim; ++r) {
+        for (int32 c = 0; c < input_dim; ++c) {
+          mask(r, c) = ((rand() % 100) < densities[d] ? 1.0 : 0.0);
+        }
+      }
+
+      MaskedBL dense(input_dim, output_dim, NULL), sparse(input_dim,
+                                                           output_dim, NULL);
+      MaskedBL *layers[2] = { &dense, &sparse };
+      BenchResult res[2];
+      CuMatrix<BaseFloat> out[2];
+      for (int32 i = 0; i < 2; ++i) {
+        layers[i]->SetLinearityWeight(linearity, false);
+        layers[i]->SetBiasWeight(bias);
+        layers[i]->SetLearnRate(0.001);
+        layers[i]->SetMomentum(0.9);
+        layers[i]->SetMask(mask);
+        layers[i]->SetSparseThreshold(i == 0 ? 0.0 : 1.0);
+        RunMaskedBL(layers[i], in, err, num_iters, &out[i], &res[i]);
+      }
+
+      // both storages do the same updates
+      Matrix<BaseFloat> out_dense, out_sparse;
+      out[0].CopyToMat(&out_dense);
+      out[1].CopyToMat(&out_sparse);
+      out_sparse.AddMat(-1.0, out_dense);
+
+      KALDI_LOG<< "Density " << densities[d] << "% ("
+               << (sparse.IsSparse() ? "sparse" : "dense") << " storage)"
+               << ", dense/sparse seconds: propagate "
+               << res[0].propagate << "/" << res[1].propagate
+               << ", backpropagate " << res[0].backpropagate << "/"
+               << res[1].backpropagate << ", update " << res[0].update << "/"
+               << res[1].update << ", max output diff "
+               << std::max(out_sparse.Max(), -out_sparse.Min());
+    }
+
+  } catch(const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
@@ -19,6 +19,8 @@
 
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
+#include "nnet/nnet-maskedbl.h"
+#include "cudamatrix/cu-math.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
@@ -52,6 +54,14 @@ int main(int argc, char *argv[]) {
 
     po.Register("silent", &silent, "Don't print any messages");
 
+    int32 cpu_threads = 1;
+    po.Register("cpu-threads", &cpu_threads, "Number of threads of the frame splicing (Expand/Copy) when running on CPU");
+
+    BaseFloat sparse_threshold = 0.05;
+    po.Register("sparse-threshold", &sparse_threshold,
+                "<maskedbl> layers with a mask density up to this use the sparse "
+                "(CSR) weights on the CPU, 0 keeps them dense");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 3) {
@@ -66,6 +76,8 @@ int main(int argc, char *argv[]) {
     using namespace kaldi;
     typedef kaldi::int32 int32;
 
+    cu::SetCpuThreads(cpu_threads);
+
     Nnet nnet_transf;
     if(feature_transform != "") {
       nnet_transf.Read(feature_transform);
@@ -73,6 +85,7 @@ int main(int argc, char *argv[]) {
 
     Nnet nnet;
     nnet.Read(model_filename);
+    SetMaskedBLSparseThreshold(sparse_threshold, &nnet);
 
     kaldi::int64 tot_t = 0;
 
@@ -13,6 +13,7 @@
 #include "util/common-utils.h"
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-math.h"
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -37,6 +38,11 @@ int main(int argc, char *argv[]) {
     BaseFloat alpha = 3.0;
     po.Register("alpha", &alpha, "Alpha value for hidden masking");
 
+    bool stack_clean_noisy = false;
+    po.Register("stack-clean-noisy", &stack_clean_noisy,
+                "Forward the clean and noisy features through the front-end "
+                "in one stacked pass (front-end must work frame by frame)");
+
     bool binary = false,
         crossvalidate = false;
     po.Register("binary", &binary, "Write output in binary mode");
@@ -166,15 +172,16 @@ int main(int argc, char *argv[]) {
           nnet_transf.Feedforward(noisy_feats, &noisy_transf);
           nnet_transf.Feedforward(clean_feats, &clean_transf);
           // compute mask
-          nnet_frontend.Feedforward(noisy_transf, &noisy_hids);
-          nnet_frontend.Feedforward(clean_transf, &clean_hids);
-          hid_masks.CopyFromMat(noisy_hids);
-          hid_masks.AddMat(-1.0, clean_hids, 1.0);
-          hid_masks.Power(2.0);
-          hid_masks.Scale(-1.0 * alpha);
-          hid_masks.ApplyExp();
-          if (binarize_mask)
-            hid_masks.Binarize(binarize_threshold);
+          if (stack_clean_noisy) {
+            nnet_frontend.FeedforwardStacked(noisy_transf, clean_transf,
+                                             &noisy_hids, &clean_hids);
+          } else {
+            nnet_frontend.Feedforward(noisy_transf, &noisy_hids);
+            nnet_frontend.Feedforward(clean_transf, &clean_hids);
+          }
+          cu::HidMask(noisy_hids, clean_hids, alpha, binarize_mask,
+                      binarize_threshold, &hid_masks,
+                      static_cast<CuMatrix<BaseFloat>*>(NULL));
           // add to cache
           cache.AddData(noisy_transf, hid_masks);
           num_done++;
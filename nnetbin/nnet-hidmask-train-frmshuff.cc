@@ -8,6 +8,8 @@
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-cache-xent-tgtmat.h"
+#include "nnet/nnet-ali-prefetch.h"
+#include "cudamatrix/cu-math.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
@@ -47,6 +49,11 @@ int main(int argc, char *argv[]) {
     BaseFloat alpha = 3.0;
     po.Register("alpha", &alpha, "Alpha value for hidden masking");
 
+    bool stack_clean_noisy = false;
+    po.Register("stack-clean-noisy", &stack_clean_noisy,
+                "Forward the clean and noisy bunches through the front-end "
+                "in one stacked pass (front-end must work frame by frame)");
+
     BaseFloat learn_rate = 0.008,
         momentum = 0.0,
         l2_penalty = 0.0,
@@ -75,6 +82,9 @@ int main(int argc, char *argv[]) {
     po.Register("cachesize", &cachesize,
                 "Size of cache for frame level shuffling");
 
+    int32 prefetch = 0;
+    po.Register("prefetch-alignments", &prefetch, "Number of alignments read ahead on a background thread (needs scp features, 0 = off)");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 7 - (cross_validate ? 2 : 0)) {
@@ -132,7 +142,7 @@ int main(int argc, char *argv[]) {
 
     SequentialBaseFloatMatrixReader noisyfeats_reader(noisyfeats_rspecifier);
     SequentialBaseFloatMatrixReader cleanfeats_reader(cleanfeats_rspecifier);
-    RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
+    AlignmentPrefetcher alignments_reader(noisyfeats_rspecifier, alignments_rspecifier, prefetch);
 
     CacheXentTgtMat cache;  // using the tgtMat to save the clean feats
     cachesize = (cachesize / bunchsize) * bunchsize;  // ensure divisibility
@@ -217,26 +227,23 @@ int main(int argc, char *argv[]) {
         // get block of features pairs
         cache.GetBunch(&front_noisy_in, &nnet_labs, &front_clean_in);
 
-        if (!cross_validate) {  // do clean first so that the buffers are overwrittend by noisy features
-          nnet_frontend.Propagate(front_clean_in, &front_clean_out);
-        }
+        if (!cross_validate && stack_clean_noisy) {
+          // one pass, the buffers keep the noisy features for the backprop
+          nnet_frontend.PropagateStacked(front_clean_in, front_noisy_in,
+                                         &front_clean_out, &front_noisy_out);
+        } else {
+          if (!cross_validate) {  // do clean first so that the buffers are overwrittend by noisy features
+            nnet_frontend.Propagate(front_clean_in, &front_clean_out);
+          }
 
-        // forward through nnet_hidmask
-        nnet_frontend.Propagate(front_noisy_in, &front_noisy_out);
+          // forward through nnet_hidmask
+          nnet_frontend.Propagate(front_noisy_in, &front_noisy_out);
+        }
 
         if (!cross_validate) {
-          // compute hid masks
-          hid_masks.CopyFromMat(front_noisy_out);
-          hid_masks.AddMat(-1.0, front_clean_out, 1.0);
-          hid_masks.Power(2.0);
-          hid_masks.Scale(-1.0 * alpha);
-          hid_masks.ApplyExp();
-
-          if (binarize_mask)
-            hid_masks.Binarize(binarize_threshold);
-
-          // apply masks to hidden acts
-          front_noisy_out.MulElements(hid_masks);
+          // compute hid masks and apply them to hidden acts
+          cu::HidMask(front_noisy_out, front_clean_out, alpha, binarize_mask,
+                      binarize_threshold, &hid_masks, &front_noisy_out);
         }
 
         // forward through backend nnet
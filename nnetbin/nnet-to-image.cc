@@ -0,0 +1,50 @@
+// nnetbin/nnet-to-image.cc
+
+/*
+ * Created on: Oct 18, 2026
+ *     Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ * Convert the network into a memory-mapped model image, which all the
+ * tools reading the model by Nnet::Read(filename) load without parsing.
+ *
+ */
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "nnet/nnet-nnet.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Convert Neural Network model to a memory-mapped model image\n"
+        "Usage:  nnet-to-image [options] <model-in> <image-out>\n"
+        "e.g.:\n"
+        " nnet-to-image nnet.mdl nnet.img\n";
+
+    ParseOptions po(usage);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        image_out_filename = po.GetArg(2);
+
+    Nnet nnet;
+    nnet.Read(model_in_filename);
+
+    nnet.WriteImage(image_out_filename);
+
+    KALDI_LOG << "Written model image to " << image_out_filename;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
+
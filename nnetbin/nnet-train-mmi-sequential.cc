@@ -30,53 +30,14 @@
 
 #include "nnet/nnet-component.h"
 #include "nnet/nnet-nnet.h"
+#include "nnet/nnet-lat-prefetch.h"
+#include "nnet/nnet-frame-lattice.h"
 //#include "nnet/nnet-loss.h"
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
 
 
 
-namespace kaldi {
-
-void LatticeAcousticRescore(const Matrix<BaseFloat> &log_like,
-                            const TransitionModel &trans_model,
-                            const std::vector<int32> state_times,
-                            Lattice *lat) {
-  kaldi::uint64 props = lat->Properties(fst::kFstProperties, false);
-  if (!(props & fst::kTopSorted))
-    KALDI_ERR << "Input lattice must be topologically sorted.";
-
-  KALDI_ASSERT(!state_times.empty());
-  std::vector<std::vector<int32> > time_to_state(log_like.NumRows());
-  for (size_t i = 0; i < state_times.size(); i++) {
-    KALDI_ASSERT(state_times[i] >= 0);
-    if (state_times[i] < log_like.NumRows()) // end state may be past this..
-      time_to_state[state_times[i]].push_back(i);
-    else
-      KALDI_ASSERT(state_times[i] == log_like.NumRows()
-                   && "There appears to be lattice/feature mismatch.");
-  }
-
-  for (int32 t = 0; t < log_like.NumRows(); t++) {
-    for (size_t i = 0; i < time_to_state[t].size(); i++) {
-      int32 state = time_to_state[t][i];
-      for (fst::MutableArcIterator<Lattice> aiter(lat, state); !aiter.Done();
-           aiter.Next()) {
-        LatticeArc arc = aiter.Value();
-        int32 trans_id = arc.ilabel;
-        if (trans_id != 0) {  // Non-epsilon input label on arc
-          int32 pdf_id = trans_model.TransitionIdToPdf(trans_id);
-          arc.weight.SetValue2(-log_like(t,pdf_id) + arc.weight.Value2());
-          aiter.SetValue(arc);
-        }
-      }
-    }
-  }
-}
-
-} // namespace kaldi
-
-
 
 
 
@@ -117,6 +78,10 @@ int main(int argc, char *argv[]) {
     po.Register("old-acoustic-scale", &old_acoustic_scale,
                 "Add the current acoustic scores with some scale.");
 
+    int32 prefetch = 0, lattice_threads = 1;
+    po.Register("prefetch-lattices", &prefetch, "Number of denominator lattices read and preprocessed ahead on background threads (needs scp features, 0 = off)");
+    po.Register("lattice-threads", &lattice_threads, "Number of threads preprocessing the prefetched lattices");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 6-(crossvalidate?1:0)) {
@@ -162,13 +127,14 @@ int main(int argc, char *argv[]) {
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessLatticeReader den_lat_reader(den_lat_rspecifier);
+    LatticePrefetcher den_lat_reader(feature_rspecifier, den_lat_rspecifier, old_acoustic_scale, prefetch, lattice_threads);
     RandomAccessInt32VectorReader num_ali_reader(num_ali_rspecifier);
 
     //Xent xent; TODO, OBJECTIVE!
     
     CuMatrix<BaseFloat> feats, feats_transf, nnet_out, nnet_err;
     Matrix<BaseFloat> nnet_out_h, nnet_err_h;
+    FrameLattice den_frame_lat;
 
     std::vector<int32> targets;
 
@@ -186,7 +152,12 @@ int main(int argc, char *argv[]) {
     for( ; !feature_reader.Done(); feature_reader.Next()) {
       std::string key = feature_reader.Key();
       bool skip_utt = false;
-      if (!den_lat_reader.HasKey(key)) { num_no_den_lat++; skip_utt = true; }
+      // the lattice of every utterance is consumed, in the feature order
+      Lattice den_lat;
+      vector<int32> state_times;
+      int32 max_time;
+      LatticePrefetcher::Status lat_status = den_lat_reader.Get(key, &den_lat, &state_times, &max_time);
+      if (lat_status == LatticePrefetcher::kNoLattice) { num_no_den_lat++; skip_utt = true; }
       if (!num_ali_reader.HasKey(key)) { num_no_num_ali++; skip_utt = true; }
       if (!skip_utt) {
         //1) get the features, numerator alignment
@@ -200,20 +171,12 @@ int main(int argc, char *argv[]) {
         }
        
         
-        //2) get the denominator lattice, preprocess
-        Lattice den_lat = den_lat_reader.Value(key);
-        if (old_acoustic_scale != 1.0) {
-          fst::ScaleLattice(fst::AcousticLatticeScale(old_acoustic_scale), &den_lat);
-        }
-        // optionaly sort it topologically
-        kaldi::uint64 props = den_lat.Properties(fst::kFstProperties, false);
-        if (!(props & fst::kTopSorted)) {
-          if (fst::TopSort(&den_lat) == false)
-            KALDI_ERR << "Cycles detected in lattice.";
+        //2) the denominator lattice was preprocessed by the prefetcher
+        if (lat_status == LatticePrefetcher::kEmptyLattice) {
+          KALDI_WARN << "Empty lattice for utt " << key;
+          num_other_error++;
+          continue;
         }
-        // get the lattice length and times of states
-        vector<int32> state_times;
-        int32 max_time = kaldi::LatticeStateTimes(den_lat, &state_times);
         // check for temporal length of denominator lattices
         if (max_time != mat.NumRows()) {
           KALDI_WARN << "Denominator lattice has wrong length "<< max_time << " vs. "<< mat.NumRows();
@@ -232,14 +195,15 @@ int main(int argc, char *argv[]) {
         nnet_out.CopyToMat(&nnet_out_h);
         // TODO: poccibly divide by priors
 
-        //4) rescore the latiice
-        LatticeAcousticRescore(nnet_out_h, trans_model, state_times, &den_lat);
+        //4) rescore the latiice, over a frame-sorted copy of its arcs
+        den_frame_lat.Init(den_lat, state_times, trans_model);
+        den_frame_lat.AcousticRescore(nnet_out_h);
         if (acoustic_scale != 1.0 || lm_scale != 1.0)
-          fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &den_lat);
+          den_frame_lat.Scale(lm_scale, acoustic_scale);
 
-        //5) get the posteriors
-        kaldi::Posterior post;
-        lat_like = kaldi::LatticeForwardBackward(den_lat, &post, &lat_ac_like);
+        //5) get the posteriors of the pdfs
+        nnet_err_h.Resize(nnet_out_h.NumRows(), nnet_out_h.NumCols());
+        lat_like = den_frame_lat.ForwardBackward(&nnet_err_h, &lat_ac_like);
         //TODO: calculate the auxiliary function somehow...
         ali_ac_like = 0.0;
         for(int32 t=0; t<nnet_out_h.NumRows(); t++) {
@@ -261,15 +225,6 @@ int main(int argc, char *argv[]) {
         total_lat_ac_like += lat_ac_like;
         total_ali_ac_like += ali_ac_like;
 
-        //6) convert the Posterior to a matrix
-        nnet_err_h.Resize(nnet_out_h.NumRows(), nnet_out_h.NumCols());
-        nnet_out_h.SetZero();
-        for(int32 t=0; t<post.size(); t++) {
-          for(int32 arc=0; arc<post[t].size(); arc++) {
-            int32 pdf = trans_model.TransitionIdToPdf(post[t][arc].first);
-            nnet_err_h(t, pdf) += post[t][arc].second;
-          }
-        }
         //subtract the pdf-Viterbi-path
         for(int32 t=0; t<nnet_err_h.NumRows(); t++) {
           nnet_err_h(t, num_ali[t]) -= 1.0;
@@ -294,7 +249,8 @@ int main(int argc, char *argv[]) {
 
     KALDI_LOG << (crossvalidate?"CROSSVALIDATE":"TRAINING") << " FINISHED " 
               << tim.Elapsed() << "s, fps" << tot_t/tim.Elapsed()
-              << ", feature wait " << time_next << "s"; 
+              << ", feature wait " << time_next << "s"
+              << ", lattice wait " << den_lat_reader.WaitTime() << "s"; 
 
     KALDI_LOG << "Done " << num_done << " files, " 
               << num_no_num_ali << " with no numerator alignments, " 
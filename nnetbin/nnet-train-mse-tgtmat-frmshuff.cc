@@ -18,10 +18,12 @@
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-cache-tgtmat.h"
+#include "nnet/nnet-maskedbl.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-math.h"
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -68,6 +70,15 @@ int main(int argc, char *argv[]) {
     po.Register("average-grad", &average_grad,
                 "Whether to average the gradient in the bunch");
 
+    int32 cpu_threads = 1;
+    po.Register("cpu-threads", &cpu_threads,
+                "Number of threads of the frame splicing (Expand/Copy) when running on CPU");
+
+    BaseFloat sparse_threshold = 0.05;
+    po.Register("sparse-threshold", &sparse_threshold,
+                "<maskedbl> layers with a mask density up to this use the sparse "
+                "(CSR) weights on the CPU, 0 keeps them dense");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4 - (crossvalidate ? 1 : 0)) {
@@ -87,6 +98,8 @@ int main(int argc, char *argv[]) {
     using namespace kaldi;
     typedef kaldi::int32 int32;
 
+    cu::SetCpuThreads(cpu_threads);
+
     Nnet nnet_transf;
     if (feature_transform != "") {
       nnet_transf.Read(feature_transform);
@@ -94,6 +107,7 @@ int main(int argc, char *argv[]) {
 
     Nnet nnet;
     nnet.Read(model_filename);
+    SetMaskedBLSparseThreshold(sparse_threshold, &nnet);
 
     if (learn_factors == "") {
       nnet.SetLearnRate(learn_rate, NULL);
@@ -25,6 +25,7 @@ sqaure errors as the second learning objective.
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-cache-xent-tgtmat.h"
+#include "nnet/nnet-ali-prefetch.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
@@ -88,6 +89,9 @@ int main(int argc, char *argv[]) {
     po.Register("diff-scaling", &diff_scaling, "Scale factor for the differences");
 
     // process options
+    int32 prefetch = 0;
+    po.Register("prefetch-alignments", &prefetch, "Number of alignments read ahead on a background thread (needs scp features, 0 = off)");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5 - (crossvalidate?1:0)) {
@@ -150,7 +154,7 @@ int main(int argc, char *argv[]) {
 
     SequentialBaseFloatMatrixReader noisyfeat_reader(noisyfeat_rspecifier);
     SequentialBaseFloatMatrixReader cleanfeat_reader(cleanfeat_rspecifier);
-    RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
+    AlignmentPrefetcher alignments_reader(noisyfeat_rspecifier, alignments_rspecifier, prefetch);
 
     CacheXentTgtMat cache;
     cachesize = (cachesize/bunchsize)*bunchsize; // ensure divisibility
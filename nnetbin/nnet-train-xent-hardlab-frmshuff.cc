@@ -17,11 +17,14 @@
 
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
+#include "nnet/nnet-ali-prefetch.h"
 #include "nnet/nnet-cache.h"
+#include "nnet/nnet-maskedbl.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-math.h"
 
 
 int main(int argc, char *argv[]) {
@@ -64,6 +67,17 @@ int main(int argc, char *argv[]) {
     po.Register("bunchsize", &bunchsize, "Size of weight update block");
     po.Register("cachesize", &cachesize, "Size of cache for frame level shuffling");
 
+    int32 prefetch = 0;
+    po.Register("prefetch-alignments", &prefetch, "Number of alignments read ahead on a background thread (needs scp features, 0 = off)");
+
+    int32 cpu_threads = 1;
+    po.Register("cpu-threads", &cpu_threads, "Number of threads of the frame splicing (Expand/Copy) when running on CPU");
+
+    BaseFloat sparse_threshold = 0.05;
+    po.Register("sparse-threshold", &sparse_threshold,
+                "<maskedbl> layers with a mask density up to this use the sparse "
+                "(CSR) weights on the CPU, 0 keeps them dense");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4-(crossvalidate?1:0)) {
@@ -84,6 +98,8 @@ int main(int argc, char *argv[]) {
     using namespace kaldi;
     typedef kaldi::int32 int32;
 
+    cu::SetCpuThreads(cpu_threads);
+
 
     Nnet nnet_transf;
     if(feature_transform != "") {
@@ -92,6 +108,7 @@ int main(int argc, char *argv[]) {
 
     Nnet nnet;
     nnet.Read(model_filename);
+    SetMaskedBLSparseThreshold(sparse_threshold, &nnet);
 
     if(learn_factors == ""){
       nnet.SetLearnRate(learn_rate, NULL);
@@ -106,7 +123,7 @@ int main(int argc, char *argv[]) {
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
+    AlignmentPrefetcher alignments_reader(feature_rspecifier, alignments_rspecifier, prefetch);
 
     Cache cache;
     cachesize = (cachesize/bunchsize)*bunchsize; // ensure divisibility
@@ -185,7 +202,8 @@ int main(int argc, char *argv[]) {
 
     KALDI_LOG << (crossvalidate?"CROSSVALIDATE":"TRAINING") << " FINISHED " 
               << tim.Elapsed() << "s, fps" << tot_t/tim.Elapsed()
-              << ", feature wait " << time_next << "s"; 
+              << ", feature wait " << time_next << "s"
+              << ", alignment wait " << alignments_reader.WaitTime() << "s";
 
     KALDI_LOG << "Done " << num_done << " files, " << num_no_alignment
               << " with no alignments, " << num_other_error
@@ -17,6 +17,8 @@
 
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
+#include "nnet/nnet-ali-prefetch.h"
+#include "nnet/nnet-maskedbl.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
@@ -51,6 +53,14 @@ int main(int argc, char *argv[]) {
     std::string feature_transform;
     po.Register("feature-transform", &feature_transform, "Feature transform Neural Network");
 
+    int32 prefetch = 0;
+    po.Register("prefetch-alignments", &prefetch, "Number of alignments read ahead on a background thread (needs scp features, 0 = off)");
+
+    BaseFloat sparse_threshold = 0.05;
+    po.Register("sparse-threshold", &sparse_threshold,
+                "<maskedbl> layers with a mask density up to this use the sparse "
+                "(CSR) weights on the CPU, 0 keeps them dense");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4-(crossvalidate?1:0)) {
@@ -79,6 +89,7 @@ int main(int argc, char *argv[]) {
 
     Nnet nnet;
     nnet.Read(model_filename);
+    SetMaskedBLSparseThreshold(sparse_threshold, &nnet);
 
     nnet.SetLearnRate(learn_rate, NULL);
     nnet.SetMomentum(momentum);
@@ -88,7 +99,7 @@ int main(int argc, char *argv[]) {
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
+    AlignmentPrefetcher alignments_reader(feature_rspecifier, alignments_rspecifier, prefetch);
 
     Xent xent;
 
@@ -149,7 +160,8 @@ int main(int argc, char *argv[]) {
 
     KALDI_LOG << (crossvalidate?"CROSSVALIDATE":"TRAINING") << " FINISHED " 
               << tim.Elapsed() << "s, fps" << tot_t/tim.Elapsed()
-              << ", feature wait " << time_next << "s"; 
+              << ", feature wait " << time_next << "s"
+              << ", alignment wait " << alignments_reader.WaitTime() << "s";
 
     KALDI_LOG << "Done " << num_done << " files, " << num_no_alignment
               << " with no alignments, " << num_other_error
@@ -15,6 +15,8 @@
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-cache-xent-tgtmat.h"
+#include "nnet/nnet-maskedbl.h"
+#include "nnet/nnet-ali-prefetch.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
@@ -74,6 +76,14 @@ int main(int argc, char *argv[]) {
         "xent-dim", &xent_dim,
         "The dimnsion of the Xent outupts, smaller than Nnet output dim.");
 
+    BaseFloat sparse_threshold = 0.05;
+    po.Register("sparse-threshold", &sparse_threshold,
+                "<maskedbl> layers with a mask density up to this use the sparse "
+                "(CSR) weights on the CPU, 0 keeps them dense");
+
+    int32 prefetch = 0;
+    po.Register("prefetch-alignments", &prefetch, "Number of alignments read ahead on a background thread (needs scp features, 0 = off)");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5 - (crossvalidate ? 1 : 0)) {
@@ -98,6 +108,7 @@ int main(int argc, char *argv[]) {
 
     Nnet nnet;
     nnet.Read(model_filename);
+    SetMaskedBLSparseThreshold(sparse_threshold, &nnet);
 
     if (learn_factors == "") {
       nnet.SetLearnRate(learn_rate, NULL);
@@ -117,7 +128,7 @@ int main(int argc, char *argv[]) {
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     SequentialBaseFloatMatrixReader targets_reader(targets_rspecifier);
-    RandomAccessInt32VectorReader alignments_reader(alignment_rspecifier);
+    AlignmentPrefetcher alignments_reader(feature_rspecifier, alignment_rspecifier, prefetch);
 
     CacheXentTgtMat cache;
     cachesize = (cachesize / bunchsize) * bunchsize;  // ensure divisibility
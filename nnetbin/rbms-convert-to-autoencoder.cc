@@ -32,9 +32,12 @@ int main(int argc, char *argv[]) {
             " rbms-convert-to-autoencoder --binary=false ae.mdl rbm1.mdl rbm2.mdl ...\n";
 
     bool binary_write = false;
+    bool tied = false;
 
     ParseOptions po(usage);
     po.Register("binary", &binary_write, "Write output in binary mode");
+    po.Register("tied", &tied, "Write the decoder as <tiedlinearity> layers "
+                "sharing the encoder weights instead of transposed copies");
 
     po.Read(argc, argv);
 
@@ -51,6 +54,10 @@ int main(int argc, char *argv[]) {
     {
       Output ko(model_out_filename, binary_write);
 
+      // layer index of the encoder <biasedlinearity> of each RBM
+      std::vector<int32> encoder_index(total_args + 1, -1);
+      int32 num_layers = 0;
+
       // Encoder
       for (int i = 2; i <= total_args; ++i) {
 
@@ -70,6 +77,8 @@ int main(int argc, char *argv[]) {
         RbmBase& rbm = dynamic_cast<RbmBase&>(*nnet.Layer(0));
 
         rbm.WriteAsAutoEncoder(ko.Stream(), true, binary_write);
+        encoder_index[i] = num_layers;
+        num_layers += (rbm.HidType() == RbmBase::BERNOULLI ? 2 : 1);
 
       }
 
@@ -89,9 +98,13 @@ int main(int argc, char *argv[]) {
 
         KALDI_ASSERT(nnet.LayerCount() == 1);
         KALDI_ASSERT(nnet.Layer(0)->GetType() == Component::kRbm);
-        RbmBase& rbm = dynamic_cast<RbmBase&>(*nnet.Layer(0));
-
-        rbm.WriteAsAutoEncoder(ko.Stream(), false, binary_write);
+        if (tied) {
+          Rbm& rbm = dynamic_cast<Rbm&>(*nnet.Layer(0));
+          rbm.WriteAsTiedDecoder(ko.Stream(), encoder_index[i], binary_write);
+        } else {
+          RbmBase& rbm = dynamic_cast<RbmBase&>(*nnet.Layer(0));
+          rbm.WriteAsAutoEncoder(ko.Stream(), false, binary_write);
+        }
 
       }
 
@@ -3,6 +3,9 @@
 //
 // The AE weights are tied in a reflection way, i.e. the first layer is tied to the last layer
 //
+// When the decoder is made of <tiedlinearity> layers (rbms-convert-to-autoencoder --tied),
+// the weights are shared and updated once, the copying below is skipped.
+//
 
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
@@ -95,6 +98,14 @@ int main(int argc, char *argv[]) {
     nnet.SetL1Penalty(l1_penalty);
     nnet.SetAverageGrad(average_grad);
 
+    // the <tiedlinearity> layers share the weights, no copying needed
+    bool shared_weights = false;
+    for (int32 i = 0; i < nnet.LayerCount(); ++i) {
+      if (nnet.Layer(i)->GetType() == Component::kTiedLinearity) {
+        shared_weights = true;
+      }
+    }
+
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
@@ -175,7 +186,8 @@ int main(int argc, char *argv[]) {
         mse.Eval(nnet_out, nnet_tgt, &glob_err);
         if (!crossvalidate) {
           nnet.Backpropagate(glob_err, NULL);
-
+        }
+        if (!crossvalidate && !shared_weights) {
           // Do the weight tying
           int32 tot_layers = nnet.LayerCount();
           int32 num_bls = 0;
@@ -0,0 +1,305 @@
+/*
+ * vts-batched-gmm.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ */
+
+#include "vts/vts-batched-gmm.h"
+#include "vts/vts-first-order.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+
+namespace kaldi {
+
+/// [mu./var -0.5./var] of the Gaussians, i.e. the GEMM weights against [x x^2]
+static void GmmWeights(const DiagGmm &gmm, SubMatrix<BaseFloat> *weights) {
+  int32 dim = gmm.Dim();
+  SubMatrix<BaseFloat>(*weights, 0, gmm.NumGauss(), 0, dim).CopyFromMat(
+      gmm.means_invvars());
+  SubMatrix<BaseFloat> var_part(*weights, 0, gmm.NumGauss(), dim, dim);
+  var_part.CopyFromMat(gmm.inv_vars());
+  var_part.Scale(-0.5);
+}
+
+/// Stable log( sum_i exp(scores[i]) )
+static BaseFloat LogSumExp(const BaseFloat *scores, int32 n) {
+  BaseFloat max = *std::max_element(scores, scores + n);
+  if (max == -std::numeric_limits<BaseFloat>::infinity()) {
+    return max;
+  }
+  double sum = 0.0;
+  for (int32 i = 0; i < n; ++i) {
+    sum += exp(scores[i] - max);
+  }
+  return max + log(sum);
+}
+
+void DiagGmmFrameLogLikelihoods(const DiagGmm &gmm,
+                                const MatrixBase<BaseFloat> &feats,
+                                Matrix<BaseFloat> *loglikes) {
+  int32 num_frames = feats.NumRows(), dim = feats.NumCols();
+  KALDI_ASSERT(dim == gmm.Dim());
+
+  Matrix<BaseFloat> weights(gmm.NumGauss(), 2 * dim);
+  SubMatrix<BaseFloat> all(weights, 0, gmm.NumGauss(), 0, 2 * dim);
+  GmmWeights(gmm, &all);
+
+  Matrix<BaseFloat> feats2(num_frames, 2 * dim);
+  SubMatrix<BaseFloat>(feats2, 0, num_frames, 0, dim).CopyFromMat(feats);
+  SubMatrix<BaseFloat> sq(feats2, 0, num_frames, dim, dim);
+  sq.CopyFromMat(feats);
+  sq.ApplyPow(2.0);
+
+  loglikes->Resize(num_frames, gmm.NumGauss(), kUndefined);
+  loglikes->CopyRowsFromVec(gmm.gconsts());
+  loglikes->AddMatMat(1.0, feats2, kNoTrans, weights, kTrans, 1.0);
+}
+
+void BatchedAmDiagGmm::SetShortlist(const DiagGmm &ubm,
+                                    const AmDiagGmm &am_gmm) {
+  KALDI_ASSERT(ubm.Dim() == am_gmm.Dim());
+  int32 num_pdf = am_gmm.NumPdfs(), num_cluster = ubm.NumGauss();
+
+  // the component that scores each mean best
+  gauss_cluster_.clear();
+  std::vector<int32> cluster_size(num_cluster, 0);
+  Vector<BaseFloat> mean(am_gmm.Dim()), scores;
+  for (int32 pdf = 0; pdf < num_pdf; ++pdf) {
+    int32 num_gauss = am_gmm.NumGaussInPdf(pdf);
+    for (int32 g = 0; g < num_gauss; ++g) {
+      am_gmm.GetGaussianMean(pdf, g, &mean);
+      ubm.LogLikelihoods(mean, &scores);
+      int32 best = std::max_element(scores.Data(), scores.Data() + num_cluster)
+          - scores.Data();
+      gauss_cluster_.push_back(best);
+      ++cluster_size[best];
+    }
+  }
+
+  cluster_offset_.resize(num_cluster + 1);
+  cluster_offset_[0] = 0;
+  for (int32 c = 0; c < num_cluster; ++c) {
+    cluster_offset_[c + 1] = cluster_offset_[c] + cluster_size[c];
+  }
+  std::vector<int32> next(cluster_offset_.begin(), cluster_offset_.end() - 1);
+  gauss_order_.resize(gauss_cluster_.size());
+  for (size_t i = 0; i < gauss_cluster_.size(); ++i) {
+    gauss_order_[next[gauss_cluster_[i]]++] = i;
+  }
+
+  SetUbm(ubm);
+}
+
+void BatchedAmDiagGmm::SetUbm(const DiagGmm &ubm) {
+  KALDI_ASSERT(static_cast<int32>(cluster_offset_.size()) == ubm.NumGauss() + 1);
+  ubm_weights_.Resize(ubm.NumGauss(), 2 * ubm.Dim(), kUndefined);
+  SubMatrix<BaseFloat> all(ubm_weights_, 0, ubm.NumGauss(), 0, 2 * ubm.Dim());
+  GmmWeights(ubm, &all);
+  ubm_gconsts_.Resize(ubm.NumGauss(), kUndefined);
+  ubm_gconsts_.CopyFromVec(ubm.gconsts());
+}
+
+void BatchedAmDiagGmm::ReadUbm(const AmDiagGmm &am_gmm) {
+  if (opts_.num_select <= 0) {
+    return;
+  }
+  if (opts_.ubm_rxfilename == "") {
+    KALDI_ERR << "--num-gselect needs the --ubm!";
+  }
+  bool binary;
+  Input ki(opts_.ubm_rxfilename, &binary);
+  clean_ubm_.Read(ki.Stream(), binary);
+  SetShortlist(clean_ubm_, am_gmm);
+}
+
+void BatchedAmDiagGmm::InitCompensated(const AmDiagGmm &noise_am_gmm,
+                                       const Vector<double> &mu_h,
+                                       const Vector<double> &mu_z,
+                                       const Vector<double> &var_z,
+                                       int32 num_cepstral, int32 num_fbank,
+                                       const Matrix<double> &dct_mat,
+                                       const Matrix<double> &inv_dct_mat) {
+  if (UseShortlist()) {
+    DiagGmm noise_ubm;
+    noise_ubm.CopyFromDiagGmm(clean_ubm_);
+    std::vector<Matrix<double> > Jx(noise_ubm.NumGauss()),
+        Jz(noise_ubm.NumGauss());  // not needed for compensation only
+    CompensateDiagGmm(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
+                      inv_dct_mat, noise_ubm, Jx, Jz);
+    SetUbm(noise_ubm);
+  }
+  Init(noise_am_gmm);
+}
+
+void BatchedAmDiagGmm::Init(const AmDiagGmm &am_gmm) {
+  int32 num_pdf = am_gmm.NumPdfs();
+  dim_ = am_gmm.Dim();
+
+  pdf_offset_.resize(num_pdf + 1);
+  pdf_offset_[0] = 0;
+  for (int32 pdf = 0; pdf < num_pdf; ++pdf) {
+    pdf_offset_[pdf + 1] = pdf_offset_[pdf] + am_gmm.NumGaussInPdf(pdf);
+  }
+  int32 num_gauss = pdf_offset_[num_pdf];
+
+  // model order
+  weights_.Resize(num_gauss, 2 * dim_, kUndefined);
+  gconsts_.Resize(num_gauss, kUndefined);
+  gauss_pdf_.resize(num_gauss);
+  for (int32 pdf = 0; pdf < num_pdf; ++pdf) {
+    const DiagGmm &gmm = am_gmm.GetPdf(pdf);
+    int32 begin = pdf_offset_[pdf], n = gmm.NumGauss();
+    SubMatrix<BaseFloat> w(weights_, begin, n, 0, 2 * dim_);
+    GmmWeights(gmm, &w);
+    gconsts_.Range(begin, n).CopyFromVec(gmm.gconsts());
+    std::fill(gauss_pdf_.begin() + begin, gauss_pdf_.begin() + begin + n, pdf);
+  }
+
+  if (!gauss_cluster_.empty()) {
+    if (static_cast<int32>(gauss_cluster_.size()) != num_gauss) {
+      KALDI_ERR<< "The shortlist was set with a different model, "
+               << gauss_cluster_.size() << " vs. " << num_gauss << " Gaussians";
+    }
+    // sorted by UBM component
+    Matrix<BaseFloat> weights(weights_);
+    Vector<BaseFloat> gconsts(gconsts_);
+    std::vector<int32> gauss_pdf(gauss_pdf_);
+    for (int32 i = 0; i < num_gauss; ++i) {
+      int32 g = gauss_order_[i];
+      weights_.CopyRowFromVec(weights.Row(g), i);
+      gconsts_(i) = gconsts(g);
+      gauss_pdf_[i] = gauss_pdf[g];
+    }
+  }
+}
+
+void BatchedAmDiagGmm::ExpandFeatures(const MatrixBase<BaseFloat> &feats,
+                                      Matrix<BaseFloat> *feats2) const {
+  int32 num_frames = feats.NumRows();
+  if (feats.NumCols() != dim_) {
+    KALDI_ERR<< "Feature dimension " << feats.NumCols()
+             << " does not match the model dimension " << dim_;
+  }
+  feats2->Resize(num_frames, 2 * dim_, kUndefined);
+  SubMatrix<BaseFloat>(*feats2, 0, num_frames, 0, dim_).CopyFromMat(feats);
+  SubMatrix<BaseFloat> sq(*feats2, 0, num_frames, dim_, dim_);
+  sq.CopyFromMat(feats);
+  sq.ApplyPow(2.0);
+}
+
+void BatchedAmDiagGmm::LogLikelihoods(const MatrixBase<BaseFloat> &feats,
+                                      Matrix<BaseFloat> *loglikes) const {
+  Matrix<BaseFloat> feats2;
+  ExpandFeatures(feats, &feats2);
+  loglikes->Resize(feats.NumRows(), NumPdfs(), kUndefined);
+  if (UseShortlist()) {
+    ScoreShortlist(feats2, loglikes);
+  } else {
+    ScoreAll(feats2, loglikes);
+  }
+}
+
+void BatchedAmDiagGmm::ScoreAll(const Matrix<BaseFloat> &feats2,
+                                Matrix<BaseFloat> *loglikes) const {
+  int32 num_frames = feats2.NumRows(), num_pdf = NumPdfs();
+  Matrix<BaseFloat> scores;
+
+  // blocks of whole pdfs, at least one pdf per block
+  for (int32 pdf_begin = 0; pdf_begin < num_pdf;) {
+    int32 pdf_end = pdf_begin + 1;
+    while (pdf_end < num_pdf
+        && pdf_offset_[pdf_end + 1] - pdf_offset_[pdf_begin] <= opts_.block_size) {
+      ++pdf_end;
+    }
+    int32 begin = pdf_offset_[pdf_begin];
+    int32 num_gauss = pdf_offset_[pdf_end] - begin;
+
+    scores.Resize(num_frames, num_gauss, kUndefined);
+    scores.CopyRowsFromVec(gconsts_.Range(begin, num_gauss));
+    scores.AddMatMat(1.0, feats2, kNoTrans,
+                     SubMatrix<BaseFloat>(weights_, begin, num_gauss, 0, 2 * dim_),
+                     kTrans, 1.0);
+
+    for (int32 t = 0; t < num_frames; ++t) {
+      const BaseFloat *row = scores.RowData(t);
+      for (int32 pdf = pdf_begin; pdf < pdf_end; ++pdf) {
+        (*loglikes)(t, pdf) = LogSumExp(row + pdf_offset_[pdf] - begin,
+                                        pdf_offset_[pdf + 1] - pdf_offset_[pdf]);
+      }
+    }
+    pdf_begin = pdf_end;
+  }
+}
+
+void BatchedAmDiagGmm::ScoreShortlist(const Matrix<BaseFloat> &feats2,
+                                      Matrix<BaseFloat> *loglikes) const {
+  int32 num_frames = feats2.NumRows(), num_cluster = ubm_weights_.NumRows();
+  int32 num_select = std::min(opts_.num_select, num_cluster);
+  const BaseFloat kLogZero = -std::numeric_limits<BaseFloat>::infinity();
+
+  // select the components of each frame with the UBM
+  Matrix<BaseFloat> ubm_scores(num_frames, num_cluster, kUndefined);
+  ubm_scores.CopyRowsFromVec(ubm_gconsts_);
+  ubm_scores.AddMatMat(1.0, feats2, kNoTrans, ubm_weights_, kTrans, 1.0);
+
+  std::vector<std::vector<int32> > cluster_frames(num_cluster);
+  std::vector<std::pair<BaseFloat, int32> > ranked(num_cluster);
+  for (int32 t = 0; t < num_frames; ++t) {
+    for (int32 c = 0; c < num_cluster; ++c) {
+      // the components without model Gaussians come last
+      bool empty = (cluster_offset_[c + 1] == cluster_offset_[c]);
+      ranked[c] = std::make_pair(empty ? kLogZero : ubm_scores(t, c), c);
+    }
+    std::nth_element(ranked.begin(), ranked.begin() + num_select - 1,
+                     ranked.end(), std::greater<std::pair<BaseFloat, int32> >());
+    for (int32 i = 0; i < num_select; ++i) {
+      cluster_frames[ranked[i].second].push_back(t);
+    }
+  }
+
+  loglikes->Set(kLogZero);
+  std::vector<BaseFloat> floor(num_frames, std::numeric_limits<BaseFloat>::max());
+
+  // one GEMM per component over the frames that selected it
+  Matrix<BaseFloat> frames, scores;
+  for (int32 c = 0; c < num_cluster; ++c) {
+    const std::vector<int32> &sel = cluster_frames[c];
+    int32 begin = cluster_offset_[c];
+    int32 num_gauss = cluster_offset_[c + 1] - begin;
+    if (sel.empty() || num_gauss == 0) continue;
+
+    frames.Resize(sel.size(), 2 * dim_, kUndefined);
+    for (size_t i = 0; i < sel.size(); ++i) {
+      frames.CopyRowFromVec(feats2.Row(sel[i]), i);
+    }
+    scores.Resize(sel.size(), num_gauss, kUndefined);
+    scores.CopyRowsFromVec(gconsts_.Range(begin, num_gauss));
+    scores.AddMatMat(1.0, frames, kNoTrans,
+                     SubMatrix<BaseFloat>(weights_, begin, num_gauss, 0, 2 * dim_),
+                     kTrans, 1.0);
+
+    for (size_t i = 0; i < sel.size(); ++i) {
+      int32 t = sel[i];
+      const BaseFloat *row = scores.RowData(i);
+      for (int32 g = 0; g < num_gauss; ++g) {
+        BaseFloat &like = (*loglikes)(t, gauss_pdf_[begin + g]);
+        like = (like == kLogZero ? row[g] : LogAdd(like, row[g]));
+        floor[t] = std::min(floor[t], row[g]);
+      }
+    }
+  }
+
+  // the pdfs with no selected Gaussian
+  for (int32 t = 0; t < num_frames; ++t) {
+    BaseFloat *row = loglikes->RowData(t);
+    for (int32 pdf = 0; pdf < loglikes->NumCols(); ++pdf) {
+      if (row[pdf] == kLogZero) row[pdf] = floor[t];
+    }
+  }
+}
+
+}  // namespace kaldi
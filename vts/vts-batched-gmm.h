@@ -0,0 +1,179 @@
+/*
+ * vts-batched-gmm.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ *  Batched log-likelihood evaluation of (compensated) diagonal GMMs.
+ *
+ *  log( c * N(x; mu, var) ) = gconst + [x x^2] * [mu./var -0.5./var]^T,
+ *  so a whole utterance is scored with one GEMM per block of Gaussians,
+ *  and the Gaussians of each pdf are pooled with a max-shifted log-sum-exp.
+ *
+ *  With a UBM shortlist, every model Gaussian is assigned to the UBM
+ *  component that scores its mean best. For each frame only the Gaussians
+ *  of the num_select best UBM components are scored; the frames sharing a
+ *  component are gathered into one GEMM. The pdfs without any selected
+ *  Gaussian get the lowest Gaussian score of the frame.
+ */
+
+#ifndef KALDI_VTS_VTS_BATCHED_GMM_H_
+#define KALDI_VTS_VTS_BATCHED_GMM_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "util/parse-options.h"
+#include "util/kaldi-io.h"
+#include "gmm/diag-gmm.h"
+#include "gmm/am-diag-gmm.h"
+#include "hmm/transition-model.h"
+#include "itf/decodable-itf.h"
+
+namespace kaldi {
+
+struct BatchedGmmOptions {
+  int32 block_size;  // Gaussians scored by one GEMM
+  int32 num_select;  // UBM components selected per frame, 0 for no pruning
+  std::string ubm_rxfilename;  // clean UBM that selects the components
+
+  BatchedGmmOptions()
+      : block_size(4096),
+        num_select(0) {
+  }
+
+  void Register(ParseOptions *po) {
+    po->Register("gauss-block-size", &block_size,
+                 "Number of Gaussians scored at a time");
+    po->Register("num-gselect", &num_select,
+                 "Number of UBM components selected per frame, "
+                 "0 scores all the Gaussians (needs --ubm otherwise)");
+    po->Register("ubm", &ubm_rxfilename,
+                 "Diagonal UBM for the Gaussian selection, see --num-gselect");
+  }
+};
+
+/// Per-Gaussian log-likelihoods of all the frames, one GEMM
+void DiagGmmFrameLogLikelihoods(const DiagGmm &gmm,
+                                const MatrixBase<BaseFloat> &feats,
+                                Matrix<BaseFloat> *loglikes);
+
+class BatchedAmDiagGmm {
+ public:
+  explicit BatchedAmDiagGmm(const BatchedGmmOptions &opts)
+      : opts_(opts),
+        dim_(0)
+  {
+  }
+
+  /// Assign the Gaussians of the model to the UBM components, enables
+  /// the shortlist when opts.num_select > 0. Call it once with the clean
+  /// models, before Init().
+  void SetShortlist(const DiagGmm &ubm, const AmDiagGmm &am_gmm);
+
+  /// Refresh the UBM that selects the components, e.g. after compensation
+  void SetUbm(const DiagGmm &ubm);
+
+  /// Read the clean UBM of opts.ubm_rxfilename and SetShortlist() with it,
+  /// does nothing when opts.num_select == 0
+  void ReadUbm(const AmDiagGmm &am_gmm);
+
+  /// Compensate the clean UBM given to ReadUbm() with the noise parameters,
+  /// SetUbm() it, and Init() with the model compensated the same way
+  void InitCompensated(const AmDiagGmm &noise_am_gmm,
+                       const Vector<double> &mu_h, const Vector<double> &mu_z,
+                       const Vector<double> &var_z, int32 num_cepstral,
+                       int32 num_fbank, const Matrix<double> &dct_mat,
+                       const Matrix<double> &inv_dct_mat);
+
+  /// Take the weights of the (compensated) model, the Gaussians have to
+  /// match the model given to SetShortlist()
+  void Init(const AmDiagGmm &am_gmm);
+
+  int32 NumPdfs() const {
+    return static_cast<int32>(pdf_offset_.size()) - 1;
+  }
+
+  /// Log-likelihoods of all the frames, indexed by (frame, pdf)
+  void LogLikelihoods(const MatrixBase<BaseFloat> &feats,
+                      Matrix<BaseFloat> *loglikes) const;
+
+ private:
+  bool UseShortlist() const {
+    return opts_.num_select > 0 && !gauss_cluster_.empty();
+  }
+
+  /// [x x^2] of all the frames
+  void ExpandFeatures(const MatrixBase<BaseFloat> &feats,
+                      Matrix<BaseFloat> *feats2) const;
+  void ScoreAll(const Matrix<BaseFloat> &feats2,
+                Matrix<BaseFloat> *loglikes) const;
+  void ScoreShortlist(const Matrix<BaseFloat> &feats2,
+                      Matrix<BaseFloat> *loglikes) const;
+
+  BatchedGmmOptions opts_;
+  int32 dim_;
+
+  std::vector<int32> pdf_offset_;  ///< first Gaussian of each pdf, plus the end
+  std::vector<int32> gauss_pdf_;  ///< pdf of each weight row
+
+  /// Weights [mu./var -0.5./var] and gconsts, one row per Gaussian in the
+  /// model order, or sorted by UBM component with the shortlist
+  Matrix<BaseFloat> weights_;
+  Vector<BaseFloat> gconsts_;
+
+  // shortlist
+  std::vector<int32> gauss_cluster_;  ///< UBM component of each model Gaussian
+  std::vector<int32> gauss_order_;  ///< model Gaussians sorted by component
+  std::vector<int32> cluster_offset_;  ///< first weight row of each component
+  Matrix<BaseFloat> ubm_weights_;
+  Vector<BaseFloat> ubm_gconsts_;
+  DiagGmm clean_ubm_;  ///< read by ReadUbm(), compensated per utterance
+};
+
+/*
+ * Decodable over a BatchedAmDiagGmm: the log-likelihoods of the whole
+ * utterance are computed at construction, the matrix also serves all the
+ * repeated requests of a pdf (through different transition-ids) in a frame.
+ */
+class DecodableAmDiagGmmBatched : public DecodableInterface {
+ public:
+  DecodableAmDiagGmmBatched(const BatchedAmDiagGmm &am,
+                            const TransitionModel &tm,
+                            const MatrixBase<BaseFloat> &feats,
+                            BaseFloat scale)
+      : trans_model_(tm),
+        scale_(scale)
+  {
+    am.LogLikelihoods(feats, &loglikes_);
+  }
+
+  // Note, frames are numbered from zero but transition-ids from one.
+  virtual BaseFloat LogLikelihood(int32 frame, int32 tid) {
+    return scale_ * loglikes_(frame, trans_model_.TransitionIdToPdf(tid));
+  }
+
+  virtual int32 NumFrames() {
+    return loglikes_.NumRows();
+  }
+
+  // Indices are one-based!  This is for compatibility with OpenFst.
+  virtual int32 NumIndices() {
+    return trans_model_.NumTransitionIds();
+  }
+
+  virtual bool IsLastFrame(int32 frame) {
+    KALDI_ASSERT(frame < NumFrames());
+    return (frame == NumFrames() - 1);
+  }
+
+ private:
+  const TransitionModel &trans_model_;
+  BaseFloat scale_;
+  Matrix<BaseFloat> loglikes_;
+};
+
+}  // namespace kaldi
+
+#endif /* KALDI_VTS_VTS_BATCHED_GMM_H_ */
@@ -18,6 +18,7 @@
 #include "nnet/nnet-component.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-multi-frame.h"
 
 namespace kaldi {
 
@@ -911,107 +912,12 @@ void CompensateMultiFrameGmm(const Vector<double> &mu_h,
                              const Matrix<double> &inv_dct_mat,
                              int32 num_frames,
                              AmDiagGmm &noise_am_gmm) {
-  //KALDI_LOG << "Beginning compensate model ...";
-  Matrix<double> Jx(num_cepstral, num_cepstral, kSetZero);
-  Matrix<double> Jz(num_cepstral, num_cepstral, kSetZero);
-
-  int32 feat_dim = noise_am_gmm.Dim() / num_frames;
-  KALDI_ASSERT(feat_dim * num_frames == noise_am_gmm.Dim());
-
-  // iterate all the GMMs
-  int32 num_pdf = noise_am_gmm.NumPdfs();
-  for (int32 pdf = 0; pdf < num_pdf; ++pdf) {
-    // iterate all the Gaussians
-    DiagGmm *gmm = &(noise_am_gmm.GetPdf(pdf));
-    DiagGmmNormal ngmm(*gmm);
-
-    int32 num_gauss = gmm->NumGauss();
-    for (int32 g = 0; g < num_gauss; ++g) {
-
-      // compute the necessary transforms
-      Vector<double> mu_y_s(num_cepstral);
-      Vector<double> tmp_fbank(num_fbank);
-
-      for (int32 n = 0; n < num_frames; ++n) {
-        SubVector<double> cur_mean(ngmm.means_.Row(g), n * feat_dim, feat_dim);
-        SubVector<double> cur_var(ngmm.vars_.Row(g), n * feat_dim, feat_dim);
-
-        for (int32 ii = 0; ii < num_cepstral; ++ii) {
-          mu_y_s(ii) = mu_z(ii) - cur_mean(ii) - mu_h(ii);
-        }  // mu_n - mu_x - mu_h
-        tmp_fbank.AddMatVec(1.0, inv_dct_mat, kNoTrans, mu_y_s, 0.0);  // C_inv * (mu_n - mu_x - mu_h)
-        tmp_fbank.ApplyExp();  // exp( C_inv * (mu_n - mu_x - mu_h) )
-        tmp_fbank.Add(1.0);  // 1 + exp( C_inv * (mu_n - mu_x - mu_h) )
-        Vector<double> tmp_inv(tmp_fbank);  // keep a version
-        tmp_fbank.ApplyLog();  // log ( 1 + exp( C_inv * (mu_n - mu_x - mu_h) ) )
-        tmp_inv.InvertElements();  // 1.0 / ( 1 + exp( C_inv * (mu_n - mu_x - mu_h) ) )
-
-        // new static mean
-        for (int32 ii = 0; ii < num_cepstral; ++ii) {
-          mu_y_s(ii) = cur_mean(ii) + mu_h(ii);
-        }  // mu_x + mu_h
-        mu_y_s.AddMatVec(1.0, dct_mat, kNoTrans, tmp_fbank, 1.0);  // mu_x + mu_h + C * log ( 1 + exp( C_inv * (mu_n - mu_x - mu_h) ) )
-
-        // compute J
-        Matrix<double> tmp_dct(dct_mat);
-        tmp_dct.MulColsVec(tmp_inv);
-        Jx.AddMatMat(1.0, tmp_dct, kNoTrans, inv_dct_mat, kNoTrans, 0.0);
-
-        // compute I_J
-        Jz.CopyFromMat(Jx);
-        for (int32 ii = 0; ii < num_cepstral; ++ii)
-          Jz(ii, ii) = 1.0 - Jz(ii, ii);
-
-        // compute and update mean
-        if (g_kaldi_verbose_level >= 9) {
-          KALDI_LOG<< "Mean Before: " << cur_mean;
-        }
-        Vector<double> tmp_mu(num_cepstral);
-        SubVector<double> mu_s(cur_mean, 0, num_cepstral);
-        mu_s.CopyFromVec(mu_y_s);
-        SubVector<double> mu_dt(cur_mean, num_cepstral, num_cepstral);
-        tmp_mu.CopyFromVec(mu_dt);
-        mu_dt.AddMatVec(1.0, Jx, kNoTrans, tmp_mu, 0.0);
-        SubVector<double> mu_acc(cur_mean, 2 * num_cepstral, num_cepstral);
-        tmp_mu.CopyFromVec(mu_acc);
-        mu_acc.AddMatVec(1.0, Jx, kNoTrans, tmp_mu, 0.0);
-        if (g_kaldi_verbose_level >= 9) {
-          KALDI_LOG<< "Mean After: " << cur_mean;
-        }
-
-        if (compensate_var) {
-          // compute and update covariance
-          if (g_kaldi_verbose_level >= 9) {
-            KALDI_LOG<< "Covarianc Before: " << cur_var;
-          }
-          for (int32 ii = 0; ii < 3; ++ii) {
-            Matrix<double> tmp_var1(Jx), tmp_var2(Jz), new_var(num_cepstral,
-                num_cepstral);
-            SubVector<double> x_var(cur_var, ii * num_cepstral, num_cepstral);
-            SubVector<double> n_var(var_z, ii * num_cepstral, num_cepstral);
+  KALDI_ASSERT(dct_mat.NumRows() == num_cepstral && dct_mat.NumCols() == num_fbank);
 
-            tmp_var1.MulColsVec(x_var);
-            new_var.AddMatMat(1.0, tmp_var1, kNoTrans, Jx, kTrans, 0.0);
-
-            tmp_var2.MulColsVec(n_var);
-            new_var.AddMatMat(1.0, tmp_var2, kNoTrans, Jz, kTrans, 1.0);
-
-            x_var.CopyDiagFromMat(new_var);
-          }
-
-          if (g_kaldi_verbose_level >= 9) {
-            KALDI_LOG << "Covariance After: " << cur_var;
-          }
-        }
-
-      }
-    }
-
-    ngmm.CopyToDiagGmm(gmm);
-    gmm->ComputeGconsts();
-  }
-
-  //KALDI_LOG << "Model compensation done!";
+  MultiFrameCompensator compensator;
+  compensator.Init(dct_mat, inv_dct_mat, num_frames);
+  compensator.SetCleanModel(noise_am_gmm);
+  compensator.Compensate(mu_h, mu_z, var_z, compensate_var, &noise_am_gmm);
 }
 
 void CompensateDiagGaussian_FBank(const Vector<double> &mu_h,
@@ -252,7 +252,9 @@ void EstimateAdditiveNoiseVariance(const AmDiagGmm &noise_am_gmm,
  * noise_am_gmm are initialized as the clean model and after
  * this function will be the compensated models.
  *
- *
+ * Each call sets up a new MultiFrameCompensator; when compensating the
+ * same clean model for many noise conditions, keep one compensator
+ * (see vts/vts-multi-frame.h) and call its Compensate() instead.
  */
 void CompensateMultiFrameGmm(const Vector<double> &mu_h,
                              const Vector<double> &mu_z,
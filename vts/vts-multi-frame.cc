@@ -0,0 +1,244 @@
+/*
+ * vts-multi-frame.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ */
+
+#include "vts/vts-multi-frame.h"
+#include "vts/vts-first-order.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace kaldi {
+
+void MultiFrameCompensator::Init(int32 num_cepstral, int32 num_fbank,
+                                 BaseFloat ceplifter, int32 num_frames) {
+  Matrix<double> dct_mat, inv_dct_mat;
+  GenerateDCTmatrix(num_cepstral, num_fbank, ceplifter, &dct_mat,
+                    &inv_dct_mat);
+  Init(dct_mat, inv_dct_mat, num_frames);
+}
+
+void MultiFrameCompensator::Init(const Matrix<double> &dct_mat,
+                                 const Matrix<double> &inv_dct_mat,
+                                 int32 num_frames) {
+  KALDI_ASSERT(dct_mat.NumRows() == inv_dct_mat.NumCols());
+  KALDI_ASSERT(dct_mat.NumCols() == inv_dct_mat.NumRows());
+  KALDI_ASSERT(num_frames > 0);
+
+  num_cepstral_ = dct_mat.NumRows();
+  num_fbank_ = dct_mat.NumCols();
+  num_frames_ = num_frames;
+  dct_mat_ = dct_mat;
+  inv_dct_mat_ = inv_dct_mat;
+
+  // the clean model has to be set again
+  feat_dim_ = 0;
+  pdf_offset_.clear();
+  scratch_.clear();
+}
+
+void MultiFrameCompensator::SetCleanModel(const AmDiagGmm &clean_am_gmm) {
+  KALDI_ASSERT(IsInitialized());
+
+  int32 dim = clean_am_gmm.Dim();
+  feat_dim_ = dim / num_frames_;
+  KALDI_ASSERT(feat_dim_ * num_frames_ == dim);
+  // static, delta and acceleration blocks
+  KALDI_ASSERT(feat_dim_ >= 3 * num_cepstral_);
+
+  int32 num_pdf = clean_am_gmm.NumPdfs();
+  pdf_offset_.resize(num_pdf + 1);
+  pdf_offset_[0] = 0;
+  for (int32 pdf = 0; pdf < num_pdf; ++pdf) {
+    pdf_offset_[pdf + 1] = pdf_offset_[pdf] + clean_am_gmm.NumGaussInPdf(pdf);
+  }
+
+  clean_means_.Resize(pdf_offset_[num_pdf], dim, kUndefined);
+  clean_vars_.Resize(pdf_offset_[num_pdf], dim, kUndefined);
+  Matrix<double> means, vars;
+  for (int32 pdf = 0; pdf < num_pdf; ++pdf) {
+    const DiagGmm &gmm = clean_am_gmm.GetPdf(pdf);
+    gmm.GetMeans(&means);
+    gmm.GetVars(&vars);
+    int32 num_gauss = gmm.NumGauss();
+    SubMatrix<double>(clean_means_, pdf_offset_[pdf], num_gauss, 0, dim)
+        .CopyFromMat(means);
+    SubMatrix<double>(clean_vars_, pdf_offset_[pdf], num_gauss, 0, dim)
+        .CopyFromMat(vars);
+  }
+  noisy_means_.Resize(clean_means_.NumRows(), dim, kUndefined);
+  noisy_vars_.Resize(clean_vars_.NumRows(), dim, kUndefined);
+}
+
+void MultiFrameCompensator::InitScratch(Scratch *s) const {
+  s->cep.Resize(num_cepstral_);
+  s->fbank.Resize(num_fbank_);
+  s->inv.Resize(num_fbank_);
+  s->tmp.Resize(num_cepstral_);
+  s->dct.Resize(num_cepstral_, num_fbank_);
+  s->jx.Resize(num_cepstral_, num_cepstral_);
+  s->jx2.Resize(num_cepstral_, num_cepstral_);
+  s->jz2.Resize(num_cepstral_, num_cepstral_);
+}
+
+void MultiFrameCompensator::CompensateFrame(const Vector<double> &mu_h,
+                                            const Vector<double> &mu_z,
+                                            const Vector<double> &var_z,
+                                            bool compensate_var,
+                                            SubVector<double> *mean,
+                                            SubVector<double> *var,
+                                            Scratch *s) const {
+  int32 nc = num_cepstral_;
+
+  for (int32 ii = 0; ii < nc; ++ii) {
+    s->cep(ii) = mu_z(ii) - (*mean)(ii) - mu_h(ii);
+  }  // mu_n - mu_x - mu_h
+  s->fbank.AddMatVec(1.0, inv_dct_mat_, kNoTrans, s->cep, 0.0);  // C_inv * (mu_n - mu_x - mu_h)
+  for (int32 k = 0; k < num_fbank_; ++k) {
+    double e = 1.0 + exp(s->fbank(k));  // 1 + exp( C_inv * (mu_n - mu_x - mu_h) )
+    s->fbank(k) = log(e);
+    s->inv(k) = 1.0 / e;
+  }
+
+  // new static mean, mu_x + mu_h + C * log ( 1 + exp( C_inv * (mu_n - mu_x - mu_h) ) )
+  for (int32 ii = 0; ii < nc; ++ii) {
+    s->cep(ii) = (*mean)(ii) + mu_h(ii);
+  }
+  s->cep.AddMatVec(1.0, dct_mat_, kNoTrans, s->fbank, 1.0);
+
+  // J = C * diag(1 / (1 + exp(.))) * C_inv
+  s->dct.CopyFromMat(dct_mat_);
+  s->dct.MulColsVec(s->inv);
+  s->jx.AddMatMat(1.0, s->dct, kNoTrans, inv_dct_mat_, kNoTrans, 0.0);
+
+  // compute and update mean
+  SubVector<double>(*mean, 0, nc).CopyFromVec(s->cep);
+  for (int32 b = 1; b < 3; ++b) {
+    SubVector<double> mu_d(*mean, b * nc, nc);
+    s->tmp.CopyFromVec(mu_d);
+    mu_d.AddMatVec(1.0, s->jx, kNoTrans, s->tmp, 0.0);
+  }
+
+  if (compensate_var) {
+    // I_J differs from J on the diagonal only
+    s->jx2.CopyFromMat(s->jx);
+    s->jz2.CopyFromMat(s->jx);
+    for (int32 ii = 0; ii < nc; ++ii) {
+      s->jz2(ii, ii) = 1.0 - s->jz2(ii, ii);
+    }
+    s->jx2.ApplyPow(2.0);
+    s->jz2.ApplyPow(2.0);
+
+    // diag( J * var_x * J^T + I_J * var_z * I_J^T )
+    for (int32 b = 0; b < 3; ++b) {
+      SubVector<double> x_var(*var, b * nc, nc);
+      SubVector<double> n_var(var_z, b * nc, nc);
+      s->tmp.AddMatVec(1.0, s->jx2, kNoTrans, x_var, 0.0);
+      s->tmp.AddMatVec(1.0, s->jz2, kNoTrans, n_var, 1.0);
+      x_var.CopyFromVec(s->tmp);
+    }
+  }
+}
+
+void MultiFrameCompensator::CompensatePdfs(const Job &job) {
+  Scratch *s = job.scratch;
+  int32 dim = clean_means_.NumCols();
+
+  for (int32 pdf = job.pdf_begin; pdf < job.pdf_end; ++pdf) {
+    int32 begin = pdf_offset_[pdf], num_gauss = pdf_offset_[pdf + 1] - begin;
+    SubMatrix<double> means(noisy_means_, begin, num_gauss, 0, dim);
+    SubMatrix<double> vars(noisy_vars_, begin, num_gauss, 0, dim);
+    means.CopyFromMat(SubMatrix<double>(clean_means_, begin, num_gauss, 0, dim));
+    vars.CopyFromMat(SubMatrix<double>(clean_vars_, begin, num_gauss, 0, dim));
+
+    for (int32 g = 0; g < num_gauss; ++g) {
+      for (int32 n = 0; n < num_frames_; ++n) {
+        SubVector<double> cur_mean(means.Row(g), n * feat_dim_, feat_dim_);
+        SubVector<double> cur_var(vars.Row(g), n * feat_dim_, feat_dim_);
+        CompensateFrame(*job.mu_h, *job.mu_z, *job.var_z, job.compensate_var,
+                        &cur_mean, &cur_var, s);
+      }
+    }
+
+    DiagGmm &gmm = job.noise_am_gmm->GetPdf(pdf);
+    KALDI_ASSERT(gmm.NumGauss() == num_gauss && gmm.Dim() == dim);
+    if (s->inv_vars.NumRows() < num_gauss) {
+      s->inv_vars.Resize(num_gauss, dim, kUndefined);
+    }
+    SubMatrix<double> inv_vars(s->inv_vars, 0, num_gauss, 0, dim);
+    inv_vars.CopyFromMat(vars);
+    inv_vars.InvertElements();
+    gmm.SetInvVarsAndMeans(inv_vars, means);
+    gmm.ComputeGconsts();
+  }
+}
+
+void* MultiFrameCompensator::RunJob(void *arg) {
+  Job *job = static_cast<Job*>(arg);
+  job->compensator->CompensatePdfs(*job);
+  return NULL;
+}
+
+void MultiFrameCompensator::Compensate(const Vector<double> &mu_h,
+                                       const Vector<double> &mu_z,
+                                       const Vector<double> &var_z,
+                                       bool compensate_var,
+                                       AmDiagGmm *noise_am_gmm) {
+  if (pdf_offset_.empty()) {
+    KALDI_ERR<< "The clean model is not set for the VTS compensation!";
+  }
+  int32 num_pdf = pdf_offset_.size() - 1;
+  KALDI_ASSERT(noise_am_gmm->NumPdfs() == num_pdf);
+  KALDI_ASSERT(mu_h.Dim() >= num_cepstral_ && mu_z.Dim() >= num_cepstral_);
+  KALDI_ASSERT(!compensate_var || var_z.Dim() >= 3 * num_cepstral_);
+
+  int32 num_threads = std::min(num_threads_, std::max(num_pdf, 1));
+  if (static_cast<int32>(scratch_.size()) != num_threads) {
+    scratch_.resize(num_threads);
+    for (int32 t = 0; t < num_threads; ++t) {
+      InitScratch(&scratch_[t]);
+    }
+  }
+
+  // contiguous blocks of pdfs
+  std::vector<Job> jobs(num_threads);
+  for (int32 t = 0; t < num_threads; ++t) {
+    Job &job = jobs[t];
+    job.compensator = this;
+    job.pdf_begin = static_cast<int64>(num_pdf) * t / num_threads;
+    job.pdf_end = static_cast<int64>(num_pdf) * (t + 1) / num_threads;
+    job.scratch = &scratch_[t];
+    job.mu_h = &mu_h;
+    job.mu_z = &mu_z;
+    job.var_z = &var_z;
+    job.compensate_var = compensate_var;
+    job.noise_am_gmm = noise_am_gmm;
+  }
+
+  if (num_threads == 1) {
+    RunJob(&jobs[0]);
+    return;
+  }
+  std::vector<pthread_t> threads(num_threads);
+  int32 num_started = 0;
+  int ret = 0;
+  for (; num_started < num_threads; ++num_started) {
+    ret = pthread_create(&threads[num_started], NULL, RunJob,
+                         &jobs[num_started]);
+    if (ret != 0) break;
+  }
+  // the started threads use jobs, wait for them before leaving
+  for (int32 t = 0; t < num_started; ++t) {
+    pthread_join(threads[t], NULL);
+  }
+  if (ret != 0) {
+    KALDI_ERR<< "Error creating thread, errno was: " << ret;
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,136 @@
+/*
+ * vts-multi-frame.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ *  First order VTS compensation of the multi-frame expanded GMMs, shared by
+ *  GaussBL, PosNegBL and CompensateMultiFrameGmm().
+ *
+ *  The DCT and inverse DCT are generated once, the clean means and variances
+ *  of all the Gaussians are kept as two contiguous matrices (one row per
+ *  Gaussian), and the compensation runs over the pdfs on several threads,
+ *  each with its own preallocated scratch buffers.
+ *
+ *  Only the diagonal of J * diag(var) * J^T is needed, it is computed as
+ *  (J .* J) * var.
+ */
+
+#ifndef KALDI_VTS_VTS_MULTI_FRAME_H_
+#define KALDI_VTS_VTS_MULTI_FRAME_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "gmm/am-diag-gmm.h"
+
+namespace kaldi {
+
+class MultiFrameCompensator {
+ public:
+  MultiFrameCompensator()
+      : num_cepstral_(0),
+        num_fbank_(0),
+        num_frames_(0),
+        feat_dim_(0),
+        num_threads_(1)
+  {
+  }
+
+  /// Generate the DCT transforms, see GenerateDCTmatrix()
+  void Init(int32 num_cepstral, int32 num_fbank, BaseFloat ceplifter,
+            int32 num_frames);
+  /// Use the given DCT transforms
+  void Init(const Matrix<double> &dct_mat, const Matrix<double> &inv_dct_mat,
+            int32 num_frames);
+
+  void SetNumThreads(int32 num_threads) {
+    num_threads_ = (num_threads > 0 ? num_threads : 1);
+  }
+
+  bool IsInitialized() const {
+    return num_cepstral_ > 0;
+  }
+
+  const Matrix<double>& DctMat() const {
+    return dct_mat_;
+  }
+  const Matrix<double>& InvDctMat() const {
+    return inv_dct_mat_;
+  }
+
+  /// Keep the means and variances of the clean model
+  void SetCleanModel(const AmDiagGmm &clean_am_gmm);
+
+  /// Compensate the clean model with the noise parameters. noise_am_gmm
+  /// must have the same pdfs and Gaussians (e.g. a copy of the clean
+  /// model), its means, variances and gconsts are overwritten.
+  void Compensate(const Vector<double> &mu_h, const Vector<double> &mu_z,
+                  const Vector<double> &var_z, bool compensate_var,
+                  AmDiagGmm *noise_am_gmm);
+
+  /// The compensated means and variances of the last Compensate(),
+  /// one row per Gaussian, rows [PdfOffset(pdf), PdfOffset(pdf + 1))
+  const Matrix<double>& NoisyMeans() const {
+    return noisy_means_;
+  }
+  const Matrix<double>& NoisyVars() const {
+    return noisy_vars_;
+  }
+  int32 PdfOffset(int32 pdf) const {
+    return pdf_offset_[pdf];
+  }
+
+ private:
+  struct Scratch {
+    Vector<double> cep;
+    Vector<double> fbank;
+    Vector<double> inv;
+    Vector<double> tmp;
+    Matrix<double> dct;
+    Matrix<double> jx;
+    Matrix<double> jx2;
+    Matrix<double> jz2;
+    Matrix<double> inv_vars;
+  };
+
+  struct Job {
+    MultiFrameCompensator *compensator;
+    int32 pdf_begin, pdf_end;
+    Scratch *scratch;
+    const Vector<double> *mu_h, *mu_z, *var_z;
+    bool compensate_var;
+    AmDiagGmm *noise_am_gmm;
+  };
+  static void* RunJob(void *arg);
+
+  void InitScratch(Scratch *s) const;
+  /// Compensate one frame of a Gaussian in place
+  void CompensateFrame(const Vector<double> &mu_h, const Vector<double> &mu_z,
+                       const Vector<double> &var_z, bool compensate_var,
+                       SubVector<double> *mean, SubVector<double> *var,
+                       Scratch *s) const;
+  void CompensatePdfs(const Job &job);
+
+  int32 num_cepstral_;
+  int32 num_fbank_;
+  int32 num_frames_;
+  int32 feat_dim_;  ///< single frame dim, static + delta + acc
+  int32 num_threads_;
+
+  Matrix<double> dct_mat_;
+  Matrix<double> inv_dct_mat_;
+
+  std::vector<int32> pdf_offset_;  ///< first Gaussian row of each pdf
+  Matrix<double> clean_means_;
+  Matrix<double> clean_vars_;
+  Matrix<double> noisy_means_;
+  Matrix<double> noisy_vars_;
+
+  std::vector<Scratch> scratch_;  ///< one per thread
+};
+
+}  // namespace kaldi
+
+#endif /* KALDI_VTS_VTS_MULTI_FRAME_H_ */
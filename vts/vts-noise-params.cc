@@ -0,0 +1,134 @@
+/*
+ * vts/vts-noise-params.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ */
+
+#include <cstring>
+
+#include "vts/vts-noise-params.h"
+
+namespace kaldi {
+
+void NoiseParams::Set(const VectorBase<double> &mu_h,
+                      const VectorBase<double> &mu_z,
+                      const VectorBase<double> &var_z) {
+  dim_mu_h_ = mu_h.Dim();
+  dim_mu_z_ = mu_z.Dim();
+  dim_var_z_ = var_z.Dim();
+
+  data_.Resize(dim_mu_h_ + dim_mu_z_ + dim_var_z_, kUndefined);
+  SubVector<double>(data_, 0, dim_mu_h_).CopyFromVec(mu_h);
+  SubVector<double>(data_, dim_mu_h_, dim_mu_z_).CopyFromVec(mu_z);
+  SubVector<double>(data_, dim_mu_h_ + dim_mu_z_, dim_var_z_).CopyFromVec(
+      var_z);
+}
+
+void NoiseParams::GetParams(Vector<double> *mu_h, Vector<double> *mu_z,
+                            Vector<double> *var_z) const {
+  KALDI_ASSERT(mu_h != NULL && mu_z != NULL && var_z != NULL);
+  mu_h->Resize(dim_mu_h_, kUndefined);
+  mu_h->CopyFromVec(MuH());
+  mu_z->Resize(dim_mu_z_, kUndefined);
+  mu_z->CopyFromVec(MuZ());
+  var_z->Resize(dim_var_z_, kUndefined);
+  var_z->CopyFromVec(VarZ());
+}
+
+void NoiseParams::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<NoiseParams>");
+  ReadBasicType(is, binary, &dim_mu_h_);
+  ReadBasicType(is, binary, &dim_mu_z_);
+  ReadBasicType(is, binary, &dim_var_z_);
+  data_.Read(is, binary);
+
+  if (dim_mu_h_ < 0 || dim_mu_z_ < 0 || dim_var_z_ < 0
+      || data_.Dim() != dim_mu_h_ + dim_mu_z_ + dim_var_z_) {
+    KALDI_ERR << "Corrupted noise parameters, dims " << dim_mu_h_ << " "
+        << dim_mu_z_ << " " << dim_var_z_ << " vs. data " << data_.Dim();
+  }
+}
+
+void NoiseParams::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<NoiseParams>");
+  WriteBasicType(os, binary, dim_mu_h_);
+  WriteBasicType(os, binary, dim_mu_z_);
+  WriteBasicType(os, binary, dim_var_z_);
+  data_.Write(os, binary);
+}
+
+bool SplitLegacyNoiseKey(const std::string &legacy_key, std::string *utt,
+                         int32 *index) {
+  static const char *suffixes[] = { "_mu_h", "_mu_z", "_var_z" };
+  for (int32 i = 0; i < 3; ++i) {
+    size_t len = strlen(suffixes[i]);
+    if (legacy_key.size() > len
+        && legacy_key.compare(legacy_key.size() - len, len, suffixes[i]) == 0) {
+      *utt = legacy_key.substr(0, legacy_key.size() - len);
+      *index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+NoiseParamsReader::NoiseParamsReader(const std::string &rspecifier,
+                                     bool legacy)
+    : legacy_(legacy),
+      seq_reader_(NULL),
+      legacy_reader_(NULL) {
+  if (legacy_) {
+    legacy_reader_ = new RandomAccessDoubleVectorReader(rspecifier);
+  } else {
+    seq_reader_ = new SequentialNoiseParamsReader(rspecifier);
+  }
+}
+
+NoiseParamsReader::~NoiseParamsReader() {
+  if (seq_reader_ != NULL)
+    delete seq_reader_;
+  if (legacy_reader_ != NULL)
+    delete legacy_reader_;
+}
+
+bool NoiseParamsReader::HasKey(const std::string &key) {
+  if (legacy_) {
+    if (!legacy_reader_->HasKey(key + "_mu_h")
+        || !legacy_reader_->HasKey(key + "_mu_z")
+        || !legacy_reader_->HasKey(key + "_var_z")) {
+      return false;
+    }
+    if (cur_key_ != key) {
+      legacy_params_.Set(legacy_reader_->Value(key + "_mu_h"),
+                         legacy_reader_->Value(key + "_mu_z"),
+                         legacy_reader_->Value(key + "_var_z"));
+      cur_key_ = key;
+    }
+    return true;
+  }
+
+  // skip the entries of utterances absent from the features, but not past
+  // the requested one: if it has no entry, the next utterances may have
+  while (!seq_reader_->Done() && seq_reader_->Key() < key) {
+    KALDI_VLOG(2) << "Skipping noise parameters of " << seq_reader_->Key();
+    seq_reader_->Next();
+  }
+  if (seq_reader_->Done() || seq_reader_->Key() != key) {
+    return false;
+  }
+  cur_key_ = key;
+  return true;
+}
+
+const NoiseParams& NoiseParamsReader::Value(const std::string &key) {
+  if (cur_key_ != key && !HasKey(key)) {
+    KALDI_ERR << "No noise parameters for " << key;
+  }
+  if (legacy_) {
+    return legacy_params_;
+  }
+  return seq_reader_->Value();
+}
+
+}  // namespace kaldi
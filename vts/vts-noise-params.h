@@ -0,0 +1,124 @@
+/*
+ * vts/vts-noise-params.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ *
+ *  Compact per-utterance VTS noise parameters.
+ *
+ *  The legacy format keeps three DoubleVector records per utterance,
+ *  i.e. "<utt>_mu_h", "<utt>_mu_z" and "<utt>_var_z". NoiseParams holds
+ *  all of them in a single contiguous record keyed by the utterance id,
+ *  so the tools can read them sequentially together with the features.
+ *
+ */
+
+#ifndef KALDI_VTS_VTS_NOISE_PARAMS_H_
+#define KALDI_VTS_VTS_NOISE_PARAMS_H_
+
+#include <string>
+
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-vector.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+
+class NoiseParams {
+ public:
+  NoiseParams()
+      : dim_mu_h_(0),
+        dim_mu_z_(0),
+        dim_var_z_(0) {
+  }
+
+  NoiseParams(const VectorBase<double> &mu_h, const VectorBase<double> &mu_z,
+              const VectorBase<double> &var_z) {
+    Set(mu_h, mu_z, var_z);
+  }
+
+  /// Copy the three parameter vectors into the contiguous storage
+  void Set(const VectorBase<double> &mu_h, const VectorBase<double> &mu_z,
+           const VectorBase<double> &var_z);
+
+  /// Copy out to the separate vectors used by the compensation routines
+  void GetParams(Vector<double> *mu_h, Vector<double> *mu_z,
+                 Vector<double> *var_z) const;
+
+  /// Convolutional noise mean
+  SubVector<double> MuH() const {
+    return SubVector<double>(data_, 0, dim_mu_h_);
+  }
+  /// Additive noise mean
+  SubVector<double> MuZ() const {
+    return SubVector<double>(data_, dim_mu_h_, dim_mu_z_);
+  }
+  /// Additive noise variance
+  SubVector<double> VarZ() const {
+    return SubVector<double>(data_, dim_mu_h_ + dim_mu_z_, dim_var_z_);
+  }
+
+  bool IsEmpty() const {
+    return data_.Dim() == 0;
+  }
+
+  void Read(std::istream &is, bool binary);
+  void Write(std::ostream &os, bool binary) const;
+
+ private:
+  int32 dim_mu_h_, dim_mu_z_, dim_var_z_;
+  /// [ mu_h mu_z var_z ]
+  Vector<double> data_;
+};
+
+typedef TableWriter<KaldiObjectHolder<NoiseParams> > NoiseParamsWriter;
+typedef SequentialTableReader<KaldiObjectHolder<NoiseParams> > SequentialNoiseParamsReader;
+typedef RandomAccessTableReader<KaldiObjectHolder<NoiseParams> > RandomAccessNoiseParamsReader;
+
+/*
+ * Split a legacy noise parameter key, e.g. "utt1_mu_z" into "utt1" and the
+ * parameter index (0: mu_h, 1: mu_z, 2: var_z).
+ *
+ * Returns false if the key has none of the legacy suffixes.
+ */
+bool SplitLegacyNoiseKey(const std::string &legacy_key, std::string *utt,
+                         int32 *index);
+
+/*
+ * Noise parameter reader used inside the feature loop of the VTS tools.
+ *
+ * With the compact format (converted from the legacy records by
+ * vts-convert-noise-params), the archive is read sequentially and advanced
+ * in sync with the feature reader: the entries sorting before the requested
+ * utterance are skipped, an entry sorting after it is kept for the next
+ * requests. Both archives must therefore be sorted on the utterance id, as
+ * the Kaldi archives normally are.
+ *
+ * With legacy=true, the three "<utt>_mu_h", "<utt>_mu_z", "<utt>_var_z"
+ * records, as written by the noise estimation tools, are fetched through a
+ * RandomAccessDoubleVectorReader.
+ */
+class NoiseParamsReader {
+ public:
+  NoiseParamsReader(const std::string &rspecifier, bool legacy);
+  ~NoiseParamsReader();
+
+  /// Must be called in the order of the feature archive
+  bool HasKey(const std::string &key);
+  /// Valid only after HasKey(key) returned true
+  const NoiseParams& Value(const std::string &key);
+
+ private:
+  bool legacy_;
+  SequentialNoiseParamsReader *seq_reader_;
+  RandomAccessDoubleVectorReader *legacy_reader_;
+
+  std::string cur_key_;
+  NoiseParams legacy_params_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NoiseParamsReader);
+};
+
+}  // namespace kaldi
+
+#endif /* KALDI_VTS_VTS_NOISE_PARAMS_H_ */
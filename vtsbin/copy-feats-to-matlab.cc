@@ -6,15 +6,18 @@
  *
  * Write the archieve feature file to two files:
  * 1) Index file: filename start_frame(0 indexed) end_frame(not included)
- * 2) Data file: each line is a frame
+ * 2) Data file: each line is a frame, or with --raw-binary the frames as
+ *    32-bit floats, read in Matlab by fread(fid, [dim, inf], 'single')'
  *
  */
 
+#include <cstdio>
 #include <fstream>
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "matrix/kaldi-matrix.h"
+#include "nnet/nnet-feat-io.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -27,6 +30,18 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
 
+    bool raw_binary = false;
+    po.Register("raw-binary", &raw_binary,
+                "Write the data file as raw 32-bit floats instead of text");
+
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads formatting the utterances");
+
+    int32 batch_size = 64;
+    po.Register("batch-size", &batch_size,
+                "Number of utterances formatted together");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 3) {
@@ -38,29 +53,52 @@ int main(int argc, char *argv[]) {
     std::string out_index_file = po.GetArg(2);
     std::string out_data_file = po.GetArg(3);
 
+    KALDI_ASSERT(batch_size > 0);
+
     std::ofstream fidx(out_index_file.c_str());
-    std::ofstream fdat(out_data_file.c_str());
+    FILE *fdat = fopen(out_data_file.c_str(), "wb");
+    if (fdat == NULL) {
+      KALDI_ERR << "Could not open " << out_data_file;
+    }
     int32 total_frames = 0;
 
+    FeatBatchConverter converter(num_threads, raw_binary);
+    std::vector<std::string> keys;
+    std::vector<Matrix<BaseFloat> > feats;
+    std::vector<std::string> bufs;
+
     SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
-    for (; !kaldi_reader.Done(); kaldi_reader.Next()) {
+    while (!kaldi_reader.Done()) {
+      // collect a batch of utterances
+      keys.clear();
+      feats.resize(batch_size);
+      for (; !kaldi_reader.Done() && keys.size() < (size_t) batch_size;
+          kaldi_reader.Next()) {
+        const Matrix<BaseFloat> &feat = kaldi_reader.Value();
+        Matrix<BaseFloat> &copy = feats[keys.size()];
+        copy.Resize(feat.NumRows(), feat.NumCols(), kUndefined);
+        copy.CopyFromMat(feat);
+        keys.push_back(kaldi_reader.Key());
+      }
+      feats.resize(keys.size());
 
-      std::string key = kaldi_reader.Key();
-      const Matrix<BaseFloat> &feat = kaldi_reader.Value();
+      converter.Format(feats, &bufs);
 
-      fidx << key << " " << total_frames << " " << total_frames + feat.NumRows()
-          << std::endl;
-      for(int32 r=0; r<feat.NumRows(); ++r){
-        for (int32 c=0; c<feat.NumCols(); ++c){
-          fdat << feat(r,c) << " ";
+      // written in the reading order
+      for (size_t i = 0; i < keys.size(); ++i) {
+        fidx << keys[i] << " " << total_frames << " "
+            << total_frames + feats[i].NumRows() << std::endl;
+        if (fwrite(bufs[i].data(), 1, bufs[i].size(), fdat) != bufs[i].size()) {
+          KALDI_ERR << "Could not write " << out_data_file;
         }
-        fdat << std::endl;
+        total_frames += feats[i].NumRows();
       }
-      total_frames += feat.NumRows();
     }
 
     fidx.close();
-    fdat.close();
+    if (fclose(fdat) != 0) {
+      KALDI_ERR << "Could not close " << out_data_file;
+    }
 
     return 0;
   } catch (const std::exception &e) {
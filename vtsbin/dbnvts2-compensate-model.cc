@@ -22,6 +22,7 @@
 #include "util/timer.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-multi-frame.h"
 #include "vts/dbnvts2-first-order.h"
 
 int main(int argc, char *argv[]) {
@@ -87,6 +88,10 @@ int main(int argc, char *argv[]) {
         "post-var-scale", &post_var_scale,
         "Whether the variance scaling is applied before compensation or after");
 
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads for the VTS compensation of the pdfs");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 6) {
@@ -159,13 +164,17 @@ int main(int argc, char *argv[]) {
       ScaleVariance(var_scale, pos_noise_am, neg_noise_am);
     }
 
-    CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-                            num_fbank, dct_mat, inv_dct_mat, num_frames,
-                            pos_noise_am);
-
-    CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-                            num_fbank, dct_mat, inv_dct_mat, num_frames,
-                            neg_noise_am);
+    // the (scaled) copies are the clean models of the compensation
+    MultiFrameCompensator pos_vts, neg_vts;
+    pos_vts.Init(dct_mat, inv_dct_mat, num_frames);
+    pos_vts.SetNumThreads(num_threads);
+    pos_vts.SetCleanModel(pos_noise_am);
+    pos_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &pos_noise_am);
+
+    neg_vts.Init(dct_mat, inv_dct_mat, num_frames);
+    neg_vts.SetNumThreads(num_threads);
+    neg_vts.SetCleanModel(neg_noise_am);
+    neg_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &neg_noise_am);
 
     if (shared_var) {
       // set the covariance to be the same for pos and neg
@@ -13,6 +13,7 @@
 #include "util/timer.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-multi-frame.h"
 #include "vts/dbnvts2-first-order.h"
 
 int main(int argc, char *argv[]) {
@@ -53,6 +54,10 @@ int main(int argc, char *argv[]) {
     po.Register("noise-params", &noise_params_rspecifier,
                 "Noise parameters for VTS compensation if available");
 
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads for the VTS compensation of the pdfs");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5) {
@@ -113,9 +118,21 @@ int main(int argc, char *argv[]) {
     AmDiagGmm pos_noise_am, neg_noise_am;
 
     Matrix<double> dct_mat, inv_dct_mat;
+    // one compensator per clean model, the noisy copies keep the structure
+    // and get new means, variances and gconsts from each Compensate()
+    MultiFrameCompensator pos_vts, neg_vts;
     if (do_vts) {
       GenerateDCTmatrix(num_cepstral, num_fbank, ceplifter, &dct_mat,
                         &inv_dct_mat);
+
+      pos_noise_am.CopyFromAmDiagGmm(pos_am_gmm);
+      neg_noise_am.CopyFromAmDiagGmm(neg_am_gmm);
+      pos_vts.Init(dct_mat, inv_dct_mat, num_frames);
+      pos_vts.SetNumThreads(num_threads);
+      pos_vts.SetCleanModel(pos_noise_am);
+      neg_vts.Init(dct_mat, inv_dct_mat, num_frames);
+      neg_vts.SetNumThreads(num_threads);
+      neg_vts.SetCleanModel(neg_noise_am);
     }
 
     kaldi::int64 tot_t = 0;
@@ -154,16 +171,8 @@ int main(int argc, char *argv[]) {
         }
 
         // compensate the postive and negative gmm models
-        pos_noise_am.CopyFromAmDiagGmm(pos_am_gmm);
-        neg_noise_am.CopyFromAmDiagGmm(neg_am_gmm);
-
-        CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-            num_fbank, dct_mat, inv_dct_mat, num_frames,
-            pos_noise_am);
-
-        CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-            num_fbank, dct_mat, inv_dct_mat, num_frames,
-            neg_noise_am);
+        pos_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &pos_noise_am);
+        neg_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &neg_noise_am);
 
         ComputeGaussianLogLikelihoodRatio_General(feat, pos_noise_am,
             neg_noise_am,
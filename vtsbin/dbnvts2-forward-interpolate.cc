@@ -23,6 +23,7 @@
 #include "util/timer.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-multi-frame.h"
 #include "vts/dbnvts2-first-order.h"
 
 int main(int argc, char *argv[]) {
@@ -111,6 +112,10 @@ int main(int argc, char *argv[]) {
 
     po.Register("silent", &silent, "Don't print any messages");
 
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads for the VTS compensation of the pdfs");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 11) {
@@ -229,6 +234,21 @@ int main(int argc, char *argv[]) {
     GenerateDCTmatrix(num_cepstral, num_fbank, ceplifter, &dct_mat,
                       &inv_dct_mat);
 
+    // one compensator per clean model, the noisy copies keep the structure
+    // and get new means, variances and gconsts from each Compensate()
+    pos_noise_am.CopyFromAmDiagGmm(pos_am_gmm);
+    neg_noise_am.CopyFromAmDiagGmm(neg_am_gmm);
+    if (use_var_scale && !post_var_scale) {
+      ScaleVariance(var_scale, pos_noise_am, neg_noise_am);
+    }
+    MultiFrameCompensator pos_vts, neg_vts;
+    pos_vts.Init(dct_mat, inv_dct_mat, num_frames);
+    pos_vts.SetNumThreads(num_threads);
+    pos_vts.SetCleanModel(pos_noise_am);
+    neg_vts.Init(dct_mat, inv_dct_mat, num_frames);
+    neg_vts.SetNumThreads(num_threads);
+    neg_vts.SetCleanModel(neg_noise_am);
+
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
@@ -287,20 +307,9 @@ int main(int argc, char *argv[]) {
       }
 
         // compensate the postive and negative gmm models
-      pos_noise_am.CopyFromAmDiagGmm(pos_am_gmm);
-      neg_noise_am.CopyFromAmDiagGmm(neg_am_gmm);
-
-      if (use_var_scale && !post_var_scale) {
-        ScaleVariance(var_scale, pos_noise_am, neg_noise_am);
-      }
-
-      CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-                              num_fbank, dct_mat, inv_dct_mat, num_frames,
-                              pos_noise_am);
-
-      CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-                              num_fbank, dct_mat, inv_dct_mat, num_frames,
-                              neg_noise_am);
+      // the variances were scaled before the compensation if asked
+      pos_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &pos_noise_am);
+      neg_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &neg_noise_am);
 
       if (shared_var) {
         // set the covariance to be the same for pos and neg
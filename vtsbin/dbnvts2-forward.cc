@@ -21,6 +21,7 @@
 #include "util/timer.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-noise-params.h"
 #include "vts/dbnvts2-first-order.h"
 
 int main(int argc, char *argv[]) {
@@ -90,6 +91,12 @@ int main(int argc, char *argv[]) {
         &no_softmax,
         "No softmax on MLP output. The MLP outputs directly log-likelihoods, log-priors will be subtracted");
 
+    bool legacy_noise = true;
+    po.Register("legacy-noise-params", &legacy_noise,
+                "Noise parameters are stored as <utt>_mu_h, <utt>_mu_z, <utt>_var_z vectors, "
+                "as written by the noise estimation tools (false: the compact archive of "
+                "vts-convert-noise-params)");
+
     po.Register("silent", &silent, "Don't print any messages");
 
     po.Read(argc, argv);
@@ -167,7 +174,7 @@ int main(int argc, char *argv[]) {
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessDoubleVectorReader noiseparams_reader(noise_params_rspecifier);
+    NoiseParamsReader noiseparams_reader(noise_params_rspecifier, legacy_noise);
     BaseFloatMatrixWriter feature_writer(feature_wspecifier);
 
     CuMatrix<BaseFloat> feat_dev, nnet_out_dev;
@@ -218,14 +225,11 @@ int main(int argc, char *argv[]) {
 
       if (have_noise) {
         // read noise parameters
-        if (!noiseparams_reader.HasKey(key + "_mu_h")
-            || !noiseparams_reader.HasKey(key + "_mu_z")
-            || !noiseparams_reader.HasKey(key + "_var_z")) {
+        if (!noiseparams_reader.HasKey(key)) {
           KALDI_ERR<< "Not all the noise parameters (mu_h, mu_z, var_z) are available!";
         }
-        Vector<double> mu_h(noiseparams_reader.Value(key + "_mu_h"));
-        Vector<double> mu_z(noiseparams_reader.Value(key + "_mu_z"));
-        Vector<double> var_z(noiseparams_reader.Value(key + "_var_z"));
+        Vector<double> mu_h, mu_z, var_z;
+        noiseparams_reader.Value(key).GetParams(&mu_h, &mu_z, &var_z);
         if (g_kaldi_verbose_level >= 1) {
           KALDI_LOG<< "Additive Noise Mean: " << mu_z;
           KALDI_LOG << "Additive Noise Covariance: " << var_z;
@@ -17,6 +17,7 @@
 #include "gmm/diag-gmm-normal.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-multi-frame.h"
 #include "vts/dbnvts2-first-order.h"
 
 int main(int argc, char *argv[]) {
@@ -74,6 +75,10 @@ int main(int argc, char *argv[]) {
     po.Register("ceplifter", &ceplifter,
                 "CepLifter value used for feature extraction");
 
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads for the VTS compensation of the pdfs");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 8) {
@@ -157,6 +162,18 @@ int main(int argc, char *argv[]) {
     GenerateDCTmatrix(num_cepstral, num_fbank, ceplifter, &dct_mat,
                       &inv_dct_mat);
 
+    // one compensator per clean model, the noisy copies keep the structure
+    // and get new means, variances and gconsts from each Compensate()
+    noise_pos_am_gmm.CopyFromAmDiagGmm(pos_am_gmm);
+    noise_neg_am_gmm.CopyFromAmDiagGmm(neg_am_gmm);
+    MultiFrameCompensator pos_vts, neg_vts;
+    pos_vts.Init(dct_mat, inv_dct_mat, num_frames);
+    pos_vts.SetNumThreads(num_threads);
+    pos_vts.SetCleanModel(noise_pos_am_gmm);
+    neg_vts.Init(dct_mat, inv_dct_mat, num_frames);
+    neg_vts.SetNumThreads(num_threads);
+    neg_vts.SetCleanModel(noise_neg_am_gmm);
+
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomAccessDoubleVectorReader noiseparams_reader(noise_params_rspecifier);
     RandomAccessBaseFloatMatrixReader blacts_reader(blacts_rspecifier);
@@ -228,21 +245,13 @@ int main(int argc, char *argv[]) {
         }
 
         // compensate the postive and negative gmm models
-        noise_pos_am_gmm.CopyFromAmDiagGmm(pos_am_gmm);
-        noise_neg_am_gmm.CopyFromAmDiagGmm(neg_am_gmm);
-
         // pre-compensation variance scaling
         /*if(use_var_scale) {
          ScaleVariance(var_scale, noise_pos_am_gmm, noise_neg_am_gmm);
          }*/
 
-        CompensateMultiFrameGmm(mu_h, mu_z, var_z, true, num_cepstral, num_fbank,
-            dct_mat, inv_dct_mat, num_frames,
-            noise_pos_am_gmm);
-
-        CompensateMultiFrameGmm(mu_h, mu_z, var_z, true, num_cepstral, num_fbank,
-            dct_mat, inv_dct_mat, num_frames,
-            noise_neg_am_gmm);
+        pos_vts.Compensate(mu_h, mu_z, var_z, true, &noise_pos_am_gmm);
+        neg_vts.Compensate(mu_h, mu_z, var_z, true, &noise_neg_am_gmm);
 
         if (shared_var) {
           // set the covariance to be the same for pos and neg
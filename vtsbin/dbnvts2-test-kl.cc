@@ -17,6 +17,7 @@
 #include "gmm/am-diag-gmm.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-multi-frame.h"
 #include "vts/dbnvts2-first-order.h"
 
 int main(int argc, char *argv[]) {
@@ -92,6 +93,10 @@ int main(int argc, char *argv[]) {
     bool silent = false;
     po.Register("silent", &silent, "Don't print any messages");
 
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads for the VTS compensation of the pdfs");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 7) {
@@ -194,15 +199,16 @@ int main(int argc, char *argv[]) {
         }
 
           // compensate the postive and negative gmm models
-        pos_noise_am.CopyFromAmDiagGmm(pos_am_gmm);
-        CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-                                num_fbank, dct_mat, inv_dct_mat, num_frames,
-                                pos_noise_am);
-
-        neg_noise_am.CopyFromAmDiagGmm(neg_am_gmm);
-        CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-                                num_fbank, dct_mat, inv_dct_mat, num_frames,
-                                neg_noise_am);
+        MultiFrameCompensator pos_vts, neg_vts;
+        pos_vts.Init(dct_mat, inv_dct_mat, num_frames);
+        pos_vts.SetNumThreads(num_threads);
+        pos_vts.SetCleanModel(pos_am_gmm);
+        pos_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &pos_noise_am);
+
+        neg_vts.Init(dct_mat, inv_dct_mat, num_frames);
+        neg_vts.SetNumThreads(num_threads);
+        neg_vts.SetCleanModel(neg_am_gmm);
+        neg_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &neg_noise_am);
 
         if (shared_var) {
           // set the covariance to be the same for pos and neg
@@ -8,6 +8,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "matrix/kaldi-matrix.h"
+#include "vts/vts-noise-params.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -17,7 +18,10 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Append VTS noise estimation to the feature frames\n"
             "Usage: feats-append-noise [options] feat-rspecifier noise-rspecifier out-wspecifier\n"
-            "Example: feats-append-noise ark:feats.ark ark:noise.ark ark:output.ark\n";
+            "Example: feats-append-noise ark:feats.ark ark:noise.ark ark:output.ark\n"
+            "Note: with --legacy-noise-params an utterance needs all three of <utt>_mu_h,\n"
+            "<utt>_mu_z and <utt>_var_z, also those not appended; an utterance missing\n"
+            "any of them (or absent from the compact archive) is skipped with a warning.\n";
 
     ParseOptions po(usage);
 
@@ -36,6 +40,12 @@ int main(int argc, char *argv[]) {
     po.Register("use-channel-noise-mean", &use_channel_noise_mean,
                 "Append the channel noise mean to each feature frame");
 
+    bool legacy_noise = true;
+    po.Register("legacy-noise-params", &legacy_noise,
+                "Noise parameters are stored as <utt>_mu_h, <utt>_mu_z, <utt>_var_z vectors, "
+                "as written by the noise estimation tools (false: the compact archive of "
+                "vts-convert-noise-params)");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 3) {
@@ -49,7 +59,7 @@ int main(int argc, char *argv[]) {
 
     BaseFloatMatrixWriter kaldi_writer(wspecifier);
     SequentialBaseFloatMatrixReader feat_reader(feat_rspecifier);
-    RandomAccessDoubleVectorReader noise_reader(noise_rspecifier);
+    NoiseParamsReader noise_reader(noise_rspecifier, legacy_noise);
 
     for (; !feat_reader.Done(); feat_reader.Next()) {
       std::string utt = feat_reader.Key();
@@ -57,39 +67,30 @@ int main(int argc, char *argv[]) {
       Vector<double> noise;
       int32 dim = 0;
 
+      if (!noise_reader.HasKey(utt)) {
+        KALDI_WARN<< "Could not find noise parameters for " << utt << " in "
+        << noise_rspecifier << (legacy_noise ? " (needs _mu_h, _mu_z and _var_z)" : "")
+        << ": producing no output for the utterance";
+        continue;
+      }
+      const NoiseParams &params = noise_reader.Value(utt);
+
       if (use_additive_noise_mean) {
-        if (!noise_reader.HasKey(utt + "_mu_z")) {
-          KALDI_WARN<< "Could not find additive noise mean for " << utt << " in "
-          << noise_rspecifier << ": producing no output for the utterance";
-          continue;
-        }
-        Vector<double> cur(noise_reader.Value(utt + "_mu_z"));
         noise.Resize(dim+num_cepstral, kCopyData); // only static part has values
-        (SubVector<double>(noise, dim, num_cepstral)).CopyFromVec(SubVector<double>(cur, 0, num_cepstral));
+        (SubVector<double>(noise, dim, num_cepstral)).CopyFromVec(params.MuZ().Range(0, num_cepstral));
         dim=noise.Dim();
       }
 
       if (use_additive_noise_var) {
-        if (!noise_reader.HasKey(utt + "_var_z")) {
-          KALDI_WARN<< "Could not find additive noise var for " << utt << " in "
-          << noise_rspecifier << ": producing no output for the utterance";
-          continue;
-        }
-        Vector<double> cur(noise_reader.Value(utt + "_var_z"));
+        SubVector<double> cur(params.VarZ());
         noise.Resize(dim+cur.Dim(), kCopyData); // var has all the values
         (SubVector<double>(noise, dim, cur.Dim())).CopyFromVec(cur);
         dim=noise.Dim();
       }
 
       if (use_channel_noise_mean) {
-        if (!noise_reader.HasKey(utt + "_mu_h")) {
-          KALDI_WARN<< "Could not find channel noise mean for " << utt << " in "
-          << noise_rspecifier << ": producing no output for the utterance";
-          continue;
-        }
-        Vector<double> cur(noise_reader.Value(utt + "_mu_h"));
         noise.Resize(dim+num_cepstral, kCopyData);
-        (SubVector<double>(noise, dim, num_cepstral)).CopyFromVec(SubVector<double>(cur, 0, num_cepstral));
+        (SubVector<double>(noise, dim, num_cepstral)).CopyFromVec(params.MuH().Range(0, num_cepstral));
         dim=noise.Dim();
       }
 
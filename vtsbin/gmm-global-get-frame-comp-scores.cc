@@ -8,6 +8,7 @@
 #include "gmm/mle-full-gmm.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-batched-gmm.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -86,22 +87,11 @@ int main(int argc, char *argv[]) {
       std::string key = feature_reader.Key();
       const Matrix<BaseFloat> &mat = feature_reader.Value();
       int32 file_frames = mat.NumRows();
-      Matrix<BaseFloat> scores(file_frames, gmm.NumGauss());
+      Matrix<BaseFloat> scores;
 
       if (!have_noise) {
         // no noise..
-        for (int32 i = 0; i < file_frames; i++) {
-          Vector<BaseFloat> loglikes;
-          if(out_likes) {
-            gmm.LogLikelihoods(mat.Row(i), &loglikes);
-          }else {
-            gmm.ComponentPosteriors(mat.Row(i), &loglikes);
-          }
-          if (!apply_log) {
-            loglikes.ApplyExp();
-          }
-          scores.CopyRowFromVec(loglikes, i);
-        }
+        DiagGmmFrameLogLikelihoods(gmm, mat, &scores);
       } else {
         // have noise
 
@@ -130,17 +120,18 @@ int main(int argc, char *argv[]) {
         std::vector<Matrix<double> > Jx(gmm.NumGauss()), Jz(gmm.NumGauss());  // not necessary for compensation only
         CompensateDiagGmm(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat, inv_dct_mat, noise_gmm, Jx, Jz);
 
-        for (int32 i = 0; i < file_frames; i++) {
-          Vector<BaseFloat> loglikes;
-          if(out_likes){
-            noise_gmm.LogLikelihoods(mat.Row(i), &loglikes);
-          }else{
-            noise_gmm.ComponentPosteriors(mat.Row(i), &loglikes);
-          }
-          if (!apply_log) {
-            loglikes.ApplyExp();
-          }
-          scores.CopyRowFromVec(loglikes, i);
+        DiagGmmFrameLogLikelihoods(noise_gmm, mat, &scores);
+      }
+
+      for (int32 i = 0; i < file_frames; i++) {
+        SubVector<BaseFloat> row(scores, i);
+        if (!out_likes) {
+          // posteriors, as DiagGmm::ComponentPosteriors()
+          row.Add(-row.LogSumExp());
+          row.ApplyExp();
+        }
+        if (!apply_log) {
+          row.ApplyExp();
         }
       }
 
@@ -16,9 +16,9 @@
 #include "fstext/fstext-lib.h"
 #include "decoder/faster-decoder.h"
 #include "decoder/training-graph-compiler.h"
-#include "decoder/decodable-am-diag-gmm.h"
 #include "lat/kaldi-lattice.h" // for {Compact}LatticeArc
 #include "vts/vts-first-order.h"
+#include "vts/vts-batched-gmm.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -66,6 +66,10 @@ int main(int argc, char *argv[]) {
                 "Number of FBanks used to generate the Cepstral features");
     po.Register("ceplifter", &ceplifter,
                 "CepLifter value used for feature extraction");
+
+    BatchedGmmOptions batched_opts;
+    batched_opts.Register(&po);
+
     po.Read(argc, argv);
 
     if (po.NumArgs() < 5 || po.NumArgs() > 6) {
@@ -95,6 +99,9 @@ int main(int argc, char *argv[]) {
       am_gmm.Read(ki.Stream(), binary);
     }
 
+    BatchedAmDiagGmm batched_am(batched_opts);
+    batched_am.ReadUbm(am_gmm);
+
     Matrix<double> dct_mat, inv_dct_mat;
     GenerateDCTmatrix(num_cepstral, num_fbank, ceplifter, &dct_mat,
                       &inv_dct_mat);
@@ -156,6 +163,9 @@ int main(int argc, char *argv[]) {
         CompensateModel(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
                         inv_dct_mat, noise_am_gmm, Jx, Jz);
 
+        batched_am.InitCompensated(noise_am_gmm, mu_h, mu_z, var_z, num_cepstral,
+                                   num_fbank, dct_mat, inv_dct_mat);
+
 
         VectorFst < StdArc > decode_fst(fst_reader.Value());
         fst_reader.FreeCurrent();  // this stops copy-on-write of the fst
@@ -183,8 +193,9 @@ int main(int argc, char *argv[]) {
         FasterDecoder decoder(decode_fst, decode_opts);
         // makes it a bit faster: 37 sec -> 26 sec on 1000 RM utterances @ beam 200.
 
-        DecodableAmDiagGmmScaled gmm_decodable(noise_am_gmm, trans_model, features,
-                                               acoustic_scale);
+        // the whole utterance is scored here, the retry reuses the scores
+        DecodableAmDiagGmmBatched gmm_decodable(batched_am, trans_model, features,
+                                                acoustic_scale);
         decoder.Decode(&gmm_decodable);
 
         VectorFst<LatticeArc> decoded;  // linear FST.
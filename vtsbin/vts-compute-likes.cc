@@ -12,6 +12,7 @@
 #include "util/timer.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-batched-gmm.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -40,6 +41,9 @@ int main(int argc, char *argv[]) {
     po.Register("ceplifter", &ceplifter,
                 "CepLifter value used for feature extraction");
 
+    BatchedGmmOptions batched_opts;
+    batched_opts.Register(&po);
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4) {
@@ -60,6 +64,9 @@ int main(int argc, char *argv[]) {
       am_gmm.Read(ki.Stream(), binary);
     }
 
+    BatchedAmDiagGmm batched_am(batched_opts);
+    batched_am.ReadUbm(am_gmm);
+
     Matrix<double> dct_mat, inv_dct_mat;
     GenerateDCTmatrix(num_cepstral, num_fbank, ceplifter, &dct_mat,
                       &inv_dct_mat);
@@ -111,13 +118,11 @@ int main(int argc, char *argv[]) {
       CompensateModel(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
                       inv_dct_mat, noise_am_gmm, Jx, Jz);
 
-      Matrix<BaseFloat> loglikes(features.NumRows(), am_gmm.NumPdfs());
-      for (int32 i = 0; i < features.NumRows(); i++) {
-        for (int32 j = 0; j < am_gmm.NumPdfs(); j++) {
-          SubVector<BaseFloat> feat_row(features, i);
-          loglikes(i, j) = noise_am_gmm.LogLikelihood(j, feat_row);
-        }
-      }
+      batched_am.InitCompensated(noise_am_gmm, mu_h, mu_z, var_z, num_cepstral,
+                                 num_fbank, dct_mat, inv_dct_mat);
+
+      Matrix<BaseFloat> loglikes;
+      batched_am.LogLikelihoods(features, &loglikes);
       if (!apply_log) {
         loglikes.ApplyExp();
       }
@@ -13,6 +13,7 @@
 #include "util/timer.h"
 #include "gmm/diag-gmm-normal.h"
 #include "vts/vts-first-order.h"
+#include "vts/vts-batched-gmm.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -39,6 +40,9 @@ int main(int argc, char *argv[]) {
                 "CepLifter value used for feature extraction");
     po.Register("take-log", &take_log, "Output log posterior probabilities or not");
 
+    BatchedGmmOptions batched_opts;
+    batched_opts.Register(&po);
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5) {
@@ -68,6 +72,9 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "mono2tri matrix size: [" << mono2tri.NumRows() << ", "
         << mono2tri.NumCols() << "].";
 
+    BatchedAmDiagGmm batched_am(batched_opts);
+    batched_am.ReadUbm(am_gmm);
+
     Matrix<double> dct_mat, inv_dct_mat;
     GenerateDCTmatrix(num_cepstral, num_fbank, ceplifter, &dct_mat,
                       &inv_dct_mat);
@@ -85,7 +92,6 @@ int main(int argc, char *argv[]) {
     for (; !feature_reader.Done(); feature_reader.Next()) {
       std::string key = feature_reader.Key();
       const Matrix<BaseFloat> &features(feature_reader.Value());
-      Vector<BaseFloat> loglikes(am_gmm.NumPdfs());
       Matrix<BaseFloat> logposts(features.NumRows(), mono2tri.NumRows());
 
       if (g_kaldi_verbose_level >= 1) {
@@ -144,20 +150,24 @@ int main(int argc, char *argv[]) {
         }
       }
 
+      batched_am.InitCompensated(noise_am_gmm, mu_h, mu_z, var_z, num_cepstral,
+                                 num_fbank, dct_mat, inv_dct_mat);
+
+      Matrix<BaseFloat> loglikes;
+      batched_am.LogLikelihoods(features, &loglikes);
+
       for (int32 i = 0; i < features.NumRows(); i++) {
         std::vector<bool> flag(mono2tri.NumRows(), true);
 
         for (int32 j = 0; j < noise_am_gmm.NumPdfs(); j++) {
-          SubVector<BaseFloat> feat_row(features, i);
-          loglikes(j) = noise_am_gmm.LogLikelihood(j, feat_row);
 
           for (int32 k = 0; k < mono2tri.NumRows(); ++k) {
             if (mono2tri(k, j) > 0.0) {
               if (flag[k]) {
-                logposts(i, k) = loglikes(j);
+                logposts(i, k) = loglikes(i, j);
                 flag[k] = false;
               } else {
-                logposts(i, k) = LogAdd(logposts(i, k), loglikes(j));
+                logposts(i, k) = LogAdd(logposts(i, k), loglikes(i, j));
               }
             }
           }
@@ -0,0 +1,102 @@
+/*
+ * vts-convert-noise-params.cc
+ *
+ * Convert the legacy per-utterance noise parameters, i.e. the three
+ * DoubleVector records "<utt>_mu_h", "<utt>_mu_z" and "<utt>_var_z",
+ * into the compact NoiseParams archive keyed by the utterance id.
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Troy Lee (troy.lee2008@gmail.com)
+ */
+
+#include <map>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "vts/vts-noise-params.h"
+
+int main(int argc, char* argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Convert legacy noise parameters (<utt>_mu_h, <utt>_mu_z, <utt>_var_z) to "
+            "the compact NoiseParams format.\n"
+            "Usage: vts-convert-noise-params [options] legacy-noise-rspecifier noiseparams-wspecifier\n"
+            "e.g.: vts-convert-noise-params ark:noise.ark ark:noise_params.ark\n";
+    ParseOptions po(usage);
+    bool reverse = false;
+
+    po.Register("reverse", &reverse,
+                "Convert from the compact format back to the legacy format");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string noise_rspecifier = po.GetArg(1), noise_wspecifier = po.GetArg(
+        2);
+
+    int32 num_done = 0, num_fail = 0;
+
+    if (reverse) {
+      SequentialNoiseParamsReader noise_reader(noise_rspecifier);
+      DoubleVectorWriter legacy_writer(noise_wspecifier);
+
+      for (; !noise_reader.Done(); noise_reader.Next()) {
+        std::string key = noise_reader.Key();
+        const NoiseParams &params = noise_reader.Value();
+        legacy_writer.Write(key + "_mu_h", Vector<double>(params.MuH()));
+        legacy_writer.Write(key + "_mu_z", Vector<double>(params.MuZ()));
+        legacy_writer.Write(key + "_var_z", Vector<double>(params.VarZ()));
+        ++num_done;
+      }
+    } else {
+      SequentialDoubleVectorReader legacy_reader(noise_rspecifier);
+      NoiseParamsWriter noise_writer(noise_wspecifier);
+
+      // the three records of an utterance are normally adjacent,
+      // keep the incomplete ones until all of them are seen
+      std::map<std::string, std::vector<Vector<double> > > pending;
+
+      for (; !legacy_reader.Done(); legacy_reader.Next()) {
+        std::string utt;
+        int32 index;
+        if (!SplitLegacyNoiseKey(legacy_reader.Key(), &utt, &index)) {
+          KALDI_WARN << "Not a noise parameter key: " << legacy_reader.Key();
+          continue;
+        }
+
+        std::vector<Vector<double> > &params = pending[utt];
+        params.resize(3);
+        params[index] = legacy_reader.Value();
+
+        if (params[0].Dim() > 0 && params[1].Dim() > 0
+            && params[2].Dim() > 0) {
+          noise_writer.Write(utt, NoiseParams(params[0], params[1], params[2]));
+          pending.erase(utt);
+          ++num_done;
+        }
+      }
+
+      for (std::map<std::string, std::vector<Vector<double> > >::iterator it =
+          pending.begin(); it != pending.end(); ++it) {
+        KALDI_WARN << "Not all the noise parameters (mu_h, mu_z, var_z) are available for "
+            << it->first;
+        ++num_fail;
+      }
+    }
+
+    KALDI_LOG << "Converted " << num_done << " utterances, " << num_fail
+        << " incomplete.";
+
+    return (num_done != 0 ? 0 : 1);
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -16,6 +16,7 @@
 #include "util/timer.h"
 #include "gmm/diag-gmm-normal.h"
 #include "vts/vts-first-order.h"
+#include "vts/vts-noise-params.h"
 #include "feat/feature-functions.h"
 
 int main(int argc, char *argv[]) {
@@ -40,12 +41,17 @@ int main(int argc, char *argv[]) {
     int32 num_cepstral = 13;
     int32 num_fbank = 26;
     BaseFloat ceplifter = 22;
+    bool legacy_noise = true;
 
     po.Register("num-cepstral", &num_cepstral, "Number of Cepstral features");
     po.Register("num-fbank", &num_fbank,
                 "Number of FBanks used to generate the Cepstral features");
     po.Register("ceplifter", &ceplifter,
                 "CepLifter value used for feature extraction");
+    po.Register("legacy-noise-params", &legacy_noise,
+                "Noise parameters are stored as <utt>_mu_h, <utt>_mu_z, <utt>_var_z vectors, "
+                "as written by the noise estimation tools (false: the compact archive of "
+                "vts-convert-noise-params)");
 
     opts.Register(&po);
 
@@ -71,7 +77,7 @@ int main(int argc, char *argv[]) {
 
     SequentialBaseFloatMatrixReader noisy_feature_reader(
         noisy_feature_rspecifier);
-    RandomAccessDoubleVectorReader noiseparams_reader(noiseparams_rspecifier);
+    NoiseParamsReader noiseparams_reader(noiseparams_rspecifier, legacy_noise);
     BaseFloatMatrixWriter clean_feature_writer(clean_feature_wspecifier);
 
     int num_success = 0, num_fail = 0;
@@ -97,9 +103,7 @@ int main(int argc, char *argv[]) {
         continue;
       }
 
-      if (!noiseparams_reader.HasKey(key + "_mu_h")
-          || !noiseparams_reader.HasKey(key + "_mu_z")
-          || !noiseparams_reader.HasKey(key + "_var_z")) {
+      if (!noiseparams_reader.HasKey(key)) {
         KALDI_ERR
             << "Not all the noise parameters (mu_h, mu_z, var_z) are available!";
           }
@@ -114,9 +118,8 @@ int main(int argc, char *argv[]) {
          Extract the noise parameters
          *************************************************/
 
-      Vector<double> mu_h(noiseparams_reader.Value(key + "_mu_h"));
-      Vector<double> mu_z(noiseparams_reader.Value(key + "_mu_z"));
-      Vector<double> var_z(noiseparams_reader.Value(key + "_var_z"));
+      Vector<double> mu_h, mu_z, var_z;
+      noiseparams_reader.Value(key).GetParams(&mu_h, &mu_z, &var_z);
 
       if (g_kaldi_verbose_level >= 1) {
         KALDI_LOG<< "Additive Noise Mean: " << mu_z;
@@ -19,6 +19,7 @@
 #include "lat/kaldi-lattice.h" // for CompactLatticeArc
 #include "gmm/diag-gmm-normal.h"
 #include "vts/vts-first-order.h"
+#include "vts/vts-noise-params.h"
 
 namespace kaldi {
 
@@ -73,6 +74,7 @@ int main(int argc, char *argv[]) {
     int32 num_cepstral = 13;
     int32 num_fbank = 26;
     BaseFloat ceplifter = 22;
+    bool legacy_noise = true;
 
     std::string word_syms_filename;
     FasterDecoderOptions decoder_opts;
@@ -86,6 +88,10 @@ int main(int argc, char *argv[]) {
                 "Number of FBanks used to generate the Cepstral features");
     po.Register("ceplifter", &ceplifter,
                 "CepLifter value used for feature extraction");
+    po.Register("legacy-noise-params", &legacy_noise,
+                "Noise parameters are stored as <utt>_mu_h, <utt>_mu_z, <utt>_var_z vectors, "
+                "as written by the noise estimation tools (false: the compact archive of "
+                "vts-convert-noise-params)");
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename,
@@ -126,7 +132,7 @@ int main(int argc, char *argv[]) {
             << word_syms_filename;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessDoubleVectorReader noiseparams_reader(noiseparams_rspecifier);
+    NoiseParamsReader noiseparams_reader(noiseparams_rspecifier, legacy_noise);
 
     // It's important that we initialize decode_fst after feature_reader, as it
     // can prevent crashes on systems installed without enough virtual memory.
@@ -161,9 +167,7 @@ int main(int argc, char *argv[]) {
         continue;
       }
 
-      if (!noiseparams_reader.HasKey(key + "_mu_h")
-          || !noiseparams_reader.HasKey(key + "_mu_z")
-          || !noiseparams_reader.HasKey(key + "_var_z")) {
+      if (!noiseparams_reader.HasKey(key)) {
         KALDI_ERR
             << "Not all the noise parameters (mu_h, mu_z, var_z) are available!";
       }
@@ -178,9 +182,8 @@ int main(int argc, char *argv[]) {
        Extract the noise parameters
        *************************************************/
 
-      Vector<double> mu_h(noiseparams_reader.Value(key + "_mu_h"));
-      Vector<double> mu_z(noiseparams_reader.Value(key + "_mu_z"));
-      Vector<double> var_z(noiseparams_reader.Value(key + "_var_z"));
+      Vector<double> mu_h, mu_z, var_z;
+      noiseparams_reader.Value(key).GetParams(&mu_h, &mu_z, &var_z);
 
       if (g_kaldi_verbose_level >= 1) {
         KALDI_LOG << "Additive Noise Mean: " << mu_z;
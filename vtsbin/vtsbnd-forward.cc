@@ -21,6 +21,8 @@
 #include "util/timer.h"
 
 #include "vts/vts-first-order.h"
+#include "vts/vts-multi-frame.h"
+#include "vts/vts-noise-params.h"
 #include "vts/dbnvts-first-order.h"
 #include "vts/vtsbnd-first-order.h"
 
@@ -96,8 +98,18 @@ int main(int argc, char *argv[]) {
         &no_softmax,
         "No softmax on MLP output. The MLP outputs directly log-likelihoods, log-priors will be subtracted");
 
+    bool legacy_noise = true;
+    po.Register("legacy-noise-params", &legacy_noise,
+                "Noise parameters are stored as <utt>_mu_h, <utt>_mu_z, <utt>_var_z vectors, "
+                "as written by the noise estimation tools (false: the compact archive of "
+                "vts-convert-noise-params)");
+
     po.Register("silent", &silent, "Don't print any messages");
 
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads,
+                "Number of threads for the VTS compensation of the pdfs");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 9) {
@@ -218,10 +230,22 @@ int main(int argc, char *argv[]) {
     GenerateDCTmatrix(num_cepstral, num_fbank, ceplifter, &dct_mat,
                       &inv_dct_mat);
 
+    // one compensator per clean model, the noisy copies keep the structure
+    // and get new means, variances and gconsts from each Compensate()
+    pos_noise_am.CopyFromAmDiagGmm(pos_am_gmm);
+    neg_noise_am.CopyFromAmDiagGmm(neg_am_gmm);
+    MultiFrameCompensator pos_vts, neg_vts;
+    pos_vts.Init(dct_mat, inv_dct_mat, num_frames);
+    pos_vts.SetNumThreads(num_threads);
+    pos_vts.SetCleanModel(pos_noise_am);
+    neg_vts.Init(dct_mat, inv_dct_mat, num_frames);
+    neg_vts.SetNumThreads(num_threads);
+    neg_vts.SetCleanModel(neg_noise_am);
+
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessDoubleVectorReader noiseparams_reader(noise_params_rspecifier);
+    NoiseParamsReader noiseparams_reader(noise_params_rspecifier, legacy_noise);
     BaseFloatMatrixWriter feature_writer(feature_wspecifier);
 
     CuMatrix<BaseFloat> feat_dev, nnet_out_dev;
@@ -264,15 +288,12 @@ int main(int argc, char *argv[]) {
       const Matrix<BaseFloat> &feat = feature_reader.Value();
 
       // read noise parameters
-      if (!noiseparams_reader.HasKey(key + "_mu_h")
-          || !noiseparams_reader.HasKey(key + "_mu_z")
-          || !noiseparams_reader.HasKey(key + "_var_z")) {
+      if (!noiseparams_reader.HasKey(key)) {
         KALDI_ERR
             << "Not all the noise parameters (mu_h, mu_z, var_z) are available!";
       }
-      Vector<double> mu_h(noiseparams_reader.Value(key + "_mu_h"));
-      Vector<double> mu_z(noiseparams_reader.Value(key + "_mu_z"));
-      Vector<double> var_z(noiseparams_reader.Value(key + "_var_z"));
+      Vector<double> mu_h, mu_z, var_z;
+      noiseparams_reader.Value(key).GetParams(&mu_h, &mu_z, &var_z);
       if (g_kaldi_verbose_level >= 1) {
         KALDI_LOG << "Additive Noise Mean: " << mu_z;
         KALDI_LOG << "Additive Noise Covariance: " << var_z;
@@ -280,15 +301,8 @@ int main(int argc, char *argv[]) {
       }
 
       // compensate the postive and negative gmm models
-      pos_noise_am.CopyFromAmDiagGmm(pos_am_gmm);
-      CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-                              num_fbank, dct_mat, inv_dct_mat, num_frames,
-                              pos_noise_am);
-
-      neg_noise_am.CopyFromAmDiagGmm(neg_am_gmm);
-      CompensateMultiFrameGmm(mu_h, mu_z, var_z, compensate_var, num_cepstral,
-                              num_fbank, dct_mat, inv_dct_mat, num_frames,
-                              neg_noise_am);
+      pos_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &pos_noise_am);
+      neg_vts.Compensate(mu_h, mu_z, var_z, compensate_var, &neg_noise_am);
 
       // convert back to normalized feature space under noisy conditions if necessary
       if (cmvn_stats_rspecifier != "") {